@@ -0,0 +1,120 @@
+#include "bm-append-text-sink.hpp"
+
+#include "bm-artifact-sync.hpp"
+#include "bm-xml-emitter.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+
+namespace bm {
+
+bool AppendOnlyTextSink::on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &,
+					 const MarkerList &full_marker_list, QString *error)
+{
+	if (!is_mp4_or_mov_path(recording_ctx.media_path))
+		return true;
+
+	const FrameRate rate = FrameRate::from_obs(recording_ctx.fps_num, recording_ctx.fps_den);
+	const QString artifact_path = artifact_path_for_media(recording_ctx.media_path);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_files.find(recording_ctx.media_path);
+	if (it == m_files.end() || it->written > full_marker_list.size() || it->fps_num != rate.num() ||
+	    it->fps_den != rate.den() || QFileInfo(artifact_path).size() != it->file_size) {
+		FileState state;
+		if (!rewrite_locked(artifact_path, recording_ctx, full_marker_list, rate, &state, error)) {
+			m_files.remove(recording_ctx.media_path);
+			return false;
+		}
+		m_files.insert(recording_ctx.media_path, state);
+		return true;
+	}
+
+	if (it->written == full_marker_list.size())
+		return true;
+	if (append_locked(artifact_path, full_marker_list, rate, &*it, error))
+		return true;
+	// Whatever reached the file is unknown now; the next marker rewrites it.
+	m_files.erase(it);
+	return false;
+}
+
+bool AppendOnlyTextSink::on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_files.remove(recording_ctx.media_path);
+	return true;
+}
+
+bool AppendOnlyTextSink::rewrite_locked(const QString &artifact_path, const MarkerExportRecordingContext &recording_ctx,
+					const MarkerList &markers, const FrameRate &rate, FileState *state,
+					QString *error)
+{
+	QByteArray contents;
+	append_header(contents, recording_ctx, rate);
+	for (int i = 0; i < markers.size(); ++i)
+		append_record(contents, markers.at(i), i, rate);
+
+	QString write_error;
+	if (!write_artifact(artifact_path, contents, recording_ctx.sync_batch, &write_error)) {
+		if (error)
+			*error = QString("%1 (%2)").arg(write_error, sink_name());
+		return false;
+	}
+
+	state->written = static_cast<int>(markers.size());
+	state->file_size = contents.size();
+	state->fps_num = rate.num();
+	state->fps_den = rate.den();
+	return true;
+}
+
+bool AppendOnlyTextSink::append_locked(const QString &artifact_path, const MarkerList &markers,
+				       const FrameRate &rate, FileState *state, QString *error)
+{
+	QByteArray records;
+	for (int i = state->written; i < markers.size(); ++i)
+		append_record(records, markers.at(i), i, rate);
+
+	QFile file(artifact_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+		if (error)
+			*error = QString("Failed to open %1 for append: %2").arg(sink_name(), artifact_path);
+		return false;
+	}
+	if (file.write(records) != records.size()) {
+		if (error)
+			*error = QString("Failed to append to %1: %2").arg(sink_name(), artifact_path);
+		return false;
+	}
+	file.close();
+
+	state->written = static_cast<int>(markers.size());
+	state->file_size += records.size();
+	return true;
+}
+
+void AppendOnlyTextSink::append_decimal(QByteArray &out, int64_t value, int min_digits)
+{
+	char digits[kMaxDecimalSize];
+	const char *const end = write_decimal(digits, value);
+	for (qsizetype pad = min_digits - (end - digits); pad > 0; --pad)
+		out.append('0');
+	out.append(digits, static_cast<qsizetype>(end - digits));
+}
+
+void AppendOnlyTextSink::append_timecode(QByteArray &out, const FrameRate &rate, int64_t frame)
+{
+	char timecode[FrameRate::kMaxTimecodeSize];
+	const char *const end = rate.write_timecode(timecode, frame);
+	out.append(timecode, static_cast<qsizetype>(end - timecode));
+}
+
+void AppendOnlyTextSink::append_single_line(QByteArray &out, const QString &text)
+{
+	QByteArray utf8 = text.toUtf8();
+	utf8.replace('\r', ' ').replace('\n', ' ');
+	out.append(utf8);
+}
+
+} // namespace bm
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "bm-frame-rate.hpp"
+#include "bm-marker-export-sink.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <cstdint>
+#include <mutex>
+
+namespace bm {
+
+// Base for sinks whose artifact is a UTF-8 text file with one record per marker, which other tools can tail while the
+// recording runs. The first write for a recording rewrites the file with the header and every marker; after that each
+// new marker is a single append at the end of the file, whatever the length of the list. The file is rewritten in
+// full again when the frame rate changes or it no longer has the size this sink left it at. Rewrites go through the
+// marker event's sync batch; appends are left to the OS, as the marker journal already holds every record durably.
+class AppendOnlyTextSink : public MarkerExportSink {
+public:
+	bool on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &marker,
+			     const MarkerList &full_marker_list, QString *error) override;
+	bool on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *error) override;
+
+	virtual QString artifact_path_for_media(const QString &media_path) const = 0;
+
+protected:
+	// Written once at the top of the file; may be empty.
+	virtual void append_header(QByteArray &out, const MarkerExportRecordingContext &recording_ctx,
+				   const FrameRate &rate) const = 0;
+	// The record for the marker at position index (0-based) of the recording, including its line break(s).
+	virtual void append_record(QByteArray &out, const MarkerRecord &marker, int index,
+				   const FrameRate &rate) const = 0;
+
+	static void append_decimal(QByteArray &out, int64_t value, int min_digits = 1);
+	static void append_timecode(QByteArray &out, const FrameRate &rate, int64_t frame);
+	// UTF-8 with CR and LF replaced by spaces, for formats whose records are single lines.
+	static void append_single_line(QByteArray &out, const QString &text);
+
+private:
+	struct FileState {
+		int written = 0;
+		qint64 file_size = 0;
+		uint32_t fps_num = 0;
+		uint32_t fps_den = 0;
+	};
+
+	bool rewrite_locked(const QString &artifact_path, const MarkerExportRecordingContext &recording_ctx,
+			    const MarkerList &markers, const FrameRate &rate, FileState *state,
+			    QString *error);
+	bool append_locked(const QString &artifact_path, const MarkerList &markers, const FrameRate &rate,
+			   FileState *state, QString *error);
+
+	std::mutex m_mutex;
+	QHash<QString, FileState> m_files;
+};
+
+} // namespace bm
@@ -0,0 +1,432 @@
+#include "bm-artifact-sync.hpp"
+
+#include "bm-file-integrity.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QUuid>
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bm {
+namespace {
+
+using Clock = ArtifactSyncer::Clock;
+
+qint64 elapsed_ns(Clock::time_point begin)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+}
+
+// Unique per write, so two batches replacing the same artifact never share a temp file.
+QString temp_path_for(const QString &path)
+{
+	return QString("%1.%2.tmp").arg(path, QUuid::createUuid().toString(QUuid::Id128).left(12));
+}
+
+QString directory_of(const QString &path)
+{
+	return QFileInfo(path).absolutePath();
+}
+
+// Renames from over to, replacing it. QFile::rename refuses to overwrite.
+bool replace_path(const QString &from, const QString &to)
+{
+#if defined(_WIN32)
+	return MoveFileExW(reinterpret_cast<const wchar_t *>(from.utf16()),
+			   reinterpret_cast<const wchar_t *>(to.utf16()),
+			   MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+// Makes the renames into a directory durable. Windows has no directory sync; MOVEFILE_WRITE_THROUGH covers the rename.
+bool sync_directory(const QString &directory, ArtifactSyncStats *stats)
+{
+#if defined(_WIN32)
+	Q_UNUSED(directory);
+	Q_UNUSED(stats);
+	return true;
+#else
+	const Clock::time_point begin = Clock::now();
+	const int fd = ::open(QFile::encodeName(directory).constData(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	const bool ok = fsync(fd) == 0;
+	::close(fd);
+	++stats->directory_syncs;
+	stats->sync_ns += elapsed_ns(begin);
+	return ok;
+#endif
+}
+
+bool sync_counted(QFile &file, ArtifactSyncStats *stats)
+{
+	const Clock::time_point begin = Clock::now();
+	const bool ok = sync_file_to_disk(file);
+	++stats->file_syncs;
+	stats->sync_ns += elapsed_ns(begin);
+	return ok;
+}
+
+// Opens path for a sync of what is already written to it.
+bool open_for_sync(QFile &file)
+{
+#if defined(_WIN32)
+	// _commit needs a handle with write access.
+	return file.open(QIODevice::ReadWrite | QIODevice::ExistingOnly);
+#else
+	return file.open(QIODevice::ReadOnly);
+#endif
+}
+
+// Starts writeback of a staged temp file so the sync at commit finds most of it on disk already.
+void start_writeback(QFile &file)
+{
+#if defined(__linux__)
+	if (file.flush())
+		sync_file_range(file.handle(), 0, 0, SYNC_FILE_RANGE_WRITE);
+#else
+	Q_UNUSED(file);
+#endif
+}
+
+void append_error(QString *error, const QString &message)
+{
+	if (!error)
+		return;
+	const QString prefix = error->isEmpty() ? QString() : QString("; ");
+	*error += prefix + message;
+}
+
+} // namespace
+
+void ArtifactSyncStats::add(const ArtifactSyncStats &other)
+{
+	artifacts += other.artifacts;
+	file_syncs += other.file_syncs;
+	directory_syncs += other.directory_syncs;
+	sync_ns += other.sync_ns;
+}
+
+ArtifactSyncer::ArtifactSyncer()
+{
+	m_thread = std::thread([this]() { run(); });
+}
+
+ArtifactSyncer::~ArtifactSyncer()
+{
+	stop();
+}
+
+void ArtifactSyncer::set_policy(ArtifactDurability durability, int window_ms)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_durability = durability;
+		m_window_ms = std::clamp(window_ms, kMinArtifactSyncWindowMs, kMaxArtifactSyncWindowMs);
+	}
+	m_cv.notify_one();
+}
+
+ArtifactDurability ArtifactSyncer::durability() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_durability;
+}
+
+void ArtifactSyncer::set_deferred_sync_callback(DeferredSyncCallback callback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_callback = std::move(callback);
+}
+
+bool ArtifactSyncer::sync_deferred(ArtifactSyncStats *synced, QString *error)
+{
+	std::lock_guard<std::mutex> sync_lock(m_sync_mutex);
+	QVector<QString> paths;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		paths.swap(m_deferred);
+	}
+
+	// An artifact replaced several times in the window is synced once, in its latest version.
+	ArtifactSyncStats stats;
+	bool ok = true;
+	QSet<QString> seen;
+	QVector<QString> directories;
+	for (const QString &path : paths) {
+		// Removed since it was written; nothing left to make durable.
+		if (seen.contains(path) || !QFile::exists(path))
+			continue;
+		seen.insert(path);
+		QFile file(path);
+		if (!open_for_sync(file) || !sync_counted(file, &stats)) {
+			ok = false;
+			append_error(error, QString("Failed to sync artifact: %1").arg(path));
+		}
+		const QString directory = directory_of(path);
+		if (!directories.contains(directory))
+			directories.push_back(directory);
+	}
+	for (const QString &directory : directories) {
+		if (!sync_directory(directory, &stats)) {
+			ok = false;
+			append_error(error, QString("Failed to sync directory: %1").arg(directory));
+		}
+	}
+
+	record(stats);
+	if (synced)
+		*synced = stats;
+	return ok;
+}
+
+void ArtifactSyncer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+	sync_deferred(nullptr, nullptr);
+}
+
+int ArtifactSyncer::deferred_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_deferred.size());
+}
+
+ArtifactSyncStats ArtifactSyncer::totals() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_totals;
+}
+
+void ArtifactSyncer::defer(const QString &path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// The window starts at the first unsynced artifact, so a steady stream of markers cannot postpone it.
+		if (m_deferred.isEmpty())
+			m_deferred_since = Clock::now();
+		m_deferred.push_back(path);
+	}
+	m_cv.notify_one();
+}
+
+void ArtifactSyncer::record(const ArtifactSyncStats &stats)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_totals.add(stats);
+}
+
+void ArtifactSyncer::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stopping) {
+		if (m_deferred.isEmpty()) {
+			m_cv.wait(lock);
+			continue;
+		}
+		const Clock::time_point due = m_deferred_since + std::chrono::milliseconds(m_window_ms);
+		if (Clock::now() < due) {
+			m_cv.wait_until(lock, due);
+			continue;
+		}
+
+		const DeferredSyncCallback callback = m_callback;
+		lock.unlock();
+		ArtifactSyncStats synced;
+		QString error;
+		sync_deferred(&synced, &error);
+		if (callback && (synced.file_syncs > 0 || !error.isEmpty()))
+			callback(synced, error);
+		lock.lock();
+	}
+}
+
+ArtifactSyncBatch::ArtifactSyncBatch(ArtifactSyncer *syncer)
+	: m_syncer(syncer),
+	  m_durability(syncer ? syncer->durability() : ArtifactDurability::Strict)
+{
+}
+
+ArtifactSyncBatch::~ArtifactSyncBatch()
+{
+	commit(nullptr);
+}
+
+bool ArtifactSyncBatch::replace_file(const QString &path, const QByteArray &contents, QString *error)
+{
+	StagedFile staged;
+	staged.temp = std::make_unique<QFile>(temp_path_for(path));
+	staged.path = path;
+	QFile &temp = *staged.temp;
+	if (!temp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		if (error)
+			*error = QString("Failed to open artifact for write: %1").arg(path);
+		return false;
+	}
+	if (temp.write(contents) != contents.size() || !temp.flush()) {
+		temp.remove();
+		if (error)
+			*error = QString("Failed to write artifact: %1").arg(path);
+		return false;
+	}
+
+	switch (m_durability) {
+	case ArtifactDurability::Grouped:
+		start_writeback(temp);
+		m_staged.push_back(std::move(staged));
+		return true;
+	case ArtifactDurability::Deferred:
+		temp.close();
+		if (!replace_path(temp.fileName(), path)) {
+			temp.remove();
+			if (error)
+				*error = QString("Failed to replace artifact: %1").arg(path);
+			return false;
+		}
+		++m_stats.artifacts;
+		if (m_syncer)
+			m_syncer->defer(path);
+		return true;
+	case ArtifactDurability::Strict:
+	default:
+		break;
+	}
+
+	if (!sync_counted(temp, &m_stats)) {
+		temp.remove();
+		if (error)
+			*error = QString("Failed to sync artifact: %1").arg(path);
+		return false;
+	}
+	temp.close();
+	if (!replace_path(temp.fileName(), path)) {
+		temp.remove();
+		if (error)
+			*error = QString("Failed to replace artifact: %1").arg(path);
+		return false;
+	}
+	++m_stats.artifacts;
+	if (!sync_directory(directory_of(path), &m_stats)) {
+		if (error)
+			*error = QString("Failed to sync directory of artifact: %1").arg(path);
+		return false;
+	}
+	return true;
+}
+
+bool ArtifactSyncBatch::sync_in_place(QFile &file, QString *error)
+{
+	const QString path = file.fileName();
+	if (m_durability != ArtifactDurability::Strict && !file.flush()) {
+		if (error)
+			*error = QString("Failed to write artifact: %1").arg(path);
+		return false;
+	}
+
+	switch (m_durability) {
+	case ArtifactDurability::Grouped:
+		start_writeback(file);
+		if (!m_in_place.contains(path))
+			m_in_place.push_back(path);
+		return true;
+	case ArtifactDurability::Deferred:
+		++m_stats.artifacts;
+		if (m_syncer)
+			m_syncer->defer(path);
+		return true;
+	case ArtifactDurability::Strict:
+	default:
+		break;
+	}
+
+	if (!sync_counted(file, &m_stats)) {
+		if (error)
+			*error = QString("Failed to sync artifact: %1").arg(path);
+		return false;
+	}
+	++m_stats.artifacts;
+	return true;
+}
+
+bool ArtifactSyncBatch::commit(QString *error)
+{
+	if (m_committed)
+		return true;
+	m_committed = true;
+
+	bool ok = true;
+	QVector<QString> directories;
+	for (StagedFile &staged : m_staged) {
+		QFile &temp = *staged.temp;
+		if (!sync_counted(temp, &m_stats)) {
+			ok = false;
+			temp.remove();
+			append_error(error, QString("Failed to sync artifact: %1").arg(staged.path));
+			continue;
+		}
+		temp.close();
+		if (!replace_path(temp.fileName(), staged.path)) {
+			ok = false;
+			temp.remove();
+			append_error(error, QString("Failed to replace artifact: %1").arg(staged.path));
+			continue;
+		}
+		++m_stats.artifacts;
+		const QString directory = directory_of(staged.path);
+		if (!directories.contains(directory))
+			directories.push_back(directory);
+	}
+	m_staged.clear();
+
+	// Nothing was renamed, so these need no directory sync.
+	for (const QString &path : m_in_place) {
+		QFile file(path);
+		if (!open_for_sync(file) || !sync_counted(file, &m_stats)) {
+			ok = false;
+			append_error(error, QString("Failed to sync artifact: %1").arg(path));
+			continue;
+		}
+		++m_stats.artifacts;
+	}
+	m_in_place.clear();
+
+	// One directory sync covers every rename the batch made into it.
+	for (const QString &directory : directories) {
+		if (!sync_directory(directory, &m_stats)) {
+			ok = false;
+			append_error(error, QString("Failed to sync directory: %1").arg(directory));
+		}
+	}
+
+	if (m_syncer)
+		m_syncer->record(m_stats);
+	return ok;
+}
+
+bool write_artifact(const QString &path, const QByteArray &contents, ArtifactSyncBatch *batch, QString *error)
+{
+	if (batch)
+		return batch->replace_file(path, contents, error);
+	ArtifactSyncBatch strict(nullptr);
+	return strict.replace_file(path, contents, error);
+}
+
+} // namespace bm
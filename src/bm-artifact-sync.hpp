@@ -0,0 +1,128 @@
+#pragma once
+
+#include "bm-models.hpp"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class QFile;
+
+namespace bm {
+
+// What a batch or a deferred sync actually issued.
+struct ArtifactSyncStats {
+	int artifacts = 0;
+	int file_syncs = 0;
+	int directory_syncs = 0;
+	// Wall time spent inside those syncs.
+	qint64 sync_ns = 0;
+
+	void add(const ArtifactSyncStats &other);
+	double sync_ms() const { return static_cast<double>(sync_ns) / 1e6; }
+};
+
+// Owns the artifact durability policy for the whole plugin and the artifacts Deferred left unsynced. Those are synced
+// together on the syncer thread artifact_sync_window_ms after the first of them, or earlier from sync_deferred().
+class ArtifactSyncer {
+public:
+	using Clock = std::chrono::steady_clock;
+	// Runs on the syncer thread after each window that synced something.
+	using DeferredSyncCallback = std::function<void(const ArtifactSyncStats &synced, const QString &error)>;
+
+	ArtifactSyncer();
+	~ArtifactSyncer();
+
+	ArtifactSyncer(const ArtifactSyncer &) = delete;
+	ArtifactSyncer &operator=(const ArtifactSyncer &) = delete;
+
+	// Batches created afterwards use the new policy. Artifacts already deferred keep their window.
+	void set_policy(ArtifactDurability durability, int window_ms);
+	ArtifactDurability durability() const;
+	void set_deferred_sync_callback(DeferredSyncCallback callback);
+
+	// Syncs every deferred artifact and its directory now, on the caller's thread. synced may be null.
+	bool sync_deferred(ArtifactSyncStats *synced, QString *error);
+	// Joins the syncer thread, then syncs whatever is still deferred.
+	void stop();
+
+	int deferred_count() const;
+	// Everything batches and deferred syncs issued so far.
+	ArtifactSyncStats totals() const;
+
+private:
+	friend class ArtifactSyncBatch;
+
+	void defer(const QString &path);
+	void record(const ArtifactSyncStats &stats);
+	void run();
+
+	// Held around each deferred sync; taken before m_mutex.
+	std::mutex m_sync_mutex;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	ArtifactDurability m_durability = ArtifactDurability::Grouped;
+	int m_window_ms = 2000;
+	QVector<QString> m_deferred;
+	Clock::time_point m_deferred_since;
+	ArtifactSyncStats m_totals;
+	DeferredSyncCallback m_callback;
+	bool m_stopping = false;
+	std::thread m_thread;
+};
+
+// The artifact writes of one marker event. Every write goes to a temp file next to the artifact and is renamed over
+// it, so readers only ever see a complete document; the policy the syncer had when the batch was created decides when
+// the syncs happen:
+//  - Strict: temp sync, rename and directory sync inside replace_file.
+//  - Grouped: replace_file only writes the temp file (starting its writeback where the OS allows); commit() syncs
+//    every temp file, renames them all and then syncs each directory once. The new contents appear at commit().
+//  - Deferred: replace_file renames right away and hands the artifact to the syncer.
+// Artifacts modified in place go through sync_in_place() and follow the same policy, minus the rename.
+// Sinks run one after another on a batch; it is committed (or destroyed, which commits) once they all returned.
+class ArtifactSyncBatch {
+public:
+	// A null syncer means Strict, counted only in stats().
+	explicit ArtifactSyncBatch(ArtifactSyncer *syncer);
+	~ArtifactSyncBatch();
+
+	ArtifactSyncBatch(const ArtifactSyncBatch &) = delete;
+	ArtifactSyncBatch &operator=(const ArtifactSyncBatch &) = delete;
+
+	ArtifactDurability durability() const { return m_durability; }
+
+	bool replace_file(const QString &path, const QByteArray &contents, QString *error);
+	// Called after file was written in place. Strict syncs it now, Grouped starts its writeback and syncs it at
+	// commit(), Deferred hands it to the syncer.
+	bool sync_in_place(QFile &file, QString *error);
+	// Artifacts whose sync or rename fails keep their previous contents; the error names each of them.
+	bool commit(QString *error);
+
+	const ArtifactSyncStats &stats() const { return m_stats; }
+
+private:
+	struct StagedFile {
+		std::unique_ptr<QFile> temp;
+		QString path;
+	};
+
+	ArtifactSyncer *const m_syncer;
+	const ArtifactDurability m_durability;
+	std::vector<StagedFile> m_staged;
+	QVector<QString> m_in_place;
+	ArtifactSyncStats m_stats;
+	bool m_committed = false;
+};
+
+// Replaces path with contents through batch, or with a Strict write of its own when batch is null.
+bool write_artifact(const QString &path, const QByteArray &contents, ArtifactSyncBatch *batch, QString *error);
+
+} // namespace bm
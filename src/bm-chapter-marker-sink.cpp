@@ -0,0 +1,45 @@
+#include "bm-chapter-marker-sink.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+
+namespace bm {
+
+QString ChapterMarkerSink::sink_name() const
+{
+	return "chapters";
+}
+
+QString ChapterMarkerSink::artifact_path_for_media(const QString &media_path) const
+{
+	const QFileInfo info(media_path);
+	return info.dir().filePath(info.completeBaseName() + ".better-markers.chapters.txt");
+}
+
+void ChapterMarkerSink::append_header(QByteArray &, const MarkerExportRecordingContext &, const FrameRate &) const {}
+
+void ChapterMarkerSink::append_record(QByteArray &out, const MarkerRecord &marker, int index,
+				      const FrameRate &rate) const
+{
+	const int64_t frame = marker.start_frame > 0 ? marker.start_frame : 0;
+	const int64_t seconds = frame * static_cast<int64_t>(rate.den()) / rate.num();
+	const QString name = marker.name.trimmed();
+
+	// The header is written before any record is known, so the opening chapter goes in front of the first one.
+	if (index == 0 && seconds > 0)
+		out.append("0:00 Start\n");
+	if (seconds >= 3600) {
+		append_decimal(out, seconds / 3600);
+		out.append(':');
+		append_decimal(out, seconds / 60 % 60, 2);
+	} else {
+		append_decimal(out, seconds / 60);
+	}
+	out.append(':');
+	append_decimal(out, seconds % 60, 2);
+	out.append(' ');
+	append_single_line(out, name.isEmpty() ? QString("Marker") : name);
+	out.append('\n');
+}
+
+} // namespace bm
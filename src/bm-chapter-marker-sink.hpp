@@ -0,0 +1,22 @@
+#pragma once
+
+#include "bm-append-text-sink.hpp"
+
+namespace bm {
+
+// YouTube description chapters: one "M:SS Title" line per marker ("H:MM:SS" from the first hour on), ready to paste
+// below a video. YouTube only shows chapters when the first one starts at 0:00, so a "0:00 Start" line leads the list
+// when the first marker is later.
+class ChapterMarkerSink : public AppendOnlyTextSink {
+public:
+	QString sink_name() const override;
+	QString artifact_path_for_media(const QString &media_path) const override;
+
+protected:
+	void append_header(QByteArray &out, const MarkerExportRecordingContext &recording_ctx,
+			   const FrameRate &rate) const override;
+	void append_record(QByteArray &out, const MarkerRecord &marker, int index,
+			   const FrameRate &rate) const override;
+};
+
+} // namespace bm
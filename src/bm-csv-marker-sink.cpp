@@ -0,0 +1,76 @@
+#include "bm-csv-marker-sink.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+
+namespace bm {
+namespace {
+
+// Stable English keys rather than the localized labels, so the column can be matched by scripts.
+const char *color_key(int color_id)
+{
+	static const char *const keys[] = {"green", "red",  "orange",   "yellow", "white",
+					   "blue",  "cyan", "lavender", "magenta"};
+	return color_id >= 0 && color_id < 9 ? keys[color_id] : keys[0];
+}
+
+void append_field(QByteArray &out, const QString &text)
+{
+	const QByteArray utf8 = text.toUtf8();
+	if (utf8.indexOf(',') < 0 && utf8.indexOf('"') < 0 && utf8.indexOf('\n') < 0 && utf8.indexOf('\r') < 0) {
+		out.append(utf8);
+		return;
+	}
+	out.append('"');
+	for (const char c : utf8) {
+		if (c == '"')
+			out.append('"');
+		out.append(c);
+	}
+	out.append('"');
+}
+
+} // namespace
+
+QString CsvMarkerSink::sink_name() const
+{
+	return "csv";
+}
+
+QString CsvMarkerSink::artifact_path_for_media(const QString &media_path) const
+{
+	const QFileInfo info(media_path);
+	return info.dir().filePath(info.completeBaseName() + ".better-markers.csv");
+}
+
+void CsvMarkerSink::append_header(QByteArray &out, const MarkerExportRecordingContext &, const FrameRate &) const
+{
+	out.append("index,frame,timecode,seconds,duration_frames,color,name,comment,guid\n");
+}
+
+void CsvMarkerSink::append_record(QByteArray &out, const MarkerRecord &marker, int index, const FrameRate &rate) const
+{
+	// Seconds with millisecond precision, truncated, in integer arithmetic.
+	const int64_t millis = marker.start_frame * static_cast<int64_t>(rate.den()) * 1000 / rate.num();
+
+	append_decimal(out, index + 1);
+	out.append(',');
+	append_decimal(out, marker.start_frame);
+	out.append(',');
+	append_timecode(out, rate, marker.start_frame);
+	out.append(',');
+	append_decimal(out, millis / 1000);
+	out.append('.');
+	append_decimal(out, millis % 1000, 3);
+	out.append(',');
+	append_decimal(out, marker.duration_frames);
+	out.append(',').append(color_key(marker.color_id)).append(',');
+	append_field(out, marker.name);
+	out.append(',');
+	append_field(out, marker.comment);
+	out.append(',');
+	append_field(out, marker.guid);
+	out.append('\n');
+}
+
+} // namespace bm
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "bm-append-text-sink.hpp"
+
+namespace bm {
+
+// RFC 4180 CSV, one row per marker under a header row:
+// index,frame,timecode,seconds,duration_frames,color,name,comment,guid
+class CsvMarkerSink : public AppendOnlyTextSink {
+public:
+	QString sink_name() const override;
+	QString artifact_path_for_media(const QString &media_path) const override;
+
+protected:
+	void append_header(QByteArray &out, const MarkerExportRecordingContext &recording_ctx,
+			   const FrameRate &rate) const override;
+	void append_record(QByteArray &out, const MarkerRecord &marker, int index,
+			   const FrameRate &rate) const override;
+};
+
+} // namespace bm
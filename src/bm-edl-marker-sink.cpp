@@ -0,0 +1,81 @@
+#include "bm-edl-marker-sink.hpp"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+
+namespace bm {
+namespace {
+
+// Nearest Resolve marker colour for each Premiere colour id.
+const char *resolve_color_name(int color_id)
+{
+	switch (color_id) {
+	case 1:
+		return "ResolveColorRed";
+	case 2:
+		return "ResolveColorSand";
+	case 3:
+		return "ResolveColorYellow";
+	case 4:
+		return "ResolveColorCream";
+	case 5:
+		return "ResolveColorBlue";
+	case 6:
+		return "ResolveColorCyan";
+	case 7:
+		return "ResolveColorLavender";
+	case 8:
+		return "ResolveColorFuchsia";
+	default:
+		return "ResolveColorGreen";
+	}
+}
+
+} // namespace
+
+QString EdlMarkerSink::sink_name() const
+{
+	return "edl";
+}
+
+QString EdlMarkerSink::artifact_path_for_media(const QString &media_path) const
+{
+	const QFileInfo info(media_path);
+	return info.dir().filePath(info.completeBaseName() + ".better-markers.edl");
+}
+
+void EdlMarkerSink::append_header(QByteArray &out, const MarkerExportRecordingContext &recording_ctx,
+				  const FrameRate &rate) const
+{
+	const QString title = QFileInfo(recording_ctx.media_path).completeBaseName();
+	out.append("TITLE: ");
+	append_single_line(out, title.isEmpty() ? QString("Better Markers Export") : title);
+	out.append(rate.drop_frame() ? "\nFCM: DROP FRAME\n\n" : "\nFCM: NON-DROP FRAME\n\n");
+}
+
+void EdlMarkerSink::append_record(QByteArray &out, const MarkerRecord &marker, int index, const FrameRate &rate) const
+{
+	const int64_t duration = std::max<int64_t>(1, marker.duration_frames);
+	const int64_t end_frame = marker.start_frame + duration;
+	const QString name = marker.name.trimmed();
+
+	// Event line: number, reel, track, cut, then source in/out and record in/out.
+	append_decimal(out, index + 1, 3);
+	out.append("  001      V     C        ");
+	append_timecode(out, rate, marker.start_frame);
+	out.append(' ');
+	append_timecode(out, rate, end_frame);
+	out.append(' ');
+	append_timecode(out, rate, marker.start_frame);
+	out.append(' ');
+	append_timecode(out, rate, end_frame);
+	out.append("  \n |C:").append(resolve_color_name(marker.color_id)).append(" |M:");
+	append_single_line(out, name.isEmpty() ? QString("Marker") : name);
+	out.append(" |D:");
+	append_decimal(out, duration);
+	out.append("\n\n");
+}
+
+} // namespace bm
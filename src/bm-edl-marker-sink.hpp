@@ -0,0 +1,22 @@
+#pragma once
+
+#include "bm-append-text-sink.hpp"
+
+namespace bm {
+
+// CMX3600 EDL with one zero-length event per marker, in the locator layout DaVinci Resolve reads through
+// "Import > Timeline Markers from EDL" (and writes itself). Record times start at 00:00:00:00, like the FCPXML
+// exports, and are drop-frame at 29.97/59.94.
+class EdlMarkerSink : public AppendOnlyTextSink {
+public:
+	QString sink_name() const override;
+	QString artifact_path_for_media(const QString &media_path) const override;
+
+protected:
+	void append_header(QByteArray &out, const MarkerExportRecordingContext &recording_ctx,
+			   const FrameRate &rate) const override;
+	void append_record(QByteArray &out, const MarkerRecord &marker, int index,
+			   const FrameRate &rate) const override;
+};
+
+} // namespace bm
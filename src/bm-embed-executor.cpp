@@ -0,0 +1,310 @@
+#include "bm-embed-executor.hpp"
+
+#include <QFileInfo>
+
+#include <algorithm>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+
+#include <fstream>
+#endif
+
+namespace bm {
+
+const char *embed_submit_result_name(EmbedSubmitResult result)
+{
+	switch (result) {
+	case EmbedSubmitResult::Queued:
+		return "queued";
+	case EmbedSubmitResult::Coalesced:
+		return "coalesced";
+	case EmbedSubmitResult::QueueFull:
+		return "queue_full";
+	case EmbedSubmitResult::Stopped:
+	default:
+		return "stopped";
+	}
+}
+
+quint64 media_device_id(const QString &path)
+{
+#if defined(__linux__) || defined(__APPLE__)
+	struct stat st {};
+	if (::stat(path.toLocal8Bit().constData(), &st) == 0)
+		return static_cast<quint64>(st.st_dev);
+	if (::stat(QFileInfo(path).absolutePath().toLocal8Bit().constData(), &st) == 0)
+		return static_cast<quint64>(st.st_dev);
+	return 0;
+#else
+	Q_UNUSED(path);
+	return 0;
+#endif
+}
+
+bool media_device_is_rotational(quint64 device)
+{
+#if defined(__linux__)
+	if (device == 0)
+		return false;
+	const dev_t dev = static_cast<dev_t>(device);
+	const std::string base = "/sys/dev/block/" + std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+	// Partitions do not carry a queue directory; their parent disk does.
+	for (const char *suffix : {"/queue/rotational", "/../queue/rotational"}) {
+		std::ifstream in(base + suffix);
+		int value = 0;
+		if (in >> value)
+			return value != 0;
+	}
+	return false;
+#else
+	Q_UNUSED(device);
+	return false;
+#endif
+}
+
+EmbedExecutor::EmbedExecutor(const EmbedConcurrency &concurrency, int max_queue_depth)
+	: m_max_queue_depth(std::max(1, max_queue_depth))
+{
+	set_concurrency(concurrency);
+}
+
+EmbedExecutor::~EmbedExecutor()
+{
+	shutdown();
+}
+
+EmbedSubmitResult EmbedExecutor::submit(EmbedExecutorJob job)
+{
+	if (!job.task)
+		return EmbedSubmitResult::Stopped;
+
+	const bool rotational = is_rotational_cached(job.device);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_stopping)
+		return EmbedSubmitResult::Stopped;
+
+	// A queued job for the same file has not read the sidecar yet; the newest task replaces it and every caller
+	// still hears about the outcome.
+	for (const std::shared_ptr<Entry> &entry : m_queue) {
+		if (entry->job.key != job.key)
+			continue;
+		if (entry->job.group != job.group)
+			entry->job.group.clear();
+		entry->job.task = std::move(job.task);
+		if (job.on_complete)
+			entry->extra_completions.push_back(std::move(job.on_complete));
+		return EmbedSubmitResult::Coalesced;
+	}
+
+	if (static_cast<int>(m_queue.size()) >= m_max_queue_depth)
+		return EmbedSubmitResult::QueueFull;
+
+	auto entry = std::make_shared<Entry>();
+	entry->job = std::move(job);
+	entry->rotational = rotational;
+	m_queue.push_back(std::move(entry));
+	spawn_worker_if_needed_locked();
+	m_work_cv.notify_one();
+	return EmbedSubmitResult::Queued;
+}
+
+void EmbedExecutor::set_concurrency(const EmbedConcurrency &concurrency)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_concurrency.max_jobs = std::clamp(concurrency.max_jobs, 1, kMaxWorkerCount);
+	m_concurrency.per_device_jobs = std::max(1, concurrency.per_device_jobs);
+	m_concurrency.rotational_device_jobs = std::max(1, concurrency.rotational_device_jobs);
+	// Raising the limit may make queued jobs runnable; lowering it lets surplus workers idle.
+	spawn_worker_if_needed_locked();
+	m_work_cv.notify_all();
+}
+
+EmbedConcurrency EmbedExecutor::concurrency() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_concurrency;
+}
+
+void EmbedExecutor::spawn_worker_if_needed_locked()
+{
+	if (m_stopping || m_queue.empty() || m_idle_workers > 0 ||
+	    static_cast<int>(m_workers.size()) >= m_concurrency.max_jobs)
+		return;
+	// Counted as idle until it picks up work, so a burst of submissions does not spawn one thread each. Each
+	// worker that takes a job spawns the next one, so workers ramp up to max_jobs while the queue stays busy.
+	++m_idle_workers;
+	m_workers.emplace_back([this]() { worker_loop(); });
+}
+
+bool EmbedExecutor::is_rotational_cached(quint64 device)
+{
+	if (device == 0)
+		return false;
+	std::lock_guard<std::mutex> lock(m_device_mutex);
+	auto it = m_rotational_cache.find(device);
+	if (it == m_rotational_cache.end())
+		it = m_rotational_cache.emplace(device, media_device_is_rotational(device)).first;
+	return it->second;
+}
+
+template<typename Predicate> int EmbedExecutor::cancel_matching(Predicate predicate)
+{
+	std::vector<std::shared_ptr<Entry>> dropped;
+	int count = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_queue.begin(); it != m_queue.end();) {
+			if (predicate((*it)->job)) {
+				dropped.push_back(*it);
+				it = m_queue.erase(it);
+			} else {
+				++it;
+			}
+		}
+		for (const std::shared_ptr<Entry> &entry : m_running) {
+			if (predicate(entry->job)) {
+				entry->cancelled->store(true);
+				++count;
+			}
+		}
+		if (m_queue.empty() && m_running.empty())
+			m_idle_cv.notify_all();
+	}
+
+	// Completions may take other locks (recovery queue persistence), so they run outside m_mutex.
+	for (const std::shared_ptr<Entry> &entry : dropped)
+		complete(*entry, cancelled_result());
+	return count + static_cast<int>(dropped.size());
+}
+
+int EmbedExecutor::cancel(const QString &key)
+{
+	return cancel_matching([&key](const EmbedExecutorJob &job) { return job.key == key; });
+}
+
+int EmbedExecutor::cancel_group(const QString &group)
+{
+	if (group.isEmpty())
+		return 0;
+	return cancel_matching([&group](const EmbedExecutorJob &job) { return job.group == group; });
+}
+
+int EmbedExecutor::cancel_all()
+{
+	return cancel_matching([](const EmbedExecutorJob &) { return true; });
+}
+
+void EmbedExecutor::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle_cv.wait(lock, [this]() { return m_queue.empty() && m_running.empty(); });
+}
+
+void EmbedExecutor::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stopping && m_workers.empty())
+			return;
+		m_stopping = true;
+	}
+	cancel_all();
+	m_work_cv.notify_all();
+	for (std::thread &worker : m_workers) {
+		if (worker.joinable())
+			worker.join();
+	}
+	m_workers.clear();
+}
+
+int EmbedExecutor::queued_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_queue.size());
+}
+
+int EmbedExecutor::running_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_running.size());
+}
+
+bool EmbedExecutor::is_runnable_locked(const Entry &entry) const
+{
+	if (static_cast<int>(m_running.size()) >= m_concurrency.max_jobs)
+		return false;
+
+	const int device_limit = entry.rotational ? m_concurrency.rotational_device_jobs
+						  : m_concurrency.per_device_jobs;
+	int on_device = 0;
+	for (const std::shared_ptr<Entry> &running : m_running) {
+		if (running->job.key == entry.job.key)
+			return false;
+		if (running->job.device == entry.job.device)
+			++on_device;
+	}
+	return on_device < device_limit;
+}
+
+void EmbedExecutor::complete(Entry &entry, const EmbedResult &result)
+{
+	if (entry.job.on_complete)
+		entry.job.on_complete(entry.job.key, result);
+	for (const EmbedExecutorJob::Completion &completion : entry.extra_completions) {
+		if (completion)
+			completion(entry.job.key, result);
+	}
+}
+
+EmbedResult EmbedExecutor::cancelled_result()
+{
+	EmbedResult result;
+	result.error = "Embed cancelled";
+	result.retryable = true;
+	result.cancelled = true;
+	return result;
+}
+
+void EmbedExecutor::worker_loop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		auto runnable = m_queue.end();
+		m_work_cv.wait(lock, [this, &runnable]() {
+			runnable = std::find_if(m_queue.begin(), m_queue.end(),
+						[this](const std::shared_ptr<Entry> &candidate) {
+							return is_runnable_locked(*candidate);
+						});
+			return m_stopping || runnable != m_queue.end();
+		});
+		if (m_stopping && runnable == m_queue.end()) {
+			--m_idle_workers;
+			return;
+		}
+
+		std::shared_ptr<Entry> entry = *runnable;
+		m_queue.erase(runnable);
+		m_running.push_back(entry);
+		--m_idle_workers;
+		spawn_worker_if_needed_locked();
+		lock.unlock();
+
+		const EmbedResult result =
+			entry->cancelled->load() ? cancelled_result() : entry->job.task(*entry->cancelled);
+		complete(*entry, entry->cancelled->load() && !result.ok ? cancelled_result() : result);
+
+		lock.lock();
+		m_running.erase(std::find(m_running.begin(), m_running.end(), entry));
+		++m_idle_workers;
+		if (m_queue.empty() && m_running.empty())
+			m_idle_cv.notify_all();
+		// A finished job frees its file and device slot, which may unblock jobs other workers skipped.
+		m_work_cv.notify_all();
+	}
+}
+
+} // namespace bm
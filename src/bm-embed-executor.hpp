@@ -0,0 +1,118 @@
+#pragma once
+
+#include "bm-mp4-mov-embed-engine.hpp"
+
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bm {
+
+enum class EmbedSubmitResult {
+	Queued,
+	Coalesced,
+	QueueFull,
+	Stopped,
+};
+
+const char *embed_submit_result_name(EmbedSubmitResult result);
+
+// Embeds are I/O bound, so parallelism is limited per storage device as well as overall: spinning disks thrash
+// when two rewrites seek against each other, while SSD/NVMe devices keep up with several.
+struct EmbedConcurrency {
+	int max_jobs = 4;
+	int per_device_jobs = 2;
+	int rotational_device_jobs = 1;
+};
+
+// st_dev of the file (or its directory when the file is gone); 0 when unknown.
+quint64 media_device_id(const QString &path);
+// Linux sysfs probe of queue/rotational; false when the device cannot be identified.
+bool media_device_is_rotational(quint64 device);
+
+struct EmbedExecutorJob {
+	using Task = std::function<EmbedResult(const std::atomic_bool &cancelled)>;
+	using Completion = std::function<void(const QString &key, const EmbedResult &result)>;
+
+	// Jobs with the same key (the media path) never run concurrently, and a queued job absorbs later submissions.
+	QString key;
+	// Lets one caller cancel its own jobs (for example startup recovery) without touching the rest.
+	QString group;
+	// Storage device of the media file (see media_device_id); jobs on one device share its concurrency limit.
+	quint64 device = 0;
+	Task task;
+	Completion on_complete;
+};
+
+// Runs embeds off the OBS output/signal threads. submit() only takes a short lock, so it is safe to call from
+// signal handlers; completions are invoked on the worker thread that ran the job. A job starts only when its file,
+// its device and the executor as a whole are below their limits, so a slow disk never starves jobs on another one.
+class EmbedExecutor {
+public:
+	static constexpr int kDefaultMaxQueueDepth = 256;
+	static constexpr int kMaxWorkerCount = 16;
+
+	explicit EmbedExecutor(const EmbedConcurrency &concurrency = EmbedConcurrency{},
+			       int max_queue_depth = kDefaultMaxQueueDepth);
+	~EmbedExecutor();
+
+	EmbedExecutor(const EmbedExecutor &) = delete;
+	EmbedExecutor &operator=(const EmbedExecutor &) = delete;
+
+	EmbedSubmitResult submit(EmbedExecutorJob job);
+	// Applies to jobs started afterwards; workers are spawned on demand up to max_jobs.
+	void set_concurrency(const EmbedConcurrency &concurrency);
+	EmbedConcurrency concurrency() const;
+
+	// Queued jobs complete immediately with a retryable "cancelled" result; running jobs see their flag raised.
+	int cancel(const QString &key);
+	int cancel_group(const QString &group);
+	int cancel_all();
+
+	// Blocks until nothing is queued or running. Intended for tests and orderly shutdown.
+	void wait_idle();
+	// Cancels everything and joins the workers; later submissions return Stopped.
+	void shutdown();
+
+	int queued_count() const;
+	int running_count() const;
+
+private:
+	struct Entry {
+		EmbedExecutorJob job;
+		std::vector<EmbedExecutorJob::Completion> extra_completions;
+		std::shared_ptr<std::atomic_bool> cancelled = std::make_shared<std::atomic_bool>(false);
+		bool rotational = false;
+	};
+
+	void worker_loop();
+	void spawn_worker_if_needed_locked();
+	bool is_runnable_locked(const Entry &entry) const;
+	bool is_rotational_cached(quint64 device);
+	template<typename Predicate> int cancel_matching(Predicate predicate);
+	static void complete(Entry &entry, const EmbedResult &result);
+	static EmbedResult cancelled_result();
+
+	const int m_max_queue_depth;
+	EmbedConcurrency m_concurrency;
+	int m_idle_workers = 0;
+	mutable std::mutex m_mutex;
+	std::mutex m_device_mutex;
+	std::unordered_map<quint64, bool> m_rotational_cache;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_idle_cv;
+	std::deque<std::shared_ptr<Entry>> m_queue;
+	std::vector<std::shared_ptr<Entry>> m_running;
+	std::vector<std::thread> m_workers;
+	bool m_stopping = false;
+};
+
+} // namespace bm
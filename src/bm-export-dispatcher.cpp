@@ -0,0 +1,186 @@
+#include "bm-export-dispatcher.hpp"
+
+#include <algorithm>
+
+namespace bm {
+
+ExportDispatcher::ExportDispatcher(DeliverCallback deliver, int capacity)
+	: m_deliver(std::move(deliver)),
+	  m_capacity(std::max(1, capacity))
+{
+	m_worker = std::thread([this]() { run(); });
+}
+
+ExportDispatcher::~ExportDispatcher()
+{
+	stop();
+}
+
+int64_t ExportDispatcher::now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+bool ExportDispatcher::post(ExportEvent event)
+{
+	m_posted.fetch_add(1);
+	if (m_stopped.load()) {
+		deliver(event);
+		return true;
+	}
+
+	// Once anything has spilled, later events spill behind it until the worker takes the overflow list, which keeps
+	// each producer's events in order.
+	bool queued = false;
+	if (!m_spilling.load()) {
+		const int depth = m_depth.fetch_add(1) + 1;
+		if (depth <= m_capacity) {
+			m_queue.push(std::move(event));
+			queued = true;
+			int max_depth = m_max_depth.load(std::memory_order_relaxed);
+			while (depth > max_depth && !m_max_depth.compare_exchange_weak(max_depth, depth))
+				;
+		} else {
+			m_depth.fetch_sub(1);
+		}
+	}
+
+	if (!queued) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_metrics.overflowed;
+		bool coalesced = false;
+		if (event.kind == ExportEvent::Kind::MarkersAdded) {
+			// A spilled MarkersAdded of this recording writes whatever list is current when it runs.
+			for (qsizetype i = m_spill.size() - 1; i >= 0; --i) {
+				const ExportEvent &spilled = m_spill.at(i);
+				if (spilled.recording_ctx.media_path != event.recording_ctx.media_path)
+					continue;
+				coalesced = spilled.kind == ExportEvent::Kind::MarkersAdded;
+				break;
+			}
+		}
+		if (coalesced)
+			++m_metrics.coalesced;
+		else
+			m_spill.push_back(std::move(event));
+		m_spilling.store(true);
+	}
+
+	if (m_worker_idle.load()) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wake_cv.notify_one();
+	}
+	if (!queued)
+		m_drained_cv.notify_all();
+	return queued;
+}
+
+void ExportDispatcher::drain()
+{
+	const uint64_t target = m_posted.load();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_drained_cv.wait(lock, [this, target]() { return m_metrics.delivered + m_metrics.coalesced >= target; });
+}
+
+void ExportDispatcher::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake_cv.notify_all();
+	if (m_worker.joinable())
+		m_worker.join();
+	m_stopped.store(true);
+	deliver_backlog();
+}
+
+int ExportDispatcher::depth() const
+{
+	return std::max(0, m_depth.load());
+}
+
+ExportDispatcher::Metrics ExportDispatcher::metrics() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Metrics metrics = m_metrics;
+	metrics.posted = m_posted.load();
+	metrics.max_depth = m_max_depth.load();
+	return metrics;
+}
+
+void ExportDispatcher::run()
+{
+	for (;;) {
+		deliver_backlog();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		// Producers read the flag after publishing their event: either they see it set and wake us, or
+		// has_work() sees their event.
+		m_worker_idle.store(true);
+		while (!m_stopping && !has_work())
+			m_wake_cv.wait(lock);
+		m_worker_idle.store(false);
+		if (m_stopping && !has_work())
+			return;
+	}
+}
+
+bool ExportDispatcher::pop_queued(ExportEvent *event)
+{
+	while (m_depth.load() > 0) {
+		if (m_queue.pop(event)) {
+			m_depth.fetch_sub(1);
+			return true;
+		}
+		// A producer has counted its event but not linked it yet (or is backing out of a full queue).
+		std::this_thread::yield();
+	}
+	return false;
+}
+
+bool ExportDispatcher::has_work() const
+{
+	return m_depth.load() > 0 || !m_spill.isEmpty();
+}
+
+void ExportDispatcher::deliver(const ExportEvent &event)
+{
+	const int64_t latency_ns = now_ns() - event.captured_ns;
+	if (m_deliver)
+		m_deliver(event);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_metrics.delivered;
+		if (event.captured_ns > 0)
+			m_metrics.max_latency_ns = std::max(m_metrics.max_latency_ns, latency_ns);
+	}
+	m_drained_cv.notify_all();
+}
+
+void ExportDispatcher::deliver_backlog()
+{
+	for (;;) {
+		ExportEvent event;
+		if (pop_queued(&event)) {
+			deliver(event);
+			continue;
+		}
+
+		// The queue is empty, so everything queued ahead of the spilled events has been delivered.
+		QVector<ExportEvent> spilled;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_depth.load() == 0) {
+				spilled.swap(m_spill);
+				m_spilling.store(false);
+			}
+		}
+		if (spilled.isEmpty())
+			return;
+		for (const ExportEvent &spilled_event : spilled)
+			deliver(spilled_event);
+	}
+}
+
+} // namespace bm
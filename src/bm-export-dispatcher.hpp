@@ -0,0 +1,103 @@
+#pragma once
+
+#include "bm-marker-export-sink.hpp"
+#include "bm-mpsc-queue.hpp"
+
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace bm {
+
+struct ExportEvent {
+	enum class Kind {
+		// Write the recording's current marker list to the sinks.
+		MarkersAdded,
+		// Finalize the recording's artifacts.
+		RecordingClosed,
+	};
+
+	Kind kind = Kind::MarkersAdded;
+	MarkerExportRecordingContext recording_ctx;
+	// Steady-clock time the event was captured, for the queue latency metric.
+	int64_t captured_ns = 0;
+};
+
+// Runs every export sink call on one worker thread, so the thread that fires a hotkey or closes a recording only
+// captures an event and enqueues it. Events go through a lock-free MPSC queue bounded at capacity; once it is full,
+// events spill to a mutex-guarded overflow list that the worker drains after the queue, so nothing is lost and each
+// producer's events are still delivered in order. A MarkersAdded event carries no marker list (the worker reads the
+// current one), so a spilled MarkersAdded is coalesced with the recording's previous one still in the list.
+class ExportDispatcher {
+public:
+	using Clock = std::chrono::steady_clock;
+	using DeliverCallback = std::function<void(const ExportEvent &event)>;
+
+	static constexpr int kDefaultCapacity = 256;
+
+	struct Metrics {
+		uint64_t posted = 0;
+		uint64_t delivered = 0;
+		// Events that found the queue full, and how many of those merged into an event already spilled.
+		uint64_t overflowed = 0;
+		uint64_t coalesced = 0;
+		int max_depth = 0;
+		// Longest time from capture to the start of delivery.
+		int64_t max_latency_ns = 0;
+	};
+
+	explicit ExportDispatcher(DeliverCallback deliver, int capacity = kDefaultCapacity);
+	~ExportDispatcher();
+
+	ExportDispatcher(const ExportDispatcher &) = delete;
+	ExportDispatcher &operator=(const ExportDispatcher &) = delete;
+
+	static int64_t now_ns();
+
+	// Never waits for a delivery. Returns false when the event overflowed the queue (it is still delivered). After
+	// stop() the event is delivered on the caller's thread.
+	bool post(ExportEvent event);
+	// Returns once every event posted before the call has been delivered. Must not be called from the callback.
+	void drain();
+	// Delivers what is queued, then joins the worker. Must not race post().
+	void stop();
+
+	int depth() const;
+	Metrics metrics() const;
+
+private:
+	void run();
+	bool pop_queued(ExportEvent *event);
+	bool has_work() const;
+	void deliver(const ExportEvent &event);
+	void deliver_backlog();
+
+	const DeliverCallback m_deliver;
+	const int m_capacity;
+	MpscQueue<ExportEvent> m_queue;
+	// Events pushed (or being pushed) and not popped yet.
+	std::atomic<int> m_depth{0};
+	std::atomic<int> m_max_depth{0};
+	std::atomic<bool> m_spilling{false};
+	// Set while the worker is about to wait; producers then take m_mutex to wake it.
+	std::atomic<bool> m_worker_idle{false};
+	std::atomic<uint64_t> m_posted{0};
+	std::atomic<bool> m_stopped{false};
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake_cv;
+	std::condition_variable m_drained_cv;
+	QVector<ExportEvent> m_spill;
+	Metrics m_metrics;
+	bool m_stopping = false;
+	std::thread m_worker;
+};
+
+} // namespace bm
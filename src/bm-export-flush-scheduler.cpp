@@ -0,0 +1,166 @@
+#include "bm-export-flush-scheduler.hpp"
+
+#include <QVector>
+
+#include <algorithm>
+
+namespace bm {
+
+ExportFlushScheduler::ExportFlushScheduler(FlushCallback flush) : m_flush(std::move(flush))
+{
+	m_thread = std::thread([this]() { run(); });
+}
+
+ExportFlushScheduler::~ExportFlushScheduler()
+{
+	stop();
+}
+
+void ExportFlushScheduler::set_cadence(ExportWriteCadence cadence, int delay_ms)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cadence = cadence;
+		m_delay_ms = std::clamp(delay_ms, kMinWriteCadenceMs, kMaxWriteCadenceMs);
+	}
+	m_cv.notify_one();
+}
+
+bool ExportFlushScheduler::schedule(const QString &media_path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stopping || m_cadence == ExportWriteCadence::Immediate) {
+			// The caller's write covers anything left over from a previous cadence.
+			m_pending.remove(media_path);
+			return true;
+		}
+
+		const Clock::time_point now = Clock::now();
+		auto it = m_pending.find(media_path);
+		if (it == m_pending.end())
+			m_pending.insert(media_path, Pending{now, now});
+		else
+			it->last = now;
+	}
+	m_cv.notify_one();
+	return false;
+}
+
+bool ExportFlushScheduler::flush(const QString &media_path)
+{
+	std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pending.remove(media_path) == 0)
+			return false;
+	}
+	m_flush(media_path);
+	return true;
+}
+
+void ExportFlushScheduler::flush_all()
+{
+	std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+	QVector<QString> media_paths;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it)
+			media_paths.push_back(it.key());
+		m_pending.clear();
+	}
+	for (const QString &media_path : media_paths)
+		m_flush(media_path);
+}
+
+void ExportFlushScheduler::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+	flush_all();
+}
+
+int ExportFlushScheduler::pending_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_pending.size());
+}
+
+ExportFlushScheduler::Clock::time_point ExportFlushScheduler::deadline(ExportWriteCadence cadence, int delay_ms,
+									Clock::time_point first,
+									Clock::time_point last)
+{
+	const std::chrono::milliseconds delay(delay_ms);
+	switch (cadence) {
+	case ExportWriteCadence::Immediate:
+		return first;
+	case ExportWriteCadence::Debounced:
+		// A hotkey held down must not postpone the write forever.
+		return std::min(last + delay, first + delay * kMaxDebounceFactor);
+	case ExportWriteCadence::Interval:
+		return first + delay;
+	case ExportWriteCadence::OnRecordingClose:
+	default:
+		return Clock::time_point::max();
+	}
+}
+
+bool ExportFlushScheduler::next_deadline_locked(Clock::time_point *next) const
+{
+	bool found = false;
+	for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+		const Clock::time_point due = deadline(m_cadence, m_delay_ms, it->first, it->last);
+		if (due != Clock::time_point::max() && (!found || due < *next)) {
+			*next = due;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void ExportFlushScheduler::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stopping) {
+		Clock::time_point next;
+		if (!next_deadline_locked(&next)) {
+			m_cv.wait(lock);
+			continue;
+		}
+		if (Clock::now() < next) {
+			m_cv.wait_until(lock, next);
+			continue;
+		}
+
+		lock.unlock();
+		flush_due();
+		lock.lock();
+	}
+}
+
+void ExportFlushScheduler::flush_due()
+{
+	std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+	QVector<QString> due;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const Clock::time_point now = Clock::now();
+		for (auto it = m_pending.begin(); it != m_pending.end();) {
+			if (deadline(m_cadence, m_delay_ms, it->first, it->last) <= now) {
+				due.push_back(it.key());
+				it = m_pending.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+	for (const QString &media_path : due)
+		m_flush(media_path);
+}
+
+} // namespace bm
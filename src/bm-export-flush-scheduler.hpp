@@ -0,0 +1,70 @@
+#pragma once
+
+#include "bm-models.hpp"
+
+#include <QHash>
+#include <QString>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace bm {
+
+// Coalesces export writes per media file according to the write cadence. A marker only marks its file dirty; the
+// flush callback then runs once for the whole burst, on the scheduler thread when the cadence deadline passes or on
+// the caller's thread from flush()/flush_all(). Callbacks never overlap, so flush() returning means no write for that
+// file is in flight.
+class ExportFlushScheduler {
+public:
+	using Clock = std::chrono::steady_clock;
+	using FlushCallback = std::function<void(const QString &media_path)>;
+
+	explicit ExportFlushScheduler(FlushCallback flush);
+	~ExportFlushScheduler();
+
+	ExportFlushScheduler(const ExportFlushScheduler &) = delete;
+	ExportFlushScheduler &operator=(const ExportFlushScheduler &) = delete;
+
+	// Files already pending are rescheduled under the new cadence; switching to Immediate flushes them promptly.
+	void set_cadence(ExportWriteCadence cadence, int delay_ms);
+	// Returns true when the caller should write right away (Immediate cadence). Otherwise the file is marked dirty
+	// and written later.
+	bool schedule(const QString &media_path);
+	// Writes the file now if it is pending. Returns whether it was.
+	bool flush(const QString &media_path);
+	void flush_all();
+	// Joins the scheduler thread, then flushes whatever is still pending. Later schedule() calls return true.
+	void stop();
+
+	int pending_count() const;
+
+	// When a file first marked dirty at first and last marked at last is due. OnRecordingClose is never due.
+	static Clock::time_point deadline(ExportWriteCadence cadence, int delay_ms, Clock::time_point first,
+					  Clock::time_point last);
+
+private:
+	struct Pending {
+		Clock::time_point first;
+		Clock::time_point last;
+	};
+
+	void run();
+	bool next_deadline_locked(Clock::time_point *next) const;
+	void flush_due();
+
+	const FlushCallback m_flush;
+	// Held around every callback; taken before m_mutex.
+	std::mutex m_flush_mutex;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	ExportWriteCadence m_cadence = ExportWriteCadence::Immediate;
+	int m_delay_ms = 1000;
+	QHash<QString, Pending> m_pending;
+	bool m_stopping = false;
+	std::thread m_thread;
+};
+
+} // namespace bm
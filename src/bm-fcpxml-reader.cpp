@@ -0,0 +1,165 @@
+#include "bm-fcpxml-reader.hpp"
+
+#include <QFile>
+#include <QUrl>
+#include <QXmlStreamReader>
+
+#include <limits>
+
+namespace bm {
+
+bool FcpxmlReader::read(QIODevice *device, const MarkerVisitor &visit, FcpxmlDocumentInfo *info, QString *error)
+{
+	QXmlStreamReader xml(device);
+	FcpxmlDocumentInfo result;
+	bool has_format = false;
+	// Names of the open elements, so a marker knows whether it sits on the spine or on the asset clip.
+	QVector<QString> open_elements;
+
+	while (!xml.atEnd()) {
+		xml.readNext();
+		if (xml.isEndElement()) {
+			if (!open_elements.isEmpty())
+				open_elements.removeLast();
+			continue;
+		}
+		if (!xml.isStartElement())
+			continue;
+
+		const QXmlStreamAttributes attributes = xml.attributes();
+		const QStringView name = xml.name();
+		if (name == QLatin1String("format") && !has_format) {
+			int64_t num = 0;
+			int64_t den = 0;
+			if (!parse_rational_time(attributes.value(QLatin1String("frameDuration")), &num, &den) ||
+			    num <= 0 || num > std::numeric_limits<uint32_t>::max() ||
+			    den > std::numeric_limits<uint32_t>::max()) {
+				if (error)
+					*error = QString("FCPXML format has no valid frame duration at line %1")
+							 .arg(xml.lineNumber());
+				return false;
+			}
+			// frameDuration is seconds per frame, the inverse of the rate.
+			result.fps_num = static_cast<uint32_t>(den);
+			result.fps_den = static_cast<uint32_t>(num);
+			has_format = true;
+		} else if (name == QLatin1String("asset") && result.media_path.isEmpty()) {
+			result.media_path = QUrl(attributes.value(QLatin1String("src")).toString()).toLocalFile();
+		} else if (name == QLatin1String("sequence")) {
+			result.drop_frame = attributes.value(QLatin1String("tcFormat")) == QLatin1String("DF");
+		} else if (name == QLatin1String("marker")) {
+			if (!has_format) {
+				if (error)
+					*error = QString("FCPXML marker before its format at line %1")
+							 .arg(xml.lineNumber());
+				return false;
+			}
+			MarkerRecord marker;
+			if (!frame_from_rational_time(attributes.value(QLatin1String("start")), result.fps_num,
+						      result.fps_den, &marker.start_frame)) {
+				if (error)
+					*error = QString("FCPXML marker start is not a rational time at line %1")
+							 .arg(xml.lineNumber());
+				return false;
+			}
+			marker.name = attributes.value(QLatin1String("value")).toString();
+			marker.comment = attributes.value(QLatin1String("note")).toString();
+			if (result.marker_count == 0 && !open_elements.isEmpty())
+				result.profile = open_elements.last() == QLatin1String("spine")
+							 ? FcpxmlProfile::ResolveTimelineMarkers
+							 : FcpxmlProfile::FinalCutClipMarkers;
+			++result.marker_count;
+			if (visit)
+				visit(marker);
+		}
+		open_elements.push_back(name.toString());
+	}
+
+	if (xml.hasError()) {
+		if (error)
+			*error = QString("Malformed FCPXML at line %1: %2")
+					 .arg(xml.lineNumber())
+					 .arg(xml.errorString());
+		return false;
+	}
+	if (!has_format) {
+		if (error)
+			*error = QString("FCPXML has no format resource");
+		return false;
+	}
+	if (info)
+		*info = result;
+	return true;
+}
+
+bool FcpxmlReader::read_file(const QString &path, const MarkerVisitor &visit, FcpxmlDocumentInfo *info,
+			     QString *error)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		if (error)
+			*error = QString("Failed to open FCPXML for read: %1").arg(path);
+		return false;
+	}
+	QString read_error;
+	if (!read(&file, visit, info, &read_error)) {
+		if (error)
+			*error = QString("%1 (%2)").arg(read_error, path);
+		return false;
+	}
+	return true;
+}
+
+bool FcpxmlReader::read_markers(const QString &path, QVector<MarkerRecord> *markers, FcpxmlDocumentInfo *info,
+				QString *error)
+{
+	QVector<MarkerRecord> read_markers;
+	const MarkerVisitor visit = [&read_markers](const MarkerRecord &marker) { read_markers.push_back(marker); };
+	if (!read_file(path, visit, info, error))
+		return false;
+	if (markers)
+		*markers = std::move(read_markers);
+	return true;
+}
+
+bool FcpxmlReader::parse_rational_time(QStringView text, int64_t *num, int64_t *den)
+{
+	if (!text.endsWith(QLatin1Char('s')))
+		return false;
+	text.chop(1);
+	bool ok = false;
+	const qsizetype slash = text.indexOf(QLatin1Char('/'));
+	if (slash < 0) {
+		*num = text.toLongLong(&ok);
+		*den = 1;
+		return ok;
+	}
+	*num = text.left(slash).toLongLong(&ok);
+	if (!ok)
+		return false;
+	*den = text.mid(slash + 1).toLongLong(&ok);
+	return ok && *den > 0;
+}
+
+bool FcpxmlReader::frame_from_rational_time(QStringView text, uint32_t fps_num, uint32_t fps_den, int64_t *frame)
+{
+	int64_t num = 0;
+	int64_t den = 0;
+	if (!parse_rational_time(text, &num, &den) || fps_num == 0 || fps_den == 0)
+		return false;
+
+	// frame = num / den * fps_num / fps_den, rounded half away from zero.
+	const int64_t limit = std::numeric_limits<int64_t>::max();
+	if (num < -limit)
+		return false;
+	const int64_t magnitude = num < 0 ? -num : num;
+	if (magnitude > limit / fps_num || den > limit / fps_den)
+		return false;
+	const int64_t scaled = magnitude * fps_num;
+	const int64_t divisor = den * fps_den;
+	const int64_t rounded = scaled / divisor + (scaled % divisor >= divisor - divisor / 2 ? 1 : 0);
+	*frame = num < 0 ? -rounded : rounded;
+	return true;
+}
+
+} // namespace bm
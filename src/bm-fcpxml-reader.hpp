@@ -0,0 +1,48 @@
+#pragma once
+
+#include "bm-fcpxml-writer.hpp"
+#include "bm-marker-data.hpp"
+
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+#include <functional>
+
+class QIODevice;
+
+namespace bm {
+
+struct FcpxmlDocumentInfo {
+	// Taken from where the markers sit: the spine (Resolve) or the asset clip (Final Cut).
+	FcpxmlProfile profile = FcpxmlProfile::FinalCutClipMarkers;
+	QString media_path;
+	uint32_t fps_num = 0;
+	uint32_t fps_den = 0;
+	bool drop_frame = false;
+	int marker_count = 0;
+};
+
+// Streaming reader for the documents FcpxmlWriter emits, in either profile. Like XmpSidecarReader it pulls the file
+// through QXmlStreamReader and hands each <marker/> to the visitor as it is read. Marker times are converted back to
+// frames at the rate of the <format> resource, which the writer puts ahead of every marker. The writer's "Marker"
+// placeholder for unnamed markers reads back as that name; FCPXML markers carry no guid or color.
+class FcpxmlReader {
+public:
+	using MarkerVisitor = std::function<void(const MarkerRecord &marker)>;
+
+	// Fails on malformed XML, a marker before the format or a time that is not a rational number of seconds.
+	// visit and info may be null.
+	static bool read(QIODevice *device, const MarkerVisitor &visit, FcpxmlDocumentInfo *info, QString *error);
+	static bool read_file(const QString &path, const MarkerVisitor &visit, FcpxmlDocumentInfo *info,
+			      QString *error);
+	static bool read_markers(const QString &path, QVector<MarkerRecord> *markers, FcpxmlDocumentInfo *info,
+				 QString *error);
+
+	// Parses "<n>/<d>s" or "<n>s" into a fraction of seconds with a positive denominator.
+	static bool parse_rational_time(QStringView text, int64_t *num, int64_t *den);
+	// The frame a rational time falls on at fps_num/fps_den, rounded to the nearest frame.
+	static bool frame_from_rational_time(QStringView text, uint32_t fps_num, uint32_t fps_den, int64_t *frame);
+};
+
+} // namespace bm
@@ -1,59 +1,48 @@
 #include "bm-fcpxml-writer.hpp"
 
+#include "bm-artifact-sync.hpp"
+
 #include <QDir>
 #include <QFileInfo>
-#include <QSaveFile>
-#include <QTextStream>
 #include <QUrl>
 
 #include <algorithm>
-#include <cstdlib>
-#include <numeric>
 
 namespace bm {
 namespace {
 
-struct Rational {
-	int64_t num = 0;
-	int64_t den = 1;
-};
-
-Rational normalize_rational(int64_t num, int64_t den)
+void emit_frame_time(XmlEmitter &xml, const FrameRate &rate, int64_t frame)
 {
-	if (den == 0)
-		return {0, 1};
-	if (den < 0) {
-		num = -num;
-		den = -den;
-	}
-
-	const int64_t divisor = std::gcd(std::llabs(num), std::llabs(den));
-	if (divisor <= 1)
-		return {num, den};
-	return {num / divisor, den / divisor};
+	xml.formatted(FrameRate::kMaxRationalTimeSize,
+		      [&rate, frame](char *out) { return rate.write_frame_time(out, frame); });
 }
 
-Rational seconds_from_frames(int64_t frame, uint32_t fps_num, uint32_t fps_den)
+void emit_frame_duration(XmlEmitter &xml, const FrameRate &rate)
 {
-	if (fps_num == 0)
-		fps_num = 30;
-	if (fps_den == 0)
-		fps_den = 1;
-	return normalize_rational(frame * static_cast<int64_t>(fps_den), static_cast<int64_t>(fps_num));
+	xml.formatted(FrameRate::kMaxRationalTimeSize, [&rate](char *out) { return rate.write_frame_duration(out); });
 }
 
-Rational frame_duration_seconds(uint32_t fps_num, uint32_t fps_den)
+// One <marker/> line (indent excluded); both profiles share the element and differ only in where it sits.
+void render_marker(XmlEmitter &xml, const MarkerRecord &marker, const FrameRate &rate)
 {
-	if (fps_num == 0)
-		fps_num = 30;
-	if (fps_den == 0)
-		fps_den = 1;
-	return normalize_rational(static_cast<int64_t>(fps_den), static_cast<int64_t>(fps_num));
+	const QString trimmed = marker.name.trimmed();
+	xml.raw("<marker start=\"");
+	emit_frame_time(xml, rate, marker.start_frame);
+	xml.raw("\" duration=\"");
+	emit_frame_duration(xml, rate);
+	xml.raw("\"").attribute("value", trimmed.isEmpty() ? QString("Marker") : trimmed);
+	xml.attribute("note", marker.comment).raw("/>\n");
 }
 
-QString rational_to_fcpx_time(const Rational &rational)
+void emit_marker(XmlEmitter &xml, const MarkerRecord &marker, const FcpxmlDocumentInput &input, const FrameRate &rate)
 {
-	return QString("%1/%2s").arg(rational.num).arg(rational.den);
+	if (!input.render_cache) {
+		render_marker(xml, marker, rate);
+		return;
+	}
+	input.render_cache->append_fragment(xml, MarkerRenderCache::Fragment::FcpxmlMarker, marker, input.fps_num,
+					    input.fps_den,
+					    [&](XmlEmitter &fragment) { render_marker(fragment, marker, rate); });
 }
 
 } // namespace
@@ -69,12 +58,14 @@ QString FcpxmlWriter::artifact_path_for_media(const QString &media_path, FcpxmlP
 
 QString FcpxmlWriter::rational_time_from_frames(int64_t frame, uint32_t fps_num, uint32_t fps_den)
 {
-	return rational_to_fcpx_time(seconds_from_frames(frame, fps_num, fps_den));
+	return FrameRate::from_obs(fps_num, fps_den).frame_time(frame);
 }
 
 QString FcpxmlWriter::frame_duration_rational(uint32_t fps_num, uint32_t fps_den)
 {
-	return rational_to_fcpx_time(frame_duration_seconds(fps_num, fps_den));
+	char buffer[FrameRate::kMaxRationalTimeSize];
+	const char *const end = FrameRate::from_obs(fps_num, fps_den).write_frame_duration(buffer);
+	return QString::fromLatin1(buffer, static_cast<qsizetype>(end - buffer));
 }
 
 QString FcpxmlWriter::file_url_from_path(const QString &path)
@@ -84,116 +75,84 @@ QString FcpxmlWriter::file_url_from_path(const QString &path)
 
 bool FcpxmlWriter::write_document(const QString &output_path, const FcpxmlDocumentInput &input, QString *error) const
 {
-	QSaveFile file(output_path);
-	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-		if (error)
-			*error = QString("Failed to open FCPXML for write: %1").arg(output_path);
-		return false;
-	}
-
-	const QByteArray payload = build_document(input).toUtf8();
-	if (file.write(payload) == -1) {
-		if (error)
-			*error = QString("Failed to write FCPXML: %1").arg(output_path);
-		return false;
-	}
-
-	if (!file.commit()) {
-		if (error)
-			*error = QString("Failed to commit FCPXML: %1").arg(output_path);
-		return false;
-	}
+	XmlArena arena;
+	XmlEmitter xml(arena.buffer());
+	emit_document(xml, input);
+	return write_artifact(output_path, xml.bytes(), input.sync_batch, error);
+}
 
-	return true;
+QByteArray FcpxmlWriter::build_document(const FcpxmlDocumentInput &input) const
+{
+	QByteArray document;
+	XmlEmitter xml(&document);
+	emit_document(xml, input);
+	return document;
 }
 
-QString FcpxmlWriter::build_document(const FcpxmlDocumentInput &input) const
+void FcpxmlWriter::emit_document(XmlEmitter &xml, const FcpxmlDocumentInput &input) const
 {
+	const FrameRate rate = FrameRate::from_obs(input.fps_num, input.fps_den);
 	const int64_t timeline_duration_frames = compute_timeline_duration_frames(input.markers);
-	const QString frame_duration = frame_duration_rational(input.fps_num, input.fps_den);
-	const QString timeline_duration = rational_time_from_frames(timeline_duration_frames, input.fps_num, input.fps_den);
 	const QString media_url = file_url_from_path(input.media_path);
 	const QString clip_name = QFileInfo(input.media_path).completeBaseName();
 	const QString project_name = clip_name.isEmpty() ? QString("Better Markers Export") : clip_name;
 
-	QString xml;
-	QTextStream stream(&xml);
-	stream.setEncoding(QStringConverter::Utf8);
-
-	stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-	stream << "<!DOCTYPE fcpxml>\n";
-	stream << "<fcpxml version=\"1.11\">\n";
-	stream << "  <resources>\n";
-	stream << "    <format id=\"r1\" frameDuration=\"" << frame_duration
-	       << "\" width=\"1920\" height=\"1080\" colorSpace=\"1-1-1 (Rec. 709)\"/>\n";
-	stream << "    <asset id=\"r2\" name=\"" << xml_escape(clip_name) << "\" src=\"" << xml_escape(media_url)
-	       << "\" start=\"0s\" duration=\"" << timeline_duration << "\" hasVideo=\"1\" hasAudio=\"1\" format=\"r1\"/>\n";
-	stream << "  </resources>\n";
-	stream << "  <library>\n";
-	stream << "    <event name=\"Better Markers\">\n";
-	stream << "      <project name=\"" << xml_escape(project_name) << "\">\n";
-	stream << "        <sequence format=\"r1\" duration=\"" << timeline_duration
-	       << "\" tcStart=\"0s\" tcFormat=\"NDF\" audioLayout=\"stereo\" audioRate=\"48k\">\n";
-	stream << "          <spine>\n";
+	xml.raw("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	xml.raw("<!DOCTYPE fcpxml>\n");
+	xml.raw("<fcpxml version=\"1.11\">\n");
+	xml.raw("  <resources>\n");
+	xml.raw("    <format id=\"r1\" frameDuration=\"");
+	emit_frame_duration(xml, rate);
+	xml.raw("\" width=\"1920\" height=\"1080\" colorSpace=\"1-1-1 (Rec. 709)\"/>\n");
+	xml.raw("    <asset id=\"r2\"").attribute("name", clip_name).attribute("src", media_url);
+	xml.raw(" start=\"0s\" duration=\"");
+	emit_frame_time(xml, rate, timeline_duration_frames);
+	xml.raw("\" hasVideo=\"1\" hasAudio=\"1\" format=\"r1\"/>\n");
+	xml.raw("  </resources>\n");
+	xml.raw("  <library>\n");
+	xml.raw("    <event name=\"Better Markers\">\n");
+	xml.raw("      <project").attribute("name", project_name).raw(">\n");
+	xml.raw("        <sequence format=\"r1\" duration=\"");
+	emit_frame_time(xml, rate, timeline_duration_frames);
+	xml.raw("\" tcStart=\"0s\" tcFormat=\"").raw(rate.drop_frame() ? "DF" : "NDF");
+	xml.raw("\" audioLayout=\"stereo\" audioRate=\"48k\">\n");
+	xml.raw("          <spine>\n");
 	if (input.profile == FcpxmlProfile::ResolveTimelineMarkers)
-		append_resolve_timeline_markers(stream, input.markers, input.fps_num, input.fps_den);
-	stream << "            <asset-clip ref=\"r2\" name=\"" << xml_escape(clip_name)
-	       << "\" offset=\"0s\" start=\"0s\" duration=\"" << timeline_duration << "\">\n";
+		append_resolve_timeline_markers(xml, input, rate);
+	xml.raw("            <asset-clip ref=\"r2\"").attribute("name", clip_name);
+	xml.raw(" offset=\"0s\" start=\"0s\" duration=\"");
+	emit_frame_time(xml, rate, timeline_duration_frames);
+	xml.raw("\">\n");
 	if (input.profile == FcpxmlProfile::FinalCutClipMarkers)
-		append_final_cut_clip_markers(stream, input.markers, input.fps_num, input.fps_den);
-	stream << "            </asset-clip>\n";
-	stream << "          </spine>\n";
-	stream << "        </sequence>\n";
-	stream << "      </project>\n";
-	stream << "    </event>\n";
-	stream << "  </library>\n";
-	stream << "</fcpxml>\n";
-
-	return xml;
+		append_final_cut_clip_markers(xml, input, rate);
+	xml.raw("            </asset-clip>\n");
+	xml.raw("          </spine>\n");
+	xml.raw("        </sequence>\n");
+	xml.raw("      </project>\n");
+	xml.raw("    </event>\n");
+	xml.raw("  </library>\n");
+	xml.raw("</fcpxml>\n");
 }
 
-void FcpxmlWriter::append_final_cut_clip_markers(QTextStream &stream, const QVector<MarkerRecord> &markers,
-						 uint32_t fps_num, uint32_t fps_den) const
+void FcpxmlWriter::append_final_cut_clip_markers(XmlEmitter &xml, const FcpxmlDocumentInput &input,
+						 const FrameRate &rate) const
 {
-	const QString marker_duration = frame_duration_rational(fps_num, fps_den);
-	for (const MarkerRecord &marker : markers) {
-		const QString start = rational_time_from_frames(marker.start_frame, fps_num, fps_den);
-		QString value = marker.name.trimmed();
-		if (value.isEmpty())
-			value = "Marker";
-
-		stream << "              <marker start=\"" << start << "\" duration=\"" << marker_duration
-		       << "\" value=\"" << xml_escape(value) << "\" note=\"" << xml_escape(marker.comment) << "\"/>\n";
+	for (const MarkerRecord &marker : input.markers) {
+		xml.raw("              ");
+		emit_marker(xml, marker, input, rate);
 	}
 }
 
-void FcpxmlWriter::append_resolve_timeline_markers(QTextStream &stream, const QVector<MarkerRecord> &markers,
-						   uint32_t fps_num, uint32_t fps_den) const
+void FcpxmlWriter::append_resolve_timeline_markers(XmlEmitter &xml, const FcpxmlDocumentInput &input,
+						   const FrameRate &rate) const
 {
-	const QString marker_duration = frame_duration_rational(fps_num, fps_den);
-	for (const MarkerRecord &marker : markers) {
-		const QString start = rational_time_from_frames(marker.start_frame, fps_num, fps_den);
-		QString value = marker.name.trimmed();
-		if (value.isEmpty())
-			value = "Marker";
-
-		stream << "            <marker start=\"" << start << "\" duration=\"" << marker_duration
-		       << "\" value=\"" << xml_escape(value) << "\" note=\"" << xml_escape(marker.comment) << "\"/>\n";
+	for (const MarkerRecord &marker : input.markers) {
+		xml.raw("            ");
+		emit_marker(xml, marker, input, rate);
 	}
 }
 
-QString FcpxmlWriter::xml_escape(const QString &value)
-{
-	QString escaped = value;
-	escaped.replace('&', "&amp;");
-	escaped.replace('<', "&lt;");
-	escaped.replace('>', "&gt;");
-	escaped.replace('"', "&quot;");
-	escaped.replace('\'', "&apos;");
-	return escaped;
-}
-
-int64_t FcpxmlWriter::compute_timeline_duration_frames(const QVector<MarkerRecord> &markers)
+int64_t FcpxmlWriter::compute_timeline_duration_frames(const MarkerList &markers)
 {
 	int64_t max_frame = 1;
 	for (const MarkerRecord &marker : markers)
@@ -1,15 +1,21 @@
 #pragma once
 
+#include "bm-frame-rate.hpp"
 #include "bm-marker-data.hpp"
+#include "bm-marker-log.hpp"
+#include "bm-marker-render-cache.hpp"
+#include "bm-xml-emitter.hpp"
 
+#include <QByteArray>
 #include <QString>
-#include <QTextStream>
 #include <QVector>
 
 #include <cstdint>
 
 namespace bm {
 
+class ArtifactSyncBatch;
+
 enum class FcpxmlProfile {
 	FinalCutClipMarkers,
 	ResolveTimelineMarkers,
@@ -18,9 +24,13 @@ enum class FcpxmlProfile {
 struct FcpxmlDocumentInput {
 	FcpxmlProfile profile = FcpxmlProfile::FinalCutClipMarkers;
 	QString media_path;
-	QVector<MarkerRecord> markers;
+	MarkerList markers;
 	uint32_t fps_num = 30;
 	uint32_t fps_den = 1;
+	// Optional; marker lines already rendered for this recording are copied from it.
+	MarkerRenderCache *render_cache = nullptr;
+	// Optional; write_document goes through it instead of syncing on its own.
+	ArtifactSyncBatch *sync_batch = nullptr;
 };
 
 class FcpxmlWriter {
@@ -31,15 +41,16 @@ public:
 	static QString file_url_from_path(const QString &path);
 
 	bool write_document(const QString &output_path, const FcpxmlDocumentInput &input, QString *error) const;
-	QString build_document(const FcpxmlDocumentInput &input) const;
+	QByteArray build_document(const FcpxmlDocumentInput &input) const;
+	// Renders the UTF-8 document into the emitter's buffer; write_document uses the thread's XmlArena for it.
+	void emit_document(XmlEmitter &xml, const FcpxmlDocumentInput &input) const;
 
 private:
-	void append_final_cut_clip_markers(QTextStream &stream, const QVector<MarkerRecord> &markers, uint32_t fps_num,
-					   uint32_t fps_den) const;
-	void append_resolve_timeline_markers(QTextStream &stream, const QVector<MarkerRecord> &markers, uint32_t fps_num,
-					     uint32_t fps_den) const;
-	static QString xml_escape(const QString &value);
-	static int64_t compute_timeline_duration_frames(const QVector<MarkerRecord> &markers);
+	void append_final_cut_clip_markers(XmlEmitter &xml, const FcpxmlDocumentInput &input,
+					   const FrameRate &rate) const;
+	void append_resolve_timeline_markers(XmlEmitter &xml, const FcpxmlDocumentInput &input,
+					     const FrameRate &rate) const;
+	static int64_t compute_timeline_duration_frames(const MarkerList &markers);
 };
 
 } // namespace bm
@@ -0,0 +1,39 @@
+#include "bm-file-integrity.hpp"
+
+#include <QFile>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace bm {
+
+quint64 fnv1a64(const char *data, qint64 size)
+{
+	quint64 hash = 14695981039346656037ULL;
+	for (qint64 i = 0; i < size; ++i) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool sync_file_to_disk(QFile &file)
+{
+	return file.flush() && sync_fd_to_disk(file.handle());
+}
+
+bool sync_fd_to_disk(int fd)
+{
+#if defined(_WIN32)
+	return _commit(fd) == 0;
+#elif defined(__linux__)
+	return fdatasync(fd) == 0;
+#else
+	return fsync(fd) == 0;
+#endif
+}
+
+} // namespace bm
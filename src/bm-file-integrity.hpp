@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QtGlobal>
+
+class QFile;
+
+namespace bm {
+
+// 64-bit FNV-1a. Checksums the marker journal records and names the copy checkpoints; not collision resistant.
+quint64 fnv1a64(const char *data, qint64 size);
+
+// Flushes file's buffered writes and forces its data to disk: _commit on Windows, fdatasync on Linux, fsync elsewhere.
+bool sync_file_to_disk(QFile &file);
+// The same for a descriptor written without a QFile buffer in front of it.
+bool sync_fd_to_disk(int fd);
+
+} // namespace bm
@@ -8,7 +8,7 @@ QString FinalCutFcpxmlSink::sink_name() const
 }
 
 bool FinalCutFcpxmlSink::on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &,
-					 const QVector<MarkerRecord> &full_marker_list, QString *error)
+					 const MarkerList &full_marker_list, QString *error)
 {
 	if (!is_mp4_or_mov_path(recording_ctx.media_path))
 		return true;
@@ -19,6 +19,8 @@ bool FinalCutFcpxmlSink::on_marker_added(const MarkerExportRecordingContext &rec
 	input.markers = full_marker_list;
 	input.fps_num = recording_ctx.fps_num;
 	input.fps_den = recording_ctx.fps_den;
+	input.render_cache = recording_ctx.render_cache.get();
+	input.sync_batch = recording_ctx.sync_batch;
 
 	const QString output_path = FcpxmlWriter::artifact_path_for_media(recording_ctx.media_path, input.profile);
 	return m_writer.write_document(output_path, input, error);
@@ -0,0 +1,156 @@
+#include "bm-frame-rate.hpp"
+
+#include "bm-xml-emitter.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace bm {
+namespace {
+
+static_assert(sizeof(kCommonFrameRates) / sizeof(kCommonFrameRates[0]) == 10, "one entry per common OBS rate");
+
+constexpr bool is_five_smooth(const CommonFrameRate &rate)
+{
+	uint32_t rest = rate.num;
+	for (uint8_t i = 0; i < rate.twos; ++i)
+		rest /= 2;
+	for (uint8_t i = 0; i < rate.threes; ++i)
+		rest /= 3;
+	for (uint8_t i = 0; i < rate.fives; ++i)
+		rest /= 5;
+	return rest == 1;
+}
+
+constexpr bool table_is_five_smooth()
+{
+	for (const CommonFrameRate &rate : kCommonFrameRates) {
+		if (!is_five_smooth(rate))
+			return false;
+	}
+	return true;
+}
+
+static_assert(table_is_five_smooth(), "common rates are reduced by their factors of 2, 3 and 5 only");
+
+// Divides value and divisor by prime as long as both allow it, at most exponent times.
+void strip_common_factor(uint64_t &value, uint64_t &divisor, uint32_t prime, uint8_t exponent)
+{
+	for (uint8_t i = 0; i < exponent && value % prime == 0; ++i) {
+		value /= prime;
+		divisor /= prime;
+	}
+}
+
+char *write_two_digits(char *out, uint32_t value)
+{
+	out[0] = static_cast<char>('0' + value / 10);
+	out[1] = static_cast<char>('0' + value % 10);
+	return out + 2;
+}
+
+} // namespace
+
+FrameRate FrameRate::from_obs(uint32_t fps_num, uint32_t fps_den)
+{
+	if (fps_num == 0)
+		fps_num = 30;
+	if (fps_den == 0)
+		fps_den = 1;
+	const uint32_t divisor = std::gcd(fps_num, fps_den);
+
+	FrameRate rate;
+	rate.m_num = fps_num / divisor;
+	rate.m_den = fps_den / divisor;
+	for (const CommonFrameRate &common : kCommonFrameRates) {
+		if (common.num == rate.m_num && common.den == rate.m_den) {
+			rate.m_timebase = common.timebase;
+			rate.m_drop_frame = common.drop_frame;
+			rate.m_common = &common;
+			return rate;
+		}
+	}
+	rate.m_timebase = std::max<uint32_t>(1, (rate.m_num + rate.m_den / 2) / rate.m_den);
+	return rate;
+}
+
+char *FrameRate::write_frame_time(char *out, int64_t frame) const
+{
+	// frame * den / num, where num and den are already coprime: only gcd(frame, num) can cancel.
+	const bool negative = frame < 0;
+	uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(frame) : static_cast<uint64_t>(frame);
+	uint64_t divisor = m_num;
+	if (magnitude == 0) {
+		divisor = 1;
+	} else if (m_common) {
+		strip_common_factor(magnitude, divisor, 2, m_common->twos);
+		strip_common_factor(magnitude, divisor, 3, m_common->threes);
+		strip_common_factor(magnitude, divisor, 5, m_common->fives);
+	} else {
+		const uint64_t common_factor = std::gcd(magnitude, divisor);
+		magnitude /= common_factor;
+		divisor /= common_factor;
+	}
+
+	const int64_t seconds_num = static_cast<int64_t>(magnitude * m_den);
+	out = write_decimal(out, negative ? -seconds_num : seconds_num);
+	*out++ = '/';
+	out = write_decimal(out, static_cast<int64_t>(divisor));
+	*out++ = 's';
+	return out;
+}
+
+char *FrameRate::write_frame_duration(char *out) const
+{
+	out = write_decimal(out, m_den);
+	*out++ = '/';
+	out = write_decimal(out, m_num);
+	*out++ = 's';
+	return out;
+}
+
+char *FrameRate::write_timecode(char *out, int64_t frame) const
+{
+	uint64_t count = frame > 0 ? static_cast<uint64_t>(frame) : 0;
+	const uint64_t timebase = m_timebase;
+	if (m_drop_frame) {
+		// SMPTE drop-frame: frame numbers 0 and 1 (0-3 at 59.94) are skipped at the start of every minute
+		// except each tenth, so the label is the count plus the numbers skipped so far.
+		const uint64_t dropped = timebase / 15;
+		const uint64_t per_ten_minutes = timebase * 600 - dropped * 9;
+		const uint64_t per_minute = timebase * 60 - dropped;
+		const uint64_t tens = count / per_ten_minutes;
+		const uint64_t rest = count % per_ten_minutes;
+		count += dropped * 9 * tens;
+		if (rest > dropped)
+			count += dropped * ((rest - dropped) / per_minute);
+	}
+
+	const uint64_t frames = count % timebase;
+	const uint64_t total_seconds = count / timebase;
+	out = write_two_digits(out, static_cast<uint32_t>(total_seconds / 3600 % 24));
+	*out++ = ':';
+	out = write_two_digits(out, static_cast<uint32_t>(total_seconds / 60 % 60));
+	*out++ = ':';
+	out = write_two_digits(out, static_cast<uint32_t>(total_seconds % 60));
+	*out++ = m_drop_frame ? ';' : ':';
+	if (frames >= 100)
+		return write_decimal(out, static_cast<int64_t>(frames));
+	return write_two_digits(out, static_cast<uint32_t>(frames));
+}
+
+QString FrameRate::frame_time(int64_t frame) const
+{
+	char buffer[kMaxRationalTimeSize];
+	const char *const end = write_frame_time(buffer, frame);
+	return QString::fromLatin1(buffer, static_cast<qsizetype>(end - buffer));
+}
+
+QString FrameRate::timecode(int64_t frame) const
+{
+	char buffer[kMaxTimecodeSize];
+	const char *const end = write_timecode(buffer, frame);
+	return QString::fromLatin1(buffer, static_cast<qsizetype>(end - buffer));
+}
+
+} // namespace bm
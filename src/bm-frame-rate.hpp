@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+
+namespace bm {
+
+struct CommonFrameRate {
+	uint32_t num;
+	uint32_t den;
+	// Integer rate used for timecode and Premiere's xmpDM:frameRate (30 for 29.97).
+	uint32_t timebase;
+	bool drop_frame;
+	// Exponents of 2, 3 and 5 in num, which is 5-smooth for every rate in the table.
+	uint8_t twos;
+	uint8_t threes;
+	uint8_t fives;
+};
+
+namespace frame_rate_detail {
+
+constexpr uint8_t exponent(uint32_t value, uint32_t prime)
+{
+	uint8_t count = 0;
+	while (value != 0 && value % prime == 0) {
+		value /= prime;
+		++count;
+	}
+	return count;
+}
+
+constexpr CommonFrameRate common(uint32_t num, uint32_t den, uint32_t timebase, bool drop_frame)
+{
+	return {num, den, timebase, drop_frame, exponent(num, 2), exponent(num, 3), exponent(num, 5)};
+}
+
+} // namespace frame_rate_detail
+
+// The rates OBS is normally configured with, as reduced rationals. Start times at these rates are reduced against the
+// precomputed factorisation instead of a gcd.
+inline constexpr CommonFrameRate kCommonFrameRates[] = {
+	frame_rate_detail::common(24000, 1001, 24, false), frame_rate_detail::common(24, 1, 24, false),
+	frame_rate_detail::common(25, 1, 25, false),       frame_rate_detail::common(30000, 1001, 30, true),
+	frame_rate_detail::common(30, 1, 30, false),       frame_rate_detail::common(48, 1, 48, false),
+	frame_rate_detail::common(50, 1, 50, false),       frame_rate_detail::common(60000, 1001, 60, true),
+	frame_rate_detail::common(60, 1, 60, false),       frame_rate_detail::common(120, 1, 120, false),
+};
+
+// A frame rate resolved once per document, with the formatting the export writers need per marker. Formatting writes
+// ASCII straight into the caller's buffer and returns the end; nothing is terminated.
+class FrameRate {
+public:
+	// Longest write_frame_time/write_frame_duration output ("-9223372036854775808/4294967295s").
+	static constexpr int kMaxRationalTimeSize = 32;
+	// Longest write_timecode output: "HH:MM:SS;" and a frame field as wide as the timebase needs.
+	static constexpr int kMaxTimecodeSize = 32;
+
+	// Zero parts fall back to 30/1, as the writers always have. Rates missing from the table reduce start times
+	// with a gcd per marker and get a rounded, non-drop timebase.
+	static FrameRate from_obs(uint32_t fps_num, uint32_t fps_den);
+
+	uint32_t num() const { return m_num; }
+	uint32_t den() const { return m_den; }
+	uint32_t timebase() const { return m_timebase; }
+	// NTSC 29.97 and 59.94; timecode then skips frame numbers to stay aligned with the wall clock.
+	bool drop_frame() const { return m_drop_frame; }
+	bool is_common() const { return m_common != nullptr; }
+
+	// "<num>/<den>s": the frame's start time in seconds, reduced.
+	char *write_frame_time(char *out, int64_t frame) const;
+	// "<den>/<num>s": one frame's duration.
+	char *write_frame_duration(char *out) const;
+	// "HH:MM:SS:FF", or "HH:MM:SS;FF" at drop-frame rates. Hours wrap at 24; negative frames clamp to zero.
+	char *write_timecode(char *out, int64_t frame) const;
+
+	QString frame_time(int64_t frame) const;
+	QString timecode(int64_t frame) const;
+
+private:
+	uint32_t m_num = 30;
+	uint32_t m_den = 1;
+	uint32_t m_timebase = 30;
+	bool m_drop_frame = false;
+	const CommonFrameRate *m_common = nullptr;
+};
+
+} // namespace bm
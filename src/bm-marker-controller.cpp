@@ -1,10 +1,12 @@
 #include "bm-marker-controller.hpp"
 
+#include "bm-fcpxml-reader.hpp"
 #include "bm-focus-policy.hpp"
 #include "bm-localization.hpp"
 #include "bm-marker-dialog.hpp"
 #include "bm-synthetic-keypress.hpp"
 #include "bm-window-focus.hpp"
+#include "bm-xmp-sidecar-reader.hpp"
 
 #include <obs-frontend-api.h>
 #include <obs.h>
@@ -17,6 +19,7 @@
 #include <QMetaObject>
 #include <QMessageBox>
 #include <QPointer>
+#include <QSet>
 #include <QThread>
 #include <QTimer>
 #include <QUuid>
@@ -53,6 +56,38 @@ const char *synthetic_keypress_status_name(SyntheticKeypressStatus status)
 	}
 }
 
+EmbedOptions embed_options_from_profile(const ExportProfile &profile)
+{
+	EmbedOptions options;
+	switch (profile.premiere_embed_writer) {
+	case PremiereEmbedWriter::ExifTool:
+		options.writer = EmbedWriter::ExifTool;
+		break;
+	case PremiereEmbedWriter::NativeWithExifToolFallback:
+		options.writer = EmbedWriter::NativeWithExifToolFallback;
+		break;
+	case PremiereEmbedWriter::Native:
+	default:
+		options.writer = EmbedWriter::Native;
+		break;
+	}
+	switch (profile.embed_io_mode) {
+	case PremiereEmbedIoMode::Streaming:
+		options.io_mode = EmbedIoMode::Streaming;
+		break;
+	case PremiereEmbedIoMode::Direct:
+		options.io_mode = EmbedIoMode::Direct;
+		break;
+	case PremiereEmbedIoMode::PageCache:
+	default:
+		options.io_mode = EmbedIoMode::PageCache;
+		break;
+	}
+	options.max_throughput_mib_s = profile.embed_max_throughput_mib_s;
+	options.faststart = profile.embed_faststart;
+	return options;
+}
+
 void run_non_blocking_delay_ms(int delay_ms)
 {
 	if (delay_ms <= 0)
@@ -69,6 +104,64 @@ void run_non_blocking_delay_ms(int delay_ms)
 	loop.exec(QEventLoop::ExcludeUserInputEvents);
 }
 
+// How the FCPXML writer renders a marker, which is all an FCPXML marker can be matched on.
+QString fcpxml_marker_key(const MarkerRecord &marker)
+{
+	const QString trimmed = marker.name.trimmed();
+	return QString("%1:%2").arg(marker.start_frame).arg(trimmed.isEmpty() ? QString("Marker") : trimmed);
+}
+
+// Reads back the artifacts an unfinalized recording left (the XMP sidecar, else either FCPXML document) and appends
+// the markers they hold that the journal lost to a torn tail record. Returns how many were added. Artifacts sharing
+// no marker with the journal belong to an earlier recording under the same name and are left alone.
+int merge_artifact_markers(const QString &media_path, QVector<MarkerRecord> *markers)
+{
+	QVector<MarkerRecord> recovered;
+	bool by_guid = false;
+	QString error;
+	const QString sidecar_path = XmpSidecarWriter::sidecar_path_for_media(media_path);
+	if (QFile::exists(sidecar_path)) {
+		// A crash mid-splice leaves the sidecar torn; the FCPXML documents are read back instead.
+		by_guid = XmpSidecarReader::read_markers(sidecar_path, &recovered, nullptr, &error);
+		if (!by_guid)
+			blog(LOG_WARNING, "[better-markers] cannot read back sidecar: %s", error.toUtf8().constData());
+	}
+	if (!by_guid) {
+		for (FcpxmlProfile profile :
+		     {FcpxmlProfile::ResolveTimelineMarkers, FcpxmlProfile::FinalCutClipMarkers}) {
+			const QString path = FcpxmlWriter::artifact_path_for_media(media_path, profile);
+			if (!QFile::exists(path))
+				continue;
+			if (FcpxmlReader::read_markers(path, &recovered, nullptr, &error))
+				break;
+			blog(LOG_WARNING, "[better-markers] cannot read back FCPXML: %s", error.toUtf8().constData());
+		}
+	}
+
+	const auto key = [by_guid](const MarkerRecord &marker) {
+		return by_guid ? marker.guid : fcpxml_marker_key(marker);
+	};
+	QSet<QString> journaled;
+	for (const MarkerRecord &marker : *markers)
+		journaled.insert(key(marker));
+
+	QVector<MarkerRecord> missing;
+	bool shares_marker = false;
+	for (MarkerRecord &marker : recovered) {
+		if (journaled.contains(key(marker))) {
+			shares_marker = true;
+			continue;
+		}
+		if (marker.guid.isEmpty())
+			marker.guid = QUuid::createUuid().toString(QUuid::WithoutBraces);
+		missing.push_back(marker);
+	}
+	if (!shares_marker)
+		return 0;
+	markers->append(missing);
+	return static_cast<int>(missing.size());
+}
+
 class HotkeyDialogFocusSession {
 public:
 	explicit HotkeyDialogFocusSession(const ScopeStore *store)
@@ -242,9 +335,26 @@ MarkerController::MarkerController(ScopeStore *store, RecordingSessionTracker *t
 	: m_store(store),
 	  m_tracker(tracker),
 	  m_parent_window(parent_window),
-	  m_premiere_xmp_sink(base_store_dir + "/pending-embed.json")
+	  m_premiere_xmp_sink(base_store_dir + "/pending-embed.json"),
+	  m_marker_journal(base_store_dir + "/marker-journal"),
+	  m_export_dispatcher([this](const ExportEvent &event) { deliver_export_event(event); }),
+	  m_flush_scheduler([this](const QString &media_path) { flush_pending_markers(media_path); })
 {
 	set_export_profile(ExportProfile{});
+	install_embed_failure_callback();
+	m_artifact_syncer.set_deferred_sync_callback([](const ArtifactSyncStats &synced, const QString &error) {
+		blog(error.isEmpty() ? LOG_INFO : LOG_WARNING,
+		     "[better-markers] deferred artifact sync: %d file + %d dir syncs, %.2f ms%s%s", synced.file_syncs,
+		     synced.directory_syncs, synced.sync_ms(), error.isEmpty() ? "" : "; ", error.toUtf8().constData());
+	});
+}
+
+void MarkerController::install_embed_failure_callback()
+{
+	// Finalize embeds complete on an executor thread; show_warning_async hops back to the UI thread.
+	m_premiere_xmp_sink.set_embed_failure_callback([this](const QString &, const QString &error) {
+		show_warning_async(bm_text("BetterMarkers.Warning.FailedToEmbedXmp").arg(error));
+	});
 }
 
 void MarkerController::set_active_templates(const QVector<MarkerTemplate> &templates)
@@ -270,7 +380,20 @@ void MarkerController::set_export_profile(const ExportProfile &profile)
 	if (profile.enable_final_cut_fcpxml)
 		sinks.push_back(&m_final_cut_fcpxml_sink);
 #endif
+	if (profile.enable_edl_markers)
+		sinks.push_back(&m_edl_marker_sink);
+	if (profile.enable_csv_markers)
+		sinks.push_back(&m_csv_marker_sink);
+	if (profile.enable_youtube_chapters)
+		sinks.push_back(&m_chapter_marker_sink);
+	m_premiere_xmp_sink.set_embed_options(embed_options_from_profile(profile));
+	EmbedConcurrency concurrency;
+	concurrency.max_jobs = profile.embed_max_concurrency;
+	concurrency.per_device_jobs = profile.embed_per_device_concurrency;
+	m_premiere_xmp_sink.set_embed_concurrency(concurrency);
 	set_export_sinks(sinks);
+	m_artifact_syncer.set_policy(profile.artifact_durability, profile.artifact_sync_window_ms);
+	m_flush_scheduler.set_cadence(profile.write_cadence, profile.write_cadence_ms);
 }
 
 void MarkerController::add_marker_from_main_button()
@@ -400,6 +523,13 @@ void MarkerController::on_recording_stopped(const QString &closed_file)
 
 void MarkerController::start_recovery_queue_async()
 {
+	QStringList recording_directories;
+	char *record_dir = obs_frontend_get_current_record_output_path();
+	if (record_dir) {
+		recording_directories.push_back(QString::fromUtf8(record_dir));
+		bfree(record_dir);
+	}
+	m_premiere_xmp_sink.remove_orphaned_temp_copies(recording_directories);
 	m_premiere_xmp_sink.start_startup_recovery_async();
 }
 
@@ -411,8 +541,28 @@ void MarkerController::stop_recovery_queue()
 void MarkerController::set_shutting_down(bool shutting_down)
 {
 	m_shutting_down.store(shutting_down);
-	if (shutting_down)
+	if (shutting_down) {
+		// Deferred writes must reach disk before the sinks go away.
+		m_flush_scheduler.flush_all();
+		m_export_dispatcher.drain();
+		sync_deferred_artifacts();
+		const ArtifactSyncStats totals = m_artifact_syncer.totals();
+		blog(LOG_INFO, "[better-markers] artifact sync totals: %d artifacts, %d file + %d dir syncs, %.2f ms",
+		     totals.artifacts, totals.file_syncs, totals.directory_syncs, totals.sync_ms());
+		const ExportDispatcher::Metrics metrics = m_export_dispatcher.metrics();
+		blog(LOG_INFO,
+		     "[better-markers] export dispatcher: %llu events, max depth %d, %llu overflowed (%llu coalesced), "
+		     "max latency %.2f ms",
+		     static_cast<unsigned long long>(metrics.posted), metrics.max_depth,
+		     static_cast<unsigned long long>(metrics.overflowed),
+		     static_cast<unsigned long long>(metrics.coalesced),
+		     static_cast<double>(metrics.max_latency_ns) / 1000000.0);
+		// Embeds still queued at unload are persisted and retried by the next startup recovery.
+		m_premiere_xmp_sink.set_embed_failure_callback(nullptr);
 		stop_recovery_queue();
+	} else {
+		install_embed_failure_callback();
+	}
 }
 
 bool MarkerController::capture_pending_context(PendingMarkerContext *out_ctx, bool show_warning_ui) const
@@ -422,15 +572,18 @@ bool MarkerController::capture_pending_context(PendingMarkerContext *out_ctx, bo
 	if (!m_tracker)
 		return false;
 
-	if (!m_tracker->can_add_marker()) {
+	// State, frame and path come from one read of the tracker, so they always describe the same recording.
+	const RecordingCapture capture = m_tracker->capture();
+	if (!capture.can_add_marker) {
 		if (show_warning_ui)
 			show_warning_async(bm_text("BetterMarkers.Warning.RecordingRequired"));
 		blog(LOG_WARNING, "[better-markers] marker ignored: recording is not active or is paused");
 		return false;
 	}
 
-	out_ctx->frozen_frame = m_tracker->capture_frame_now();
-	out_ctx->media_path = m_tracker->current_media_path();
+	out_ctx->frozen_frame = capture.frame;
+	out_ctx->frame_error = capture.frame_error;
+	out_ctx->media_path = capture.media_path;
 	out_ctx->trigger_time_ns = os_gettime_ns();
 	if (out_ctx->media_path.isEmpty()) {
 		if (show_warning_ui)
@@ -439,6 +592,17 @@ bool MarkerController::capture_pending_context(PendingMarkerContext *out_ctx, bo
 		return false;
 	}
 
+	const char *on_screen = capture.rendered_frame ? ", frame on screen" : "";
+	if (capture.timing_source == FrameTimingSource::WallClock) {
+		blog(LOG_INFO,
+		     "[better-markers] marker frame %lld from the recording clock (no recent video packets%s)",
+		     static_cast<long long>(capture.frame), on_screen);
+	} else {
+		blog(LOG_INFO, "[better-markers] marker frame %lld from video packets, +/-%.2f frames%s%s",
+		     static_cast<long long>(capture.frame), capture.frame_error,
+		     capture.timing_source == FrameTimingSource::Packets ? " (encoder latency not reported)" : "",
+		     on_screen);
+	}
 	return true;
 }
 
@@ -508,25 +672,78 @@ void MarkerController::maybe_send_synthetic_keypress(bool before_focus) const
 
 void MarkerController::append_marker(const QString &media_path, const MarkerRecord &marker)
 {
-	QVector<MarkerRecord> markers;
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
-		m_markers_by_file[media_path].push_back(marker);
-		markers = m_markers_by_file.value(media_path);
+		std::shared_ptr<MarkerLog> &log = m_markers_by_file[media_path];
+		if (!log)
+			log = std::make_shared<MarkerLog>();
+		log->append(marker);
 	}
 
+	// The journal is the durable copy; the sinks can then write on whatever cadence the profile asks for.
 	const MarkerExportRecordingContext ctx = make_recording_context(media_path);
-	QString error;
-	if (!dispatch_marker_added(ctx, marker, markers, &error)) {
-		blog(LOG_ERROR, "[better-markers] failed to export marker for '%s': %s",
-		     media_path.toUtf8().constData(), error.toUtf8().constData());
-		show_warning_async(bm_text("BetterMarkers.Warning.FailedToWriteSidecar").arg(error));
+	QString journal_error;
+	if (!m_marker_journal.append(media_path, ctx.fps_num, ctx.fps_den, marker, &journal_error))
+		blog(LOG_WARNING, "[better-markers] marker journal append failed for '%s': %s",
+		     media_path.toUtf8().constData(), journal_error.toUtf8().constData());
+
+	// The sinks write on the dispatcher's worker; a failed write still surfaces through show_warning_async there.
+	const bool write_now = m_flush_scheduler.schedule(media_path);
+	if (write_now)
+		post_export_event(ExportEvent::Kind::MarkersAdded, ctx);
+
+	blog(LOG_INFO, "[better-markers] marker added: file=%s frame=%lld color=%d title='%s'%s",
+	     media_path.toUtf8().constData(), static_cast<long long>(marker.start_frame), marker.color_id,
+	     marker.name.toUtf8().constData(), write_now ? " (queued)" : " (write deferred)");
+}
+
+void MarkerController::flush_pending_markers(const QString &media_path)
+{
+	post_export_event(ExportEvent::Kind::MarkersAdded, make_recording_context(media_path));
+}
+
+void MarkerController::post_export_event(ExportEvent::Kind kind, const MarkerExportRecordingContext &ctx)
+{
+	ExportEvent event;
+	event.kind = kind;
+	event.recording_ctx = ctx;
+	event.captured_ns = ExportDispatcher::now_ns();
+	if (!m_export_dispatcher.post(std::move(event)))
+		blog(LOG_WARNING, "[better-markers] export queue full; '%s' export runs after the backlog (depth %d)",
+		     ctx.media_path.toUtf8().constData(), m_export_dispatcher.depth());
+}
+
+void MarkerController::deliver_export_event(const ExportEvent &event)
+{
+	const MarkerExportRecordingContext &ctx = event.recording_ctx;
+	if (event.kind == ExportEvent::Kind::RecordingClosed) {
+		finalize_recording(ctx);
 		return;
 	}
 
-	blog(LOG_INFO, "[better-markers] marker added: file=%s frame=%lld color=%d title='%s'",
-	     media_path.toUtf8().constData(), static_cast<long long>(marker.start_frame), marker.color_id,
-	     marker.name.toUtf8().constData());
+	// The list is read at delivery, so one event writes every marker added since the last one was delivered.
+	MarkerList markers;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const std::shared_ptr<MarkerLog> log = m_markers_by_file.value(ctx.media_path);
+		if (log)
+			markers = log->snapshot();
+	}
+	if (!markers.isEmpty())
+		export_markers(ctx, markers);
+}
+
+bool MarkerController::export_markers(const MarkerExportRecordingContext &ctx, const MarkerList &markers)
+{
+	// Sinks rewrite their documents from the full list, so one write covers every marker added since the last.
+	QString error;
+	if (dispatch_marker_added(ctx, markers.last(), markers, &error))
+		return true;
+
+	blog(LOG_ERROR, "[better-markers] failed to export marker for '%s': %s", ctx.media_path.toUtf8().constData(),
+	     error.toUtf8().constData());
+	show_warning_async(bm_text("BetterMarkers.Warning.FailedToWriteSidecar").arg(error));
+	return false;
 }
 
 void MarkerController::finalize_closed_file(const QString &closed_file)
@@ -534,37 +751,94 @@ void MarkerController::finalize_closed_file(const QString &closed_file)
 	if (closed_file.isEmpty())
 		return;
 
-	const MarkerExportRecordingContext ctx = make_recording_context(closed_file);
+	// Pending writes are queued ahead of the finalize (and embed) of the closed file.
+	m_flush_scheduler.flush(closed_file);
+	post_export_event(ExportEvent::Kind::RecordingClosed, make_recording_context(closed_file));
+}
+
+void MarkerController::finalize_recording(const MarkerExportRecordingContext &ctx)
+{
 	QString error;
-	if (!dispatch_recording_closed(ctx, &error))
+	if (dispatch_recording_closed(ctx, &error)) {
+		// The artifacts are complete; a journal left behind would replay them again at the next startup.
+		// Deferred artifacts lose their journal backing here, so they are synced first.
+		sync_deferred_artifacts();
+		QString journal_error;
+		if (!m_marker_journal.remove(ctx.media_path, &journal_error))
+			blog(LOG_WARNING, "[better-markers] %s", journal_error.toUtf8().constData());
+	} else {
 		show_warning_async(bm_text("BetterMarkers.Warning.FailedToEmbedXmp").arg(error));
+	}
 
 	std::lock_guard<std::mutex> lock(m_mutex);
-	m_markers_by_file.remove(closed_file);
+	m_markers_by_file.remove(ctx.media_path);
+	m_render_caches.remove(ctx.media_path);
 }
 
-MarkerExportRecordingContext MarkerController::make_recording_context(const QString &media_path) const
+void MarkerController::replay_marker_journals()
+{
+	const QVector<MarkerJournal::Recording> recordings = m_marker_journal.load_all();
+	for (const MarkerJournal::Recording &recording : recordings) {
+		if (!QFile::exists(recording.media_path) || recording.markers.isEmpty()) {
+			blog(LOG_INFO, "[better-markers] dropping marker journal for '%s' (%s)",
+			     recording.media_path.toUtf8().constData(),
+			     recording.markers.isEmpty() ? "no markers" : "media missing");
+			m_marker_journal.remove(recording.media_path, nullptr);
+			continue;
+		}
+
+		// A crash left this recording unfinalized: rebuild its marker list and artifacts the way closing the
+		// file would have, keeping anything the artifacts already hold.
+		QVector<MarkerRecord> markers = recording.markers;
+		const int recovered = merge_artifact_markers(recording.media_path, &markers);
+		blog(LOG_INFO,
+		     "[better-markers] replaying marker journal for '%s': %d markers (%d read back from artifacts)",
+		     recording.media_path.toUtf8().constData(), static_cast<int>(markers.size()), recovered);
+		const std::shared_ptr<MarkerLog> log = std::make_shared<MarkerLog>(markers);
+		const MarkerList snapshot = log->snapshot();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_markers_by_file[recording.media_path] = log;
+		}
+		MarkerExportRecordingContext ctx = make_recording_context(recording.media_path);
+		ctx.fps_num = recording.fps_num;
+		ctx.fps_den = recording.fps_den;
+		if (export_markers(ctx, snapshot))
+			finalize_recording(ctx);
+	}
+}
+
+MarkerExportRecordingContext MarkerController::make_recording_context(const QString &media_path)
 {
 	MarkerExportRecordingContext ctx;
 	ctx.media_path = media_path;
 	ctx.fps_num = m_tracker ? m_tracker->fps_num() : 30;
 	ctx.fps_den = m_tracker ? m_tracker->fps_den() : 1;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::shared_ptr<MarkerRenderCache> &render_cache = m_render_caches[media_path];
+	if (!render_cache)
+		render_cache = std::make_shared<MarkerRenderCache>();
+	ctx.render_cache = render_cache;
 	return ctx;
 }
 
 bool MarkerController::dispatch_marker_added(const MarkerExportRecordingContext &ctx, const MarkerRecord &marker,
-					     const QVector<MarkerRecord> &full_marker_list, QString *error)
+					     const MarkerList &full_marker_list, QString *error)
 {
 	QVector<MarkerExportSink *> sinks;
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		sinks = m_export_sinks;
 	}
+	// Every sink's artifact for this event is synced together when the batch commits.
+	ArtifactSyncBatch batch(&m_artifact_syncer);
+	MarkerExportRecordingContext batch_ctx = ctx;
+	batch_ctx.sync_batch = &batch;
 	for (MarkerExportSink *sink : sinks) {
 		if (!sink)
 			continue;
 		QString sink_error;
-		if (!sink->on_marker_added(ctx, marker, full_marker_list, &sink_error)) {
+		if (!sink->on_marker_added(batch_ctx, marker, full_marker_list, &sink_error)) {
 			blog(LOG_ERROR, "[better-markers][%s] marker export failed: %s",
 			     sink->sink_name().toUtf8().constData(), sink_error.toUtf8().constData());
 			if (error) {
@@ -573,6 +847,7 @@ bool MarkerController::dispatch_marker_added(const MarkerExportRecordingContext
 			}
 		}
 	}
+	commit_sync_batch(&batch, ctx.media_path, error);
 	return !error || error->isEmpty();
 }
 
@@ -583,11 +858,14 @@ bool MarkerController::dispatch_recording_closed(const MarkerExportRecordingCont
 		std::lock_guard<std::mutex> lock(m_mutex);
 		sinks = m_export_sinks;
 	}
+	ArtifactSyncBatch batch(&m_artifact_syncer);
+	MarkerExportRecordingContext batch_ctx = ctx;
+	batch_ctx.sync_batch = &batch;
 	for (MarkerExportSink *sink : sinks) {
 		if (!sink)
 			continue;
 		QString sink_error;
-		if (!sink->on_recording_closed(ctx, &sink_error)) {
+		if (!sink->on_recording_closed(batch_ctx, &sink_error)) {
 			blog(LOG_WARNING, "[better-markers][%s] finalize export failed: %s",
 			     sink->sink_name().toUtf8().constData(), sink_error.toUtf8().constData());
 			if (error) {
@@ -596,9 +874,38 @@ bool MarkerController::dispatch_recording_closed(const MarkerExportRecordingCont
 			}
 		}
 	}
+	commit_sync_batch(&batch, ctx.media_path, error);
 	return !error || error->isEmpty();
 }
 
+bool MarkerController::commit_sync_batch(ArtifactSyncBatch *batch, const QString &media_path, QString *error)
+{
+	QString commit_error;
+	const bool ok = batch->commit(&commit_error);
+	const ArtifactSyncStats &stats = batch->stats();
+	if (stats.artifacts > 0 || stats.file_syncs > 0)
+		blog(LOG_INFO,
+		     "[better-markers] artifact sync (%s) for '%s': %d artifacts, %d file + %d dir syncs, %.2f ms",
+		     artifact_durability_to_key(batch->durability()), media_path.toUtf8().constData(),
+		     stats.artifacts, stats.file_syncs, stats.directory_syncs, stats.sync_ms());
+	if (ok)
+		return true;
+
+	blog(LOG_ERROR, "[better-markers] artifact commit failed: %s", commit_error.toUtf8().constData());
+	if (error) {
+		const QString prefix = error->isEmpty() ? QString() : QString("; ");
+		*error += prefix + commit_error;
+	}
+	return false;
+}
+
+void MarkerController::sync_deferred_artifacts()
+{
+	QString error;
+	if (!m_artifact_syncer.sync_deferred(nullptr, &error))
+		blog(LOG_WARNING, "[better-markers] deferred artifact sync failed: %s", error.toUtf8().constData());
+}
+
 void MarkerController::show_warning_async(const QString &message) const
 {
 	if (m_shutting_down.load() || !m_parent_window)
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "bm-artifact-sync.hpp"
+#include "bm-chapter-marker-sink.hpp"
+#include "bm-csv-marker-sink.hpp"
+#include "bm-edl-marker-sink.hpp"
+#include "bm-export-dispatcher.hpp"
+#include "bm-export-flush-scheduler.hpp"
 #include "bm-marker-data.hpp"
 #include "bm-marker-export-sink.hpp"
+#include "bm-marker-journal.hpp"
+#include "bm-marker-log.hpp"
 #include "bm-final-cut-fcpxml-sink.hpp"
 #include "bm-premiere-xmp-sink.hpp"
 #include "bm-recording-session-tracker.hpp"
@@ -12,6 +20,7 @@
 #include <QVector>
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 class QWidget;
@@ -36,6 +45,8 @@ public:
 
 	void on_recording_file_changed(const QString &closed_file, const QString &next_file);
 	void on_recording_stopped(const QString &closed_file);
+	// Regenerates the artifacts of recordings a crash left with a marker journal. Call before recording starts.
+	void replay_marker_journals();
 	void start_recovery_queue_async();
 	void stop_recovery_queue();
 	void set_shutting_down(bool shutting_down);
@@ -48,10 +59,18 @@ private:
 	void maybe_send_synthetic_keypress(bool before_focus) const;
 
 	void append_marker(const QString &media_path, const MarkerRecord &marker);
+	void flush_pending_markers(const QString &media_path);
+	bool export_markers(const MarkerExportRecordingContext &ctx, const MarkerList &markers);
 	void finalize_closed_file(const QString &closed_file);
-	MarkerExportRecordingContext make_recording_context(const QString &media_path) const;
+	void finalize_recording(const MarkerExportRecordingContext &ctx);
+	void deliver_export_event(const ExportEvent &event);
+	void post_export_event(ExportEvent::Kind kind, const MarkerExportRecordingContext &ctx);
+	void install_embed_failure_callback();
+	bool commit_sync_batch(ArtifactSyncBatch *batch, const QString &media_path, QString *error);
+	void sync_deferred_artifacts();
+	MarkerExportRecordingContext make_recording_context(const QString &media_path);
 	bool dispatch_marker_added(const MarkerExportRecordingContext &ctx, const MarkerRecord &marker,
-				   const QVector<MarkerRecord> &full_marker_list, QString *error);
+				   const MarkerList &full_marker_list, QString *error);
 	bool dispatch_recording_closed(const MarkerExportRecordingContext &ctx, QString *error);
 	void show_warning_async(const QString &message) const;
 
@@ -64,14 +83,26 @@ private:
 	PremiereXmpSink m_premiere_xmp_sink;
 	ResolveFcpxmlSink m_resolve_fcpxml_sink;
 	FinalCutFcpxmlSink m_final_cut_fcpxml_sink;
+	EdlMarkerSink m_edl_marker_sink;
+	CsvMarkerSink m_csv_marker_sink;
+	ChapterMarkerSink m_chapter_marker_sink;
+	MarkerJournal m_marker_journal;
 
 	mutable std::mutex m_mutex;
 	QVector<MarkerTemplate> m_active_templates;
 	QVector<MarkerExportSink *> m_export_sinks;
-	QHash<QString, QVector<MarkerRecord>> m_markers_by_file;
+	// Appended under m_mutex; exports read snapshots of them without the lock.
+	QHash<QString, std::shared_ptr<MarkerLog>> m_markers_by_file;
+	QHash<QString, std::shared_ptr<MarkerRenderCache>> m_render_caches;
+	// Declared after the sinks and before the export dispatcher, whose last deliveries still write through it.
+	ArtifactSyncer m_artifact_syncer;
+	// Runs every sink call. Declared after what its worker calls into and before the flush scheduler posting to it.
+	ExportDispatcher m_export_dispatcher;
 	std::atomic_bool m_shutting_down{false};
 	std::atomic_bool m_hotkey_dialog_open{false};
 	mutable std::atomic_bool m_synthetic_keypress_warning_shown{false};
+	// Declared last: its thread calls back into the members above, so it is stopped before they are destroyed.
+	ExportFlushScheduler m_flush_scheduler;
 };
 
 } // namespace bm
@@ -16,6 +16,8 @@ struct MarkerRecord {
 
 struct PendingMarkerContext {
 	int64_t frozen_frame = 0;
+	// Estimated error of frozen_frame in frames; negative when it came from the wall clock.
+	double frame_error = -1.0;
 	QString media_path;
 	uint64_t trigger_time_ns = 0;
 };
@@ -1,11 +1,15 @@
 #pragma once
 
+#include "bm-artifact-sync.hpp"
 #include "bm-marker-data.hpp"
+#include "bm-marker-log.hpp"
+#include "bm-marker-render-cache.hpp"
 
 #include <QString>
 #include <QVector>
 
 #include <cstdint>
+#include <memory>
 
 namespace bm {
 
@@ -13,6 +17,10 @@ struct MarkerExportRecordingContext {
 	QString media_path;
 	uint32_t fps_num = 30;
 	uint32_t fps_den = 1;
+	// Shared by every sink for the recording's lifetime; null renders everything afresh.
+	std::shared_ptr<MarkerRenderCache> render_cache;
+	// The batch of the marker event being dispatched; null writes each artifact with its own Strict sync.
+	ArtifactSyncBatch *sync_batch = nullptr;
 };
 
 class MarkerExportSink {
@@ -20,8 +28,9 @@ public:
 	virtual ~MarkerExportSink() = default;
 
 	virtual QString sink_name() const = 0;
+	// full_marker_list is a snapshot of the recording's markers; keep a copy of it rather than of its markers.
 	virtual bool on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &marker,
-				     const QVector<MarkerRecord> &full_marker_list, QString *error) = 0;
+				     const MarkerList &full_marker_list, QString *error) = 0;
 	virtual bool on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *error) = 0;
 };
 
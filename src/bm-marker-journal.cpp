@@ -0,0 +1,361 @@
+#include "bm-marker-journal.hpp"
+
+#include "bm-file-integrity.hpp"
+
+#include <QDir>
+#include <QFile>
+
+namespace bm {
+namespace {
+
+// Journal layout: magic, then records of [payload size (be32)][payload][FNV-1a of the payload (be64)]. The first
+// record opens the recording (media path and frame rate); every later one is a marker. Replay stops at the first
+// short or mismatching record, which is where a crash cut the last append.
+const QByteArray JOURNAL_MAGIC("BMMJRNL1");
+const QString JOURNAL_SUFFIX(".bmj");
+constexpr qint64 kRecordHeaderSize = 4;
+constexpr qint64 kRecordChecksumSize = 8;
+// Far beyond any real marker; a larger size can only come from a damaged header.
+constexpr quint32 kMaxRecordPayloadSize = 16 * 1024 * 1024;
+
+enum RecordType : char {
+	RecordOpen = 1,
+	RecordMarker = 2,
+};
+
+void append_be(QByteArray *out, quint64 value, int bytes)
+{
+	for (int i = bytes - 1; i >= 0; --i)
+		out->append(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+void append_string(QByteArray *out, const QString &value)
+{
+	const QByteArray utf8 = value.toUtf8();
+	append_be(out, static_cast<quint64>(utf8.size()), 4);
+	out->append(utf8);
+}
+
+void append_record(QByteArray *out, const QByteArray &payload)
+{
+	append_be(out, static_cast<quint64>(payload.size()), 4);
+	out->append(payload);
+	append_be(out, fnv1a64(payload.constData(), payload.size()), 8);
+}
+
+QByteArray open_payload(const QString &media_path, uint32_t fps_num, uint32_t fps_den)
+{
+	QByteArray payload;
+	payload.append(RecordOpen);
+	append_be(&payload, fps_num, 4);
+	append_be(&payload, fps_den, 4);
+	append_string(&payload, media_path);
+	return payload;
+}
+
+QByteArray marker_payload(const MarkerRecord &marker)
+{
+	QByteArray payload;
+	payload.reserve(64 + marker.name.size() + marker.comment.size() + marker.guid.size());
+	payload.append(RecordMarker);
+	append_be(&payload, static_cast<quint64>(marker.start_frame), 8);
+	append_be(&payload, static_cast<quint64>(marker.duration_frames), 8);
+	append_be(&payload, static_cast<quint32>(marker.color_id), 4);
+	append_string(&payload, marker.name);
+	append_string(&payload, marker.comment);
+	append_string(&payload, marker.type);
+	append_string(&payload, marker.guid);
+	return payload;
+}
+
+// Bounds-checked reads over one record's payload.
+class PayloadReader {
+public:
+	PayloadReader(const char *data, qint64 size) : m_data(data), m_size(size) {}
+
+	bool read_be(int bytes, quint64 *value)
+	{
+		if (m_size - m_offset < bytes)
+			return false;
+		quint64 result = 0;
+		for (int i = 0; i < bytes; ++i)
+			result = (result << 8) | static_cast<unsigned char>(m_data[m_offset + i]);
+		m_offset += bytes;
+		*value = result;
+		return true;
+	}
+
+	bool read_string(QString *value)
+	{
+		quint64 size = 0;
+		if (!read_be(4, &size) || static_cast<quint64>(m_size - m_offset) < size)
+			return false;
+		*value = QString::fromUtf8(m_data + m_offset, static_cast<qsizetype>(size));
+		m_offset += static_cast<qint64>(size);
+		return true;
+	}
+
+	bool at_end() const { return m_offset == m_size; }
+
+private:
+	const char *m_data;
+	qint64 m_size;
+	qint64 m_offset = 0;
+};
+
+bool parse_open(PayloadReader *reader, MarkerJournal::Recording *out)
+{
+	quint64 fps_num = 0;
+	quint64 fps_den = 0;
+	if (!reader->read_be(4, &fps_num) || !reader->read_be(4, &fps_den) || !reader->read_string(&out->media_path))
+		return false;
+	out->fps_num = static_cast<uint32_t>(fps_num);
+	out->fps_den = static_cast<uint32_t>(fps_den);
+	return reader->at_end() && !out->media_path.isEmpty();
+}
+
+bool parse_marker(PayloadReader *reader, MarkerRecord *out)
+{
+	quint64 start_frame = 0;
+	quint64 duration_frames = 0;
+	quint64 color_id = 0;
+	if (!reader->read_be(8, &start_frame) || !reader->read_be(8, &duration_frames) ||
+	    !reader->read_be(4, &color_id) || !reader->read_string(&out->name) || !reader->read_string(&out->comment) ||
+	    !reader->read_string(&out->type) || !reader->read_string(&out->guid))
+		return false;
+	out->start_frame = static_cast<int64_t>(start_frame);
+	out->duration_frames = static_cast<int64_t>(duration_frames);
+	out->color_id = static_cast<int>(static_cast<qint32>(color_id));
+	return reader->at_end();
+}
+
+} // namespace
+
+MarkerJournal::MarkerJournal(const QString &journal_dir) : m_journal_dir(journal_dir)
+{
+	m_committer = std::thread([this]() { run(); });
+}
+
+MarkerJournal::~MarkerJournal()
+{
+	stop();
+}
+
+QString MarkerJournal::journal_path_for_media(const QString &media_path) const
+{
+	const QByteArray utf8 = media_path.toUtf8();
+	const QString name = QString::number(fnv1a64(utf8.constData(), utf8.size()), 16).rightJustified(16, '0');
+	return QDir(m_journal_dir).filePath(name + JOURNAL_SUFFIX);
+}
+
+bool MarkerJournal::append(const QString &media_path, uint32_t fps_num, uint32_t fps_den, const MarkerRecord &marker,
+			   QString *error)
+{
+	QByteArray bytes;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_journals.find(media_path);
+	if (it == m_journals.end()) {
+		// A journal under this name left from an earlier session was replayed at startup, so start over.
+		const QString journal_path = journal_path_for_media(media_path);
+		auto file = std::make_shared<QFile>(journal_path);
+		if (!QDir().mkpath(m_journal_dir) ||
+		    !file->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+			if (error)
+				*error = QString("Failed to open marker journal: %1").arg(journal_path);
+			return false;
+		}
+		bytes += JOURNAL_MAGIC;
+		append_record(&bytes, open_payload(media_path, fps_num, fps_den));
+		it = m_journals.insert(media_path, OpenJournal{std::move(file), false});
+	}
+
+	append_record(&bytes, marker_payload(marker));
+	if (it->file->write(bytes) != bytes.size()) {
+		if (error)
+			*error = QString("Failed to append to marker journal: %1").arg(it->file->fileName());
+		return false;
+	}
+
+	it->dirty = true;
+	m_has_dirty = true;
+	m_cv.notify_one();
+	if (m_commit_error.isEmpty())
+		return true;
+	// The committer has no one to tell, so its failure is reported to the next caller.
+	if (error)
+		*error = m_commit_error;
+	m_commit_error.clear();
+	return false;
+}
+
+bool MarkerJournal::sync(QString *error)
+{
+	std::lock_guard<std::mutex> sync_lock(m_sync_mutex);
+	return commit_dirty(error);
+}
+
+bool MarkerJournal::remove(const QString &media_path, QString *error)
+{
+	std::lock_guard<std::mutex> sync_lock(m_sync_mutex);
+	std::shared_ptr<QFile> file;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		file = m_journals.take(media_path).file;
+	}
+	if (file)
+		file->close();
+
+	const QString journal_path = journal_path_for_media(media_path);
+	if (QFile::exists(journal_path) && !QFile::remove(journal_path)) {
+		if (error)
+			*error = QString("Failed to remove marker journal: %1").arg(journal_path);
+		return false;
+	}
+	return true;
+}
+
+QVector<MarkerJournal::Recording> MarkerJournal::load_all() const
+{
+	QVector<Recording> recordings;
+	const QDir dir(m_journal_dir);
+	const QStringList names = dir.entryList(QStringList{"*" + JOURNAL_SUFFIX}, QDir::Files, QDir::Name);
+	for (const QString &name : names) {
+		const QString journal_path = dir.filePath(name);
+		Recording recording;
+		QString error;
+		if (read_journal(journal_path, &recording, &error)) {
+			recordings.push_back(recording);
+			continue;
+		}
+		// Nothing was committed past the header, so there is nothing to recover.
+		QFile::remove(journal_path);
+	}
+	return recordings;
+}
+
+void MarkerJournal::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_cv.notify_all();
+	if (m_committer.joinable())
+		m_committer.join();
+	sync(nullptr);
+}
+
+bool MarkerJournal::read_journal(const QString &journal_path, Recording *out, QString *error)
+{
+	QFile file(journal_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		if (error)
+			*error = QString("Failed to open marker journal: %1").arg(journal_path);
+		return false;
+	}
+	const QByteArray bytes = file.readAll();
+	if (!bytes.startsWith(JOURNAL_MAGIC)) {
+		if (error)
+			*error = QString("Not a marker journal: %1").arg(journal_path);
+		return false;
+	}
+
+	Recording recording;
+	bool opened = false;
+	qint64 offset = JOURNAL_MAGIC.size();
+	while (bytes.size() - offset >= kRecordHeaderSize + kRecordChecksumSize) {
+		quint64 payload_size = 0;
+		PayloadReader header(bytes.constData() + offset, kRecordHeaderSize);
+		header.read_be(4, &payload_size);
+		const qint64 available = bytes.size() - offset - kRecordHeaderSize - kRecordChecksumSize;
+		if (payload_size == 0 || payload_size > kMaxRecordPayloadSize ||
+		    static_cast<quint64>(available) < payload_size)
+			break;
+
+		const char *payload = bytes.constData() + offset + kRecordHeaderSize;
+		quint64 checksum = 0;
+		PayloadReader trailer(payload + payload_size, kRecordChecksumSize);
+		trailer.read_be(8, &checksum);
+		if (checksum != fnv1a64(payload, static_cast<qint64>(payload_size)))
+			break;
+
+		PayloadReader reader(payload + 1, static_cast<qint64>(payload_size) - 1);
+		if (!opened) {
+			if (payload[0] != RecordOpen || !parse_open(&reader, &recording))
+				break;
+			opened = true;
+		} else {
+			MarkerRecord marker;
+			if (payload[0] != RecordMarker || !parse_marker(&reader, &marker))
+				break;
+			recording.markers.push_back(marker);
+		}
+		offset += kRecordHeaderSize + static_cast<qint64>(payload_size) + kRecordChecksumSize;
+	}
+
+	if (!opened) {
+		if (error)
+			*error = QString("Marker journal has no intact header record: %1").arg(journal_path);
+		return false;
+	}
+	*out = recording;
+	return true;
+}
+
+void MarkerJournal::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stopping) {
+		if (!m_has_dirty) {
+			m_cv.wait(lock);
+			continue;
+		}
+		lock.unlock();
+		QString error;
+		const bool ok = sync(&error);
+		lock.lock();
+		if (!ok)
+			m_commit_error = error;
+	}
+}
+
+bool MarkerJournal::commit_dirty(QString *error)
+{
+	struct DirtyJournal {
+		std::shared_ptr<QFile> file;
+		int fd = -1;
+		QString path;
+	};
+	QVector<DirtyJournal> dirty;
+	bool ok = true;
+	{
+		// append() writes under m_mutex, so the QFile is only touched here; its descriptor is synced without
+		// the lock. remove() closes journals under m_sync_mutex, which the caller holds, so they stay open.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_journals.begin(); it != m_journals.end(); ++it) {
+			if (!it->dirty)
+				continue;
+			it->dirty = false;
+			const QString path = it->file->fileName();
+			if (!it->file->flush()) {
+				if (error && ok)
+					*error = QString("Failed to flush marker journal: %1").arg(path);
+				ok = false;
+				continue;
+			}
+			dirty.push_back(DirtyJournal{it->file, it->file->handle(), path});
+		}
+		m_has_dirty = false;
+	}
+
+	for (const DirtyJournal &journal : dirty) {
+		if (sync_fd_to_disk(journal.fd))
+			continue;
+		if (error && ok)
+			*error = QString("Failed to sync marker journal: %1").arg(journal.path);
+		ok = false;
+	}
+	return ok;
+}
+
+} // namespace bm
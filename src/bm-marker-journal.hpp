@@ -0,0 +1,80 @@
+#pragma once
+
+#include "bm-marker-data.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class QFile;
+
+namespace bm {
+
+// Append-only record of every marker added to a recording, one file per media file under the store dir. It is the
+// durable copy of the markers while recording: each marker is a single ~100-byte append, and a committer thread
+// fdatasyncs every journal written since its last pass in one go (appends that land during a sync ride along with
+// the next one). A recording's journal is removed once its artifacts are finalized, so whatever is left at startup
+// belongs to a session that crashed and is replayed to regenerate the sidecars.
+class MarkerJournal {
+public:
+	struct Recording {
+		QString media_path;
+		uint32_t fps_num = 30;
+		uint32_t fps_den = 1;
+		QVector<MarkerRecord> markers;
+	};
+
+	explicit MarkerJournal(const QString &journal_dir);
+	~MarkerJournal();
+
+	MarkerJournal(const MarkerJournal &) = delete;
+	MarkerJournal &operator=(const MarkerJournal &) = delete;
+
+	QString journal_path_for_media(const QString &media_path) const;
+
+	// Appends the marker to the media file's journal, starting a new journal for a recording not seen this session.
+	// Returns once the record is written; it is on disk after the committer's next pass or sync(). Also returns
+	// false, with the record written, to report that a background commit failed since the last call.
+	bool append(const QString &media_path, uint32_t fps_num, uint32_t fps_den, const MarkerRecord &marker,
+		    QString *error);
+	// Commits every append made so far before returning.
+	bool sync(QString *error);
+	// Closes and deletes the media file's journal.
+	bool remove(const QString &media_path, QString *error);
+	// Every journal left in the directory, up to its last intact record. Journals too short to name their recording
+	// are deleted.
+	QVector<Recording> load_all() const;
+	// Stops the committer after a last sync; later appends are committed by sync() or not at all.
+	void stop();
+
+	static bool read_journal(const QString &journal_path, Recording *out, QString *error);
+
+private:
+	struct OpenJournal {
+		std::shared_ptr<QFile> file;
+		bool dirty = false;
+	};
+
+	void run();
+	bool commit_dirty(QString *error);
+
+	const QString m_journal_dir;
+	// Held around every fdatasync pass and by remove(), so a journal is never deleted while it is being synced.
+	// Taken before m_mutex; appends only take m_mutex and never wait for the disk.
+	std::mutex m_sync_mutex;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	QHash<QString, OpenJournal> m_journals;
+	bool m_has_dirty = false;
+	QString m_commit_error;
+	bool m_stopping = false;
+	std::thread m_committer;
+};
+
+} // namespace bm
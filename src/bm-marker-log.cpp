@@ -0,0 +1,52 @@
+#include "bm-marker-log.hpp"
+
+namespace bm {
+
+MarkerList::MarkerList(const QVector<MarkerRecord> &markers)
+{
+	const MarkerLog log(markers);
+	*this = log.snapshot();
+}
+
+QVector<MarkerRecord> MarkerList::to_vector() const
+{
+	QVector<MarkerRecord> markers;
+	markers.reserve(m_size);
+	for (const MarkerRecord &marker : *this)
+		markers.push_back(marker);
+	return markers;
+}
+
+MarkerList::Chunk::~Chunk()
+{
+	for (qsizetype slot = 0; slot < constructed; ++slot)
+		record(slot).~MarkerRecord();
+}
+
+MarkerLog::MarkerLog(const QVector<MarkerRecord> &markers)
+{
+	for (const MarkerRecord &marker : markers)
+		append(marker);
+}
+
+void MarkerLog::append(const MarkerRecord &marker)
+{
+	const qsizetype slot = m_size % MarkerList::kChunkSize;
+	if (slot == 0) {
+		// Lists already taken keep the old table; the new one only adds the chunk pointer.
+		auto chunks = std::make_shared<MarkerList::ChunkTable>();
+		if (m_chunks) {
+			chunks->reserve(m_chunks->size() + 1);
+			chunks->insert(chunks->end(), m_chunks->begin(), m_chunks->end());
+		}
+		chunks->push_back(std::make_shared<MarkerList::Chunk>());
+		m_chunks = std::move(chunks);
+	}
+
+	MarkerList::Chunk &chunk = *m_chunks->back();
+	new (chunk.storage + slot * sizeof(MarkerRecord)) MarkerRecord(marker);
+	chunk.constructed = slot + 1;
+	++m_size;
+}
+
+} // namespace bm
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "bm-marker-data.hpp"
+
+#include <QVector>
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace bm {
+
+// Immutable view of a recording's first size() markers, taken from a MarkerLog. Copying one costs a reference count,
+// whatever the length of the list, and it stays valid (and unchanged) while the log keeps appending or after the log
+// is gone, so the export worker and the sinks read it without taking the controller's lock or copying any marker.
+class MarkerList {
+public:
+	// Markers per chunk; a power of two so at() is a shift and a mask.
+	static constexpr qsizetype kChunkSize = 128;
+
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = MarkerRecord;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const MarkerRecord *;
+		using reference = const MarkerRecord &;
+
+		const_iterator(const MarkerList *list, qsizetype index) : m_list(list), m_index(index) {}
+
+		reference operator*() const { return m_list->at(m_index); }
+		pointer operator->() const { return &m_list->at(m_index); }
+		const_iterator &operator++()
+		{
+			++m_index;
+			return *this;
+		}
+		bool operator==(const const_iterator &other) const { return m_index == other.m_index; }
+		bool operator!=(const const_iterator &other) const { return m_index != other.m_index; }
+
+	private:
+		const MarkerList *m_list;
+		qsizetype m_index;
+	};
+
+	MarkerList() = default;
+	// Copies markers into a list of their own; for replayed recordings and tests, not the per-marker path.
+	MarkerList(const QVector<MarkerRecord> &markers);
+
+	qsizetype size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+	const MarkerRecord &at(qsizetype index) const
+	{
+		return (*m_chunks)[static_cast<size_t>(index / kChunkSize)]->record(index % kChunkSize);
+	}
+	const MarkerRecord &first() const { return at(0); }
+	const MarkerRecord &last() const { return at(m_size - 1); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, m_size); }
+
+	QVector<MarkerRecord> to_vector() const;
+
+private:
+	friend class MarkerLog;
+
+	// Slots are constructed in place one at a time by the owning log and never change afterwards; a list only reads
+	// the slots below its size, which were all written before it was taken.
+	struct Chunk {
+		Chunk() = default;
+		~Chunk();
+		Chunk(const Chunk &) = delete;
+		Chunk &operator=(const Chunk &) = delete;
+
+		MarkerRecord &record(qsizetype slot)
+		{
+			return *std::launder(reinterpret_cast<MarkerRecord *>(storage) + slot);
+		}
+		const MarkerRecord &record(qsizetype slot) const
+		{
+			return *std::launder(reinterpret_cast<const MarkerRecord *>(storage) + slot);
+		}
+
+		alignas(MarkerRecord) unsigned char storage[kChunkSize * sizeof(MarkerRecord)];
+		// Written by the owning log only; read by the destructor once every list is gone.
+		qsizetype constructed = 0;
+	};
+	using ChunkTable = std::vector<std::shared_ptr<Chunk>>;
+
+	MarkerList(std::shared_ptr<const ChunkTable> chunks, qsizetype size) : m_chunks(std::move(chunks)), m_size(size)
+	{
+	}
+
+	std::shared_ptr<const ChunkTable> m_chunks;
+	qsizetype m_size = 0;
+};
+
+// Append-only marker list of one recording. Appending constructs the marker in the tail chunk, which lists already
+// taken share but never read that far into; only starting a new chunk copies the chunk table (one pointer per
+// kChunkSize markers). Not thread-safe: appends and snapshot() must be serialized by the owner, after which the
+// snapshots can be read from any thread. Not copyable, since two logs appending into a shared chunk would collide.
+class MarkerLog {
+public:
+	MarkerLog() = default;
+	explicit MarkerLog(const QVector<MarkerRecord> &markers);
+
+	MarkerLog(const MarkerLog &) = delete;
+	MarkerLog &operator=(const MarkerLog &) = delete;
+
+	void append(const MarkerRecord &marker);
+	qsizetype size() const { return m_size; }
+	MarkerList snapshot() const { return MarkerList(m_chunks, m_size); }
+
+private:
+	std::shared_ptr<const MarkerList::ChunkTable> m_chunks;
+	qsizetype m_size = 0;
+};
+
+} // namespace bm
@@ -0,0 +1,69 @@
+#include "bm-marker-render-cache.hpp"
+
+namespace bm {
+namespace {
+
+bool same_marker(const MarkerRecord &a, const MarkerRecord &b)
+{
+	return a.start_frame == b.start_frame && a.duration_frames == b.duration_frames && a.color_id == b.color_id &&
+	       a.name == b.name && a.comment == b.comment && a.type == b.type;
+}
+
+} // namespace
+
+void MarkerRenderCache::append_fragment(XmlEmitter &xml, Fragment fragment, const MarkerRecord &marker,
+						uint32_t fps_num, uint32_t fps_den, const Render &render)
+{
+	if (marker.guid.isEmpty()) {
+		render(xml);
+		return;
+	}
+
+	QByteArray bytes;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(marker.guid);
+		if (it != m_entries.end() && same_marker(it->marker, marker)) {
+			const Slot &slot = fragment == Fragment::FcpxmlMarker ? it->fcpxml_marker : it->xmp_item;
+			if (slot.fps_num == fps_num && slot.fps_den == fps_den)
+				bytes = slot.bytes;
+		}
+	}
+	if (!bytes.isEmpty()) {
+		xml.raw(bytes);
+		return;
+	}
+
+	// Rendered in place, then copied out of the document buffer.
+	const qsizetype start = xml.size();
+	render(xml);
+	bytes = xml.bytes().mid(start);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(marker.guid);
+	if (it == m_entries.end() || !same_marker(it->marker, marker)) {
+		// New marker, or an edited one whose other fragments are stale too.
+		Entry entry;
+		entry.marker = marker;
+		it = m_entries.insert(marker.guid, entry);
+	}
+	Slot &slot = fragment == Fragment::FcpxmlMarker ? it->fcpxml_marker : it->xmp_item;
+	slot.fps_num = fps_num;
+	slot.fps_den = fps_den;
+	slot.bytes = bytes;
+	++m_render_count;
+}
+
+int MarkerRenderCache::size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<int>(m_entries.size());
+}
+
+int MarkerRenderCache::render_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_render_count;
+}
+
+} // namespace bm
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bm-marker-data.hpp"
+#include "bm-xml-emitter.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace bm {
+
+// Per-recording cache of each marker's rendered UTF-8 fragments, keyed by marker guid. The sinks rewrite their
+// documents from the full marker list on every add; with the cache only new or edited markers are formatted and
+// escaped again, the rest are copied in as bytes. A fragment is dropped when its marker or the frame rate it was
+// rendered at changes. Shared by every sink of the recording and safe to use from several threads.
+class MarkerRenderCache {
+public:
+	enum class Fragment {
+		// <marker .../> line without indent, shared by both FCPXML profiles.
+		FcpxmlMarker,
+		// Whole <rdf:li> item of the XMP marker track.
+		XmpItem,
+	};
+
+	using Render = std::function<void(XmlEmitter &xml)>;
+
+	// Appends the cached fragment to xml, calling render on a miss (and caching what it emitted).
+	void append_fragment(XmlEmitter &xml, Fragment fragment, const MarkerRecord &marker, uint32_t fps_num,
+			     uint32_t fps_den, const Render &render);
+
+	int size() const;
+	int render_count() const;
+
+private:
+	struct Slot {
+		uint32_t fps_num = 0;
+		uint32_t fps_den = 0;
+		QByteArray bytes;
+	};
+
+	struct Entry {
+		MarkerRecord marker;
+		Slot fcpxml_marker;
+		Slot xmp_item;
+	};
+
+	mutable std::mutex m_mutex;
+	QHash<QString, Entry> m_entries;
+	int m_render_count = 0;
+};
+
+} // namespace bm
@@ -1,5 +1,7 @@
 #include "bm-models.hpp"
 
+#include <algorithm>
+
 namespace bm {
 
 const char *scope_to_key(TemplateScope scope)
@@ -109,6 +111,12 @@ ResolveExportMode resolve_export_mode_from_key(const QString &mode_key)
 const char *export_write_cadence_to_key(ExportWriteCadence cadence)
 {
 	switch (cadence) {
+	case ExportWriteCadence::Debounced:
+		return "debounced";
+	case ExportWriteCadence::Interval:
+		return "interval";
+	case ExportWriteCadence::OnRecordingClose:
+		return "on_recording_close";
 	case ExportWriteCadence::Immediate:
 	default:
 		return "immediate";
@@ -117,19 +125,101 @@ const char *export_write_cadence_to_key(ExportWriteCadence cadence)
 
 ExportWriteCadence export_write_cadence_from_key(const QString &cadence_key)
 {
-	if (cadence_key == "immediate")
-		return ExportWriteCadence::Immediate;
+	if (cadence_key == "debounced")
+		return ExportWriteCadence::Debounced;
+	if (cadence_key == "interval")
+		return ExportWriteCadence::Interval;
+	if (cadence_key == "on_recording_close")
+		return ExportWriteCadence::OnRecordingClose;
 	return ExportWriteCadence::Immediate;
 }
 
+const char *artifact_durability_to_key(ArtifactDurability durability)
+{
+	switch (durability) {
+	case ArtifactDurability::Strict:
+		return "strict";
+	case ArtifactDurability::Deferred:
+		return "deferred";
+	case ArtifactDurability::Grouped:
+	default:
+		return "grouped";
+	}
+}
+
+ArtifactDurability artifact_durability_from_key(const QString &durability_key)
+{
+	if (durability_key == "strict")
+		return ArtifactDurability::Strict;
+	if (durability_key == "deferred")
+		return ArtifactDurability::Deferred;
+	return ArtifactDurability::Grouped;
+}
+
+const char *premiere_embed_writer_to_key(PremiereEmbedWriter writer)
+{
+	switch (writer) {
+	case PremiereEmbedWriter::ExifTool:
+		return "exiftool";
+	case PremiereEmbedWriter::NativeWithExifToolFallback:
+		return "native_with_exiftool_fallback";
+	case PremiereEmbedWriter::Native:
+	default:
+		return "native";
+	}
+}
+
+PremiereEmbedWriter premiere_embed_writer_from_key(const QString &writer_key)
+{
+	if (writer_key == "exiftool")
+		return PremiereEmbedWriter::ExifTool;
+	if (writer_key == "native_with_exiftool_fallback")
+		return PremiereEmbedWriter::NativeWithExifToolFallback;
+	return PremiereEmbedWriter::Native;
+}
+
+const char *premiere_embed_io_mode_to_key(PremiereEmbedIoMode mode)
+{
+	switch (mode) {
+	case PremiereEmbedIoMode::Streaming:
+		return "streaming";
+	case PremiereEmbedIoMode::Direct:
+		return "direct";
+	case PremiereEmbedIoMode::PageCache:
+	default:
+		return "page_cache";
+	}
+}
+
+PremiereEmbedIoMode premiere_embed_io_mode_from_key(const QString &mode_key)
+{
+	if (mode_key == "streaming")
+		return PremiereEmbedIoMode::Streaming;
+	if (mode_key == "direct")
+		return PremiereEmbedIoMode::Direct;
+	return PremiereEmbedIoMode::PageCache;
+}
+
 QJsonObject export_profile_to_json(const ExportProfile &profile)
 {
 	QJsonObject json_obj;
 	json_obj.insert("enablePremiereXmp", profile.enable_premiere_xmp);
 	json_obj.insert("enableResolveFcpxml", profile.enable_resolve_fcpxml);
 	json_obj.insert("enableFinalCutFcpxml", profile.enable_final_cut_fcpxml);
+	json_obj.insert("enableEdlMarkers", profile.enable_edl_markers);
+	json_obj.insert("enableCsvMarkers", profile.enable_csv_markers);
+	json_obj.insert("enableYoutubeChapters", profile.enable_youtube_chapters);
 	json_obj.insert("resolveMode", resolve_export_mode_to_key(profile.resolve_mode));
 	json_obj.insert("writeCadence", export_write_cadence_to_key(profile.write_cadence));
+	json_obj.insert("writeCadenceMs", profile.write_cadence_ms);
+	json_obj.insert("artifactDurability", artifact_durability_to_key(profile.artifact_durability));
+	json_obj.insert("artifactSyncWindowMs", profile.artifact_sync_window_ms);
+	json_obj.insert("premiereEmbedWriter", premiere_embed_writer_to_key(profile.premiere_embed_writer));
+	json_obj.insert("embedMaxConcurrency", profile.embed_max_concurrency);
+	json_obj.insert("embedPerDeviceConcurrency", profile.embed_per_device_concurrency);
+	json_obj.insert("embedIoMode", premiere_embed_io_mode_to_key(profile.embed_io_mode));
+	json_obj.insert("embedMaxThroughputMiBs", profile.embed_max_throughput_mib_s);
+	json_obj.insert("embedFaststart", profile.embed_faststart);
 	return json_obj;
 }
 
@@ -140,8 +230,31 @@ ExportProfile export_profile_from_json(const QJsonObject &json_obj)
 		profile.enable_premiere_xmp = json_obj.value("enablePremiereXmp").toBool(true);
 		profile.enable_resolve_fcpxml = json_obj.value("enableResolveFcpxml").toBool(false);
 		profile.enable_final_cut_fcpxml = json_obj.value("enableFinalCutFcpxml").toBool(false);
+		profile.enable_edl_markers = json_obj.value("enableEdlMarkers").toBool(false);
+		profile.enable_csv_markers = json_obj.value("enableCsvMarkers").toBool(false);
+		profile.enable_youtube_chapters = json_obj.value("enableYoutubeChapters").toBool(false);
 		profile.resolve_mode = resolve_export_mode_from_key(json_obj.value("resolveMode").toString("timeline_markers"));
 		profile.write_cadence = export_write_cadence_from_key(json_obj.value("writeCadence").toString("immediate"));
+		const int cadence_ms = json_obj.value("writeCadenceMs").toInt(profile.write_cadence_ms);
+		profile.write_cadence_ms = std::clamp(cadence_ms, kMinWriteCadenceMs, kMaxWriteCadenceMs);
+		profile.artifact_durability =
+			artifact_durability_from_key(json_obj.value("artifactDurability").toString("grouped"));
+		const int window_ms = json_obj.value("artifactSyncWindowMs").toInt(profile.artifact_sync_window_ms);
+		profile.artifact_sync_window_ms =
+			std::clamp(window_ms, kMinArtifactSyncWindowMs, kMaxArtifactSyncWindowMs);
+		profile.premiere_embed_writer =
+			premiere_embed_writer_from_key(json_obj.value("premiereEmbedWriter").toString("native"));
+		const int max_concurrency = json_obj.value("embedMaxConcurrency").toInt(profile.embed_max_concurrency);
+		const int per_device_concurrency =
+			json_obj.value("embedPerDeviceConcurrency").toInt(profile.embed_per_device_concurrency);
+		profile.embed_max_concurrency = std::clamp(max_concurrency, 1, kMaxEmbedConcurrency);
+		profile.embed_per_device_concurrency = std::clamp(per_device_concurrency, 1, kMaxEmbedConcurrency);
+		profile.embed_io_mode =
+			premiere_embed_io_mode_from_key(json_obj.value("embedIoMode").toString("page_cache"));
+		const int max_throughput =
+			json_obj.value("embedMaxThroughputMiBs").toInt(profile.embed_max_throughput_mib_s);
+		profile.embed_max_throughput_mib_s = std::clamp(max_throughput, 0, kMaxEmbedThroughputMiBs);
+		profile.embed_faststart = json_obj.value("embedFaststart").toBool(false);
 	}
 	return profile;
 }
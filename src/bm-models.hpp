@@ -36,18 +36,73 @@ enum class ResolveExportMode {
 	TimelineMarkers,
 };
 
+// When marker additions reach the export sinks. Every cadence still writes everything on recording close.
 enum class ExportWriteCadence {
 	Immediate,
+	// write_cadence_ms after the last marker of a burst, capped at kMaxDebounceFactor delays after its first.
+	Debounced,
+	// At most once per write_cadence_ms, write_cadence_ms after the first unwritten marker.
+	Interval,
+	OnRecordingClose,
+};
+
+// When rewritten export artifacts are forced to disk. The marker journal is the durable copy of every marker, so an
+// artifact lost to a crash before its sync is regenerated by journal replay at the next startup.
+enum class ArtifactDurability {
+	// Each artifact is synced, renamed into place and its directory synced before its sink returns.
+	Strict,
+	// The artifacts of one marker event are synced and renamed together, then each directory is synced once.
+	Grouped,
+	// Artifacts are renamed into place unsynced and synced together artifact_sync_window_ms after the first one.
+	Deferred,
+};
+
+enum class PremiereEmbedWriter {
+	Native,
+	ExifTool,
+	NativeWithExifToolFallback,
+};
+
+enum class PremiereEmbedIoMode {
+	PageCache,
+	Streaming,
+	Direct,
 };
 
 struct ExportProfile {
 	bool enable_premiere_xmp = true;
 	bool enable_resolve_fcpxml = false;
 	bool enable_final_cut_fcpxml = false;
+	// Append-only text exports that can be followed while the recording runs.
+	bool enable_edl_markers = false;
+	bool enable_csv_markers = false;
+	bool enable_youtube_chapters = false;
 	ResolveExportMode resolve_mode = ResolveExportMode::TimelineMarkers;
 	ExportWriteCadence write_cadence = ExportWriteCadence::Immediate;
+	// Delay for the Debounced and Interval cadences.
+	int write_cadence_ms = 1000;
+	ArtifactDurability artifact_durability = ArtifactDurability::Grouped;
+	// Longest time a Deferred artifact stays unsynced.
+	int artifact_sync_window_ms = 2000;
+	PremiereEmbedWriter premiere_embed_writer = PremiereEmbedWriter::Native;
+	// Parallel embeds overall and per SSD/NVMe device; spinning disks always take one at a time.
+	int embed_max_concurrency = 4;
+	int embed_per_device_concurrency = 2;
+	// Temp-copy I/O: keep the page cache, stream past it, or bypass it; 0 MB/s means unthrottled.
+	PremiereEmbedIoMode embed_io_mode = PremiereEmbedIoMode::PageCache;
+	int embed_max_throughput_mib_s = 0;
+	// Move moov ahead of mdat while embedding, so no separate faststart remux is needed.
+	bool embed_faststart = false;
 };
 
+constexpr int kMaxEmbedConcurrency = 16;
+constexpr int kMaxEmbedThroughputMiBs = 10000;
+constexpr int kMinWriteCadenceMs = 50;
+constexpr int kMaxWriteCadenceMs = 60000;
+constexpr int kMaxDebounceFactor = 5;
+constexpr int kMinArtifactSyncWindowMs = 100;
+constexpr int kMaxArtifactSyncWindowMs = 60000;
+
 const char *scope_to_key(TemplateScope scope);
 TemplateScope scope_from_key(const QString &scope_key);
 
@@ -63,6 +118,15 @@ ResolveExportMode resolve_export_mode_from_key(const QString &mode_key);
 const char *export_write_cadence_to_key(ExportWriteCadence cadence);
 ExportWriteCadence export_write_cadence_from_key(const QString &cadence_key);
 
+const char *artifact_durability_to_key(ArtifactDurability durability);
+ArtifactDurability artifact_durability_from_key(const QString &durability_key);
+
+const char *premiere_embed_writer_to_key(PremiereEmbedWriter writer);
+PremiereEmbedWriter premiere_embed_writer_from_key(const QString &writer_key);
+
+const char *premiere_embed_io_mode_to_key(PremiereEmbedIoMode mode);
+PremiereEmbedIoMode premiere_embed_io_mode_from_key(const QString &mode_key);
+
 QJsonObject export_profile_to_json(const ExportProfile &profile);
 ExportProfile export_profile_from_json(const QJsonObject &json_obj);
 
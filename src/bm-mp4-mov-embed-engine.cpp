@@ -1,26 +1,50 @@
 #include "bm-mp4-mov-embed-engine.hpp"
 
+#include "bm-file-integrity.hpp"
+
 #include <QCoreApplication>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QProcess>
+#include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
+#include <QStringList>
 #include <QThread>
 
 #include <algorithm>
-#include <limits>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#if defined(_WIN32)
+#include <QDateTime>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
 
 namespace bm {
 namespace {
 
 const QByteArray ADOBE_XMP_UUID = QByteArray::fromHex("be7acfcb97a942e89c71999491e3afac");
+// Next to the recording: the temp copy, its resume checkpoint and the original while the copy replaces it.
+const QString TEMP_COPY_SUFFIX(".better-markers.tmp");
+const QString CHECKPOINT_SUFFIX(".checkpoint");
+const QString BACKUP_SUFFIX(".better-markers.bak");
 
-struct Atom {
-	quint64 offset = 0;
-	quint64 size = 0;
-	quint64 header_size = 0;
-	QByteArray type;
-};
+using Atom = Mp4Atom;
 
 quint32 read_be32(const char *data)
 {
@@ -43,190 +67,1320 @@ void write_be32(char *data, quint32 value)
 	data[3] = static_cast<char>(value & 0xFF);
 }
 
-bool is_xmp_uuid_atom(const QByteArray &atom)
+bool read_atom_header(QFile &file, quint64 offset, quint64 end, Atom *atom, QString *error)
 {
-	if (atom.size() < 24)
+	if (!file.seek(static_cast<qint64>(offset))) {
+		if (error)
+			*error = "Failed to seek while parsing atoms";
 		return false;
-	if (atom.mid(4, 4) != "uuid")
+	}
+
+	char header[16];
+	const qint64 wanted = static_cast<qint64>(std::min<quint64>(sizeof(header), end - offset));
+	const qint64 read = file.read(header, wanted);
+	if (read < 8) {
+		if (error)
+			*error = "Truncated atom header";
 		return false;
-	if (atom.mid(8, 16) != ADOBE_XMP_UUID)
+	}
+
+	const quint32 size32 = read_be32(header);
+	quint64 size = size32;
+	quint64 header_size = 8;
+	if (size32 == 1) {
+		if (read < 16) {
+			if (error)
+				*error = "Truncated extended atom header";
+			return false;
+		}
+		size = read_be64(header + 8);
+		header_size = 16;
+	} else if (size32 == 0) {
+		size = end - offset;
+	}
+
+	if (size < header_size || size > end - offset) {
+		if (error)
+			*error = "Invalid atom size";
 		return false;
-	return atom.indexOf("<?xpacket", 24) >= 0;
+	}
+
+	*atom = Atom{offset, size, header_size, QByteArray(header + 4, 4), size32 == 0};
+	return true;
 }
 
-bool parse_atoms_from_buffer(const QByteArray &buffer, int start, int end, QVector<Atom> &atoms, QString *error)
+// Walks sibling atoms inside [begin, end) by seeking from header to header. Only the 8/16-byte headers are read, so
+// memory use does not depend on atom or file size. Recurse by walking an atom's payload range.
+class AtomIterator {
+public:
+	AtomIterator(QFile &file, quint64 begin, quint64 end) : m_file(file), m_offset(begin), m_end(end) {}
+	AtomIterator(QFile &file, const Atom &parent)
+		: AtomIterator(file, parent.offset + parent.header_size, parent.offset + parent.size)
+	{
+	}
+
+	bool next(Atom *atom)
+	{
+		if (m_failed || m_offset + 8 > m_end)
+			return false;
+		if (!read_atom_header(m_file, m_offset, m_end, atom, &m_error)) {
+			m_failed = true;
+			return false;
+		}
+		m_offset += atom->size;
+		return true;
+	}
+
+	// True once the whole range was covered by well-formed atoms.
+	bool finished(QString *error) const
+	{
+		if (m_failed) {
+			if (error)
+				*error = m_error;
+			return false;
+		}
+		if (m_offset != m_end) {
+			if (error)
+				*error = "Atom parse did not end on container boundary";
+			return false;
+		}
+		return true;
+	}
+
+private:
+	QFile &m_file;
+	quint64 m_offset = 0;
+	quint64 m_end = 0;
+	bool m_failed = false;
+	QString m_error;
+};
+
+bool parse_top_level_atoms(QFile &file, QVector<Atom> &atoms, QString *error)
 {
 	atoms.clear();
-	int pos = start;
-	while (pos + 8 <= end) {
-		const char *ptr = buffer.constData() + pos;
-		const quint32 size32 = read_be32(ptr);
-		const QByteArray type(ptr + 4, 4);
-
-		quint64 size = size32;
-		quint64 header = 8;
-		if (size32 == 1) {
-			if (pos + 16 > end) {
-				if (error)
-					*error = "Truncated extended atom header";
-				return false;
+	AtomIterator it(file, 0, static_cast<quint64>(file.size()));
+	Atom atom;
+	while (it.next(&atom))
+		atoms.push_back(atom);
+	return it.finished(error);
+}
+
+// Reads only the 16-byte UUID plus a short probe of the payload for the xpacket wrapper.
+bool is_xmp_uuid_atom(QFile &file, const Atom &atom)
+{
+	constexpr quint64 kXmpPacketProbeBytes = 256;
+
+	if (atom.type != "uuid" || atom.size < atom.header_size + 16)
+		return false;
+	if (!file.seek(static_cast<qint64>(atom.offset + atom.header_size)))
+		return false;
+
+	const quint64 probe = std::min<quint64>(atom.size - atom.header_size, 16 + kXmpPacketProbeBytes);
+	const QByteArray head = file.read(static_cast<qint64>(probe));
+	if (head.size() < 16 || head.left(16) != ADOBE_XMP_UUID)
+		return false;
+	return head.indexOf("<?xpacket", 16) >= 0;
+}
+
+int first_xmp_index(const QVector<Atom> &top_level)
+{
+	for (int i = 0; i < top_level.size(); ++i) {
+		if (top_level.at(i).xmp_uuid)
+			return i;
+	}
+	return -1;
+}
+
+// Parses the top-level atoms and probes uuid atoms for XMP, or takes both from the cache when the file is unchanged.
+bool load_top_level_layout(QFile &file, const QString &path, AtomLayoutCache *cache, QVector<Atom> *top_level,
+			   QString *error)
+{
+	MediaFileIdentity identity;
+	const bool cacheable = cache && read_media_file_identity(path, &identity);
+	if (cacheable && cache->lookup(path, identity, top_level))
+		return true;
+
+	if (!parse_top_level_atoms(file, *top_level, error))
+		return false;
+	for (Atom &atom : *top_level)
+		atom.xmp_uuid = is_xmp_uuid_atom(file, atom);
+	if (cacheable)
+		cache->store(path, identity, *top_level);
+	return true;
+}
+
+void remember_written_layout(AtomLayoutCache *cache, const QString &path, const QVector<Atom> &top_level)
+{
+	MediaFileIdentity identity;
+	if (cache && read_media_file_identity(path, &identity))
+		cache->store(path, identity, top_level);
+}
+
+// Checks a freshly written file against the layout the writer produced: the total size, no atom before the last one
+// running to EOF, and the XMP atom header plus packet probe at its recorded offset. Two small reads instead of a walk.
+bool verify_written_layout(const QString &path, const QVector<Atom> &top_level)
+{
+	const int xmp_index = first_xmp_index(top_level);
+	if (xmp_index < 0)
+		return false;
+	for (int i = 0; i + 1 < top_level.size(); ++i) {
+		if (top_level.at(i).extends_to_eof)
+			return false;
+	}
+
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	const quint64 file_size = static_cast<quint64>(file.size());
+	if (file_size != top_level.constLast().offset + top_level.constLast().size)
+		return false;
+
+	const Atom &expected = top_level.at(xmp_index);
+	Atom actual;
+	return read_atom_header(file, expected.offset, file_size, &actual, nullptr) && actual.size == expected.size &&
+	       is_xmp_uuid_atom(file, actual);
+}
+
+Atom written_xmp_atom(quint64 offset, quint64 size)
+{
+	Atom atom{offset, size, 8, QByteArray("uuid")};
+	atom.xmp_uuid = true;
+	return atom;
+}
+
+QByteArray make_atom(const QByteArray &type, const QByteArray &payload, bool *ok)
+{
+	if (type.size() != 4) {
+		if (ok)
+			*ok = false;
+		return {};
+	}
+
+	const quint64 total_size = 8 + static_cast<quint64>(payload.size());
+	if (total_size > 0xFFFFFFFFULL) {
+		if (ok)
+			*ok = false;
+		return {};
+	}
+
+	QByteArray atom;
+	atom.resize(static_cast<int>(total_size));
+	write_be32(atom.data(), static_cast<quint32>(total_size));
+	memcpy(atom.data() + 4, type.constData(), 4);
+	if (!payload.isEmpty())
+		memcpy(atom.data() + 8, payload.constData(), payload.size());
+
+	if (ok)
+		*ok = true;
+	return atom;
+}
+
+QByteArray make_uuid_atom(const QByteArray &payload, bool *ok)
+{
+	const quint64 total_size = 8 + 16 + static_cast<quint64>(payload.size());
+	if (total_size > 0xFFFFFFFFULL) {
+		if (ok)
+			*ok = false;
+		return {};
+	}
+
+	QByteArray atom;
+	atom.resize(static_cast<int>(total_size));
+	write_be32(atom.data(), static_cast<quint32>(total_size));
+	memcpy(atom.data() + 4, "uuid", 4);
+	memcpy(atom.data() + 8, ADOBE_XMP_UUID.constData(), 16);
+	if (!payload.isEmpty())
+		memcpy(atom.data() + 24, payload.constData(), payload.size());
+
+	if (ok)
+		*ok = true;
+	return atom;
+}
+
+bool is_free_atom_type(const QByteArray &type)
+{
+	return type == "free" || type == "skip";
+}
+
+QByteArray make_free_atom_header(quint64 size)
+{
+	QByteArray header;
+	header.resize(8);
+	write_be32(header.data(), static_cast<quint32>(size));
+	memcpy(header.data() + 4, "free", 4);
+	return header;
+}
+
+enum class InPlaceOutcome {
+	Done,
+	NotApplicable,
+	Failed,
+};
+
+bool write_at(QFile &file, quint64 offset, const QByteArray &bytes)
+{
+	if (!file.seek(static_cast<qint64>(offset)))
+		return false;
+	return file.write(bytes) == bytes.size();
+}
+
+// Bytes of the recording as they were before an in-place write overwrote them.
+struct SavedRange {
+	quint64 offset = 0;
+	QByteArray bytes;
+};
+
+bool save_range(QFile &file, quint64 offset, quint64 length, QVector<SavedRange> *saved)
+{
+	if (!file.seek(static_cast<qint64>(offset)))
+		return false;
+	SavedRange range;
+	range.offset = offset;
+	range.bytes = file.read(static_cast<qint64>(length));
+	if (static_cast<quint64>(range.bytes.size()) != length)
+		return false;
+	saved->push_back(range);
+	return true;
+}
+
+// Puts the file back to original_size and writes the saved bytes back, newest first. False when the file could not
+// be restored, so the caller can say the recording may be damaged.
+bool restore_ranges(QFile &file, const QVector<SavedRange> &saved, quint64 original_size)
+{
+	bool ok = static_cast<quint64>(file.size()) == original_size || file.resize(static_cast<qint64>(original_size));
+	for (int i = saved.size() - 1; i >= 0; --i)
+		ok = write_at(file, saved.at(i).offset, saved.at(i).bytes) && ok;
+	return sync_file_to_disk(file) && ok;
+}
+
+bool restore_in_place(QFile &file, quint64 offset, const QByteArray &original, quint64 original_size)
+{
+	QVector<SavedRange> saved;
+	if (!original.isEmpty())
+		saved.push_back(SavedRange{offset, original});
+	return restore_ranges(file, saved, original_size);
+}
+
+// On Done, written holds the resulting top-level layout and the file is on disk. On Failed, the bytes that were
+// overwritten have been written back and anything appended truncated, so the atom chain is the one before the call.
+InPlaceOutcome try_embed_in_place(const QString &media_path, const QVector<Atom> &top_level, int existing_xmp_index,
+				  const QByteArray &xmp_atom, EmbedWriteMode *mode, QVector<Atom> *written,
+				  QString *error)
+{
+	QFile file(media_path);
+	if (!file.open(QIODevice::ReadWrite))
+		return InPlaceOutcome::NotApplicable;
+
+	const quint64 file_size = static_cast<quint64>(file.size());
+	const quint64 atom_size = static_cast<quint64>(xmp_atom.size());
+
+	if (existing_xmp_index >= 0) {
+		// The replacement may take over the old XMP atom and any free/skip atoms directly around it.
+		int first = existing_xmp_index;
+		while (first > 0 && is_free_atom_type(top_level.at(first - 1).type))
+			--first;
+		int last = existing_xmp_index;
+		while (last + 1 < top_level.size() && is_free_atom_type(top_level.at(last + 1).type) &&
+		       !top_level.at(last + 1).extends_to_eof)
+			++last;
+
+		const quint64 region_offset = top_level.at(first).offset;
+		const quint64 region_end = top_level.at(last).offset + top_level.at(last).size;
+		const quint64 region_size = region_end - region_offset;
+		const bool exact_fit = atom_size == region_size;
+		const bool padded_fit = atom_size + 8 <= region_size && region_size - atom_size <= 0xFFFFFFFFULL;
+		if (exact_fit || padded_fit) {
+			QByteArray region = xmp_atom;
+			if (!exact_fit)
+				region += make_free_atom_header(region_size - atom_size);
+			// Only the bytes the new atom and free header cover are overwritten; the rest of the padding is
+			// left as it was.
+			if (!file.seek(static_cast<qint64>(region_offset)))
+				return InPlaceOutcome::NotApplicable;
+			const QByteArray original = file.read(region.size());
+			if (original.size() != region.size())
+				return InPlaceOutcome::NotApplicable;
+			if (!write_at(file, region_offset, region) || !sync_file_to_disk(file)) {
+				const bool restored = restore_in_place(file, region_offset, original, file_size);
+				if (error) {
+					*error = "Failed to rewrite XMP uuid atom in place";
+					if (!restored)
+						*error += ", and the previous atom could not be restored";
+				}
+				return InPlaceOutcome::Failed;
 			}
-			size = read_be64(ptr + 8);
-			header = 16;
-		} else if (size32 == 0) {
-			size = static_cast<quint64>(end - pos);
+			written->clear();
+			for (int i = 0; i < first; ++i)
+				written->push_back(top_level.at(i));
+			written->push_back(written_xmp_atom(region_offset, atom_size));
+			if (!exact_fit)
+				written->push_back(Atom{region_offset + atom_size, region_size - atom_size, 8, "free"});
+			for (int i = last + 1; i < top_level.size(); ++i)
+				written->push_back(top_level.at(i));
+			if (mode)
+				*mode = EmbedWriteMode::InPlaceReplace;
+			return InPlaceOutcome::Done;
 		}
+	}
 
-		if (size < header || pos + static_cast<qint64>(size) > end) {
+	// Appending after an atom that is declared to run until EOF would swallow the new atom.
+	if (!top_level.isEmpty() && top_level.constLast().extends_to_eof)
+		return InPlaceOutcome::NotApplicable;
+
+	// The new atom is on disk before the old one is retired, so a crash in between leaves two XMP atoms rather than
+	// none.
+	if (!write_at(file, file_size, xmp_atom) || !sync_file_to_disk(file)) {
+		restore_in_place(file, file_size, QByteArray(), file_size);
+		if (error)
+			*error = "Failed to append XMP uuid atom in place";
+		return InPlaceOutcome::Failed;
+	}
+
+	*written = top_level;
+	if (existing_xmp_index >= 0) {
+		const Atom &existing = top_level.at(existing_xmp_index);
+		if (!write_at(file, existing.offset + 4, QByteArray("free")) || !sync_file_to_disk(file)) {
+			const bool restored = restore_in_place(file, existing.offset + 4, existing.type, file_size);
+			if (error) {
+				*error = "Failed to retire previous XMP uuid atom";
+				if (!restored)
+					*error += ", and the appended atom could not be removed";
+			}
+			return InPlaceOutcome::Failed;
+		}
+		(*written)[existing_xmp_index].type = "free";
+		(*written)[existing_xmp_index].xmp_uuid = false;
+	}
+	written->push_back(written_xmp_atom(file_size, atom_size));
+
+	if (mode)
+		*mode = EmbedWriteMode::InPlaceAppend;
+	return InPlaceOutcome::Done;
+}
+
+bool write_atom_size(QFile &file, const Atom &atom, quint64 new_size)
+{
+	QByteArray bytes;
+	if (atom.header_size == 16) {
+		bytes.resize(8);
+		write_be32(bytes.data(), static_cast<quint32>(new_size >> 32));
+		write_be32(bytes.data() + 4, static_cast<quint32>(new_size & 0xFFFFFFFFULL));
+		return write_at(file, atom.offset + 8, bytes);
+	}
+	if (new_size > 0xFFFFFFFFULL)
+		return false;
+	bytes.resize(4);
+	write_be32(bytes.data(), static_cast<quint32>(new_size));
+	return write_at(file, atom.offset, bytes);
+}
+
+// Mirrors the packet into moov/udta/XMP_ the way ExifTool lays out MOV metadata. Growing moov is only safe when no
+// media data follows it (chunk offsets would shift), so only free atoms and our XMP uuid atom may trail moov; the
+// uuid atom is carried over after the grown moov. Every byte it overwrites is saved first and written back on
+// failure, so a failed mirror leaves the recording as it was.
+bool write_udta_xmp_in_place(const QString &media_path, const QByteArray &xmp_payload, QString *error)
+{
+	QFile file(media_path);
+	if (!file.open(QIODevice::ReadWrite)) {
+		if (error)
+			*error = "Failed to open recording for udta XMP";
+		return false;
+	}
+
+	QVector<Atom> top_level;
+	if (!parse_top_level_atoms(file, top_level, error))
+		return false;
+
+	int moov_index = -1;
+	for (int i = 0; i < top_level.size(); ++i) {
+		if (top_level.at(i).type == "moov")
+			moov_index = i;
+	}
+	if (moov_index < 0) {
+		if (error)
+			*error = "No moov atom to carry udta XMP";
+		return false;
+	}
+
+	QByteArray tail;
+	for (int i = moov_index + 1; i < top_level.size(); ++i) {
+		const Atom &atom = top_level.at(i);
+		if (is_free_atom_type(atom.type))
+			continue;
+		if (!is_xmp_uuid_atom(file, atom)) {
+			if (error)
+				*error = "Media data follows moov; udta XMP skipped";
+			return false;
+		}
+		if (!file.seek(static_cast<qint64>(atom.offset))) {
 			if (error)
-				*error = "Invalid atom size while parsing buffer";
+				*error = "Failed to seek trailing XMP uuid atom";
 			return false;
 		}
+		const QByteArray bytes = file.read(static_cast<qint64>(atom.size));
+		if (bytes.size() != static_cast<qint64>(atom.size)) {
+			if (error)
+				*error = "Failed to read trailing XMP uuid atom";
+			return false;
+		}
+		tail += bytes;
+	}
+
+	const Atom moov = top_level.at(moov_index);
+	Atom udta;
+	bool has_udta = false;
+	bool udta_is_last = false;
+	AtomIterator moov_it(file, moov);
+	Atom child;
+	while (moov_it.next(&child)) {
+		udta_is_last = child.type == "udta";
+		if (udta_is_last) {
+			udta = child;
+			has_udta = true;
+		}
+	}
+	if (!moov_it.finished(error))
+		return false;
+	if (has_udta && !udta_is_last) {
+		if (error)
+			*error = "moov/udta is not the last moov child; udta XMP skipped";
+		return false;
+	}
+
+	QVector<quint64> stale_offsets;
+	if (has_udta) {
+		AtomIterator udta_it(file, udta);
+		Atom udta_child;
+		while (udta_it.next(&udta_child)) {
+			if (udta_child.type == "XMP_")
+				stale_offsets.push_back(udta_child.offset);
+		}
+		if (!udta_it.finished(error))
+			return false;
+	}
 
-		atoms.push_back(Atom{static_cast<quint64>(pos), size, header, type});
-		pos += static_cast<int>(size);
+	bool ok = true;
+	QByteArray mirror = make_atom("XMP_", xmp_payload, &ok);
+	if (ok && !has_udta)
+		mirror = make_atom("udta", mirror, &ok);
+	if (!ok) {
+		if (error)
+			*error = "XMP payload is too large for udta atom";
+		return false;
 	}
 
-	if (pos != end) {
+	const quint64 file_size = static_cast<quint64>(file.size());
+	const quint64 moov_end = moov.offset + moov.size;
+	const quint64 grown = static_cast<quint64>(mirror.size());
+	QVector<SavedRange> saved;
+	bool saved_all = save_range(file, moov_end, file_size - moov_end, &saved) &&
+			 save_range(file, moov.offset, moov.header_size, &saved) &&
+			 (!has_udta || save_range(file, udta.offset, udta.header_size, &saved));
+	for (quint64 offset : stale_offsets)
+		saved_all = saved_all && save_range(file, offset + 4, 4, &saved);
+	if (!saved_all) {
 		if (error)
-			*error = "Unaligned atom payload";
+			*error = "Failed to read the atoms udta XMP would overwrite";
+		return false;
+	}
+
+	// The new bytes are on disk before any size points at them: until moov is patched the mirror reads as a
+	// standalone top-level atom. The retypes and size patches are then synced together.
+	bool written = write_at(file, moov_end, mirror + tail) &&
+		       file.resize(static_cast<qint64>(moov_end + grown + static_cast<quint64>(tail.size()))) &&
+		       sync_file_to_disk(file);
+	for (quint64 offset : stale_offsets)
+		written = written && write_at(file, offset + 4, QByteArray("free"));
+	written = written && (!has_udta || write_atom_size(file, udta, udta.size + grown)) &&
+		  write_atom_size(file, moov, moov.size + grown) && sync_file_to_disk(file);
+	if (!written) {
+		const bool restored = restore_ranges(file, saved, file_size);
+		if (error) {
+			*error = "Failed to write moov/udta/XMP_ atom";
+			if (!restored)
+				*error += ", and the previous atoms could not be restored";
+		}
 		return false;
 	}
 
 	return true;
 }
 
-bool parse_top_level_atoms(QFile &file, QVector<Atom> &atoms, QString *error)
+// Faststart relocation holds only moov in memory; everything else is still copied as file ranges.
+constexpr quint64 kMaxFaststartMoovBytes = 256ULL << 20;
+
+struct FaststartPlan {
+	// moov with every stco/co64 entry already pointing at the relocated media data.
+	QByteArray moov;
+	// Top-level atoms written before and after moov + XMP, in file order.
+	QVector<Atom> prefix;
+	QVector<Atom> body;
+	// Top-level layout of the output, for verification and the layout cache.
+	QVector<Atom> written;
+	bool udta_mirror_written = false;
+};
+
+// Where a kept top-level atom lands in the relocated output.
+struct AtomMove {
+	quint64 old_offset = 0;
+	quint64 old_end = 0;
+	quint64 new_offset = 0;
+};
+
+bool read_buffer_atom(const QByteArray &buffer, quint64 offset, quint64 end, Atom *atom)
 {
-	atoms.clear();
-	const quint64 file_size = static_cast<quint64>(file.size());
-	quint64 offset = 0;
+	if (end > static_cast<quint64>(buffer.size()) || offset + 8 > end)
+		return false;
+
+	const char *data = buffer.constData() + offset;
+	const quint32 size32 = read_be32(data);
+	quint64 size = size32;
+	quint64 header_size = 8;
+	if (size32 == 1) {
+		if (offset + 16 > end)
+			return false;
+		size = read_be64(data + 8);
+		header_size = 16;
+	} else if (size32 == 0) {
+		size = end - offset;
+	}
+	if (size < header_size || size > end - offset)
+		return false;
+
+	*atom = Atom{offset, size, header_size, QByteArray(data + 4, 4), size32 == 0};
+	return true;
+}
+
+bool read_buffer_children(const QByteArray &buffer, const Atom &parent, QVector<Atom> *children)
+{
+	children->clear();
+	quint64 offset = parent.offset + parent.header_size;
+	const quint64 end = parent.offset + parent.size;
+	while (offset + 8 <= end) {
+		Atom child;
+		if (!read_buffer_atom(buffer, offset, end, &child))
+			return false;
+		children->push_back(child);
+		offset += child.size;
+	}
+	return offset == end;
+}
+
+bool set_buffer_atom_size(QByteArray &buffer, const Atom &atom, quint64 new_size)
+{
+	char *data = buffer.data() + atom.offset;
+	if (atom.header_size == 16) {
+		write_be32(data + 8, static_cast<quint32>(new_size >> 32));
+		write_be32(data + 12, static_cast<quint32>(new_size & 0xFFFFFFFFULL));
+		return true;
+	}
+	if (new_size > 0xFFFFFFFFULL)
+		return false;
+	write_be32(data, static_cast<quint32>(new_size));
+	return true;
+}
+
+// Same layout as write_udta_xmp_in_place, but on a moov that is being rewritten anyway, so udta may sit anywhere.
+bool mirror_udta_xmp_in_buffer(QByteArray &moov, const QByteArray &xmp_payload)
+{
+	Atom moov_atom;
+	QVector<Atom> children;
+	if (!read_buffer_atom(moov, 0, static_cast<quint64>(moov.size()), &moov_atom) ||
+	    !read_buffer_children(moov, moov_atom, &children))
+		return false;
+
+	bool ok = true;
+	QByteArray mirror = make_atom("XMP_", xmp_payload, &ok);
+	if (!ok)
+		return false;
+
+	int udta_index = -1;
+	for (int i = 0; i < children.size(); ++i) {
+		if (children.at(i).type == "udta")
+			udta_index = i;
+	}
+
+	QByteArray updated;
+	if (udta_index >= 0) {
+		const Atom udta = children.at(udta_index);
+		QVector<Atom> udta_children;
+		if (!read_buffer_children(moov, udta, &udta_children))
+			return false;
+		for (const Atom &child : udta_children) {
+			if (child.type == "XMP_")
+				memcpy(moov.data() + child.offset + 4, "free", 4);
+		}
+		const quint64 insert_at = udta.offset + udta.size;
+		updated = moov.left(static_cast<qsizetype>(insert_at)) + mirror +
+			  moov.mid(static_cast<qsizetype>(insert_at));
+		if (!set_buffer_atom_size(updated, udta, udta.size + static_cast<quint64>(mirror.size())))
+			return false;
+	} else {
+		mirror = make_atom("udta", mirror, &ok);
+		if (!ok)
+			return false;
+		updated = moov + mirror;
+	}
+
+	if (!set_buffer_atom_size(updated, moov_atom, moov_atom.size + static_cast<quint64>(mirror.size())))
+		return false;
+	moov = updated;
+	return true;
+}
+
+bool is_sample_table_path_atom(const QByteArray &type)
+{
+	return type == "moov" || type == "trak" || type == "mdia" || type == "minf" || type == "stbl";
+}
+
+// Rewrites every stco/co64 entry under parent through translate. Fails (leaving the buffer partially patched) when a
+// table is malformed, an offset cannot be mapped, or a 32-bit stco entry would overflow.
+template<typename Translate>
+bool patch_chunk_offsets(QByteArray &moov, const Atom &parent, const Translate &translate)
+{
+	QVector<Atom> children;
+	if (!read_buffer_children(moov, parent, &children))
+		return false;
+
+	for (const Atom &child : children) {
+		if (is_sample_table_path_atom(child.type)) {
+			if (!patch_chunk_offsets(moov, child, translate))
+				return false;
+			continue;
+		}
+
+		const bool wide = child.type == "co64";
+		if (!wide && child.type != "stco")
+			continue;
+		const quint64 entry_size = wide ? 8 : 4;
+		const quint64 payload = child.offset + child.header_size;
+		if (child.size < child.header_size + 8)
+			return false;
+		const quint64 count = read_be32(moov.constData() + payload + 4);
+		if (count > (child.size - child.header_size - 8) / entry_size)
+			return false;
+
+		char *entries = moov.data() + payload + 8;
+		for (quint64 i = 0; i < count; ++i) {
+			char *entry = entries + i * entry_size;
+			quint64 value = wide ? read_be64(entry) : read_be32(entry);
+			if (!translate(&value))
+				return false;
+			if (wide) {
+				write_be32(entry, static_cast<quint32>(value >> 32));
+				write_be32(entry + 4, static_cast<quint32>(value & 0xFFFFFFFFULL));
+			} else {
+				if (value > 0xFFFFFFFFULL)
+					return false;
+				write_be32(entry, static_cast<quint32>(value));
+			}
+		}
+	}
+	return true;
+}
+
+// Returns false when relocation does not apply: moov already precedes the media data, the file is fragmented, or
+// moov cannot be rewritten safely. The regular embed path takes over in that case.
+bool plan_faststart(QFile &input, const QVector<Atom> &top_level, int existing_xmp_index, quint64 xmp_atom_size,
+		    const QByteArray &xmp_payload, bool mirror_udta, FaststartPlan *plan)
+{
+	int moov_index = -1;
+	int first_mdat_index = -1;
+	for (int i = 0; i < top_level.size(); ++i) {
+		const QByteArray &type = top_level.at(i).type;
+		if (type == "moof")
+			return false;
+		if (type == "moov") {
+			if (moov_index >= 0)
+				return false;
+			moov_index = i;
+		} else if (type == "mdat" && first_mdat_index < 0) {
+			first_mdat_index = i;
+		}
+	}
+	if (moov_index < 0 || first_mdat_index < 0 || moov_index < first_mdat_index)
+		return false;
+
+	const Atom &moov_atom = top_level.at(moov_index);
+	if (moov_atom.size > kMaxFaststartMoovBytes || !input.seek(static_cast<qint64>(moov_atom.offset)))
+		return false;
+	plan->moov = input.read(static_cast<qint64>(moov_atom.size));
+	if (plan->moov.size() != static_cast<qint64>(moov_atom.size))
+		return false;
+	plan->udta_mirror_written = mirror_udta && mirror_udta_xmp_in_buffer(plan->moov, xmp_payload);
+	Atom relocated;
+	if (!read_buffer_atom(plan->moov, 0, static_cast<quint64>(plan->moov.size()), &relocated))
+		return false;
+
+	QVector<AtomMove> moves;
+	quint64 position = 0;
+	for (int i = 0; i < top_level.size(); ++i) {
+		if (i == moov_index || i == existing_xmp_index)
+			continue;
+		Atom atom = top_level.at(i);
+		if (i < first_mdat_index) {
+			plan->prefix.push_back(atom);
+		} else {
+			if (plan->body.isEmpty()) {
+				plan->written.push_back(Atom{position, relocated.size, relocated.header_size, "moov"});
+				position += relocated.size;
+				plan->written.push_back(written_xmp_atom(position, xmp_atom_size));
+				position += xmp_atom_size;
+			}
+			plan->body.push_back(atom);
+		}
+		moves.push_back(AtomMove{atom.offset, atom.offset + atom.size, position});
+		atom.offset = position;
+		plan->written.push_back(atom);
+		position += atom.size;
+	}
+
+	const auto translate = [&moves](quint64 *offset) {
+		auto it = std::upper_bound(moves.begin(), moves.end(), *offset,
+					   [](quint64 value, const AtomMove &move) { return value < move.old_offset; });
+		if (it == moves.begin())
+			return false;
+		--it;
+		if (*offset >= it->old_end)
+			return false;
+		*offset = *offset - it->old_offset + it->new_offset;
+		return true;
+	};
+
+	return patch_chunk_offsets(plan->moov, relocated, translate);
+}
+
+struct CopyContext {
+	bool allow_kernel_copy = true;
+	EmbedIoMode io_mode = EmbedIoMode::PageCache;
+	quint64 max_bytes_per_sec = 0;
+	CopyStrategy strategy = CopyStrategy::None;
+	embed_engine_detail::CopyVolume copied;
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	// Streaming: the output window whose write-back was started last and still has to be dropped.
+	int pending_out_fd = -1;
+	quint64 pending_out_offset = 0;
+	quint64 pending_out_length = 0;
+	// Cancellation and progress hooks of the embed; the flag is polled before every chunk.
+	const EmbedControl *control = nullptr;
+	bool cancelled = false;
+	// Output bytes kept from a checkpoint and written from memory (XMP atom, relocated moov).
+	quint64 resumed_bytes = 0;
+	quint64 literal_bytes = 0;
+	quint64 total_bytes = 0;
+	// Syncs the output and records how much of it is complete; called once per interval.
+	std::function<void(int out_fd, quint64 verified_bytes)> checkpoint;
+	quint64 checkpoint_interval = 0;
+	quint64 next_checkpoint = 0;
+};
+
+constexpr quint64 kBufferedCopyChunk = 1ULL << 20;
+constexpr quint64 kStreamWindow = 8ULL << 20;
+
+void note_copy_strategy(CopyContext *ctx, CopyStrategy strategy)
+{
+	if (ctx && static_cast<int>(strategy) > static_cast<int>(ctx->strategy))
+		ctx->strategy = strategy;
+}
+
+bool is_paced(const CopyContext *ctx)
+{
+	return ctx && (ctx->io_mode != EmbedIoMode::PageCache || ctx->max_bytes_per_sec > 0);
+}
+
+// Copies that have to act between chunks (pacing, cancellation, progress, checkpoints) go in bounded windows.
+bool is_windowed(const CopyContext *ctx)
+{
+	return is_paced(ctx) ||
+	       (ctx && (ctx->checkpoint_interval > 0 ||
+			(ctx->control && (ctx->control->cancelled || ctx->control->on_progress))));
+}
+
+quint64 output_done(const CopyContext *ctx)
+{
+	return ctx->resumed_bytes + ctx->literal_bytes + ctx->copied.written_bytes();
+}
+
+// Latches the cancellation flag so callers can tell a cancelled copy from an I/O error.
+bool copy_cancelled(CopyContext *ctx)
+{
+	if (ctx && !ctx->cancelled && ctx->control && ctx->control->cancelled && ctx->control->cancelled->load())
+		ctx->cancelled = true;
+	return ctx && ctx->cancelled;
+}
+
+bool fail_cancelled(QString *error)
+{
+	if (error)
+		*error = "Embed cancelled";
+	return false;
+}
+
+void report_progress(const CopyContext *ctx)
+{
+	if (ctx && ctx->control && ctx->control->on_progress)
+		ctx->control->on_progress(output_done(ctx), ctx->total_bytes);
+}
+
+// Sleeps until the bytes moved so far fit the throughput cap.
+void pace_copy(const CopyContext *ctx)
+{
+	if (!ctx || ctx->max_bytes_per_sec == 0)
+		return;
+	const auto delay = embed_engine_detail::copy_pacing_delay(ctx->copied, ctx->max_bytes_per_sec,
+								 std::chrono::steady_clock::now() - ctx->started);
+	if (delay.count() > 0)
+		std::this_thread::sleep_for(delay);
+}
+
+// Runs once a chunk is in the output: reports progress, records a checkpoint when one is due and applies the
+// throughput cap.
+void after_copied_chunk(CopyContext *ctx, int out_fd)
+{
+	report_progress(ctx);
+	if (ctx->checkpoint && output_done(ctx) >= ctx->next_checkpoint) {
+		ctx->checkpoint(out_fd, output_done(ctx));
+		ctx->next_checkpoint = output_done(ctx) + ctx->checkpoint_interval;
+	}
+	pace_copy(ctx);
+}
+
+// Drops the previous output window once its write-back finished, starts write-back of this one and drops the
+// source pages just read. Then runs the per-chunk hooks.
+void account_copied_chunk(CopyContext *ctx, int in_fd, quint64 in_offset, int out_fd, quint64 out_offset,
+			  quint64 length)
+{
+	if (!ctx)
+		return;
+	ctx->copied.moved_bytes += length;
+
+#if defined(__linux__)
+	if (ctx->io_mode != EmbedIoMode::PageCache && length > 0) {
+		posix_fadvise(in_fd, static_cast<off_t>(in_offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+		sync_file_range(out_fd, static_cast<off64_t>(out_offset), static_cast<off64_t>(length),
+				SYNC_FILE_RANGE_WRITE);
+		if (ctx->pending_out_fd >= 0) {
+			constexpr unsigned int kWaitAndWrite =
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER;
+			sync_file_range(ctx->pending_out_fd, static_cast<off64_t>(ctx->pending_out_offset),
+					static_cast<off64_t>(ctx->pending_out_length), kWaitAndWrite);
+			posix_fadvise(ctx->pending_out_fd, static_cast<off_t>(ctx->pending_out_offset),
+				      static_cast<off_t>(ctx->pending_out_length), POSIX_FADV_DONTNEED);
+		}
+		ctx->pending_out_fd = out_fd;
+		ctx->pending_out_offset = out_offset;
+		ctx->pending_out_length = length;
+	}
+#else
+	Q_UNUSED(in_fd);
+	Q_UNUSED(in_offset);
+	Q_UNUSED(out_offset);
+#endif
+
+	after_copied_chunk(ctx, out_fd);
+}
+
+// Called before the output fd is closed so the last window does not linger in the page cache.
+void finish_copy(CopyContext *ctx)
+{
+#if defined(__linux__)
+	if (ctx && ctx->pending_out_fd >= 0) {
+		sync_file_range(ctx->pending_out_fd, static_cast<off64_t>(ctx->pending_out_offset),
+				static_cast<off64_t>(ctx->pending_out_length),
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+		posix_fadvise(ctx->pending_out_fd, static_cast<off_t>(ctx->pending_out_offset),
+			      static_cast<off_t>(ctx->pending_out_length), POSIX_FADV_DONTNEED);
+		ctx->pending_out_fd = -1;
+	}
+#else
+	Q_UNUSED(ctx);
+#endif
+}
+
+#if defined(__linux__)
+constexpr quint64 kKernelCopyChunk = 1ULL << 30;
+constexpr quint64 kDirectIoAlignment = 4096;
+constexpr size_t kDirectIoBuffer = 4U << 20;
+
+// Copies as much of the range as the kernel will take without going through user space. Returns the number of bytes
+// copied; the caller finishes whatever is left with the buffered loop.
+quint64 kernel_copy_range(int in_fd, int out_fd, quint64 offset, quint64 out_offset, quint64 length,
+			  CopyContext *ctx)
+{
+	quint64 done = 0;
+	// Windowed copies give cache dropping, the rate cap and the cancellation check a chance between chunks.
+	const quint64 max_chunk = is_windowed(ctx) ? kStreamWindow : kKernelCopyChunk;
+
+#if defined(FICLONE) && defined(FICLONERANGE)
+	struct stat in_stat {};
+	if (fstat(in_fd, &in_stat) == 0 && in_stat.st_blksize > 0) {
+		const quint64 in_size = static_cast<quint64>(in_stat.st_size);
+		const quint64 block = static_cast<quint64>(in_stat.st_blksize);
+		if (offset == 0 && out_offset == 0 && length == in_size) {
+			if (ioctl(out_fd, FICLONE, in_fd) == 0)
+				done = length;
+		} else if (offset % block == 0 && out_offset % block == 0) {
+			// Clone ranges must be block aligned, except for a tail that ends at the source EOF.
+			const quint64 clone_length = offset + length == in_size ? length : length - (length % block);
+			if (clone_length > 0) {
+				struct file_clone_range range {};
+				range.src_fd = in_fd;
+				range.src_offset = offset;
+				range.src_length = clone_length;
+				range.dest_offset = out_offset;
+				if (ioctl(out_fd, FICLONERANGE, &range) == 0)
+					done = clone_length;
+			}
+		}
+		if (done > 0) {
+			// Shared extents move no data, so they are neither cached nor rate limited.
+			note_copy_strategy(ctx, CopyStrategy::Reflink);
+			if (ctx)
+				ctx->copied.reflinked_bytes += done;
+			report_progress(ctx);
+		}
+	}
+#endif
+
+	while (done < length && !copy_cancelled(ctx)) {
+		loff_t in_off = static_cast<loff_t>(offset + done);
+		loff_t out_off = static_cast<loff_t>(out_offset + done);
+		const size_t chunk = static_cast<size_t>(std::min(length - done, max_chunk));
+		const ssize_t copied = copy_file_range(in_fd, &in_off, out_fd, &out_off, chunk, 0);
+		if (copied <= 0)
+			break;
+		account_copied_chunk(ctx, in_fd, offset + done, out_fd, out_offset + done,
+				     static_cast<quint64>(copied));
+		done += static_cast<quint64>(copied);
+		note_copy_strategy(ctx, CopyStrategy::CopyFileRange);
+	}
+
+	if (done < length && !copy_cancelled(ctx) &&
+	    lseek(out_fd, static_cast<off_t>(out_offset + done), SEEK_SET) >= 0) {
+		off_t in_off = static_cast<off_t>(offset + done);
+		while (done < length && !copy_cancelled(ctx)) {
+			const size_t chunk = static_cast<size_t>(std::min(length - done, max_chunk));
+			const ssize_t copied = sendfile(out_fd, in_fd, &in_off, chunk);
+			if (copied <= 0)
+				break;
+			account_copied_chunk(ctx, in_fd, offset + done, out_fd, out_offset + done,
+					     static_cast<quint64>(copied));
+			done += static_cast<quint64>(copied);
+			note_copy_strategy(ctx, CopyStrategy::Sendfile);
+		}
+	}
+
+	return done;
+}
+
+// Copies whole aligned blocks through O_DIRECT descriptors of the same files, bypassing the page cache entirely.
+// Returns the number of bytes copied (a multiple of the alignment); the caller copies the rest normally.
+quint64 direct_copy_range(const QString &in_path, const QString &out_path, quint64 offset, quint64 out_offset,
+			  quint64 length, CopyContext *ctx)
+{
+	const quint64 aligned_length = length - (length % kDirectIoAlignment);
+	if (aligned_length == 0 || offset % kDirectIoAlignment != 0 || out_offset % kDirectIoAlignment != 0)
+		return 0;
+
+	const int in_fd = ::open(QFile::encodeName(in_path).constData(), O_RDONLY | O_DIRECT);
+	const int out_fd = in_fd >= 0 ? ::open(QFile::encodeName(out_path).constData(), O_WRONLY | O_DIRECT) : -1;
+	void *buffer = nullptr;
+	quint64 done = 0;
+	if (out_fd >= 0 && posix_memalign(&buffer, kDirectIoAlignment, kDirectIoBuffer) == 0) {
+		while (done < aligned_length && !copy_cancelled(ctx)) {
+			const size_t chunk =
+				static_cast<size_t>(std::min<quint64>(aligned_length - done, kDirectIoBuffer));
+			const ssize_t got = pread(in_fd, buffer, chunk, static_cast<off_t>(offset + done));
+			if (got != static_cast<ssize_t>(chunk))
+				break;
+			if (pwrite(out_fd, buffer, chunk, static_cast<off_t>(out_offset + done)) != got)
+				break;
+			done += chunk;
+			if (ctx) {
+				ctx->copied.moved_bytes += chunk;
+				after_copied_chunk(ctx, out_fd);
+			}
+		}
+		if (done > 0)
+			note_copy_strategy(ctx, CopyStrategy::DirectIo);
+	}
+
+	free(buffer);
+	if (out_fd >= 0)
+		::close(out_fd);
+	if (in_fd >= 0)
+		::close(in_fd);
+	return done;
+}
+#endif
+
+bool buffered_copy_range(QFile &input, QFile &output, quint64 offset, quint64 length, CopyContext *ctx,
+			 QString *error)
+{
+	if (length == 0)
+		return true;
+
+	if (!input.seek(static_cast<qint64>(offset))) {
+		if (error)
+			*error = "Failed to seek input for copy";
+		return false;
+	}
 
-	while (offset + 8 <= file_size) {
-		if (!file.seek(static_cast<qint64>(offset))) {
+	note_copy_strategy(ctx, CopyStrategy::Buffered);
+	const bool windowed = is_windowed(ctx);
+	quint64 remaining = length;
+	while (remaining > 0) {
+		if (copy_cancelled(ctx))
+			return fail_cancelled(error);
+		const qint64 chunk = static_cast<qint64>(std::min(remaining, kBufferedCopyChunk));
+		const quint64 out_offset = static_cast<quint64>(output.pos());
+		QByteArray data = input.read(chunk);
+		if (data.size() != chunk) {
 			if (error)
-				*error = "Failed to seek while parsing atoms";
+				*error = "Failed to read input while copying";
 			return false;
 		}
-
-		QByteArray header = file.read(16);
-		if (header.size() < 8) {
+		if (output.write(data) != data.size()) {
 			if (error)
-				*error = "Truncated atom header";
+				*error = "Failed to write output while copying";
+			return false;
+		}
+		if (windowed && !output.flush()) {
+			if (error)
+				*error = "Failed to flush output while copying";
 			return false;
 		}
+		account_copied_chunk(ctx, input.handle(), offset + (length - remaining), output.handle(), out_offset,
+				     static_cast<quint64>(chunk));
+		remaining -= static_cast<quint64>(chunk);
+	}
 
-		const quint32 size32 = read_be32(header.constData());
-		const QByteArray type = header.mid(4, 4);
+	return true;
+}
 
-		quint64 size = size32;
-		quint64 header_size = 8;
-		if (size32 == 1) {
-			if (header.size() < 16) {
+bool copy_range(QFile &input, QFile &output, quint64 offset, quint64 length, CopyContext *ctx, QString *error)
+{
+	if (length == 0)
+		return true;
+
+#if defined(__linux__)
+	if (ctx && ctx->io_mode == EmbedIoMode::Direct && output.flush()) {
+		// O_DIRECT needs both sides aligned; copy the unaligned head through the cache first when that lines
+		// them up, otherwise the whole range takes the streaming path.
+		const quint64 out_offset = static_cast<quint64>(output.pos());
+		if (offset % kDirectIoAlignment == out_offset % kDirectIoAlignment) {
+			const quint64 head = std::min(length, (kDirectIoAlignment - offset % kDirectIoAlignment) %
+								      kDirectIoAlignment);
+			if (!buffered_copy_range(input, output, offset, head, ctx, error) || !output.flush())
+				return false;
+			offset += head;
+			length -= head;
+			const quint64 copied = direct_copy_range(input.fileName(), output.fileName(), offset,
+								 out_offset + head, length, ctx);
+			if (!output.seek(static_cast<qint64>(out_offset + head + copied))) {
 				if (error)
-					*error = "Truncated extended atom header";
+					*error = "Failed to seek output after direct copy";
 				return false;
 			}
-			size = read_be64(header.constData() + 8);
-			header_size = 16;
-		} else if (size32 == 0) {
-			size = file_size - offset;
+			offset += copied;
+			length -= copied;
 		}
-
-		if (size < header_size || offset + size > file_size) {
+	} else if (ctx && ctx->allow_kernel_copy && output.flush()) {
+		const quint64 out_offset = static_cast<quint64>(output.pos());
+		const quint64 copied =
+			kernel_copy_range(input.handle(), output.handle(), offset, out_offset, length, ctx);
+		if (!output.seek(static_cast<qint64>(out_offset + copied))) {
 			if (error)
-				*error = "Invalid top-level atom size";
+				*error = "Failed to seek output after kernel copy";
 			return false;
 		}
-
-		atoms.push_back(Atom{offset, size, header_size, type});
-		offset += size;
+		offset += copied;
+		length -= copied;
 	}
+	if (length > 0 && copy_cancelled(ctx))
+		return fail_cancelled(error);
+#endif
 
-	if (offset != file_size) {
-		if (error)
-			*error = "Top-level atom parse did not end on file boundary";
-		return false;
+	return buffered_copy_range(input, output, offset, length, ctx, error);
+}
+
+// One piece of the temp-copy output: a range of the source file, or bytes built in memory (XMP atom, relocated moov).
+struct CopySegment {
+	quint64 source_offset = 0;
+	quint64 length = 0;
+	QByteArray literal;
+
+	bool is_literal() const { return !literal.isEmpty(); }
+};
+
+// Appends a source range, merging it into the previous segment when the two are adjacent in the source.
+void append_source_segment(QVector<CopySegment> *segments, quint64 offset, quint64 length)
+{
+	if (length == 0)
+		return;
+	if (!segments->isEmpty() && !segments->last().is_literal() &&
+	    segments->last().source_offset + segments->last().length == offset) {
+		segments->last().length += length;
+		return;
 	}
+	segments->push_back(CopySegment{offset, length, QByteArray()});
+}
 
-	return true;
+void append_atom_segments(QVector<CopySegment> *segments, const QVector<Atom> &atoms)
+{
+	for (const Atom &atom : atoms)
+		append_source_segment(segments, atom.offset, atom.size);
 }
 
-QByteArray make_atom(const QByteArray &type, const QByteArray &payload, bool *ok)
+void append_literal_segment(QVector<CopySegment> *segments, const QByteArray &bytes)
 {
-	if (type.size() != 4) {
-		if (ok)
-			*ok = false;
-		return {};
-	}
+	segments->push_back(CopySegment{0, static_cast<quint64>(bytes.size()), bytes});
+}
 
-	const quint64 total_size = 8 + static_cast<quint64>(payload.size());
-	if (total_size > 0xFFFFFFFFULL) {
-		if (ok)
-			*ok = false;
-		return {};
+// Writes the output from offset resume_from onwards; everything before it is already in place.
+bool write_segments(QFile &input, QFile &output, const QVector<CopySegment> &segments, quint64 resume_from,
+		    CopyContext *ctx, QString *error)
+{
+	quint64 position = 0;
+	for (const CopySegment &segment : segments) {
+		const quint64 end = position + segment.length;
+		if (end > resume_from) {
+			const quint64 skip = resume_from > position ? resume_from - position : 0;
+			if (!segment.is_literal()) {
+				if (!copy_range(input, output, segment.source_offset + skip, segment.length - skip, ctx,
+						error))
+					return false;
+			} else {
+				if (copy_cancelled(ctx))
+					return fail_cancelled(error);
+				const QByteArray bytes = segment.literal.mid(static_cast<int>(skip));
+				if (output.write(bytes) != bytes.size()) {
+					if (error)
+						*error = "Failed to write XMP uuid atom to temp file";
+					return false;
+				}
+				ctx->literal_bytes += static_cast<quint64>(bytes.size());
+				report_progress(ctx);
+			}
+		}
+		position = end;
 	}
+	return true;
+}
 
-	QByteArray atom;
-	atom.resize(static_cast<int>(total_size));
-	write_be32(atom.data(), static_cast<quint32>(total_size));
-	memcpy(atom.data() + 4, type.constData(), 4);
-	if (!payload.isEmpty())
-		memcpy(atom.data() + 8, payload.constData(), payload.size());
+// Temp-copy checkpoints. The checkpoint names the source (identity), the planned output (one key per segment) and how
+// many leading output bytes were synced, plus a hash of the synced tail so a temp file that was touched afterwards is
+// not trusted.
+constexpr int kCheckpointVersion = 1;
+constexpr quint64 kCheckpointTailBytes = 4096;
 
-	if (ok)
-		*ok = true;
-	return atom;
+QString segment_key(const CopySegment &segment)
+{
+	if (segment.is_literal()) {
+		const quint64 hash = fnv1a64(segment.literal.constData(), segment.literal.size());
+		return QString("literal:%1:%2").arg(QString::number(hash, 16)).arg(segment.length);
+	}
+	return QString("source:%1:%2").arg(segment.source_offset).arg(segment.length);
 }
 
-QByteArray make_uuid_atom(const QByteArray &payload, bool *ok)
+QString checkpoint_hash(const QString &temp_path, quint64 verified_bytes)
 {
-	const quint64 total_size = 8 + 16 + static_cast<quint64>(payload.size());
-	if (total_size > 0xFFFFFFFFULL) {
-		if (ok)
-			*ok = false;
-		return {};
-	}
+	QFile file(temp_path);
+	const quint64 begin = verified_bytes > kCheckpointTailBytes ? verified_bytes - kCheckpointTailBytes : 0;
+	if (!file.open(QIODevice::ReadOnly) || !file.seek(static_cast<qint64>(begin)))
+		return QString();
+	const QByteArray tail = file.read(static_cast<qint64>(verified_bytes - begin));
+	if (static_cast<quint64>(tail.size()) != verified_bytes - begin)
+		return QString();
+	return QString::number(fnv1a64(tail.constData(), tail.size()), 16);
+}
 
-	QByteArray atom;
-	atom.resize(static_cast<int>(total_size));
-	write_be32(atom.data(), static_cast<quint32>(total_size));
-	memcpy(atom.data() + 4, "uuid", 4);
-	memcpy(atom.data() + 8, ADOBE_XMP_UUID.constData(), 16);
-	if (!payload.isEmpty())
-		memcpy(atom.data() + 24, payload.constData(), payload.size());
+QJsonObject media_identity_to_json(const MediaFileIdentity &identity)
+{
+	// 64-bit values as strings; JSON numbers lose precision past 2^53.
+	QJsonObject json_obj;
+	json_obj.insert("size", QString::number(identity.size));
+	json_obj.insert("mtimeNs", QString::number(identity.mtime_ns));
+	json_obj.insert("inode", QString::number(identity.inode));
+	json_obj.insert("device", QString::number(identity.device));
+	return json_obj;
+}
 
-	if (ok)
-		*ok = true;
-	return atom;
+void save_copy_checkpoint(const QString &checkpoint_path, const QString &temp_path, const MediaFileIdentity &source,
+			  const QStringList &segment_keys, quint64 verified_bytes)
+{
+	const QString tail_hash = checkpoint_hash(temp_path, verified_bytes);
+	if (tail_hash.isEmpty())
+		return;
+
+	QJsonObject root;
+	root.insert("version", kCheckpointVersion);
+	root.insert("source", media_identity_to_json(source));
+	root.insert("segments", QJsonArray::fromStringList(segment_keys));
+	root.insert("verifiedBytes", QString::number(verified_bytes));
+	root.insert("tailHash", tail_hash);
+
+	QSaveFile file(checkpoint_path);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+	file.commit();
 }
 
-bool copy_range(QFile &input, QFile &output, quint64 offset, quint64 length, QString *error)
+// How many leading bytes of the temp file an interrupted embed left reusable: the source must be unchanged, the planned
+// output has to match up to there and the synced tail must hash the same. 0 means start over.
+quint64 load_copy_checkpoint(const QString &checkpoint_path, const QString &temp_path, const MediaFileIdentity &source,
+			     const QVector<CopySegment> &segments, const QStringList &segment_keys)
 {
-	if (!input.seek(static_cast<qint64>(offset))) {
-		if (error)
-			*error = "Failed to seek input for copy";
-		return false;
+	QFile file(checkpoint_path);
+	if (!file.open(QIODevice::ReadOnly))
+		return 0;
+
+	QJsonParseError parse_error;
+	const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parse_error);
+	if (parse_error.error != QJsonParseError::NoError || !doc.isObject())
+		return 0;
+
+	const QJsonObject root = doc.object();
+	if (root.value("version").toInt() != kCheckpointVersion ||
+	    root.value("source").toObject() != media_identity_to_json(source))
+		return 0;
+
+	bool ok = false;
+	const quint64 verified_bytes = root.value("verifiedBytes").toString().toULongLong(&ok);
+	if (!ok || verified_bytes == 0 || static_cast<quint64>(QFileInfo(temp_path).size()) < verified_bytes)
+		return 0;
+
+	const QJsonArray saved_keys = root.value("segments").toArray();
+	quint64 matched = 0;
+	for (int i = 0; i < segments.size() && i < saved_keys.size(); ++i) {
+		if (saved_keys.at(i).toString() != segment_keys.at(i))
+			break;
+		matched += segments.at(i).length;
 	}
 
-	quint64 remaining = length;
-	while (remaining > 0) {
-		const qint64 chunk = static_cast<qint64>(remaining > (1ULL << 20) ? (1ULL << 20) : remaining);
-		QByteArray data = input.read(chunk);
-		if (data.size() != chunk) {
-			if (error)
-				*error = "Failed to read input while copying";
-			return false;
-		}
-		if (output.write(data) != data.size()) {
-			if (error)
-				*error = "Failed to write output while copying";
+	const quint64 resumable = std::min(verified_bytes, matched);
+	if (resumable == 0 || checkpoint_hash(temp_path, verified_bytes) != root.value("tailHash").toString())
+		return 0;
+	return resumable;
+}
+
+void discard_temp_copy(const QString &temp_path, const QString &checkpoint_path)
+{
+	QFile::remove(temp_path);
+	QFile::remove(checkpoint_path);
+}
+
+// Sleeps in short slices so a raised cancellation flag ends the wait early. Returns false when cancelled.
+bool sleep_unless_cancelled(const std::atomic_bool *cancelled, int delay_ms)
+{
+	constexpr int kSliceMs = 50;
+	for (int slept = 0; slept < delay_ms; slept += kSliceMs) {
+		if (cancelled && cancelled->load())
 			return false;
-		}
-		remaining -= static_cast<quint64>(chunk);
+		QThread::msleep(static_cast<unsigned long>(std::min(kSliceMs, delay_ms - slept)));
 	}
-
-	return true;
+	return !(cancelled && cancelled->load());
 }
 
 bool has_xmp_atom(const QString &path)
@@ -243,15 +1397,7 @@ bool has_xmp_atom(const QString &path)
 	for (const Atom &atom : top) {
 		if (atom.type == "XMP_")
 			return true;
-		if (atom.type != "uuid")
-			continue;
-
-		if (!file.seek(static_cast<qint64>(atom.offset)))
-			return false;
-		const QByteArray uuid_atom = file.read(static_cast<qint64>(atom.size));
-		if (uuid_atom.size() != static_cast<qint64>(atom.size))
-			return false;
-		if (is_xmp_uuid_atom(uuid_atom))
+		if (is_xmp_uuid_atom(file, atom))
 			return true;
 	}
 
@@ -260,40 +1406,25 @@ bool has_xmp_atom(const QString &path)
 		if (atom.type != "moov")
 			continue;
 
-		if (!file.seek(static_cast<qint64>(atom.offset)))
-			return false;
-		const QByteArray moov = file.read(static_cast<qint64>(atom.size));
-		if (moov.size() != static_cast<qint64>(atom.size))
-			return false;
-		if (moov.size() > std::numeric_limits<int>::max())
-			return false;
-		const int moov_size = static_cast<int>(moov.size());
-
-		QVector<Atom> moov_children;
-		if (!parse_atoms_from_buffer(moov, 8, moov_size, moov_children, &error))
-			return false;
-		for (const Atom &child : moov_children) {
+		AtomIterator moov_it(file, atom);
+		Atom child;
+		while (moov_it.next(&child)) {
 			if (child.type != "udta")
 				continue;
 
-			const QByteArray udta = moov.mid(static_cast<int>(child.offset), static_cast<int>(child.size));
-			if (udta.size() > std::numeric_limits<int>::max())
-				return false;
-			const int udta_size = static_cast<int>(udta.size());
-			QVector<Atom> udta_children;
-			if (!parse_atoms_from_buffer(udta, 8, udta_size, udta_children, &error))
-				return false;
-			for (const Atom &udta_child : udta_children) {
+			AtomIterator udta_it(file, child);
+			Atom udta_child;
+			while (udta_it.next(&udta_child)) {
 				if (udta_child.type == "XMP_")
 					return true;
-				if (udta_child.type == "uuid") {
-					const QByteArray uuid_atom = udta.mid(static_cast<int>(udta_child.offset),
-									      static_cast<int>(udta_child.size));
-					if (is_xmp_uuid_atom(uuid_atom))
-						return true;
-				}
+				if (is_xmp_uuid_atom(file, udta_child))
+					return true;
 			}
+			if (!udta_it.finished(&error))
+				return false;
 		}
+		if (!moov_it.finished(&error))
+			return false;
 	}
 
 	return false;
@@ -304,7 +1435,25 @@ EmbedResult embed_failure(const QString &error, bool retryable)
 	return {false, error, retryable};
 }
 
-EmbedResult try_embed_with_exiftool(const QString &media_path, const QString &sidecar_path)
+EmbedResult embed_success(EmbedWriteMode mode)
+{
+	EmbedResult result;
+	result.ok = true;
+	result.write_mode = mode;
+	return result;
+}
+
+EmbedResult embed_cancelled()
+{
+	EmbedResult result;
+	result.error = "Embed cancelled";
+	result.retryable = true;
+	result.cancelled = true;
+	return result;
+}
+
+EmbedResult try_embed_with_exiftool(const QString &media_path, const QString &sidecar_path,
+				    const std::atomic_bool *cancelled)
 {
 	const QString exiftool = QStandardPaths::findExecutable("exiftool");
 	if (exiftool.isEmpty())
@@ -314,10 +1463,17 @@ EmbedResult try_embed_with_exiftool(const QString &media_path, const QString &si
 	process.start(exiftool, {"-overwrite_original", QString("-XMP<=%1").arg(sidecar_path), media_path});
 	if (!process.waitForStarted(1000))
 		return embed_failure("Failed to start ExifTool process", true);
-	if (!process.waitForFinished(20000)) {
-		process.kill();
-		process.waitForFinished(1000);
-		return embed_failure("ExifTool process timed out", true);
+	// Wait in slices so a cancelled embed does not sit out the whole timeout.
+	constexpr int kTimeoutMs = 20000;
+	constexpr int kPollMs = 100;
+	for (int waited_ms = 0; !process.waitForFinished(kPollMs) && process.state() != QProcess::NotRunning;
+	     waited_ms += kPollMs) {
+		const bool stop = cancelled && cancelled->load();
+		if (stop || waited_ms + kPollMs >= kTimeoutMs) {
+			process.kill();
+			process.waitForFinished(1000);
+			return stop ? embed_cancelled() : embed_failure("ExifTool process timed out", true);
+		}
 	}
 
 	if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
@@ -332,13 +1488,258 @@ EmbedResult try_embed_with_exiftool(const QString &media_path, const QString &si
 	if (!has_xmp_atom(media_path))
 		return embed_failure("ExifTool reported success but XMP metadata was not found", false);
 
-	return {true, {}};
+	return embed_success(EmbedWriteMode::ExifTool);
+}
+
+void note_embed_io(EmbedResult *result, quint64 bytes_written, std::chrono::steady_clock::time_point started)
+{
+	result->bytes_written = bytes_written;
+	result->elapsed_ms = static_cast<quint64>(
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started)
+			.count());
+}
+
+void maybe_mirror_udta_xmp(const EmbedOptions &options, const QString &media_path, const QByteArray &xmp_payload,
+			   AtomLayoutCache *cache, EmbedResult *result)
+{
+	if (!options.mirror_udta_xmp || !result || !result->ok)
+		return;
+	QString error;
+	result->udta_mirror_written = write_udta_xmp_in_place(media_path, xmp_payload, &error);
+	// moov and the atoms after it may have moved, whether or not the mirror completed.
+	if (cache)
+		cache->invalidate(media_path);
 }
 
 } // namespace
 
+namespace embed_engine_detail {
+
+std::chrono::microseconds copy_pacing_delay(const CopyVolume &volume, quint64 max_bytes_per_sec,
+					    std::chrono::nanoseconds elapsed)
+{
+	if (max_bytes_per_sec == 0)
+		return std::chrono::microseconds(0);
+	const auto budget = std::chrono::microseconds(volume.moved_bytes * 1000000ULL / max_bytes_per_sec);
+	const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+	return budget > waited ? budget - waited : std::chrono::microseconds(0);
+}
+
+} // namespace embed_engine_detail
+
+const char *copy_strategy_name(CopyStrategy strategy)
+{
+	switch (strategy) {
+	case CopyStrategy::Reflink:
+		return "reflink";
+	case CopyStrategy::CopyFileRange:
+		return "copy_file_range";
+	case CopyStrategy::Sendfile:
+		return "sendfile";
+	case CopyStrategy::DirectIo:
+		return "direct_io";
+	case CopyStrategy::Buffered:
+		return "buffered";
+	case CopyStrategy::None:
+	default:
+		return "none";
+	}
+}
+
+const char *embed_io_mode_name(EmbedIoMode mode)
+{
+	switch (mode) {
+	case EmbedIoMode::Streaming:
+		return "streaming";
+	case EmbedIoMode::Direct:
+		return "direct";
+	case EmbedIoMode::PageCache:
+	default:
+		return "page_cache";
+	}
+}
+
+double embed_rate_mib_s(const EmbedResult &result)
+{
+	if (result.elapsed_ms == 0)
+		return 0.0;
+	return static_cast<double>(result.bytes_written) / (1024.0 * 1024.0) /
+	       (static_cast<double>(result.elapsed_ms) / 1000.0);
+}
+
+const char *embed_writer_name(EmbedWriter writer)
+{
+	switch (writer) {
+	case EmbedWriter::ExifTool:
+		return "exiftool";
+	case EmbedWriter::NativeWithExifToolFallback:
+		return "native_with_exiftool_fallback";
+	case EmbedWriter::Native:
+	default:
+		return "native";
+	}
+}
+
+const char *embed_write_mode_name(EmbedWriteMode mode)
+{
+	switch (mode) {
+	case EmbedWriteMode::TempCopy:
+		return "temp_copy";
+	case EmbedWriteMode::InPlaceReplace:
+		return "in_place_replace";
+	case EmbedWriteMode::InPlaceAppend:
+		return "in_place_append";
+	case EmbedWriteMode::ExifTool:
+		return "exiftool";
+	case EmbedWriteMode::Faststart:
+		return "faststart";
+	case EmbedWriteMode::None:
+	default:
+		return "none";
+	}
+}
+
+bool read_media_file_identity(const QString &path, MediaFileIdentity *identity)
+{
+#if defined(_WIN32)
+	const QFileInfo info(path);
+	if (!info.exists())
+		return false;
+	identity->size = info.size();
+	identity->mtime_ns = info.lastModified().toMSecsSinceEpoch() * 1000000LL;
+	identity->inode = 0;
+	identity->device = 0;
+#else
+	struct stat st {};
+	if (::stat(QFile::encodeName(path).constData(), &st) != 0)
+		return false;
+	identity->size = static_cast<qint64>(st.st_size);
+#if defined(__APPLE__)
+	identity->mtime_ns = static_cast<qint64>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+	identity->mtime_ns = static_cast<qint64>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+	identity->inode = static_cast<quint64>(st.st_ino);
+	identity->device = static_cast<quint64>(st.st_dev);
+#endif
+	return true;
+}
+
+AtomLayoutCache::AtomLayoutCache(int capacity) : m_capacity(std::max(1, capacity)) {}
+
+bool AtomLayoutCache::lookup(const QString &path, const MediaFileIdentity &identity, QVector<Mp4Atom> *top_level)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(path);
+	if (it == m_entries.end() || !(it->identity == identity)) {
+		if (it != m_entries.end())
+			m_entries.erase(it);
+		++m_misses;
+		return false;
+	}
+	it->last_used = ++m_use_clock;
+	*top_level = it->top_level;
+	++m_hits;
+	return true;
+}
+
+void AtomLayoutCache::store(const QString &path, const MediaFileIdentity &identity,
+			    const QVector<Mp4Atom> &top_level)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_entries.contains(path) && m_entries.size() >= m_capacity) {
+		auto oldest = m_entries.begin();
+		for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+			if (it->last_used < oldest->last_used)
+				oldest = it;
+		}
+		m_entries.erase(oldest);
+	}
+	m_entries.insert(path, Entry{identity, top_level, ++m_use_clock});
+}
+
+void AtomLayoutCache::invalidate(const QString &path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.remove(path);
+}
+
+quint64 AtomLayoutCache::hits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hits;
+}
+
+quint64 AtomLayoutCache::misses() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_misses;
+}
+
+void Mp4MovEmbedEngine::set_options(const EmbedOptions &options)
+{
+	m_options = options;
+}
+
+const EmbedOptions &Mp4MovEmbedEngine::options() const
+{
+	return m_options;
+}
+
+void Mp4MovEmbedEngine::set_layout_cache(std::shared_ptr<AtomLayoutCache> cache)
+{
+	m_layout_cache = std::move(cache);
+}
+
+const std::shared_ptr<AtomLayoutCache> &Mp4MovEmbedEngine::layout_cache() const
+{
+	return m_layout_cache;
+}
+
+void Mp4MovEmbedEngine::set_control(EmbedControl control)
+{
+	m_control = std::move(control);
+}
+
+bool Mp4MovEmbedEngine::is_cancelled() const
+{
+	return m_control.cancelled && m_control.cancelled->load();
+}
+
+bool Mp4MovEmbedEngine::has_xmp_metadata(const QString &media_path)
+{
+	return has_xmp_atom(media_path);
+}
+
+int Mp4MovEmbedEngine::remove_orphaned_temp_copies(const QString &directory, const QStringList &pending_media_paths)
+{
+	QSet<QString> pending;
+	for (const QString &media_path : pending_media_paths)
+		pending.insert(QFileInfo(media_path).absoluteFilePath());
+
+	// Backups are left alone: one without its recording is the only copy of the original.
+	const QDir dir(directory);
+	const QStringList names = dir.entryList({"*" + TEMP_COPY_SUFFIX, "*" + TEMP_COPY_SUFFIX + CHECKPOINT_SUFFIX},
+						QDir::Files | QDir::Hidden);
+	int removed = 0;
+	for (const QString &name : names) {
+		QString media_name = name;
+		if (media_name.endsWith(CHECKPOINT_SUFFIX))
+			media_name.chop(CHECKPOINT_SUFFIX.size());
+		media_name.chop(TEMP_COPY_SUFFIX.size());
+		if (pending.contains(QFileInfo(dir.filePath(media_name)).absoluteFilePath()))
+			continue;
+		if (QFile::remove(dir.filePath(name)))
+			++removed;
+	}
+	return removed;
+}
+
 EmbedResult Mp4MovEmbedEngine::embed_from_sidecar(const QString &media_path, const QString &sidecar_path) const
 {
+	if (is_cancelled())
+		return embed_cancelled();
+
 	QFile sidecar(sidecar_path);
 	if (!sidecar.exists())
 		return embed_failure(QString("Missing sidecar: %1").arg(sidecar_path), false);
@@ -349,15 +1750,31 @@ EmbedResult Mp4MovEmbedEngine::embed_from_sidecar(const QString &media_path, con
 	if (payload.isEmpty())
 		return embed_failure(QString("Sidecar is empty: %1").arg(sidecar_path), false);
 
+	// ExifTool blocks on a child process, so it never runs on the UI thread.
 	QCoreApplication *app = QCoreApplication::instance();
-	const bool on_ui_thread = app && QThread::currentThread() == app->thread();
-	if (!on_ui_thread) {
-		const EmbedResult exiftool_result = try_embed_with_exiftool(media_path, sidecar_path);
-		if (exiftool_result.ok)
-			return exiftool_result;
+	const bool can_run_exiftool = !(app && QThread::currentThread() == app->thread());
+
+	switch (m_options.writer) {
+	case EmbedWriter::ExifTool:
+		if (can_run_exiftool) {
+			const EmbedResult exiftool_result =
+				try_embed_with_exiftool(media_path, sidecar_path, m_control.cancelled);
+			if (exiftool_result.ok)
+				return exiftool_result;
+		}
+		return embed_xmp(media_path, payload);
+	case EmbedWriter::NativeWithExifToolFallback: {
+		const EmbedResult native_result = embed_xmp(media_path, payload);
+		if (native_result.ok || native_result.cancelled || !can_run_exiftool)
+			return native_result;
+		const EmbedResult exiftool_result =
+			try_embed_with_exiftool(media_path, sidecar_path, m_control.cancelled);
+		return exiftool_result.ok ? exiftool_result : native_result;
+	}
+	case EmbedWriter::Native:
+	default:
+		return embed_xmp(media_path, payload);
 	}
-
-	return embed_xmp(media_path, payload);
 }
 
 EmbedResult Mp4MovEmbedEngine::embed_from_sidecar_with_retry(const QString &media_path, const QString &sidecar_path,
@@ -371,9 +1788,9 @@ EmbedResult Mp4MovEmbedEngine::embed_from_sidecar_with_retry(const QString &medi
 	const bool on_ui_thread = app && QThread::currentThread() == app->thread();
 
 	EmbedResult result = embed_from_sidecar(media_path, sidecar_path);
-	for (int attempt = 1; attempt < attempts && !result.ok && result.retryable; ++attempt) {
-		if (delay_ms > 0 && !on_ui_thread)
-			QThread::msleep(static_cast<unsigned long>(delay_ms));
+	for (int attempt = 1; attempt < attempts && !result.ok && result.retryable && !result.cancelled; ++attempt) {
+		if (delay_ms > 0 && !on_ui_thread && !sleep_unless_cancelled(m_control.cancelled, delay_ms))
+			return embed_cancelled();
 		result = embed_from_sidecar(media_path, sidecar_path);
 		if (delay_ms > 0)
 			delay_ms = std::min(max_delay, delay_ms * 2);
@@ -384,83 +1801,167 @@ EmbedResult Mp4MovEmbedEngine::embed_from_sidecar_with_retry(const QString &medi
 
 EmbedResult Mp4MovEmbedEngine::embed_xmp(const QString &media_path, const QByteArray &xmp_payload) const
 {
+	const auto started = std::chrono::steady_clock::now();
+	if (is_cancelled())
+		return embed_cancelled();
 	QFile input(media_path);
 	if (!input.exists())
 		return embed_failure(QString("Recording file not found: %1").arg(media_path), true);
 	if (!input.open(QIODevice::ReadOnly))
 		return embed_failure(QString("Failed to open recording file: %1").arg(media_path), true);
 
+	AtomLayoutCache *cache = m_layout_cache.get();
 	QVector<Atom> top_level;
 	QString error;
-	if (!parse_top_level_atoms(input, top_level, &error))
+	if (!load_top_level_layout(input, media_path, cache, &top_level, &error))
 		return embed_failure(QString("Failed to parse MP4/MOV atoms: %1").arg(error), true);
 
 	bool ok = true;
 	const QByteArray xmp_atom = make_uuid_atom(xmp_payload, &ok);
 	if (!ok)
 		return embed_failure("XMP payload is too large for MP4 uuid atom", false);
-
-	int existing_xmp_index = -1;
-	for (int i = 0; i < top_level.size(); ++i) {
-		const Atom &atom = top_level.at(i);
-		if (atom.type != "uuid")
-			continue;
-		if (!input.seek(static_cast<qint64>(atom.offset)))
-			return embed_failure("Failed to seek existing uuid atom", true);
-		const QByteArray uuid_atom = input.read(static_cast<qint64>(atom.size));
-		if (uuid_atom.size() != static_cast<qint64>(atom.size))
-			return embed_failure("Failed to read existing uuid atom", true);
-		if (is_xmp_uuid_atom(uuid_atom)) {
-			existing_xmp_index = i;
-			break;
-		}
-	}
-
-	const QString temp_path = media_path + ".better-markers.tmp";
-	const QString backup_path = media_path + ".better-markers.bak";
-	QFile::remove(temp_path);
-
-	QFile output(temp_path);
-	if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
-		return embed_failure(QString("Failed to open temp file: %1").arg(temp_path), true);
-
-	if (existing_xmp_index >= 0) {
-		const Atom existing_xmp = top_level.at(existing_xmp_index);
-
-		if (!copy_range(input, output, 0, existing_xmp.offset, &error)) {
-			output.close();
-			QFile::remove(temp_path);
+	const quint64 xmp_atom_size = static_cast<quint64>(xmp_atom.size());
+	const quint64 input_size = static_cast<quint64>(input.size());
+	const int existing_xmp_index = first_xmp_index(top_level);
+
+	FaststartPlan faststart;
+	const bool relocate_moov =
+		m_options.faststart && plan_faststart(input, top_level, existing_xmp_index, xmp_atom_size, xmp_payload,
+						      m_options.mirror_udta_xmp, &faststart);
+
+	const QString temp_path = media_path + TEMP_COPY_SUFFIX;
+	const QString backup_path = media_path + BACKUP_SUFFIX;
+	const QString checkpoint_path = temp_path + CHECKPOINT_SUFFIX;
+
+	if (m_options.allow_in_place && !relocate_moov) {
+		input.close();
+		EmbedWriteMode mode = EmbedWriteMode::None;
+		QVector<Atom> written;
+		const InPlaceOutcome outcome = try_embed_in_place(media_path, top_level, existing_xmp_index, xmp_atom,
+								  &mode, &written, &error);
+		if (outcome == InPlaceOutcome::Failed) {
+			if (cache)
+				cache->invalidate(media_path);
 			return embed_failure(error, true);
 		}
-		if (output.write(xmp_atom) != xmp_atom.size()) {
-			output.close();
-			QFile::remove(temp_path);
-			return embed_failure("Failed to write replacement XMP uuid atom", true);
+		if (outcome == InPlaceOutcome::Done) {
+			if (!verify_written_layout(media_path, written)) {
+				if (cache)
+					cache->invalidate(media_path);
+				return embed_failure("In-place embed validation failed (missing XMP metadata atom)",
+						     false);
+			}
+			remember_written_layout(cache, media_path, written);
+			// A temp copy left by an interrupted attempt is useless now.
+			discard_temp_copy(temp_path, checkpoint_path);
+			EmbedResult result = embed_success(mode);
+			note_embed_io(&result, xmp_atom_size, started);
+			maybe_mirror_udta_xmp(m_options, media_path, xmp_payload, cache, &result);
+			return result;
 		}
+		if (!input.open(QIODevice::ReadOnly))
+			return embed_failure(QString("Failed to reopen recording file: %1").arg(media_path), true);
+	}
 
+	QVector<CopySegment> segments;
+	QVector<Atom> written;
+	if (relocate_moov) {
+		append_atom_segments(&segments, faststart.prefix);
+		append_literal_segment(&segments, faststart.moov);
+		append_literal_segment(&segments, xmp_atom);
+		append_atom_segments(&segments, faststart.body);
+		written = faststart.written;
+	} else if (existing_xmp_index >= 0) {
+		const Atom &existing_xmp = top_level.at(existing_xmp_index);
 		const quint64 tail_offset = existing_xmp.offset + existing_xmp.size;
-		const quint64 tail_size = static_cast<quint64>(input.size()) - tail_offset;
-		if (!copy_range(input, output, tail_offset, tail_size, &error)) {
-			output.close();
-			QFile::remove(temp_path);
-			return embed_failure(error, true);
+		append_source_segment(&segments, 0, existing_xmp.offset);
+		append_literal_segment(&segments, xmp_atom);
+		append_source_segment(&segments, tail_offset, input_size - tail_offset);
+
+		for (int i = 0; i < existing_xmp_index; ++i)
+			written.push_back(top_level.at(i));
+		written.push_back(written_xmp_atom(existing_xmp.offset, xmp_atom_size));
+		for (int i = existing_xmp_index + 1; i < top_level.size(); ++i) {
+			Atom atom = top_level.at(i);
+			atom.offset = atom.offset - existing_xmp.size + xmp_atom_size;
+			written.push_back(atom);
 		}
 	} else {
-		if (!copy_range(input, output, 0, static_cast<quint64>(input.size()), &error)) {
-			output.close();
-			QFile::remove(temp_path);
-			return embed_failure(error, true);
-		}
-		if (output.write(xmp_atom) != xmp_atom.size()) {
+		append_source_segment(&segments, 0, input_size);
+		append_literal_segment(&segments, xmp_atom);
+		written = top_level;
+		written.push_back(written_xmp_atom(input_size, xmp_atom_size));
+	}
+
+	QStringList segment_keys;
+	quint64 total_bytes = 0;
+	for (const CopySegment &segment : segments) {
+		segment_keys.push_back(segment_key(segment));
+		total_bytes += segment.length;
+	}
+
+	MediaFileIdentity source_identity;
+	const bool checkpoints = m_options.checkpoint_interval_mib > 0 &&
+				 read_media_file_identity(media_path, &source_identity);
+	quint64 resume_from = checkpoints ? load_copy_checkpoint(checkpoint_path, temp_path, source_identity, segments,
+								 segment_keys)
+					  : 0;
+
+	QFile output(temp_path);
+	if (resume_from > 0 &&
+	    (!output.open(QIODevice::ReadWrite) || !output.resize(static_cast<qint64>(resume_from)) ||
+	     !output.seek(static_cast<qint64>(resume_from)))) {
+		output.close();
+		resume_from = 0;
+	}
+	if (resume_from == 0) {
+		discard_temp_copy(temp_path, checkpoint_path);
+		if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+			return embed_failure(QString("Failed to open temp file: %1").arg(temp_path), true);
+	}
+
+	CopyContext copy_ctx;
+	copy_ctx.allow_kernel_copy = m_options.allow_kernel_copy;
+	copy_ctx.io_mode = m_options.io_mode;
+	copy_ctx.max_bytes_per_sec = static_cast<quint64>(std::max(0, m_options.max_throughput_mib_s)) << 20;
+	copy_ctx.control = &m_control;
+	copy_ctx.resumed_bytes = resume_from;
+	copy_ctx.total_bytes = total_bytes;
+	if (checkpoints) {
+		copy_ctx.checkpoint_interval = static_cast<quint64>(m_options.checkpoint_interval_mib) << 20;
+		copy_ctx.next_checkpoint = resume_from + copy_ctx.checkpoint_interval;
+		copy_ctx.checkpoint = [&](int out_fd, quint64 verified_bytes) {
+			if (sync_fd_to_disk(out_fd))
+				save_copy_checkpoint(checkpoint_path, temp_path, source_identity, segment_keys,
+						     verified_bytes);
+		};
+	}
+#if defined(__linux__)
+	if (copy_ctx.io_mode != EmbedIoMode::PageCache)
+		posix_fadvise(input.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	if (!write_segments(input, output, segments, resume_from, &copy_ctx, &error)) {
+		finish_copy(&copy_ctx);
+		if (copy_ctx.cancelled && checkpoints && output.flush()) {
+			// Keep the temp file; the next attempt picks up from this checkpoint.
+			copy_ctx.checkpoint(output.handle(), output_done(&copy_ctx));
 			output.close();
-			QFile::remove(temp_path);
-			return embed_failure("Failed to append XMP uuid atom", true);
+			EmbedResult result = embed_cancelled();
+			result.resumed_bytes = resume_from;
+			note_embed_io(&result, copy_ctx.copied.written_bytes() + copy_ctx.literal_bytes, started);
+			return result;
 		}
+		output.close();
+		discard_temp_copy(temp_path, checkpoint_path);
+		return copy_ctx.cancelled ? embed_cancelled() : embed_failure(error, true);
 	}
+	finish_copy(&copy_ctx);
 	output.close();
 	input.close();
 
-	if (!has_xmp_atom(temp_path)) {
+	QFile::remove(checkpoint_path);
+	if (!verify_written_layout(temp_path, written)) {
 		QFile::remove(temp_path);
 		return embed_failure("Embedded file validation failed (missing XMP metadata atom)", false);
 	}
@@ -478,7 +1979,16 @@ EmbedResult Mp4MovEmbedEngine::embed_xmp(const QString &media_path, const QByteA
 	}
 
 	QFile::remove(backup_path);
-	return {true, {}};
+	remember_written_layout(cache, media_path, written);
+	EmbedResult result = embed_success(relocate_moov ? EmbedWriteMode::Faststart : EmbedWriteMode::TempCopy);
+	result.copy_strategy = copy_ctx.strategy;
+	result.resumed_bytes = resume_from;
+	note_embed_io(&result, copy_ctx.copied.written_bytes() + copy_ctx.literal_bytes, started);
+	if (relocate_moov)
+		result.udta_mirror_written = faststart.udta_mirror_written;
+	else
+		maybe_mirror_udta_xmp(m_options, media_path, xmp_payload, cache, &result);
+	return result;
 }
 
 } // namespace bm
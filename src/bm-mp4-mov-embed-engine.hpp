@@ -1,22 +1,204 @@
 #pragma once
 
 #include <QByteArray>
+#include <QHash>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 namespace bm {
 
+enum class EmbedWriteMode {
+	None,
+	TempCopy,
+	InPlaceReplace,
+	InPlaceAppend,
+	ExifTool,
+	// Temp copy that also moved moov ahead of the media data (see EmbedOptions::faststart).
+	Faststart,
+};
+
+enum class EmbedWriter {
+	Native,
+	ExifTool,
+	NativeWithExifToolFallback,
+};
+
+// Ordered from cheapest to most expensive; a copy that needed several strategies reports the slowest one.
+enum class CopyStrategy {
+	None,
+	Reflink,
+	CopyFileRange,
+	Sendfile,
+	DirectIo,
+	Buffered,
+};
+
+// How the temp-copy path treats the page cache. Streaming and Direct keep a multi-gigabyte copy from evicting
+// pages the muxer of the live recording still needs.
+enum class EmbedIoMode {
+	PageCache,
+	// posix_fadvise SEQUENTIAL on the source, then DONTNEED behind the copy on source and temp file.
+	Streaming,
+	// O_DIRECT for the block-aligned body of the copy, Streaming for the unaligned edges (Linux only).
+	Direct,
+};
+
+struct EmbedOptions {
+	// Native writes the ExifTool layout in-process; ExifTool keeps the native writer as its fallback.
+	EmbedWriter writer = EmbedWriter::Native;
+	// Also mirror the packet into moov/udta/XMP_ (MOV-style), when moov can grow without moving media data.
+	bool mirror_udta_xmp = false;
+	// Rewrite the XMP atom (or append it) directly in the recording instead of copying the whole file.
+	bool allow_in_place = true;
+	// Let the temp-copy path use reflink/copy_file_range/sendfile before the buffered loop (Linux only).
+	bool allow_kernel_copy = true;
+	EmbedIoMode io_mode = EmbedIoMode::PageCache;
+	// Caps the temp-copy rate; 0 means unlimited.
+	int max_throughput_mib_s = 0;
+	// When moov trails the media data, move it to the front (patching stco/co64) in the same copy that writes the
+	// XMP atom. Files that are already faststart keep using the in-place path.
+	bool faststart = false;
+	// Temp copies sync the partial output and record a checkpoint this often, so an interrupted embed resumes from
+	// there instead of starting over. 0 disables checkpoints (and resuming).
+	int checkpoint_interval_mib = 256;
+};
+
+// Temp-copy progress in output bytes, including bytes carried over from a checkpoint.
+using EmbedProgressCallback = std::function<void(quint64 bytes_done, quint64 bytes_total)>;
+
+// Per-call hooks for long embeds. The flag is polled between copy chunks (and retry delays); once raised the embed ends
+// with a retryable cancelled result and keeps its checkpoint for the next attempt.
+struct EmbedControl {
+	const std::atomic_bool *cancelled = nullptr;
+	EmbedProgressCallback on_progress;
+};
+
 struct EmbedResult {
 	bool ok = false;
 	QString error;
 	bool retryable = false;
+	EmbedWriteMode write_mode = EmbedWriteMode::None;
+	CopyStrategy copy_strategy = CopyStrategy::None;
+	bool udta_mirror_written = false;
+	bool cancelled = false;
+	quint64 bytes_written = 0;
+	quint64 elapsed_ms = 0;
+	// Temp-copy bytes kept from the checkpoint of an interrupted embed.
+	quint64 resumed_bytes = 0;
+};
+
+const char *embed_writer_name(EmbedWriter writer);
+const char *embed_write_mode_name(EmbedWriteMode mode);
+const char *copy_strategy_name(CopyStrategy strategy);
+const char *embed_io_mode_name(EmbedIoMode mode);
+double embed_rate_mib_s(const EmbedResult &result);
+
+struct Mp4Atom {
+	quint64 offset = 0;
+	quint64 size = 0;
+	quint64 header_size = 0;
+	QByteArray type;
+	bool extends_to_eof = false;
+	// Top-level Adobe XMP uuid atom (UUID and xpacket probe matched).
+	bool xmp_uuid = false;
+};
+
+// What the layout cache compares to decide whether a file changed since its layout was recorded.
+struct MediaFileIdentity {
+	qint64 size = -1;
+	qint64 mtime_ns = 0;
+	quint64 inode = 0;
+	quint64 device = 0;
+
+	bool operator==(const MediaFileIdentity &other) const
+	{
+		return size == other.size && mtime_ns == other.mtime_ns && inode == other.inode &&
+		       device == other.device;
+	}
 };
 
+bool read_media_file_identity(const QString &path, MediaFileIdentity *identity);
+
+// Top-level atom layouts of recently parsed or written files. Retries, recovery passes and post-write checks reuse
+// them instead of walking every atom header again, which is slow on fragmented files and network storage. Entries are
+// only returned while size, mtime and inode still match; the least recently used entry is evicted when full.
+class AtomLayoutCache {
+public:
+	static constexpr int kDefaultCapacity = 64;
+
+	explicit AtomLayoutCache(int capacity = kDefaultCapacity);
+
+	bool lookup(const QString &path, const MediaFileIdentity &identity, QVector<Mp4Atom> *top_level);
+	void store(const QString &path, const MediaFileIdentity &identity, const QVector<Mp4Atom> &top_level);
+	void invalidate(const QString &path);
+
+	quint64 hits() const;
+	quint64 misses() const;
+
+private:
+	struct Entry {
+		MediaFileIdentity identity;
+		QVector<Mp4Atom> top_level;
+		quint64 last_used = 0;
+	};
+
+	const int m_capacity;
+	mutable std::mutex m_mutex;
+	QHash<QString, Entry> m_entries;
+	quint64 m_use_clock = 0;
+	quint64 m_hits = 0;
+	quint64 m_misses = 0;
+};
+
+namespace embed_engine_detail {
+
+// What a temp copy has put into its output so far. Reflinked extents share the source's blocks and move no data.
+struct CopyVolume {
+	quint64 moved_bytes = 0;
+	quint64 reflinked_bytes = 0;
+
+	quint64 written_bytes() const { return moved_bytes + reflinked_bytes; }
+};
+
+// How long a copy that started elapsed ago has to wait before its next chunk to keep the bytes it moved under
+// max_bytes_per_sec (0 = no cap). Reflinked bytes are not paced.
+std::chrono::microseconds copy_pacing_delay(const CopyVolume &volume, quint64 max_bytes_per_sec,
+					    std::chrono::nanoseconds elapsed);
+
+} // namespace embed_engine_detail
+
 class Mp4MovEmbedEngine {
 public:
+	void set_options(const EmbedOptions &options);
+	const EmbedOptions &options() const;
+	// Engines own a private cache by default; share one to carry layouts across engines. nullptr disables caching.
+	void set_layout_cache(std::shared_ptr<AtomLayoutCache> cache);
+	const std::shared_ptr<AtomLayoutCache> &layout_cache() const;
+	void set_control(EmbedControl control);
+
+	static bool has_xmp_metadata(const QString &media_path);
+	// Deletes the temp copies in directory, and their checkpoints, that no embed will resume: those whose recording
+	// is not one of pending_media_paths. Returns how many files were removed.
+	static int remove_orphaned_temp_copies(const QString &directory, const QStringList &pending_media_paths);
+
 	EmbedResult embed_from_sidecar(const QString &media_path, const QString &sidecar_path) const;
 	EmbedResult embed_from_sidecar_with_retry(const QString &media_path, const QString &sidecar_path,
 						  int max_attempts, int initial_delay_ms, int max_delay_ms) const;
 	EmbedResult embed_xmp(const QString &media_path, const QByteArray &xmp_payload) const;
+
+private:
+	bool is_cancelled() const;
+
+	EmbedOptions m_options;
+	EmbedControl m_control;
+	std::shared_ptr<AtomLayoutCache> m_layout_cache = std::make_shared<AtomLayoutCache>();
 };
 
 } // namespace bm
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace bm {
+
+// Unbounded multi-producer, single-consumer FIFO (Vyukov's node-based queue). push() is one atomic exchange plus a
+// store and never waits for another thread; pop() runs on a single consumer thread only. A push that has exchanged
+// the head but not yet linked its node is invisible to pop() until it does, so a consumer that knows an item is
+// coming (through a separate counter) simply retries. T must be default-constructible for the stub node.
+template<typename T> class MpscQueue {
+public:
+	MpscQueue() : m_head(new Node()), m_tail(m_head.load(std::memory_order_relaxed)) {}
+
+	~MpscQueue()
+	{
+		T discarded;
+		while (pop(&discarded)) {
+		}
+		delete m_tail;
+	}
+
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue &operator=(const MpscQueue &) = delete;
+
+	void push(T value)
+	{
+		Node *node = new Node();
+		node->value = std::move(value);
+		Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// Consumer thread only. The node holding the popped value becomes the new stub.
+	bool pop(T *out)
+	{
+		Node *tail = m_tail;
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return false;
+		*out = std::move(next->value);
+		next->value = T();
+		m_tail = next;
+		delete tail;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node *> next{nullptr};
+		T value;
+	};
+
+	// Producers swing the head; the consumer owns the tail (always the stub whose successor is the next item).
+	std::atomic<Node *> m_head;
+	Node *m_tail;
+};
+
+} // namespace bm
@@ -0,0 +1,148 @@
+#include "bm-packet-timeline.hpp"
+
+#include "bm-recording-clock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace bm {
+namespace {
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+constexpr uint64_t kMaxExtrapolationNs = 5 * kNsPerSecond;
+
+struct TimelinePoint {
+	uint64_t pts_ns = 0;
+	uint64_t render_ns = 0;
+};
+
+// How much the render times of two frames are further apart, or closer together, than their pts.
+uint64_t jitter_ns(const TimelinePoint &earlier, const TimelinePoint &later)
+{
+	const uint64_t rendered = later.render_ns + earlier.pts_ns;
+	const uint64_t presented = later.pts_ns + earlier.render_ns;
+	return rendered > presented ? rendered - presented : presented - rendered;
+}
+
+bool has_composition_time(const PacketSample &sample)
+{
+	return sample.composed_ns != 0 && sample.composed_ns <= sample.received_ns;
+}
+
+} // namespace
+
+PacketFrameEstimate estimate_packet_frame(const PacketSample *samples, size_t count, uint64_t trigger_ns,
+					  uint32_t fps_num, uint32_t fps_den)
+{
+	PacketFrameEstimate estimate;
+	if (!samples || count == 0 || fps_num == 0 || fps_den == 0)
+		return estimate;
+	count = std::min(count, PacketTimeline::kCapacity);
+
+	std::array<PacketSample, PacketTimeline::kCapacity> sorted;
+	std::copy(samples, samples + count, sorted.begin());
+	std::stable_sort(sorted.begin(), sorted.begin() + count,
+			 [](const PacketSample &a, const PacketSample &b) { return a.pts_ns < b.pts_ns; });
+
+	// A B frame waits in the encoder for the frame that releases its group, so the smallest latency is the one that
+	// matches the arrival envelope below.
+	bool latency_measured = false;
+	uint64_t latency_ns = 0;
+	for (size_t i = 0; i < count; ++i) {
+		const PacketSample &sample = sorted[i];
+		if (!has_composition_time(sample))
+			continue;
+		const uint64_t sample_latency_ns = sample.received_ns - sample.composed_ns;
+		latency_ns = latency_measured ? std::min(latency_ns, sample_latency_ns) : sample_latency_ns;
+		latency_measured = true;
+	}
+
+	// Render times in pts order, each capped by every later frame's so the timeline never runs backwards.
+	std::array<TimelinePoint, PacketTimeline::kCapacity> points;
+	uint64_t latest_render_ns = std::numeric_limits<uint64_t>::max();
+	for (size_t i = count; i-- > 0;) {
+		const PacketSample &sample = sorted[i];
+		uint64_t render_ns = sample.composed_ns;
+		if (!has_composition_time(sample))
+			render_ns = sample.received_ns > latency_ns ? sample.received_ns - latency_ns : 0;
+		latest_render_ns = std::min(latest_render_ns, render_ns);
+		points[i].pts_ns = sample.pts_ns;
+		points[i].render_ns = latest_render_ns;
+	}
+
+	const auto after = std::upper_bound(
+		points.begin(), points.begin() + count, trigger_ns,
+		[](uint64_t trigger, const TimelinePoint &point) { return trigger < point.render_ns; });
+	const size_t next = static_cast<size_t>(after - points.begin());
+	if (next == 0)
+		return estimate;
+
+	const TimelinePoint &before = points[next - 1];
+	const uint64_t since_render_ns = trigger_ns - before.render_ns;
+	uint64_t media_ns = 0;
+	uint64_t error_ns = 0;
+	if (next < count) {
+		const TimelinePoint &later = points[next];
+		media_ns = before.pts_ns + mul_div_floor(since_render_ns, later.pts_ns - before.pts_ns,
+							 later.render_ns - before.render_ns);
+		error_ns = jitter_ns(before, later);
+	} else {
+		if (since_render_ns > kMaxExtrapolationNs)
+			return estimate;
+		media_ns = before.pts_ns + since_render_ns;
+		// A lone frame says nothing about the clock's steadiness; call it a frame either way.
+		if (next >= 2)
+			error_ns = jitter_ns(points[next - 2], before);
+		else
+			error_ns = mul_div_ceil(fps_den, kNsPerSecond, fps_num);
+	}
+
+	const uint64_t frame = mul_div_floor(media_ns, fps_num, fps_den * kNsPerSecond);
+	estimate.frame = static_cast<int64_t>(std::min<uint64_t>(frame, std::numeric_limits<int64_t>::max()));
+	estimate.error_frames = static_cast<double>(error_ns) * fps_num / (static_cast<double>(fps_den) * kNsPerSecond);
+	estimate.latency_measured = latency_measured;
+	estimate.valid = true;
+	return estimate;
+}
+
+void PacketTimeline::record(const PacketSample &sample)
+{
+	const uint64_t recorded = m_recorded.load(std::memory_order_relaxed);
+	Slot slot;
+	slot.sample = sample;
+	slot.position = recorded + 1;
+	slot.epoch = m_epoch.load(std::memory_order_acquire);
+	m_slots[recorded % kCapacity].store(slot);
+	m_recorded.store(recorded + 1, std::memory_order_release);
+}
+
+void PacketTimeline::reset()
+{
+	m_epoch.fetch_add(1, std::memory_order_acq_rel);
+}
+
+size_t PacketTimeline::snapshot(PacketSample *out) const
+{
+	const uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+	const uint64_t recorded = m_recorded.load(std::memory_order_acquire);
+	size_t count = 0;
+	// Newest first, up to a slot the producer has since reused or one recorded before the last reset.
+	for (uint64_t position = recorded; position > 0 && count < kCapacity; --position) {
+		const Slot slot = m_slots[(position - 1) % kCapacity].load();
+		if (slot.position != position || slot.epoch != epoch)
+			break;
+		out[count++] = slot.sample;
+	}
+	std::reverse(out, out + count);
+	return count;
+}
+
+PacketFrameEstimate PacketTimeline::estimate(uint64_t trigger_ns, uint32_t fps_num, uint32_t fps_den) const
+{
+	PacketSample samples[kCapacity];
+	const size_t count = snapshot(samples);
+	return estimate_packet_frame(samples, count, trigger_ns, fps_num, fps_den);
+}
+
+} // namespace bm
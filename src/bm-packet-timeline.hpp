@@ -0,0 +1,74 @@
+#pragma once
+
+#include "bm-seqlock.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace bm {
+
+// One encoded video packet as the recording output handed it over.
+struct PacketSample {
+	int64_t dts_usec = 0;
+	// Presentation time in the recording, rounded up to the nanosecond so it floors back to the packet's frame.
+	uint64_t pts_ns = 0;
+	// os_gettime_ns() when the packet callback ran.
+	uint64_t received_ns = 0;
+	// When OBS rendered the frame (encoder_packet_time::cts), or 0 when the output did not report it.
+	uint64_t composed_ns = 0;
+};
+
+// The frame a trigger time maps to through the recent packets.
+struct PacketFrameEstimate {
+	bool valid = false;
+	int64_t frame = 0;
+	// How far the packets' render times strayed from a steady frame clock around the trigger, in frames.
+	double error_frames = 0.0;
+	// Encoder latency came from OBS's composition times rather than from the packets' arrival alone.
+	bool latency_measured = false;
+};
+
+// Maps trigger_ns onto the media timeline of samples (oldest first, any order of pts).
+//
+// A packet cannot arrive before its frame, or any earlier frame, was rendered, so the earliest arrival among packets
+// at or after a pts bounds when that pts was rendered; this envelope undoes B-frame reordering. When some packets
+// carry a composition time those frames use it, and the smallest measured latency (arrival minus composition) is
+// taken off the others. The trigger is then interpolated between the two frames whose render times bracket it, or
+// carried forward from the newest one at the nominal rate. Invalid when the trigger is older than every sample or more
+// than five seconds past the newest.
+PacketFrameEstimate estimate_packet_frame(const PacketSample *samples, size_t count, uint64_t trigger_ns,
+					  uint32_t fps_num, uint32_t fps_den);
+
+// The last kCapacity video packets of a recording. record() is called from the output's packet callback (one
+// producer); snapshot() and estimate() read from any thread without a lock, and reset() from any thread drops every
+// sample recorded so far.
+class PacketTimeline {
+public:
+	static constexpr size_t kCapacity = 128;
+
+	PacketTimeline() = default;
+	PacketTimeline(const PacketTimeline &) = delete;
+	PacketTimeline &operator=(const PacketTimeline &) = delete;
+
+	void record(const PacketSample &sample);
+	void reset();
+
+	// Copies the current samples, oldest first, into out (room for kCapacity) and returns how many there are.
+	size_t snapshot(PacketSample *out) const;
+	PacketFrameEstimate estimate(uint64_t trigger_ns, uint32_t fps_num, uint32_t fps_den) const;
+
+private:
+	struct Slot {
+		PacketSample sample;
+		// Position of the sample in the stream, from 1; 0 while the slot is empty.
+		uint64_t position = 0;
+		uint64_t epoch = 0;
+	};
+
+	Seqlock<Slot> m_slots[kCapacity];
+	std::atomic<uint64_t> m_recorded{0};
+	std::atomic<uint64_t> m_epoch{0};
+};
+
+} // namespace bm
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bm-embed-executor.hpp"
 #include "bm-marker-export-sink.hpp"
 #include "bm-mp4-mov-embed-engine.hpp"
 #include "bm-recovery-queue.hpp"
@@ -9,47 +10,72 @@
 #include <util/base.h>
 #include <util/platform.h>
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QStringList>
 #include <QVector>
 
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <thread>
 
 namespace bm {
 
 class PremiereXmpSink : public MarkerExportSink {
 public:
+	using EmbedFailureCallback = std::function<void(const QString &media_path, const QString &error)>;
+
 	explicit PremiereXmpSink(const QString &queue_path);
 	~PremiereXmpSink() override;
 
 	QString sink_name() const override;
 	bool on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &marker,
-			     const QVector<MarkerRecord> &full_marker_list, QString *error) override;
+			     const MarkerList &full_marker_list, QString *error) override;
 	bool on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *error) override;
 
 	void start_startup_recovery_async();
 	void stop_startup_recovery();
+	// Deletes temp copies and checkpoints left by embeds that are no longer pending, in recording_directories and
+	// next to every pending job. Run before startup recovery, while no embed is running.
+	void remove_orphaned_temp_copies(const QStringList &recording_directories);
+	void set_embed_options(const EmbedOptions &options);
+	void set_embed_concurrency(const EmbedConcurrency &concurrency);
+	// Invoked on an embed worker thread when a finalize embed fails after all retries.
+	void set_embed_failure_callback(EmbedFailureCallback callback);
 
 private:
 	static constexpr int kFinalizeRetryAttempts = 8;
 	static constexpr int kFinalizeRetryInitialDelayMs = 120;
 	static constexpr int kFinalizeRetryMaxDelayMs = 2000;
+	static constexpr const char *kFinalizeGroup = "finalize";
+	static constexpr const char *kStartupRecoveryGroup = "startup-recovery";
 
 	bool load_recovery_queue_locked();
 	bool save_recovery_queue_locked();
-	void run_startup_recovery_worker();
+	EmbedResult run_embed(const QString &media_path, const QString &sidecar_path, int max_attempts,
+			      int initial_delay_ms, int max_delay_ms, const std::atomic_bool *cancelled);
+	void on_finalize_embed_complete(const QString &media_path, const EmbedResult &result);
+	void on_startup_recovery_job_complete(const QString &media_path, const StartupRecoveryDecision &decision,
+					      const EmbedResult &result, uint64_t job_begin_ns);
 	void remove_job_and_save_locked(const QString &media_path);
 	void upsert_job_and_save_locked(const QString &media_path, const QString &last_error);
+	EmbedOptions embed_options() const;
 
 	XmpSidecarWriter m_xmp_writer;
-	Mp4MovEmbedEngine m_embed_engine;
+	EmbedOptions m_embed_options;
+	mutable std::mutex m_embed_options_mutex;
+	// Shared by every job, so finalize retries and recovery passes reuse atom layouts (the cache locks internally).
+	std::shared_ptr<AtomLayoutCache> m_layout_cache = std::make_shared<AtomLayoutCache>();
 	RecoveryQueue m_recovery;
 	std::mutex m_recovery_mutex;
-	std::mutex m_embed_mutex;
-	std::thread m_startup_recovery_thread;
-	std::atomic_bool m_stop_startup_recovery{false};
-	std::atomic_bool m_startup_recovery_running{false};
+	EmbedFailureCallback m_embed_failure_callback;
+	std::mutex m_callback_mutex;
+	std::atomic_int m_startup_recovery_outstanding{0};
+	std::atomic<uint64_t> m_startup_recovery_begin_ns{0};
+	// Declared last so its workers are joined before any state their completions touch is destroyed.
+	EmbedExecutor m_executor;
 };
 
 inline PremiereXmpSink::PremiereXmpSink(const QString &queue_path)
@@ -63,7 +89,30 @@ inline PremiereXmpSink::PremiereXmpSink(const QString &queue_path)
 
 inline PremiereXmpSink::~PremiereXmpSink()
 {
-	stop_startup_recovery();
+	m_executor.shutdown();
+}
+
+inline void PremiereXmpSink::set_embed_options(const EmbedOptions &options)
+{
+	std::lock_guard<std::mutex> lock(m_embed_options_mutex);
+	m_embed_options = options;
+}
+
+inline void PremiereXmpSink::set_embed_concurrency(const EmbedConcurrency &concurrency)
+{
+	m_executor.set_concurrency(concurrency);
+}
+
+inline EmbedOptions PremiereXmpSink::embed_options() const
+{
+	std::lock_guard<std::mutex> lock(m_embed_options_mutex);
+	return m_embed_options;
+}
+
+inline void PremiereXmpSink::set_embed_failure_callback(EmbedFailureCallback callback)
+{
+	std::lock_guard<std::mutex> lock(m_callback_mutex);
+	m_embed_failure_callback = std::move(callback);
 }
 
 inline QString PremiereXmpSink::sink_name() const
@@ -72,70 +121,272 @@ inline QString PremiereXmpSink::sink_name() const
 }
 
 inline bool PremiereXmpSink::on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &,
-					     const QVector<MarkerRecord> &full_marker_list, QString *error)
+					     const MarkerList &full_marker_list, QString *error)
 {
-	return m_xmp_writer.write_sidecar(recording_ctx.media_path, full_marker_list, recording_ctx.fps_num,
-					  recording_ctx.fps_den, error);
+	return m_xmp_writer.append_markers(recording_ctx.media_path, full_marker_list, recording_ctx.fps_num,
+					   recording_ctx.fps_den, error, recording_ctx.render_cache,
+					   recording_ctx.sync_batch);
 }
 
+// Called from the recording's file_changed/stop signal: only queue the work so the output thread is not held while
+// the sidecar is embedded. The job is in pending-embed.json before it is queued and leaves it only once the embed
+// succeeded, so a crash, kill or shutdown while it is queued or copying hands it to startup recovery.
 inline bool PremiereXmpSink::on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *error)
 {
 	if (!is_mp4_or_mov_path(recording_ctx.media_path))
 		return true;
 
-	const QString sidecar = XmpSidecarWriter::sidecar_path_for_media(recording_ctx.media_path);
-	if (!QFile::exists(sidecar))
+	const QString media_path = recording_ctx.media_path;
+	EmbedExecutorJob job;
+	job.key = media_path;
+	job.group = kFinalizeGroup;
+	job.device = media_device_id(media_path);
+	job.task = [this, media_path](const std::atomic_bool &cancelled) {
+		// Markers were spliced in one at a time while recording; embed a cleanly rebuilt sidecar.
+		QString finalize_error;
+		if (!m_xmp_writer.finalize_sidecar(media_path, &finalize_error))
+			blog(LOG_WARNING, "[better-markers][%s] sidecar rebuild failed for '%s': %s",
+			     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+			     finalize_error.toUtf8().constData());
+		const QString sidecar = XmpSidecarWriter::sidecar_path_for_media(media_path);
+		if (!QFile::exists(sidecar)) {
+			EmbedResult skipped;
+			skipped.ok = true;
+			return skipped;
+		}
+		return run_embed(media_path, sidecar, kFinalizeRetryAttempts, kFinalizeRetryInitialDelayMs,
+				 kFinalizeRetryMaxDelayMs, &cancelled);
+	};
+	job.on_complete = [this](const QString &key, const EmbedResult &result) {
+		on_finalize_embed_complete(key, result);
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(m_recovery_mutex);
+		upsert_job_and_save_locked(media_path, "Finalize embed did not complete");
+	}
+	const EmbedSubmitResult submitted = m_executor.submit(std::move(job));
+	if (submitted == EmbedSubmitResult::Queued || submitted == EmbedSubmitResult::Coalesced)
 		return true;
 
-	EmbedResult result;
+	// The sidecar is complete either way; rebuilding it here just keeps the writer from holding on to its state.
+	m_xmp_writer.finalize_sidecar(media_path, nullptr);
+
+	const QString reason = QString("Embed executor rejected job (%1); deferred to startup recovery")
+				       .arg(embed_submit_result_name(submitted));
+	blog(LOG_WARNING, "[better-markers][%s] %s: '%s'", sink_name().toUtf8().constData(),
+	     reason.toUtf8().constData(), media_path.toUtf8().constData());
 	{
-		std::lock_guard<std::mutex> embed_lock(m_embed_mutex);
-		result = m_embed_engine.embed_from_sidecar_with_retry(recording_ctx.media_path, sidecar,
-								      kFinalizeRetryAttempts,
-								      kFinalizeRetryInitialDelayMs,
-								      kFinalizeRetryMaxDelayMs);
+		std::lock_guard<std::mutex> lock(m_recovery_mutex);
+		upsert_job_and_save_locked(media_path, reason);
 	}
+	if (error)
+		*error = reason;
+	return false;
+}
+
+inline EmbedResult PremiereXmpSink::run_embed(const QString &media_path, const QString &sidecar_path,
+					      int max_attempts, int initial_delay_ms, int max_delay_ms,
+					      const std::atomic_bool *cancelled)
+{
+	// The engine only carries options and the shared layout cache, so each job gets its own and embeds on different
+	// files run in parallel; the executor guarantees a file is never embedded by two jobs at once.
+	Mp4MovEmbedEngine engine;
+	engine.set_options(embed_options());
+	engine.set_layout_cache(m_layout_cache);
+
+	// Stopping the executor raises the flag; the engine then keeps its checkpoint so the next attempt resumes.
+	EmbedControl control;
+	control.cancelled = cancelled;
+	control.on_progress = [this, media_path, next_quarter = 1](quint64 bytes_done, quint64 bytes_total) mutable {
+		if (bytes_total == 0 || bytes_done * 4 < bytes_total * static_cast<quint64>(next_quarter))
+			return;
+		next_quarter = static_cast<int>(bytes_done * 4 / bytes_total) + 1;
+		blog(LOG_DEBUG, "[better-markers][%s] embedding '%s': %llu/%llu bytes",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+		     static_cast<unsigned long long>(bytes_done), static_cast<unsigned long long>(bytes_total));
+	};
+	engine.set_control(std::move(control));
+	return engine.embed_from_sidecar_with_retry(media_path, sidecar_path, max_attempts, initial_delay_ms,
+						    max_delay_ms);
+}
+
+inline void PremiereXmpSink::on_finalize_embed_complete(const QString &media_path, const EmbedResult &result)
+{
 	if (result.ok) {
 		std::lock_guard<std::mutex> lock(m_recovery_mutex);
-		remove_job_and_save_locked(recording_ctx.media_path);
-		blog(LOG_INFO, "[better-markers][%s] embedded XMP into '%s'", sink_name().toUtf8().constData(),
-		     recording_ctx.media_path.toUtf8().constData());
-		return true;
+		remove_job_and_save_locked(media_path);
+		if (result.write_mode == EmbedWriteMode::None)
+			return;
+		blog(LOG_INFO,
+		     "[better-markers][%s] embedded XMP into '%s' (mode=%s copy=%s bytes=%llu resumed=%llu "
+		     "rate=%.1f MB/s)",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+		     embed_write_mode_name(result.write_mode), copy_strategy_name(result.copy_strategy),
+		     static_cast<unsigned long long>(result.bytes_written),
+		     static_cast<unsigned long long>(result.resumed_bytes), embed_rate_mib_s(result));
+		return;
 	}
 
-	blog(LOG_WARNING, "[better-markers][%s] XMP embed retries exhausted for '%s': %s",
-	     sink_name().toUtf8().constData(), recording_ctx.media_path.toUtf8().constData(),
-	     result.error.toUtf8().constData());
 	{
 		std::lock_guard<std::mutex> lock(m_recovery_mutex);
-		upsert_job_and_save_locked(recording_ctx.media_path, result.error);
+		upsert_job_and_save_locked(media_path, result.error);
 	}
-	if (error)
-		*error = result.error;
-	return false;
+	if (result.cancelled) {
+		blog(LOG_INFO, "[better-markers][%s] XMP embed cancelled for '%s'; deferred to startup recovery",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData());
+		return;
+	}
+	blog(LOG_WARNING, "[better-markers][%s] XMP embed retries exhausted for '%s': %s",
+	     sink_name().toUtf8().constData(), media_path.toUtf8().constData(), result.error.toUtf8().constData());
+
+	EmbedFailureCallback callback;
+	{
+		std::lock_guard<std::mutex> lock(m_callback_mutex);
+		callback = m_embed_failure_callback;
+	}
+	if (callback)
+		callback(media_path, result.error);
 }
 
 inline void PremiereXmpSink::start_startup_recovery_async()
 {
-	bool expected = false;
-	if (!m_startup_recovery_running.compare_exchange_strong(expected, true)) {
+	if (m_startup_recovery_outstanding.load() > 0) {
 		blog(LOG_INFO, "[better-markers][%s] startup recovery already running; skipping duplicate start",
 		     sink_name().toUtf8().constData());
 		return;
 	}
 
-	m_stop_startup_recovery.store(false);
-	if (m_startup_recovery_thread.joinable())
-		m_startup_recovery_thread.join();
-	m_startup_recovery_thread = std::thread([this]() { run_startup_recovery_worker(); });
+	QVector<PendingEmbedJob> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_recovery_mutex);
+		jobs = m_recovery.jobs();
+	}
+	m_startup_recovery_begin_ns.store(os_gettime_ns());
+	blog(LOG_INFO, "[better-markers][%s] startup recovery begin: jobs=%lld", sink_name().toUtf8().constData(),
+	     static_cast<long long>(jobs.size()));
+	if (jobs.isEmpty())
+		return;
+
+	m_startup_recovery_outstanding.fetch_add(static_cast<int>(jobs.size()));
+	for (const PendingEmbedJob &pending : jobs) {
+		const QString media_path = pending.media_path;
+		auto decision = std::make_shared<StartupRecoveryDecision>();
+		auto job_begin_ns = std::make_shared<uint64_t>(0);
+
+		EmbedExecutorJob job;
+		job.key = media_path;
+		job.group = kStartupRecoveryGroup;
+		job.device = media_device_id(media_path);
+		job.task = [this, media_path, decision, job_begin_ns](const std::atomic_bool &cancelled) {
+			*job_begin_ns = os_gettime_ns();
+			*decision = decide_startup_recovery(media_path);
+			if (decision->action != StartupRecoveryAction::RetryOnce) {
+				EmbedResult dropped;
+				dropped.ok = true;
+				return dropped;
+			}
+			QString sidecar_error;
+			if (!validate_startup_sidecar(decision.get(), &sidecar_error)) {
+				blog(LOG_WARNING, "[better-markers][%s] startup recovery sidecar rejected: %s",
+				     sink_name().toUtf8().constData(), sidecar_error.toUtf8().constData());
+				EmbedResult dropped;
+				dropped.ok = true;
+				return dropped;
+			}
+			return run_embed(media_path, decision->sidecar_path, startup_recovery_retry_attempts(), 0, 0,
+					 &cancelled);
+		};
+		job.on_complete = [this, decision, job_begin_ns](const QString &key, const EmbedResult &result) {
+			on_startup_recovery_job_complete(key, *decision, result, *job_begin_ns);
+		};
+
+		const EmbedSubmitResult submitted = m_executor.submit(std::move(job));
+		if (submitted == EmbedSubmitResult::QueueFull || submitted == EmbedSubmitResult::Stopped) {
+			// The job stays in pending-embed.json and is picked up on the next start.
+			blog(LOG_WARNING, "[better-markers][%s] startup recovery deferred '%s': %s",
+			     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+			     embed_submit_result_name(submitted));
+			on_startup_recovery_job_complete(media_path, StartupRecoveryDecision{}, EmbedResult{}, 0);
+		}
+	}
+}
+
+inline void PremiereXmpSink::on_startup_recovery_job_complete(const QString &media_path,
+							      const StartupRecoveryDecision &decision,
+							      const EmbedResult &result, uint64_t job_begin_ns)
+{
+	const unsigned long long elapsed_ms =
+		job_begin_ns ? static_cast<unsigned long long>((os_gettime_ns() - job_begin_ns) / 1000000ULL) : 0ULL;
+
+	if (job_begin_ns == 0 || result.cancelled) {
+		// Cancelled or rejected: leave the persisted job untouched for the next start.
+	} else if (decision.action != StartupRecoveryAction::RetryOnce) {
+		{
+			std::lock_guard<std::mutex> lock(m_recovery_mutex);
+			remove_job_and_save_locked(media_path);
+		}
+		blog(LOG_INFO, "[better-markers][%s] startup recovery dropped stale job: '%s' action=%s (%llu ms)",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+		     startup_recovery_action_name(decision.action), elapsed_ms);
+	} else if (result.ok) {
+		{
+			std::lock_guard<std::mutex> lock(m_recovery_mutex);
+			remove_job_and_save_locked(media_path);
+		}
+		blog(LOG_INFO,
+		     "[better-markers][%s] startup recovery success: '%s' mode=%s copy=%s bytes=%llu "
+		     "resumed=%llu rate=%.1f MB/s (%llu ms)",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+		     embed_write_mode_name(result.write_mode), copy_strategy_name(result.copy_strategy),
+		     static_cast<unsigned long long>(result.bytes_written),
+		     static_cast<unsigned long long>(result.resumed_bytes), embed_rate_mib_s(result), elapsed_ms);
+	} else {
+		{
+			std::lock_guard<std::mutex> lock(m_recovery_mutex);
+			upsert_job_and_save_locked(media_path, result.error);
+		}
+		blog(LOG_WARNING, "[better-markers][%s] startup recovery failed: '%s' error='%s' (%llu ms)",
+		     sink_name().toUtf8().constData(), media_path.toUtf8().constData(),
+		     result.error.toUtf8().constData(), elapsed_ms);
+	}
+
+	if (m_startup_recovery_outstanding.fetch_sub(1) == 1)
+		blog(LOG_INFO, "[better-markers][%s] startup recovery complete (%llu ms)",
+		     sink_name().toUtf8().constData(),
+		     static_cast<unsigned long long>((os_gettime_ns() - m_startup_recovery_begin_ns.load()) /
+						     1000000ULL));
 }
 
 inline void PremiereXmpSink::stop_startup_recovery()
 {
-	m_stop_startup_recovery.store(true);
-	if (m_startup_recovery_thread.joinable())
-		m_startup_recovery_thread.join();
-	m_startup_recovery_running.store(false);
+	m_executor.cancel_group(kStartupRecoveryGroup);
+}
+
+inline void PremiereXmpSink::remove_orphaned_temp_copies(const QStringList &recording_directories)
+{
+	QStringList pending_media_paths;
+	{
+		std::lock_guard<std::mutex> lock(m_recovery_mutex);
+		for (const PendingEmbedJob &job : m_recovery.jobs())
+			pending_media_paths.push_back(job.media_path);
+	}
+
+	QStringList directories;
+	for (const QString &directory : recording_directories)
+		directories.push_back(QDir(directory).absolutePath());
+	for (const QString &media_path : pending_media_paths)
+		directories.push_back(QFileInfo(media_path).absolutePath());
+	directories.removeDuplicates();
+
+	for (const QString &directory : directories) {
+		if (directory.isEmpty() || !QDir(directory).exists())
+			continue;
+		const int removed = Mp4MovEmbedEngine::remove_orphaned_temp_copies(directory, pending_media_paths);
+		if (removed > 0)
+			blog(LOG_INFO, "[better-markers][%s] removed %d orphaned embed temp files in '%s'",
+			     sink_name().toUtf8().constData(), removed, directory.toUtf8().constData());
+	}
 }
 
 inline bool PremiereXmpSink::load_recovery_queue_locked()
@@ -164,65 +415,4 @@ inline void PremiereXmpSink::upsert_job_and_save_locked(const QString &media_pat
 		     sink_name().toUtf8().constData());
 }
 
-inline void PremiereXmpSink::run_startup_recovery_worker()
-{
-	const uint64_t begin_ns = os_gettime_ns();
-	QVector<PendingEmbedJob> jobs;
-	{
-		std::lock_guard<std::mutex> lock(m_recovery_mutex);
-		jobs = m_recovery.jobs();
-	}
-	blog(LOG_INFO, "[better-markers][%s] startup recovery begin: jobs=%lld", sink_name().toUtf8().constData(),
-	     static_cast<long long>(jobs.size()));
-
-	for (const PendingEmbedJob &job : jobs) {
-		if (m_stop_startup_recovery.load())
-			break;
-
-		const uint64_t job_begin_ns = os_gettime_ns();
-		const StartupRecoveryDecision decision = decide_startup_recovery(job.media_path);
-		if (decision.action != StartupRecoveryAction::RetryOnce) {
-			{
-				std::lock_guard<std::mutex> lock(m_recovery_mutex);
-				remove_job_and_save_locked(job.media_path);
-			}
-			blog(LOG_INFO,
-			     "[better-markers][%s] startup recovery dropped stale job: '%s' action=%s (%llu ms)",
-			     sink_name().toUtf8().constData(), job.media_path.toUtf8().constData(),
-			     startup_recovery_action_name(decision.action),
-			     static_cast<unsigned long long>((os_gettime_ns() - job_begin_ns) / 1000000ULL));
-			continue;
-		}
-
-		EmbedResult result;
-		{
-			std::lock_guard<std::mutex> embed_lock(m_embed_mutex);
-			result = m_embed_engine.embed_from_sidecar_with_retry(job.media_path, decision.sidecar_path,
-									      startup_recovery_retry_attempts(), 0, 0);
-		}
-		if (result.ok) {
-			{
-				std::lock_guard<std::mutex> lock(m_recovery_mutex);
-				remove_job_and_save_locked(job.media_path);
-			}
-			blog(LOG_INFO, "[better-markers][%s] startup recovery success: '%s' (%llu ms)",
-			     sink_name().toUtf8().constData(), job.media_path.toUtf8().constData(),
-			     static_cast<unsigned long long>((os_gettime_ns() - job_begin_ns) / 1000000ULL));
-		} else {
-			{
-				std::lock_guard<std::mutex> lock(m_recovery_mutex);
-				upsert_job_and_save_locked(job.media_path, result.error);
-			}
-			blog(LOG_WARNING, "[better-markers][%s] startup recovery failed: '%s' error='%s' (%llu ms)",
-			     sink_name().toUtf8().constData(), job.media_path.toUtf8().constData(),
-			     result.error.toUtf8().constData(),
-			     static_cast<unsigned long long>((os_gettime_ns() - job_begin_ns) / 1000000ULL));
-		}
-	}
-
-	m_startup_recovery_running.store(false);
-	blog(LOG_INFO, "[better-markers][%s] startup recovery complete (%llu ms)", sink_name().toUtf8().constData(),
-	     static_cast<unsigned long long>((os_gettime_ns() - begin_ns) / 1000000ULL));
-}
-
 } // namespace bm
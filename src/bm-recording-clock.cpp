@@ -0,0 +1,103 @@
+#include "bm-recording-clock.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace bm {
+namespace {
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+constexpr int64_t kMinPacketDriftFrames = 30;
+constexpr uint64_t kPacketDriftSeconds = 3;
+
+int64_t to_frame(uint64_t frame)
+{
+	return static_cast<int64_t>(std::min<uint64_t>(frame, std::numeric_limits<int64_t>::max()));
+}
+
+} // namespace
+
+namespace recording_clock_detail {
+
+uint64_t mul_div_floor_portable(uint64_t a, uint64_t b, uint64_t c)
+{
+	const uint64_t a_low = a & 0xffffffffu;
+	const uint64_t a_high = a >> 32;
+	const uint64_t b_low = b & 0xffffffffu;
+	const uint64_t b_high = b >> 32;
+	const uint64_t low_low = a_low * b_low;
+	const uint64_t high_low = a_high * b_low;
+	const uint64_t low_high = a_low * b_high;
+	const uint64_t cross = (low_low >> 32) + (high_low & 0xffffffffu) + low_high;
+	const uint64_t high = a_high * b_high + (high_low >> 32) + (cross >> 32);
+	const uint64_t low = (cross << 32) | (low_low & 0xffffffffu);
+	if (high >= c)
+		return std::numeric_limits<uint64_t>::max();
+
+	// The high word is already below c, so the quotient fits in 64 bits.
+	uint64_t remainder = high;
+	uint64_t quotient = 0;
+	for (int bit = 63; bit >= 0; --bit) {
+		const bool carry = (remainder >> 63) != 0;
+		remainder = (remainder << 1) | ((low >> bit) & 1);
+		quotient <<= 1;
+		if (carry || remainder >= c) {
+			remainder -= c;
+			quotient |= 1;
+		}
+	}
+	return quotient;
+}
+
+} // namespace recording_clock_detail
+
+uint64_t mul_div_floor(uint64_t a, uint64_t b, uint64_t c)
+{
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 quotient = static_cast<unsigned __int128>(a) * b / c;
+	if (quotient > std::numeric_limits<uint64_t>::max())
+		return std::numeric_limits<uint64_t>::max();
+	return static_cast<uint64_t>(quotient);
+#else
+	return recording_clock_detail::mul_div_floor_portable(a, b, c);
+#endif
+}
+
+uint64_t mul_div_ceil(uint64_t a, uint64_t b, uint64_t c)
+{
+	const uint64_t quotient = mul_div_floor(a, b, c);
+	if (quotient == std::numeric_limits<uint64_t>::max())
+		return quotient;
+	// quotient * c never exceeds a * b, and reaches it exactly when the division was exact.
+	return mul_div_floor(quotient, c, b) == a ? quotient : quotient + 1;
+}
+
+int64_t wall_clock_frame_at(const RecordingClockState &state, uint64_t now_ns)
+{
+	if (state.fps_num == 0 || state.fps_den == 0 || now_ns <= state.start_ns)
+		return 0;
+
+	uint64_t paused_ns = state.total_paused_ns;
+	if (state.paused && state.pause_start_ns != 0 && now_ns > state.pause_start_ns)
+		paused_ns += now_ns - state.pause_start_ns;
+
+	const uint64_t elapsed_ns = now_ns - state.start_ns;
+	const uint64_t active_ns = elapsed_ns > paused_ns ? elapsed_ns - paused_ns : 0;
+	return to_frame(mul_div_floor(active_ns, state.fps_num, state.fps_den * kNsPerSecond));
+}
+
+bool within_packet_drift(const RecordingClockState &state, int64_t wall_clock_frame, int64_t packet_frame)
+{
+	if (state.fps_num == 0 || state.fps_den == 0)
+		return false;
+
+	// Three seconds of frames, rounded to nearest.
+	const uint64_t fps_den = state.fps_den;
+	const uint64_t drift_frames = (2 * kPacketDriftSeconds * state.fps_num + fps_den) / (2 * fps_den);
+	const int64_t max_drift = std::max<int64_t>(kMinPacketDriftFrames, to_frame(drift_frames));
+	const int64_t drift = packet_frame > wall_clock_frame ? packet_frame - wall_clock_frame
+							       : wall_clock_frame - packet_frame;
+	return drift <= max_drift;
+}
+
+} // namespace bm
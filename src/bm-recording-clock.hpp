@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+namespace bm {
+
+// Timing of the recording in progress, as RecordingSessionTracker publishes it. Trivially copyable so it can be read
+// through a Seqlock.
+struct RecordingClockState {
+	bool active = false;
+	bool paused = false;
+	uint64_t start_ns = 0;
+	// Start of the pause in progress, or 0.
+	uint64_t pause_start_ns = 0;
+	// Pauses already ended.
+	uint64_t total_paused_ns = 0;
+	uint32_t fps_num = 30;
+	uint32_t fps_den = 1;
+};
+
+// floor(a * b / c) from the exact 128-bit product; saturates at UINT64_MAX when the quotient does not fit. c must not
+// be zero.
+uint64_t mul_div_floor(uint64_t a, uint64_t b, uint64_t c);
+// ceil(a * b / c), saturating the same way. b and c must not be zero.
+uint64_t mul_div_ceil(uint64_t a, uint64_t b, uint64_t c);
+
+// The pause-adjusted wall clock's frame at now_ns.
+int64_t wall_clock_frame_at(const RecordingClockState &state, uint64_t now_ns);
+
+// Whether a frame taken from the video packets is within about three seconds (at least 30 frames) of the wall clock's.
+// One further off is stale, or from before a restart, and is ignored.
+bool within_packet_drift(const RecordingClockState &state, int64_t wall_clock_frame, int64_t packet_frame);
+
+namespace recording_clock_detail {
+
+// mul_div_floor without a native 128-bit type (MSVC): a multiply from 32-bit halves and a restoring division.
+uint64_t mul_div_floor_portable(uint64_t a, uint64_t b, uint64_t c);
+
+} // namespace recording_clock_detail
+
+} // namespace bm
@@ -5,9 +5,6 @@
 
 #include <QFileInfo>
 
-#include <algorithm>
-#include <cmath>
-
 namespace bm {
 namespace {
 
@@ -20,6 +17,24 @@ bool looks_like_media_file_path(const QString &path)
 	return !info.isDir();
 }
 
+// Counts a reader from before it loads the published state until it has copied the path out of it.
+class PublishedPathReader {
+public:
+	explicit PublishedPathReader(std::atomic<int> &readers) : m_readers(readers)
+	{
+		m_readers.fetch_add(1);
+		// Pairs with the fence in publish_locked: either it sees this reader or this reader sees its store.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	~PublishedPathReader() { m_readers.fetch_sub(1, std::memory_order_release); }
+
+	PublishedPathReader(const PublishedPathReader &) = delete;
+	PublishedPathReader &operator=(const PublishedPathReader &) = delete;
+
+private:
+	std::atomic<int> &m_readers;
+};
+
 } // namespace
 
 RecordingSessionTracker::~RecordingSessionTracker()
@@ -68,32 +83,42 @@ void RecordingSessionTracker::handle_frontend_event(enum obs_frontend_event even
 void RecordingSessionTracker::shutdown()
 {
 	detach_output_hooks();
+	detach_render_clock();
+}
+
+void RecordingSessionTracker::set_render_clock_enabled(bool enabled)
+{
+	m_render_clock_enabled.store(enabled);
+	if (!enabled)
+		detach_render_clock();
+	else if (is_recording_active())
+		attach_render_clock();
 }
 
 bool RecordingSessionTracker::is_recording_active() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_recording_active;
+	return m_published.load().clock.active;
 }
 
 bool RecordingSessionTracker::is_recording_paused() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_recording_paused;
+	return m_published.load().clock.paused;
 }
 
 bool RecordingSessionTracker::can_add_marker() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_recording_active && !m_recording_paused;
+	const RecordingClockState clock = m_published.load().clock;
+	return clock.active && !clock.paused;
 }
 
 QString RecordingSessionTracker::current_media_path()
 {
+	PublishedState published;
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		if (looks_like_media_file_path(m_current_media_path))
-			return m_current_media_path;
+		const PublishedPathReader reader(m_path_readers);
+		published = m_published.load();
+		if (published.media_path_valid)
+			return *published.media_path;
 	}
 
 	const QString resolved = query_current_recording_path();
@@ -101,68 +126,79 @@ QString RecordingSessionTracker::current_media_path()
 		return {};
 
 	std::lock_guard<std::mutex> lock(m_mutex);
-	m_current_media_path = resolved;
+	// A file change may have published a path while OBS was queried; it wins over the older query.
+	if (m_media_path_generation == published.media_path_generation) {
+		set_media_path_locked(resolved);
+		publish_locked();
+	}
 	return m_current_media_path;
 }
 
 uint32_t RecordingSessionTracker::fps_num() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_fps_num;
+	return m_published.load().clock.fps_num;
 }
 
 uint32_t RecordingSessionTracker::fps_den() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_fps_den;
+	return m_published.load().clock.fps_den;
 }
 
 int64_t RecordingSessionTracker::capture_frame_now() const
 {
-	const int64_t latest_dts_usec = m_latest_video_dts_usec.load();
-
-	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_fps_den == 0)
-		return 0;
+	return frame_at(m_published.load().clock, os_gettime_ns()).frame;
+}
 
+RecordingCapture RecordingSessionTracker::capture()
+{
 	const uint64_t now_ns = os_gettime_ns();
-	uint64_t paused_ns = m_total_paused_ns;
-	if (m_recording_paused && m_pause_start_ns != 0 && now_ns > m_pause_start_ns)
-		paused_ns += now_ns - m_pause_start_ns;
-
-	int64_t monotonic_frame = 0;
-	if (now_ns > m_recording_start_ns) {
-		const uint64_t active_ns = (now_ns - m_recording_start_ns > paused_ns) ? (now_ns - m_recording_start_ns - paused_ns)
-										      : 0;
-		const long double numerator = static_cast<long double>(active_ns) * m_fps_num;
-		const long double denominator = static_cast<long double>(m_fps_den) * 1000000000.0L;
-		const auto frame = static_cast<int64_t>(numerator / denominator);
-		monotonic_frame = frame < 0 ? 0 : frame;
-	}
+	const PublishedPathReader reader(m_path_readers);
+	const PublishedState published = m_published.load();
+	if (!published.clock.active || published.clock.paused)
+		return {};
 
-	if (latest_dts_usec >= 0) {
-		const long double numerator = static_cast<long double>(latest_dts_usec) * m_fps_num;
-		const long double denominator = static_cast<long double>(m_fps_den) * 1000000.0L;
-		const int64_t packet_frame = std::max<int64_t>(0, static_cast<int64_t>(numerator / denominator));
+	RecordingCapture capture = frame_at(published.clock, now_ns);
+	capture.can_add_marker = true;
+	capture.media_path = published.media_path_valid ? *published.media_path : current_media_path();
+	return capture;
+}
 
-		const long double fps = static_cast<long double>(m_fps_num) / static_cast<long double>(m_fps_den);
-		const int64_t max_packet_drift = std::max<int64_t>(30, static_cast<int64_t>(std::llround(fps * 3.0L)));
-		if (std::llabs(packet_frame - monotonic_frame) <= max_packet_drift)
-			return packet_frame;
+RecordingCapture RecordingSessionTracker::frame_at(const RecordingClockState &clock, uint64_t now_ns) const
+{
+	RecordingCapture capture;
+	uint64_t trigger_ns = now_ns;
+	if (m_render_clock_enabled.load(std::memory_order_relaxed))
+		capture.rendered_frame = rendered_frame_midpoint(m_render_clock.load(), now_ns, clock.fps_num,
+								 clock.fps_den, &trigger_ns);
+
+	capture.frame = wall_clock_frame_at(clock, trigger_ns);
+	const PacketFrameEstimate estimate = m_packets.estimate(trigger_ns, clock.fps_num, clock.fps_den);
+	if (estimate.valid && within_packet_drift(clock, capture.frame, estimate.frame)) {
+		capture.frame = estimate.frame;
+		capture.frame_error = estimate.error_frames;
+		capture.timing_source =
+			estimate.latency_measured ? FrameTimingSource::ComposedPackets : FrameTimingSource::Packets;
 	}
-
-	return monotonic_frame;
+	return capture;
 }
 
-void RecordingSessionTracker::packet_callback(obs_output_t *, struct encoder_packet *pkt, struct encoder_packet_time *,
-					      void *param)
+void RecordingSessionTracker::packet_callback(obs_output_t *, struct encoder_packet *pkt,
+					      struct encoder_packet_time *pkt_time, void *param)
 {
 	auto *self = static_cast<RecordingSessionTracker *>(param);
-	if (!self || !pkt)
+	if (!self || !pkt || pkt->type != OBS_ENCODER_VIDEO)
+		return;
+	if (pkt->pts < 0 || pkt->timebase_num <= 0 || pkt->timebase_den <= 0)
 		return;
 
-	if (pkt->type == OBS_ENCODER_VIDEO)
-		self->m_latest_video_dts_usec.store(pkt->dts_usec);
+	PacketSample sample;
+	sample.dts_usec = pkt->dts_usec;
+	sample.pts_ns = mul_div_ceil(static_cast<uint64_t>(pkt->pts),
+				     static_cast<uint64_t>(pkt->timebase_num) * 1000000000u,
+				     static_cast<uint64_t>(pkt->timebase_den));
+	sample.received_ns = os_gettime_ns();
+	sample.composed_ns = pkt_time ? pkt_time->cts : 0;
+	self->m_packets.record(sample);
 }
 
 void RecordingSessionTracker::file_changed_signal(void *param, calldata_t *data)
@@ -179,11 +215,12 @@ void RecordingSessionTracker::file_changed_signal(void *param, calldata_t *data)
 	{
 		std::lock_guard<std::mutex> lock(self->m_mutex);
 		closed_file = self->m_current_media_path;
-		self->m_current_media_path = next_file;
+		self->set_media_path_locked(next_file);
+		self->publish_locked();
 		callback = self->m_file_changed_cb;
 	}
 
-	self->m_latest_video_dts_usec.store(-1);
+	self->m_packets.reset();
 
 	if (callback && !closed_file.isEmpty())
 		callback(closed_file, next_file);
@@ -197,6 +234,7 @@ void RecordingSessionTracker::on_recording_started()
 		ovi.fps_den = 1;
 	}
 
+	QString started_file;
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
 		m_recording_active = true;
@@ -206,13 +244,17 @@ void RecordingSessionTracker::on_recording_started()
 		m_total_paused_ns = 0;
 		m_fps_num = ovi.fps_num == 0 ? 30 : ovi.fps_num;
 		m_fps_den = ovi.fps_den == 0 ? 1 : ovi.fps_den;
-		m_current_media_path = query_current_recording_path();
+		set_media_path_locked(query_current_recording_path());
+		publish_locked();
+		started_file = m_current_media_path;
 	}
 
-	m_latest_video_dts_usec.store(-1);
+	m_packets.reset();
 	attach_output_hooks();
+	if (m_render_clock_enabled.load())
+		attach_render_clock();
 
-	blog(LOG_INFO, "[better-markers] recording started: %s", m_current_media_path.toUtf8().constData());
+	blog(LOG_INFO, "[better-markers] recording started: %s", started_file.toUtf8().constData());
 }
 
 void RecordingSessionTracker::on_recording_stopped()
@@ -227,11 +269,13 @@ void RecordingSessionTracker::on_recording_stopped()
 		m_recording_paused = false;
 		m_pause_start_ns = 0;
 		m_total_paused_ns = 0;
-		m_current_media_path.clear();
+		set_media_path_locked(QString());
+		publish_locked();
 	}
 
-	m_latest_video_dts_usec.store(-1);
+	m_packets.reset();
 	detach_output_hooks();
+	detach_render_clock();
 
 	if (cb && !closed_file.isEmpty())
 		cb(closed_file);
@@ -257,6 +301,9 @@ void RecordingSessionTracker::on_recording_paused(bool paused)
 			m_pause_start_ns = 0;
 		}
 	}
+	// pts carries on across a pause while the render clock does not; older packets would misplace markers.
+	m_packets.reset();
+	publish_locked();
 }
 
 void RecordingSessionTracker::attach_output_hooks()
@@ -290,6 +337,49 @@ void RecordingSessionTracker::detach_output_hooks()
 	m_output = nullptr;
 }
 
+void RecordingSessionTracker::render_tick(void *param, float)
+{
+	auto *self = static_cast<RecordingSessionTracker *>(param);
+	const uint64_t start_ns = os_gettime_ns();
+	self->m_render_clock.tick(obs_get_video_frame_time());
+	self->m_render_clock.record_callback_cost(os_gettime_ns() - start_ns);
+}
+
+void RecordingSessionTracker::attach_render_clock()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_render_clock_attached)
+		return;
+
+	m_render_clock_metrics_at_attach = m_render_clock.metrics();
+	obs_add_tick_callback(&RecordingSessionTracker::render_tick, this);
+	m_render_clock_attached = true;
+}
+
+void RecordingSessionTracker::detach_render_clock()
+{
+	RenderFrameClockMetrics attached;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_render_clock_attached)
+			return;
+
+		// No tick is running once this returns.
+		obs_remove_tick_callback(&RecordingSessionTracker::render_tick, this);
+		m_render_clock_attached = false;
+		attached = m_render_clock_metrics_at_attach;
+	}
+
+	const RenderFrameClockMetrics metrics = m_render_clock.metrics();
+	const uint64_t ticks = metrics.ticks - attached.ticks;
+	if (ticks == 0)
+		return;
+	blog(LOG_INFO, "[better-markers] render clock: %llu frames, %.0f ns mean, %llu ns peak per tick callback",
+	     static_cast<unsigned long long>(ticks),
+	     static_cast<double>(metrics.callback_ns - attached.callback_ns) / static_cast<double>(ticks),
+	     static_cast<unsigned long long>(metrics.max_callback_ns));
+}
+
 QString RecordingSessionTracker::query_current_recording_path() const
 {
 	obs_output_t *output = obs_frontend_get_recording_output();
@@ -323,4 +413,33 @@ QString RecordingSessionTracker::query_current_recording_path() const
 	return {};
 }
 
+void RecordingSessionTracker::set_media_path_locked(const QString &path)
+{
+	m_current_media_path = path;
+	m_published_paths.push_back(std::make_unique<const QString>(path));
+	++m_media_path_generation;
+}
+
+void RecordingSessionTracker::publish_locked()
+{
+	PublishedState published;
+	published.clock.active = m_recording_active;
+	published.clock.paused = m_recording_paused;
+	published.clock.start_ns = m_recording_start_ns;
+	published.clock.pause_start_ns = m_pause_start_ns;
+	published.clock.total_paused_ns = m_total_paused_ns;
+	published.clock.fps_num = m_fps_num;
+	published.clock.fps_den = m_fps_den;
+	published.media_path = m_published_paths.empty() ? nullptr : m_published_paths.back().get();
+	published.media_path_generation = m_media_path_generation;
+	// Checked once here rather than on every marker.
+	published.media_path_valid = published.media_path && looks_like_media_file_path(*published.media_path);
+	m_published.store(published);
+
+	// Readers arriving from here on load the path just published, so the older ones can go unless one is counted.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_published_paths.size() > 1 && m_path_readers.load(std::memory_order_acquire) == 0)
+		m_published_paths.erase(m_published_paths.begin(), m_published_paths.end() - 1);
+}
+
 } // namespace bm
@@ -1,16 +1,47 @@
 #pragma once
 
+#include "bm-packet-timeline.hpp"
+#include "bm-recording-clock.hpp"
+#include "bm-render-frame-clock.hpp"
+#include "bm-seqlock.hpp"
+
 #include <obs-frontend-api.h>
 #include <obs.h>
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include <QString>
 
 namespace bm {
 
+// Where a captured frame number came from.
+enum class FrameTimingSource {
+	// The pause-adjusted time since the recording started.
+	WallClock,
+	// The recent video packets; the encoder did not report its latency, so the frame may trail the screen.
+	Packets,
+	// The recent video packets, corrected by the encoder latency OBS measured.
+	ComposedPackets,
+};
+
+// What a marker trigger needs from the tracker, read at one instant.
+struct RecordingCapture {
+	bool can_add_marker = false;
+	int64_t frame = 0;
+	// Estimated error of frame, in frames; negative when it came from the wall clock and has no estimate.
+	double frame_error = -1.0;
+	FrameTimingSource timing_source = FrameTimingSource::WallClock;
+	// The trigger was stamped with the frame OBS rendered last rather than the instant it happened.
+	bool rendered_frame = false;
+	QString media_path;
+};
+
+// The recording state changes under m_mutex (frontend events, the output's file_changed signal) and is published
+// through a seqlock; every getter, and capture() on the hotkey path, reads it without a lock.
 class RecordingSessionTracker {
 public:
 	using FileChangedCallback = std::function<void(const QString &closed_file, const QString &next_file)>;
@@ -25,6 +56,8 @@ public:
 	void sync_from_frontend_state();
 	void handle_frontend_event(enum obs_frontend_event event);
 	void shutdown();
+	// Stamp markers with the frame on screen, from a per-frame tick callback hooked while recording.
+	void set_render_clock_enabled(bool enabled);
 
 	bool is_recording_active() const;
 	bool is_recording_paused() const;
@@ -35,19 +68,37 @@ public:
 	uint32_t fps_den() const;
 
 	int64_t capture_frame_now() const;
+	// One consistent read of the state for a marker trigger. Only takes the lock when the media path has not been
+	// resolved yet.
+	RecordingCapture capture();
 
 private:
 	static void packet_callback(obs_output_t *output, struct encoder_packet *pkt, struct encoder_packet_time *pkt_time,
 				    void *param);
 	static void file_changed_signal(void *param, calldata_t *data);
+	static void render_tick(void *param, float seconds);
 
 	void on_recording_started();
 	void on_recording_stopped();
 	void on_recording_paused(bool paused);
 
+	struct PublishedState {
+		RecordingClockState clock;
+		// The current media path and the number of times it changed. Readers copy it without a lock while
+		// counted in m_path_readers; a published path is never modified and only freed once none is counted.
+		const QString *media_path = nullptr;
+		uint64_t media_path_generation = 0;
+		bool media_path_valid = false;
+	};
+
+	RecordingCapture frame_at(const RecordingClockState &clock, uint64_t now_ns) const;
 	void attach_output_hooks();
 	void detach_output_hooks();
+	void attach_render_clock();
+	void detach_render_clock();
 	QString query_current_recording_path() const;
+	void set_media_path_locked(const QString &path);
+	void publish_locked();
 
 	mutable std::mutex m_mutex;
 	bool m_recording_active = false;
@@ -58,8 +109,18 @@ private:
 	uint32_t m_fps_num = 30;
 	uint32_t m_fps_den = 1;
 	QString m_current_media_path;
-
-	std::atomic<int64_t> m_latest_video_dts_usec{-1};
+	// The path published last, plus older ones a reader was still copying when a newer one was published; those go
+	// at the next publish that finds no reader.
+	std::vector<std::unique_ptr<const QString>> m_published_paths;
+	std::atomic<int> m_path_readers{0};
+	uint64_t m_media_path_generation = 0;
+	Seqlock<PublishedState> m_published;
+
+	PacketTimeline m_packets;
+	RenderFrameClock m_render_clock;
+	std::atomic<bool> m_render_clock_enabled{true};
+	bool m_render_clock_attached = false;
+	RenderFrameClockMetrics m_render_clock_metrics_at_attach;
 
 	obs_output_t *m_output = nullptr;
 	FileChangedCallback m_file_changed_cb;
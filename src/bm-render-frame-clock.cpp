@@ -0,0 +1,55 @@
+#include "bm-render-frame-clock.hpp"
+
+#include "bm-recording-clock.hpp"
+
+namespace bm {
+namespace {
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+constexpr uint64_t kMaxFrameAgeNs = kNsPerSecond;
+
+} // namespace
+
+bool rendered_frame_midpoint(const RenderTick &tick, uint64_t now_ns, uint32_t fps_num, uint32_t fps_den,
+			     uint64_t *out_ns)
+{
+	if (!out_ns || tick.frames == 0 || fps_num == 0 || fps_den == 0)
+		return false;
+	if (now_ns > tick.frame_time_ns && now_ns - tick.frame_time_ns > kMaxFrameAgeNs)
+		return false;
+
+	*out_ns = tick.frame_time_ns + mul_div_floor(fps_den, kNsPerSecond, 2ull * fps_num);
+	return true;
+}
+
+void RenderFrameClock::tick(uint64_t frame_time_ns)
+{
+	RenderTick tick;
+	tick.frames = ++m_frames;
+	tick.frame_time_ns = frame_time_ns;
+	m_tick.store(tick);
+}
+
+RenderTick RenderFrameClock::load() const
+{
+	return m_tick.load();
+}
+
+void RenderFrameClock::record_callback_cost(uint64_t callback_ns)
+{
+	// Only the graphics thread writes, so plain loads and stores keep the totals exact.
+	m_callback_ns.store(m_callback_ns.load(std::memory_order_relaxed) + callback_ns, std::memory_order_relaxed);
+	if (callback_ns > m_max_callback_ns.load(std::memory_order_relaxed))
+		m_max_callback_ns.store(callback_ns, std::memory_order_relaxed);
+}
+
+RenderFrameClockMetrics RenderFrameClock::metrics() const
+{
+	RenderFrameClockMetrics metrics;
+	metrics.ticks = m_tick.load().frames;
+	metrics.callback_ns = m_callback_ns.load(std::memory_order_relaxed);
+	metrics.max_callback_ns = m_max_callback_ns.load(std::memory_order_relaxed);
+	return metrics;
+}
+
+} // namespace bm
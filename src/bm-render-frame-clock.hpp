@@ -0,0 +1,51 @@
+#pragma once
+
+#include "bm-seqlock.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace bm {
+
+// The video frame OBS is rendering: how many frames the clock has seen and that frame's timestamp (the video clock,
+// os_gettime_ns() based).
+struct RenderTick {
+	uint64_t frames = 0;
+	uint64_t frame_time_ns = 0;
+};
+
+struct RenderFrameClockMetrics {
+	uint64_t ticks = 0;
+	uint64_t callback_ns = 0;
+	uint64_t max_callback_ns = 0;
+};
+
+// Where a trigger at now_ns lands when it is stamped with the frame on screen: the middle of the frame in tick, so a
+// composition time a little off the video clock cannot move it to a neighbour. False, leaving out_ns alone, when the
+// clock has not ticked, the rate is invalid, or the frame is over a second old (the graphics thread stalled).
+bool rendered_frame_midpoint(const RenderTick &tick, uint64_t now_ns, uint32_t fps_num, uint32_t fps_den,
+			     uint64_t *out_ns);
+
+// Published once per video frame from OBS's tick callback on the graphics thread (one writer); load() from any thread
+// without a lock.
+class RenderFrameClock {
+public:
+	RenderFrameClock() = default;
+	RenderFrameClock(const RenderFrameClock &) = delete;
+	RenderFrameClock &operator=(const RenderFrameClock &) = delete;
+
+	void tick(uint64_t frame_time_ns);
+	RenderTick load() const;
+
+	// Time the tick callback took, measured by the caller around tick().
+	void record_callback_cost(uint64_t callback_ns);
+	RenderFrameClockMetrics metrics() const;
+
+private:
+	Seqlock<RenderTick> m_tick;
+	uint64_t m_frames = 0;
+	std::atomic<uint64_t> m_callback_ns{0};
+	std::atomic<uint64_t> m_max_callback_ns{0};
+};
+
+} // namespace bm
@@ -9,7 +9,7 @@ class ResolveFcpxmlSink : public MarkerExportSink {
 public:
 	QString sink_name() const override;
 	bool on_marker_added(const MarkerExportRecordingContext &recording_ctx, const MarkerRecord &marker,
-			     const QVector<MarkerRecord> &full_marker_list, QString *error) override;
+			     const MarkerList &full_marker_list, QString *error) override;
 	bool on_recording_closed(const MarkerExportRecordingContext &recording_ctx, QString *error) override;
 
 private:
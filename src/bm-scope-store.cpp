@@ -73,6 +73,7 @@ bool ScopeStore::load_global()
 	m_skipped_update_tag = json_obj.value("skippedUpdateTag").toString();
 	m_auto_focus_marker_dialog = json_obj.value("autoFocusMarkerDialog").toBool(true);
 	m_pause_recording_during_marker_dialog = json_obj.value("pauseRecordingDuringMarkerDialog").toBool(true);
+	m_stamp_markers_with_rendered_frame = json_obj.value("stampMarkersWithRenderedFrame").toBool(true);
 	m_synthetic_keypress_around_focus_enabled = json_obj.value("syntheticKeypressAroundFocusEnabled").toBool(false);
 	m_synthetic_keypress_before_focus_portable = json_obj.value("syntheticKeypressBeforeFocus").toString("Esc");
 	m_synthetic_keypress_after_unfocus_portable = json_obj.value("syntheticKeypressAfterUnfocus").toString("Esc");
@@ -86,6 +87,7 @@ bool ScopeStore::save_global() const
 	root.insert("skippedUpdateTag", m_skipped_update_tag);
 	root.insert("autoFocusMarkerDialog", m_auto_focus_marker_dialog);
 	root.insert("pauseRecordingDuringMarkerDialog", m_pause_recording_during_marker_dialog);
+	root.insert("stampMarkersWithRenderedFrame", m_stamp_markers_with_rendered_frame);
 	root.insert("syntheticKeypressAroundFocusEnabled", m_synthetic_keypress_around_focus_enabled);
 	root.insert("syntheticKeypressBeforeFocus", m_synthetic_keypress_before_focus_portable);
 	root.insert("syntheticKeypressAfterUnfocus", m_synthetic_keypress_after_unfocus_portable);
@@ -209,6 +211,16 @@ void ScopeStore::set_pause_recording_during_marker_dialog(bool enabled)
 	m_pause_recording_during_marker_dialog = enabled;
 }
 
+bool ScopeStore::stamp_markers_with_rendered_frame() const
+{
+	return m_stamp_markers_with_rendered_frame;
+}
+
+void ScopeStore::set_stamp_markers_with_rendered_frame(bool enabled)
+{
+	m_stamp_markers_with_rendered_frame = enabled;
+}
+
 bool ScopeStore::synthetic_keypress_around_focus_enabled() const
 {
 	return m_synthetic_keypress_around_focus_enabled;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace bm {
+
+// Sequence lock for a small trivially copyable value: load() never blocks a writer and never takes a lock, it retries
+// while a store is in progress and returns a copy no store was half-way through. The value is kept in relaxed atomic
+// words, so a racing read is well-defined and simply discarded. Stores must be serialized by the caller.
+template<typename T> class Seqlock {
+	static_assert(std::is_trivially_copyable<T>::value, "Seqlock values are copied word by word");
+
+public:
+	Seqlock() { store(T()); }
+	explicit Seqlock(const T &value) { store(value); }
+
+	Seqlock(const Seqlock &) = delete;
+	Seqlock &operator=(const Seqlock &) = delete;
+
+	void store(const T &value)
+	{
+		uint64_t words[kWords] = {};
+		std::memcpy(words, &value, sizeof(T));
+		const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < kWords; ++i)
+			m_words[i].store(words[i], std::memory_order_relaxed);
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	T load() const
+	{
+		uint64_t words[kWords];
+		for (;;) {
+			const uint64_t before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (size_t i = 0; i < kWords; ++i)
+				words[i] = m_words[i].load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequence.load(std::memory_order_relaxed) == before)
+				break;
+		}
+		T value;
+		std::memcpy(&value, words, sizeof(T));
+		return value;
+	}
+
+private:
+	static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	// Odd while a store is in progress.
+	std::atomic<uint64_t> m_sequence{0};
+	std::atomic<uint64_t> m_words[kWords];
+};
+
+} // namespace bm
@@ -19,8 +19,10 @@
 #include <QKeySequenceEdit>
 #include <QKeySequence>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QGroupBox>
 #include <QSignalBlocker>
+#include <QSpinBox>
 #include <QtGlobal>
 #include <QUrl>
 #include <QVBoxLayout>
@@ -128,6 +130,115 @@ SettingsDialog::SettingsDialog(ScopeStore *store, QWidget *parent) : QDialog(par
 
 	main_layout->addWidget(export_targets_group);
 
+	auto *live_exports_group = new QGroupBox(bm_text("BetterMarkers.Settings.LiveExports"), this);
+	auto *live_exports_layout = new QHBoxLayout(live_exports_group);
+	live_exports_layout->setContentsMargins(10, 8, 10, 8);
+	live_exports_layout->setSpacing(12);
+
+	m_edl_toggle = new QCheckBox(bm_text("BetterMarkers.Settings.ExportEdlLabel"), live_exports_group);
+	m_edl_toggle->setToolTip(bm_text("BetterMarkers.Settings.ExportEdlHint"));
+	live_exports_layout->addWidget(m_edl_toggle);
+	live_exports_layout->addSpacing(18);
+
+	m_csv_toggle = new QCheckBox(bm_text("BetterMarkers.Settings.ExportCsvLabel"), live_exports_group);
+	m_csv_toggle->setToolTip(bm_text("BetterMarkers.Settings.ExportCsvHint"));
+	live_exports_layout->addWidget(m_csv_toggle);
+	live_exports_layout->addSpacing(18);
+
+	m_chapters_toggle = new QCheckBox(bm_text("BetterMarkers.Settings.ExportChaptersLabel"), live_exports_group);
+	m_chapters_toggle->setToolTip(bm_text("BetterMarkers.Settings.ExportChaptersHint"));
+	live_exports_layout->addWidget(m_chapters_toggle);
+	live_exports_layout->addStretch(1);
+
+	main_layout->addWidget(live_exports_group);
+
+	auto *export_writes_group = new QGroupBox(bm_text("BetterMarkers.Settings.ExportWrites"), this);
+	auto *export_writes_form = new QFormLayout(export_writes_group);
+	export_writes_form->setContentsMargins(10, 8, 10, 8);
+	export_writes_form->setHorizontalSpacing(12);
+	m_write_cadence_combo = new QComboBox(export_writes_group);
+	m_write_cadence_combo->addItem(bm_text("BetterMarkers.Settings.WriteCadenceImmediate"),
+				       export_write_cadence_to_key(ExportWriteCadence::Immediate));
+	m_write_cadence_combo->addItem(bm_text("BetterMarkers.Settings.WriteCadenceDebounced"),
+				       export_write_cadence_to_key(ExportWriteCadence::Debounced));
+	m_write_cadence_combo->addItem(bm_text("BetterMarkers.Settings.WriteCadenceInterval"),
+				       export_write_cadence_to_key(ExportWriteCadence::Interval));
+	m_write_cadence_combo->addItem(bm_text("BetterMarkers.Settings.WriteCadenceOnRecordingClose"),
+				       export_write_cadence_to_key(ExportWriteCadence::OnRecordingClose));
+	m_write_cadence_combo->setToolTip(bm_text("BetterMarkers.Settings.WriteCadenceHint"));
+	export_writes_form->addRow(bm_text("BetterMarkers.Settings.WriteCadenceLabel"), m_write_cadence_combo);
+	m_write_cadence_ms_spin = new QSpinBox(export_writes_group);
+	m_write_cadence_ms_spin->setRange(kMinWriteCadenceMs, kMaxWriteCadenceMs);
+	m_write_cadence_ms_spin->setSingleStep(250);
+	m_write_cadence_ms_spin->setSuffix(" ms");
+	m_write_cadence_ms_spin->setToolTip(bm_text("BetterMarkers.Settings.WriteCadenceDelayHint"));
+	export_writes_form->addRow(bm_text("BetterMarkers.Settings.WriteCadenceDelayLabel"), m_write_cadence_ms_spin);
+	m_artifact_durability_combo = new QComboBox(export_writes_group);
+	m_artifact_durability_combo->addItem(bm_text("BetterMarkers.Settings.ArtifactDurabilityStrict"),
+					     artifact_durability_to_key(ArtifactDurability::Strict));
+	m_artifact_durability_combo->addItem(bm_text("BetterMarkers.Settings.ArtifactDurabilityGrouped"),
+					     artifact_durability_to_key(ArtifactDurability::Grouped));
+	m_artifact_durability_combo->addItem(bm_text("BetterMarkers.Settings.ArtifactDurabilityDeferred"),
+					     artifact_durability_to_key(ArtifactDurability::Deferred));
+	m_artifact_durability_combo->setToolTip(bm_text("BetterMarkers.Settings.ArtifactDurabilityHint"));
+	export_writes_form->addRow(bm_text("BetterMarkers.Settings.ArtifactDurabilityLabel"),
+				   m_artifact_durability_combo);
+	m_artifact_sync_window_spin = new QSpinBox(export_writes_group);
+	m_artifact_sync_window_spin->setRange(kMinArtifactSyncWindowMs, kMaxArtifactSyncWindowMs);
+	m_artifact_sync_window_spin->setSingleStep(500);
+	m_artifact_sync_window_spin->setSuffix(" ms");
+	m_artifact_sync_window_spin->setToolTip(bm_text("BetterMarkers.Settings.ArtifactSyncWindowHint"));
+	export_writes_form->addRow(bm_text("BetterMarkers.Settings.ArtifactSyncWindowLabel"),
+				   m_artifact_sync_window_spin);
+	main_layout->addWidget(export_writes_group);
+
+	auto *premiere_embed_group = new QGroupBox(bm_text("BetterMarkers.Settings.PremiereEmbed"), this);
+	auto *premiere_embed_form = new QFormLayout(premiere_embed_group);
+	premiere_embed_form->setContentsMargins(10, 8, 10, 8);
+	premiere_embed_form->setHorizontalSpacing(12);
+	m_embed_writer_combo = new QComboBox(premiere_embed_group);
+	m_embed_writer_combo->addItem(bm_text("BetterMarkers.Settings.EmbedWriterNative"),
+				      premiere_embed_writer_to_key(PremiereEmbedWriter::Native));
+	m_embed_writer_combo->addItem(bm_text("BetterMarkers.Settings.EmbedWriterNativeWithFallback"),
+				      premiere_embed_writer_to_key(PremiereEmbedWriter::NativeWithExifToolFallback));
+	m_embed_writer_combo->addItem(bm_text("BetterMarkers.Settings.EmbedWriterExifTool"),
+				      premiere_embed_writer_to_key(PremiereEmbedWriter::ExifTool));
+	m_embed_writer_combo->setToolTip(bm_text("BetterMarkers.Settings.EmbedWriterHint"));
+	premiere_embed_form->addRow(bm_text("BetterMarkers.Settings.EmbedWriterLabel"), m_embed_writer_combo);
+	m_embed_max_concurrency_spin = new QSpinBox(premiere_embed_group);
+	m_embed_max_concurrency_spin->setRange(1, kMaxEmbedConcurrency);
+	m_embed_max_concurrency_spin->setToolTip(bm_text("BetterMarkers.Settings.EmbedMaxConcurrencyHint"));
+	premiere_embed_form->addRow(bm_text("BetterMarkers.Settings.EmbedMaxConcurrencyLabel"),
+				    m_embed_max_concurrency_spin);
+	m_embed_per_device_concurrency_spin = new QSpinBox(premiere_embed_group);
+	m_embed_per_device_concurrency_spin->setRange(1, kMaxEmbedConcurrency);
+	m_embed_per_device_concurrency_spin->setToolTip(
+		bm_text("BetterMarkers.Settings.EmbedPerDeviceConcurrencyHint"));
+	premiere_embed_form->addRow(bm_text("BetterMarkers.Settings.EmbedPerDeviceConcurrencyLabel"),
+				    m_embed_per_device_concurrency_spin);
+	m_embed_io_mode_combo = new QComboBox(premiere_embed_group);
+	m_embed_io_mode_combo->addItem(bm_text("BetterMarkers.Settings.EmbedIoModePageCache"),
+				       premiere_embed_io_mode_to_key(PremiereEmbedIoMode::PageCache));
+	m_embed_io_mode_combo->addItem(bm_text("BetterMarkers.Settings.EmbedIoModeStreaming"),
+				       premiere_embed_io_mode_to_key(PremiereEmbedIoMode::Streaming));
+	m_embed_io_mode_combo->addItem(bm_text("BetterMarkers.Settings.EmbedIoModeDirect"),
+				       premiere_embed_io_mode_to_key(PremiereEmbedIoMode::Direct));
+	m_embed_io_mode_combo->setToolTip(bm_text("BetterMarkers.Settings.EmbedIoModeHint"));
+	premiere_embed_form->addRow(bm_text("BetterMarkers.Settings.EmbedIoModeLabel"), m_embed_io_mode_combo);
+	m_embed_max_throughput_spin = new QSpinBox(premiere_embed_group);
+	m_embed_max_throughput_spin->setRange(0, kMaxEmbedThroughputMiBs);
+	m_embed_max_throughput_spin->setSingleStep(50);
+	m_embed_max_throughput_spin->setSuffix(" MB/s");
+	m_embed_max_throughput_spin->setSpecialValueText(bm_text("BetterMarkers.Settings.EmbedMaxThroughputUnlimited"));
+	m_embed_max_throughput_spin->setToolTip(bm_text("BetterMarkers.Settings.EmbedMaxThroughputHint"));
+	premiere_embed_form->addRow(bm_text("BetterMarkers.Settings.EmbedMaxThroughputLabel"),
+				    m_embed_max_throughput_spin);
+	m_embed_faststart_toggle =
+		new QCheckBox(bm_text("BetterMarkers.Settings.EmbedFaststart"), premiere_embed_group);
+	m_embed_faststart_toggle->setToolTip(bm_text("BetterMarkers.Settings.EmbedFaststartHint"));
+	premiere_embed_form->addRow(m_embed_faststart_toggle);
+	main_layout->addWidget(premiere_embed_group);
+
 	auto *dialog_behavior_group = new QGroupBox(bm_text("BetterMarkers.Settings.MarkerDialog"), this);
 	auto *dialog_behavior_layout = new QVBoxLayout(dialog_behavior_group);
 	dialog_behavior_layout->setContentsMargins(10, 8, 10, 8);
@@ -139,6 +250,10 @@ SettingsDialog::SettingsDialog(ScopeStore *store, QWidget *parent) : QDialog(par
 	m_pause_during_dialog_toggle = new QCheckBox(
 		bm_text("BetterMarkers.Settings.PauseRecordingDuringMarkerDialogLabel"), dialog_behavior_group);
 	dialog_behavior_layout->addWidget(m_pause_during_dialog_toggle);
+	m_rendered_frame_toggle =
+		new QCheckBox(bm_text("BetterMarkers.Settings.StampRenderedFrameLabel"), dialog_behavior_group);
+	m_rendered_frame_toggle->setToolTip(bm_text("BetterMarkers.Settings.StampRenderedFrameHint"));
+	dialog_behavior_layout->addWidget(m_rendered_frame_toggle);
 	m_synthetic_keypress_toggle = new QCheckBox(bm_text("BetterMarkers.Settings.SyntheticKeypressAroundFocusLabel"),
 						    dialog_behavior_group);
 	dialog_behavior_layout->addWidget(m_synthetic_keypress_toggle);
@@ -172,6 +287,27 @@ SettingsDialog::SettingsDialog(ScopeStore *store, QWidget *parent) : QDialog(par
 	connect(m_premiere_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
 	connect(m_resolve_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
 	connect(m_final_cut_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
+	connect(m_edl_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
+	connect(m_csv_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
+	connect(m_chapters_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
+	connect(m_write_cadence_combo, &QComboBox::currentIndexChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_write_cadence_ms_spin, &QSpinBox::valueChanged, this, [this]() { update_export_profile_from_ui(); });
+	connect(m_artifact_durability_combo, &QComboBox::currentIndexChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_artifact_sync_window_spin, &QSpinBox::valueChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_writer_combo, &QComboBox::currentIndexChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_max_concurrency_spin, &QSpinBox::valueChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_per_device_concurrency_spin, &QSpinBox::valueChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_io_mode_combo, &QComboBox::currentIndexChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_max_throughput_spin, &QSpinBox::valueChanged, this,
+		[this]() { update_export_profile_from_ui(); });
+	connect(m_embed_faststart_toggle, &QCheckBox::toggled, this, [this]() { update_export_profile_from_ui(); });
 	connect(m_auto_focus_toggle, &QCheckBox::toggled, this, [this](bool enabled) {
 		m_store->set_auto_focus_marker_dialog(enabled);
 		if (m_persist_callback)
@@ -183,6 +319,11 @@ SettingsDialog::SettingsDialog(ScopeStore *store, QWidget *parent) : QDialog(par
 		if (m_persist_callback)
 			m_persist_callback();
 	});
+	connect(m_rendered_frame_toggle, &QCheckBox::toggled, this, [this](bool enabled) {
+		m_store->set_stamp_markers_with_rendered_frame(enabled);
+		if (m_persist_callback)
+			m_persist_callback();
+	});
 	connect(m_synthetic_keypress_toggle, &QCheckBox::toggled, this, [this](bool enabled) {
 		m_store->set_synthetic_keypress_around_focus_enabled(enabled);
 		if (m_persist_callback)
@@ -248,6 +389,68 @@ void SettingsDialog::refresh()
 		QSignalBlocker block_final_cut(m_final_cut_toggle);
 		m_final_cut_toggle->setChecked(profile.enable_final_cut_fcpxml);
 	}
+	{
+		QSignalBlocker block_edl(m_edl_toggle);
+		m_edl_toggle->setChecked(profile.enable_edl_markers);
+	}
+	{
+		QSignalBlocker block_csv(m_csv_toggle);
+		m_csv_toggle->setChecked(profile.enable_csv_markers);
+	}
+	{
+		QSignalBlocker block_chapters(m_chapters_toggle);
+		m_chapters_toggle->setChecked(profile.enable_youtube_chapters);
+	}
+	{
+		QSignalBlocker block_write_cadence(m_write_cadence_combo);
+		const int index = m_write_cadence_combo->findData(
+			QString::fromLatin1(export_write_cadence_to_key(profile.write_cadence)));
+		m_write_cadence_combo->setCurrentIndex(index >= 0 ? index : 0);
+	}
+	{
+		QSignalBlocker block_write_cadence_ms(m_write_cadence_ms_spin);
+		m_write_cadence_ms_spin->setValue(profile.write_cadence_ms);
+	}
+	refresh_write_cadence_controls();
+	{
+		QSignalBlocker block_artifact_durability(m_artifact_durability_combo);
+		const int index = m_artifact_durability_combo->findData(
+			QString::fromLatin1(artifact_durability_to_key(profile.artifact_durability)));
+		m_artifact_durability_combo->setCurrentIndex(index >= 0 ? index : 0);
+	}
+	{
+		QSignalBlocker block_artifact_sync_window(m_artifact_sync_window_spin);
+		m_artifact_sync_window_spin->setValue(profile.artifact_sync_window_ms);
+	}
+	refresh_artifact_durability_controls();
+	{
+		QSignalBlocker block_embed_writer(m_embed_writer_combo);
+		const int index = m_embed_writer_combo->findData(
+			QString::fromLatin1(premiere_embed_writer_to_key(profile.premiere_embed_writer)));
+		m_embed_writer_combo->setCurrentIndex(index >= 0 ? index : 0);
+	}
+	{
+		QSignalBlocker block_max_concurrency(m_embed_max_concurrency_spin);
+		m_embed_max_concurrency_spin->setValue(profile.embed_max_concurrency);
+	}
+	{
+		QSignalBlocker block_per_device_concurrency(m_embed_per_device_concurrency_spin);
+		m_embed_per_device_concurrency_spin->setValue(profile.embed_per_device_concurrency);
+	}
+	{
+		QSignalBlocker block_io_mode(m_embed_io_mode_combo);
+		const int index = m_embed_io_mode_combo->findData(
+			QString::fromLatin1(premiere_embed_io_mode_to_key(profile.embed_io_mode)));
+		m_embed_io_mode_combo->setCurrentIndex(index >= 0 ? index : 0);
+	}
+	{
+		QSignalBlocker block_max_throughput(m_embed_max_throughput_spin);
+		m_embed_max_throughput_spin->setValue(profile.embed_max_throughput_mib_s);
+	}
+	{
+		QSignalBlocker block_faststart(m_embed_faststart_toggle);
+		m_embed_faststart_toggle->setChecked(profile.embed_faststart);
+	}
 	{
 		QSignalBlocker block_auto_focus(m_auto_focus_toggle);
 		m_auto_focus_toggle->setChecked(m_store->auto_focus_marker_dialog());
@@ -256,6 +459,10 @@ void SettingsDialog::refresh()
 		QSignalBlocker block_pause_during_dialog(m_pause_during_dialog_toggle);
 		m_pause_during_dialog_toggle->setChecked(m_store->pause_recording_during_marker_dialog());
 	}
+	{
+		QSignalBlocker block_rendered_frame(m_rendered_frame_toggle);
+		m_rendered_frame_toggle->setChecked(m_store->stamp_markers_with_rendered_frame());
+	}
 	{
 		QSignalBlocker block_synthetic_toggle(m_synthetic_keypress_toggle);
 		m_synthetic_keypress_toggle->setChecked(m_store->synthetic_keypress_around_focus_enabled());
@@ -319,11 +526,58 @@ void SettingsDialog::update_export_profile_from_ui()
 #else
 	profile.enable_final_cut_fcpxml = false;
 #endif
+	profile.enable_edl_markers = m_edl_toggle && m_edl_toggle->isChecked();
+	profile.enable_csv_markers = m_csv_toggle && m_csv_toggle->isChecked();
+	profile.enable_youtube_chapters = m_chapters_toggle && m_chapters_toggle->isChecked();
+	if (m_write_cadence_combo)
+		profile.write_cadence = export_write_cadence_from_key(m_write_cadence_combo->currentData().toString());
+	if (m_write_cadence_ms_spin)
+		profile.write_cadence_ms = m_write_cadence_ms_spin->value();
+	refresh_write_cadence_controls();
+	if (m_artifact_durability_combo)
+		profile.artifact_durability =
+			artifact_durability_from_key(m_artifact_durability_combo->currentData().toString());
+	if (m_artifact_sync_window_spin)
+		profile.artifact_sync_window_ms = m_artifact_sync_window_spin->value();
+	refresh_artifact_durability_controls();
+	if (m_embed_writer_combo)
+		profile.premiere_embed_writer =
+			premiere_embed_writer_from_key(m_embed_writer_combo->currentData().toString());
+	if (m_embed_max_concurrency_spin)
+		profile.embed_max_concurrency = m_embed_max_concurrency_spin->value();
+	if (m_embed_per_device_concurrency_spin)
+		profile.embed_per_device_concurrency = m_embed_per_device_concurrency_spin->value();
+	if (m_embed_io_mode_combo)
+		profile.embed_io_mode =
+			premiere_embed_io_mode_from_key(m_embed_io_mode_combo->currentData().toString());
+	if (m_embed_max_throughput_spin)
+		profile.embed_max_throughput_mib_s = m_embed_max_throughput_spin->value();
+	if (m_embed_faststart_toggle)
+		profile.embed_faststart = m_embed_faststart_toggle->isChecked();
 
 	if (m_persist_callback)
 		m_persist_callback();
 }
 
+void SettingsDialog::refresh_write_cadence_controls()
+{
+	if (!m_write_cadence_combo || !m_write_cadence_ms_spin)
+		return;
+	const ExportWriteCadence cadence =
+		export_write_cadence_from_key(m_write_cadence_combo->currentData().toString());
+	m_write_cadence_ms_spin->setEnabled(cadence == ExportWriteCadence::Debounced ||
+					    cadence == ExportWriteCadence::Interval);
+}
+
+void SettingsDialog::refresh_artifact_durability_controls()
+{
+	if (!m_artifact_durability_combo || !m_artifact_sync_window_spin)
+		return;
+	m_artifact_sync_window_spin->setEnabled(
+		artifact_durability_from_key(m_artifact_durability_combo->currentData().toString()) ==
+		ArtifactDurability::Deferred);
+}
+
 void SettingsDialog::add_template()
 {
 	TemplateEditorDialog editor(available_profiles(), available_scene_collections(),
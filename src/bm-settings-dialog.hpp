@@ -8,6 +8,8 @@
 
 class QListWidget;
 class QCheckBox;
+class QComboBox;
+class QSpinBox;
 class QPushButton;
 class QLabel;
 class QKeySequenceEdit;
@@ -30,6 +32,8 @@ private:
 	void delete_template();
 	void on_selection_changed();
 	void update_export_profile_from_ui();
+	void refresh_write_cadence_controls();
+	void refresh_artifact_durability_controls();
 	void refresh_synthetic_keypress_controls();
 	QStringList available_profiles() const;
 	QStringList available_scene_collections() const;
@@ -46,8 +50,22 @@ private:
 	QCheckBox *m_premiere_toggle = nullptr;
 	QCheckBox *m_resolve_toggle = nullptr;
 	QCheckBox *m_final_cut_toggle = nullptr;
+	QCheckBox *m_edl_toggle = nullptr;
+	QCheckBox *m_csv_toggle = nullptr;
+	QCheckBox *m_chapters_toggle = nullptr;
+	QComboBox *m_write_cadence_combo = nullptr;
+	QSpinBox *m_write_cadence_ms_spin = nullptr;
+	QComboBox *m_artifact_durability_combo = nullptr;
+	QSpinBox *m_artifact_sync_window_spin = nullptr;
+	QComboBox *m_embed_writer_combo = nullptr;
+	QSpinBox *m_embed_max_concurrency_spin = nullptr;
+	QSpinBox *m_embed_per_device_concurrency_spin = nullptr;
+	QComboBox *m_embed_io_mode_combo = nullptr;
+	QSpinBox *m_embed_max_throughput_spin = nullptr;
+	QCheckBox *m_embed_faststart_toggle = nullptr;
 	QCheckBox *m_auto_focus_toggle = nullptr;
 	QCheckBox *m_pause_during_dialog_toggle = nullptr;
+	QCheckBox *m_rendered_frame_toggle = nullptr;
 	QCheckBox *m_synthetic_keypress_toggle = nullptr;
 	QKeySequenceEdit *m_synthetic_pre_key_edit = nullptr;
 	QKeySequenceEdit *m_synthetic_post_key_edit = nullptr;
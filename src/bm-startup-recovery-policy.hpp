@@ -1,6 +1,7 @@
 #pragma once
 
 #include "bm-marker-data.hpp"
+#include "bm-xmp-sidecar-reader.hpp"
 
 #include <QDir>
 #include <QFile>
@@ -14,6 +15,7 @@ enum class StartupRecoveryAction {
 	DropMissingMedia,
 	DropUnsupportedMedia,
 	DropMissingSidecar,
+	DropInvalidSidecar,
 };
 
 struct StartupRecoveryDecision {
@@ -42,6 +44,19 @@ inline StartupRecoveryDecision decide_startup_recovery(const QString &media_path
 	return {StartupRecoveryAction::RetryOnce, sidecar_path};
 }
 
+// Streams the sidecar of a job about to be retried through XmpSidecarReader. A sidecar that does not parse as a marker
+// track would only be embedded as garbage, so the job is dropped instead. Marker journals are replayed first, so a
+// sidecar torn mid-splice has been rebuilt by then.
+inline bool validate_startup_sidecar(StartupRecoveryDecision *decision, QString *error)
+{
+	if (decision->action != StartupRecoveryAction::RetryOnce)
+		return true;
+	if (XmpSidecarReader::read_file(decision->sidecar_path, nullptr, nullptr, error))
+		return true;
+	decision->action = StartupRecoveryAction::DropInvalidSidecar;
+	return false;
+}
+
 inline const char *startup_recovery_action_name(StartupRecoveryAction action)
 {
 	switch (action) {
@@ -53,6 +68,8 @@ inline const char *startup_recovery_action_name(StartupRecoveryAction action)
 		return "drop_unsupported_media";
 	case StartupRecoveryAction::DropMissingSidecar:
 		return "drop_missing_sidecar";
+	case StartupRecoveryAction::DropInvalidSidecar:
+		return "drop_invalid_sidecar";
 	default:
 		return "unknown";
 	}
@@ -0,0 +1,231 @@
+#include "bm-xml-emitter.hpp"
+
+#include "bm-xml-escape.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bm {
+namespace {
+
+struct ThreadArena {
+	QByteArray buffer;
+	bool in_use = false;
+};
+
+ThreadArena &thread_arena()
+{
+	thread_local ThreadArena arena;
+	return arena;
+}
+
+char *append_escape(char *out, const char *entity, size_t size)
+{
+	std::memcpy(out, entity, size);
+	return out + size;
+}
+
+constexpr char kDigitPairs[] = "00010203040506070809"
+			       "10111213141516171819"
+			       "20212223242526272829"
+			       "30313233343536373839"
+			       "40414243444546474849"
+			       "50515253545556575859"
+			       "60616263646566676869"
+			       "70717273747576777879"
+			       "80818283848586878889"
+			       "90919293949596979899";
+
+} // namespace
+
+char *write_decimal(char *out, int64_t value)
+{
+	// Negated in unsigned arithmetic so INT64_MIN does not overflow.
+	uint64_t magnitude = static_cast<uint64_t>(value);
+	if (value < 0) {
+		*out++ = '-';
+		magnitude = 0 - magnitude;
+	}
+
+	int digits = 1;
+	for (uint64_t rest = magnitude; rest >= 10; rest /= 10)
+		++digits;
+
+	char *const end = out + digits;
+	char *cursor = end;
+	while (magnitude >= 100) {
+		const size_t pair = static_cast<size_t>(magnitude % 100) * 2;
+		magnitude /= 100;
+		*--cursor = kDigitPairs[pair + 1];
+		*--cursor = kDigitPairs[pair];
+	}
+	if (magnitude >= 10) {
+		const size_t pair = static_cast<size_t>(magnitude) * 2;
+		*--cursor = kDigitPairs[pair + 1];
+		*--cursor = kDigitPairs[pair];
+	} else {
+		*--cursor = static_cast<char>('0' + magnitude);
+	}
+	return end;
+}
+
+XmlEmitter::XmlEmitter(QByteArray *buffer) : m_buffer(buffer)
+{
+	m_buffer->resize(0);
+}
+
+XmlEmitter &XmlEmitter::raw(const char *markup)
+{
+	return raw(markup, static_cast<qsizetype>(std::strlen(markup)));
+}
+
+XmlEmitter &XmlEmitter::raw(const char *markup, qsizetype size)
+{
+	if (size > 0)
+		std::memcpy(grow(size), markup, static_cast<size_t>(size));
+	return *this;
+}
+
+XmlEmitter &XmlEmitter::raw(const QByteArray &bytes)
+{
+	return raw(bytes.constData(), bytes.size());
+}
+
+XmlEmitter &XmlEmitter::number(int64_t value)
+{
+	return formatted(kMaxDecimalSize, [value](char *out) { return write_decimal(out, value); });
+}
+
+XmlEmitter &XmlEmitter::text(const QString &value)
+{
+	const qsizetype length = value.size();
+	if (length == 0)
+		return *this;
+
+	// Worst case is six bytes per UTF-16 unit ("&quot;"); the unused tail is cut off below.
+	char *const start = grow(length * 6);
+	char *out = start;
+	const char16_t *in = reinterpret_cast<const char16_t *>(value.utf16());
+	const char16_t *const end = in + length;
+	while (in < end) {
+		// Marker text is mostly plain ASCII: runs of it are copied in bulk, then the unit that ended the run
+		// (an escape or a multi-byte sequence) is handled here.
+		const qsizetype plain = xml_copy_plain_ascii(in, end - in, out);
+		in += plain;
+		out += plain;
+		if (in == end)
+			break;
+
+		const char32_t unit = *in++;
+		if (unit < 0x80) {
+			switch (unit) {
+			case '&':
+				out = append_escape(out, "&amp;", 5);
+				break;
+			case '<':
+				out = append_escape(out, "&lt;", 4);
+				break;
+			case '>':
+				out = append_escape(out, "&gt;", 4);
+				break;
+			case '"':
+				out = append_escape(out, "&quot;", 6);
+				break;
+			case '\'':
+				out = append_escape(out, "&apos;", 6);
+				break;
+			default:
+				*out++ = static_cast<char>(unit);
+				break;
+			}
+			continue;
+		}
+		if (unit < 0x800) {
+			*out++ = static_cast<char>(0xC0 | (unit >> 6));
+			*out++ = static_cast<char>(0x80 | (unit & 0x3F));
+			continue;
+		}
+
+		char32_t code_point = unit;
+		if (unit >= 0xD800 && unit <= 0xDFFF) {
+			// Lone surrogates come out as '?', like QString::toUtf8.
+			if (unit > 0xDBFF || in == end || *in < 0xDC00 || *in > 0xDFFF) {
+				*out++ = '?';
+				continue;
+			}
+			code_point = 0x10000 + ((unit - 0xD800) << 10) + (*in++ - 0xDC00);
+			*out++ = static_cast<char>(0xF0 | (code_point >> 18));
+			*out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+		} else {
+			*out++ = static_cast<char>(0xE0 | (code_point >> 12));
+		}
+		*out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+	}
+
+	m_buffer->resize(m_buffer->size() - (length * 6 - (out - start)));
+	return *this;
+}
+
+XmlEmitter &XmlEmitter::attribute(const char *name, const QString &value)
+{
+	raw(" ").raw(name).raw("=\"");
+	return text(value).raw("\"");
+}
+
+XmlEmitter &XmlEmitter::attribute(const char *name, int64_t value)
+{
+	raw(" ").raw(name).raw("=\"");
+	return number(value).raw("\"");
+}
+
+const QByteArray &XmlEmitter::bytes() const
+{
+	return *m_buffer;
+}
+
+qsizetype XmlEmitter::size() const
+{
+	return m_buffer->size();
+}
+
+char *XmlEmitter::grow(qsizetype extra)
+{
+	// Doubles the capacity so a document built from many small appends reallocates a logarithmic number of times.
+	const qsizetype size = m_buffer->size();
+	if (m_buffer->capacity() < size + extra)
+		m_buffer->reserve(std::max(size + extra, m_buffer->capacity() * 2));
+	m_buffer->resize(size + extra);
+	return m_buffer->data() + size;
+}
+
+XmlArena::XmlArena()
+{
+	ThreadArena &arena = thread_arena();
+	if (arena.in_use) {
+		m_buffer = &m_private;
+		return;
+	}
+	arena.in_use = true;
+	m_borrowed = true;
+	m_buffer = &arena.buffer;
+}
+
+XmlArena::~XmlArena()
+{
+	if (!m_borrowed)
+		return;
+	ThreadArena &arena = thread_arena();
+	if (arena.buffer.capacity() > kMaxRetainedBytes)
+		arena.buffer = QByteArray();
+	else
+		arena.buffer.resize(0);
+	arena.in_use = false;
+}
+
+QByteArray *XmlArena::buffer()
+{
+	return m_buffer;
+}
+
+} // namespace bm
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstdint>
+
+namespace bm {
+
+// Longest output of write_decimal ("-9223372036854775808").
+constexpr qsizetype kMaxDecimalSize = 20;
+
+// Writes value in decimal at out, two digits at a time, and returns the end. No terminator.
+char *write_decimal(char *out, int64_t value);
+
+// Appends a UTF-8 XML document to a byte buffer. Text is escaped while it is transcoded from UTF-16, so a document is
+// produced in one pass without an intermediate QString. Markup passed to raw() must already be UTF-8.
+class XmlEmitter {
+public:
+	// Empties the buffer but keeps its capacity.
+	explicit XmlEmitter(QByteArray *buffer);
+
+	XmlEmitter &raw(const char *markup);
+	XmlEmitter &raw(const char *markup, qsizetype size);
+	XmlEmitter &raw(const QByteArray &bytes);
+	XmlEmitter &number(int64_t value);
+	// Reserves max_size bytes, lets write fill them in place and keeps what it wrote. write takes the start pointer
+	// and returns the end.
+	template <typename Write> XmlEmitter &formatted(qsizetype max_size, Write &&write);
+	// Escapes & < > " and ' (so the same call serves element text and attribute values).
+	XmlEmitter &text(const QString &value);
+	// Emits ` name="value"`.
+	XmlEmitter &attribute(const char *name, const QString &value);
+	XmlEmitter &attribute(const char *name, int64_t value);
+
+	const QByteArray &bytes() const;
+	qsizetype size() const;
+
+private:
+	char *grow(qsizetype extra);
+
+	QByteArray *m_buffer;
+};
+
+template <typename Write> XmlEmitter &XmlEmitter::formatted(qsizetype max_size, Write &&write)
+{
+	char *const start = grow(max_size);
+	const char *const end = write(start);
+	m_buffer->resize(m_buffer->size() - (max_size - (end - start)));
+	return *this;
+}
+
+// Borrows the calling thread's scratch buffer for one document. The buffer keeps its capacity between documents (up to
+// kMaxRetainedBytes), so writers rendering similar documents over and over stop allocating after the first one. A
+// nested arena on the same thread gets a private buffer instead.
+class XmlArena {
+public:
+	static constexpr qsizetype kMaxRetainedBytes = 1 << 20;
+
+	XmlArena();
+	~XmlArena();
+	XmlArena(const XmlArena &) = delete;
+	XmlArena &operator=(const XmlArena &) = delete;
+
+	QByteArray *buffer();
+
+private:
+	QByteArray m_private;
+	QByteArray *m_buffer = nullptr;
+	bool m_borrowed = false;
+};
+
+} // namespace bm
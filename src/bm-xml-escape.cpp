@@ -0,0 +1,153 @@
+#include "bm-xml-escape.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BM_XML_ESCAPE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BM_XML_ESCAPE_TARGET_AVX2
+#else
+#define BM_XML_ESCAPE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace bm {
+namespace {
+
+inline bool is_plain_ascii(char16_t unit)
+{
+	return unit < 0x80 && unit != '&' && unit != '<' && unit != '>' && unit != '"' && unit != '\'';
+}
+
+qsizetype copy_plain_scalar(const char16_t *in, qsizetype size, char *out)
+{
+	qsizetype i = 0;
+	while (i < size && is_plain_ascii(in[i])) {
+		out[i] = static_cast<char>(in[i]);
+		++i;
+	}
+	return i;
+}
+
+#if defined(BM_XML_ESCAPE_X86)
+
+inline unsigned count_trailing_zeros(quint32 mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// All-ones lanes for units that can be copied as is.
+inline __m128i plain_lanes_sse2(__m128i units)
+{
+	const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xFF80))),
+					      _mm_setzero_si128());
+	__m128i special = _mm_cmpeq_epi16(units, _mm_set1_epi16('&'));
+	special = _mm_or_si128(special, _mm_cmpeq_epi16(units, _mm_set1_epi16('<')));
+	special = _mm_or_si128(special, _mm_cmpeq_epi16(units, _mm_set1_epi16('>')));
+	special = _mm_or_si128(special, _mm_cmpeq_epi16(units, _mm_set1_epi16('"')));
+	special = _mm_or_si128(special, _mm_cmpeq_epi16(units, _mm_set1_epi16('\'')));
+	return _mm_andnot_si128(special, ascii);
+}
+
+qsizetype copy_plain_sse2(const char16_t *in, qsizetype size, char *out)
+{
+	qsizetype i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+		// Stored before the check: bytes past the run are scratch the caller overwrites.
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(low, high));
+		const quint32 plain = static_cast<quint32>(_mm_movemask_epi8(plain_lanes_sse2(low))) |
+				      (static_cast<quint32>(_mm_movemask_epi8(plain_lanes_sse2(high))) << 16);
+		if (plain != 0xFFFFFFFFu)
+			return i + count_trailing_zeros(~plain) / 2;
+	}
+	return i + copy_plain_scalar(in + i, size - i, out + i);
+}
+
+BM_XML_ESCAPE_TARGET_AVX2 inline __m256i plain_lanes_avx2(__m256i units)
+{
+	const __m256i ascii = _mm256_cmpeq_epi16(
+		_mm256_and_si256(units, _mm256_set1_epi16(static_cast<short>(0xFF80))), _mm256_setzero_si256());
+	__m256i special = _mm256_cmpeq_epi16(units, _mm256_set1_epi16('&'));
+	special = _mm256_or_si256(special, _mm256_cmpeq_epi16(units, _mm256_set1_epi16('<')));
+	special = _mm256_or_si256(special, _mm256_cmpeq_epi16(units, _mm256_set1_epi16('>')));
+	special = _mm256_or_si256(special, _mm256_cmpeq_epi16(units, _mm256_set1_epi16('"')));
+	special = _mm256_or_si256(special, _mm256_cmpeq_epi16(units, _mm256_set1_epi16('\'')));
+	return _mm256_andnot_si256(special, ascii);
+}
+
+BM_XML_ESCAPE_TARGET_AVX2 qsizetype copy_plain_avx2(const char16_t *in, qsizetype size, char *out)
+{
+	qsizetype i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+		const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 16));
+		// packus works per 128-bit lane; the permute puts the four 8-byte groups back in order.
+		const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), bytes);
+		const quint32 plain_low = static_cast<quint32>(_mm256_movemask_epi8(plain_lanes_avx2(low)));
+		if (plain_low != 0xFFFFFFFFu)
+			return i + count_trailing_zeros(~plain_low) / 2;
+		const quint32 plain_high = static_cast<quint32>(_mm256_movemask_epi8(plain_lanes_avx2(high)));
+		if (plain_high != 0xFFFFFFFFu)
+			return i + 16 + count_trailing_zeros(~plain_high) / 2;
+	}
+	return i + copy_plain_sse2(in + i, size - i, out + i);
+}
+
+bool cpu_has_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+	__cpuidex(info, 7, 0);
+	return os_saves_ymm && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+xml_escape_detail::CopyPlainKernel selected_kernel()
+{
+	static const xml_escape_detail::CopyPlainKernel kernel =
+		xml_escape_detail::available_kernels().last().copy_plain;
+	return kernel;
+}
+
+} // namespace
+
+qsizetype xml_copy_plain_ascii(const char16_t *in, qsizetype size, char *out)
+{
+	return selected_kernel()(in, size, out);
+}
+
+namespace xml_escape_detail {
+
+QVector<Kernel> available_kernels()
+{
+	QVector<Kernel> kernels;
+	kernels.push_back({"scalar", copy_plain_scalar});
+#if defined(BM_XML_ESCAPE_X86)
+	kernels.push_back({"sse2", copy_plain_sse2});
+	if (cpu_has_avx2())
+		kernels.push_back({"avx2", copy_plain_avx2});
+#endif
+	return kernels;
+}
+
+} // namespace xml_escape_detail
+
+} // namespace bm
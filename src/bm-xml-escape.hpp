@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QVector>
+
+namespace bm {
+
+// Copies the leading run of UTF-16 text that needs no escaping and no multi-byte encoding (ASCII other than
+// & < > " ') to out as bytes and returns its length. out must have room for size bytes; the SIMD kernels may write
+// scratch bytes past the run, within that room. Uses AVX2 or SSE2 when the CPU has them.
+qsizetype xml_copy_plain_ascii(const char16_t *in, qsizetype size, char *out);
+
+namespace xml_escape_detail {
+
+using CopyPlainKernel = qsizetype (*)(const char16_t *in, qsizetype size, char *out);
+
+struct Kernel {
+	const char *name;
+	CopyPlainKernel copy_plain;
+};
+
+// Every kernel this CPU can run, scalar first; xml_copy_plain_ascii uses the last one.
+QVector<Kernel> available_kernels();
+
+} // namespace xml_escape_detail
+
+} // namespace bm
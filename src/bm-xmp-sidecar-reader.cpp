@@ -0,0 +1,173 @@
+#include "bm-xmp-sidecar-reader.hpp"
+
+#include "bm-xmp-sidecar-writer.hpp"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QXmlStreamReader>
+
+namespace bm {
+namespace {
+
+const QLatin1String kRdfNamespace("http://www.w3.org/1999/02/22-rdf-syntax-ns#");
+const QLatin1String kXmpDmNamespace("http://ns.adobe.com/xmp/1.0/DynamicMedia/");
+const QLatin1String kColorKeywordPrefix("keywordExtDVAv1_");
+
+bool is_element(const QXmlStreamReader &xml, QLatin1String namespace_uri, QLatin1String name)
+{
+	return xml.namespaceUri() == namespace_uri && xml.name() == name;
+}
+
+// Reads xmpDM:frameRate="f<N>".
+uint32_t parse_timebase(QStringView frame_rate)
+{
+	if (!frame_rate.startsWith(QLatin1Char('f')))
+		return 0;
+	bool ok = false;
+	const uint32_t timebase = frame_rate.mid(1).toUInt(&ok);
+	return ok ? timebase : 0;
+}
+
+// Reads the {"color":<argb>} value of a color keyword cue point.
+int parse_color_id(QStringView value)
+{
+	const QJsonDocument json = QJsonDocument::fromJson(value.toUtf8());
+	if (!json.isObject())
+		return 0;
+	const double argb = json.object().value("color").toDouble(-1);
+	if (argb < 0 || argb > 4294967295.0)
+		return 0;
+	return premiere_color_id_for_argb(static_cast<quint32>(argb));
+}
+
+bool begin_marker(const QXmlStreamAttributes &attributes, MarkerRecord *marker, QString *error)
+{
+	bool ok = false;
+	*marker = MarkerRecord();
+	marker->start_frame = attributes.value(kXmpDmNamespace, QLatin1String("startTime")).toLongLong(&ok);
+	if (!ok) {
+		if (error)
+			*error = QString("XMP marker start time is not a frame number: %1")
+					 .arg(attributes.value(kXmpDmNamespace, QLatin1String("startTime")).toString());
+		return false;
+	}
+	const QStringView duration = attributes.value(kXmpDmNamespace, QLatin1String("duration"));
+	if (!duration.isEmpty())
+		marker->duration_frames = duration.toLongLong();
+	marker->name = attributes.value(kXmpDmNamespace, QLatin1String("name")).toString();
+	marker->comment = attributes.value(kXmpDmNamespace, QLatin1String("comment")).toString();
+	marker->type = attributes.value(kXmpDmNamespace, QLatin1String("type")).toString();
+	marker->guid = attributes.value(kXmpDmNamespace, QLatin1String("guid")).toString();
+	return true;
+}
+
+void read_cue_point(const QXmlStreamAttributes &attributes, MarkerRecord *marker)
+{
+	const QStringView key = attributes.value(kXmpDmNamespace, QLatin1String("key"));
+	const QStringView value = attributes.value(kXmpDmNamespace, QLatin1String("value"));
+	if (key == QLatin1String("marker_guid")) {
+		if (marker->guid.isEmpty())
+			marker->guid = value.toString();
+	} else if (key.startsWith(kColorKeywordPrefix)) {
+		marker->color_id = parse_color_id(value);
+	}
+}
+
+} // namespace
+
+bool XmpSidecarReader::read(QIODevice *device, const MarkerVisitor &visit, Summary *summary, QString *error)
+{
+	QXmlStreamReader xml(device);
+	Summary result;
+	bool has_track = false;
+	MarkerRecord marker;
+	// Element nesting depth, and the depths of the open <xmpDM:markers> and marker <rdf:Description> (0 when none).
+	int depth = 0;
+	int markers_depth = 0;
+	int marker_depth = 0;
+
+	while (!xml.atEnd()) {
+		xml.readNext();
+		if (xml.isStartElement()) {
+			++depth;
+			if (is_element(xml, kXmpDmNamespace, QLatin1String("markers"))) {
+				if (markers_depth == 0)
+					markers_depth = depth;
+			} else if (is_element(xml, kRdfNamespace, QLatin1String("Description"))) {
+				const QXmlStreamAttributes attributes = xml.attributes();
+				if (attributes.value(kXmpDmNamespace, QLatin1String("trackName")) ==
+				    QLatin1String("Markers")) {
+					has_track = true;
+					result.timebase = parse_timebase(
+						attributes.value(kXmpDmNamespace, QLatin1String("frameRate")));
+				} else if (markers_depth != 0 && marker_depth == 0 &&
+					   !attributes.value(kXmpDmNamespace, QLatin1String("startTime")).isEmpty()) {
+					if (!begin_marker(attributes, &marker, error))
+						return false;
+					marker_depth = depth;
+				}
+			} else if (marker_depth != 0 && is_element(xml, kRdfNamespace, QLatin1String("li"))) {
+				read_cue_point(xml.attributes(), &marker);
+			}
+		} else if (xml.isEndElement()) {
+			if (depth == marker_depth) {
+				marker_depth = 0;
+				++result.marker_count;
+				if (visit)
+					visit(marker);
+			} else if (depth == markers_depth) {
+				markers_depth = 0;
+			}
+			--depth;
+		}
+	}
+
+	if (xml.hasError()) {
+		if (error)
+			*error = QString("Malformed XMP sidecar at line %1: %2")
+					 .arg(xml.lineNumber())
+					 .arg(xml.errorString());
+		return false;
+	}
+	if (!has_track) {
+		if (error)
+			*error = QString("XMP sidecar has no marker track");
+		return false;
+	}
+	if (summary)
+		*summary = result;
+	return true;
+}
+
+bool XmpSidecarReader::read_file(const QString &sidecar_path, const MarkerVisitor &visit, Summary *summary,
+				 QString *error)
+{
+	QFile file(sidecar_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		if (error)
+			*error = QString("Failed to open sidecar for read: %1").arg(sidecar_path);
+		return false;
+	}
+	QString read_error;
+	if (!read(&file, visit, summary, &read_error)) {
+		if (error)
+			*error = QString("%1 (%2)").arg(read_error, sidecar_path);
+		return false;
+	}
+	return true;
+}
+
+bool XmpSidecarReader::read_markers(const QString &sidecar_path, QVector<MarkerRecord> *markers, Summary *summary,
+				    QString *error)
+{
+	QVector<MarkerRecord> read_markers;
+	const MarkerVisitor visit = [&read_markers](const MarkerRecord &marker) { read_markers.push_back(marker); };
+	if (!read_file(sidecar_path, visit, summary, error))
+		return false;
+	if (markers)
+		*markers = std::move(read_markers);
+	return true;
+}
+
+} // namespace bm
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "bm-marker-data.hpp"
+
+#include <QString>
+#include <QVector>
+
+#include <cstdint>
+#include <functional>
+
+class QIODevice;
+
+namespace bm {
+
+// Streaming reader for the sidecar layout XmpSidecarWriter emits. The document is pulled through QXmlStreamReader in
+// small chunks and each marker is handed to the visitor as soon as its <rdf:Description> closes, so memory stays at
+// one marker whatever the size of the sidecar. Markers come back as written: colors are mapped back from Premiere's
+// keyword values and the guid falls back to the marker_guid cue point when the attribute is missing.
+class XmpSidecarReader {
+public:
+	struct Summary {
+		// Integer frame rate of the marker track (xmpDM:frameRate="f30" reads as 30).
+		uint32_t timebase = 0;
+		int marker_count = 0;
+	};
+
+	using MarkerVisitor = std::function<void(const MarkerRecord &marker)>;
+
+	// Fails on malformed XML, a document without the marker track or a marker without an integer start time.
+	// visit and summary may be null.
+	static bool read(QIODevice *device, const MarkerVisitor &visit, Summary *summary, QString *error);
+	static bool read_file(const QString &sidecar_path, const MarkerVisitor &visit, Summary *summary,
+			      QString *error);
+	static bool read_markers(const QString &sidecar_path, QVector<MarkerRecord> *markers, Summary *summary,
+				 QString *error);
+};
+
+} // namespace bm
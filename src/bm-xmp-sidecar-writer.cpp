@@ -1,9 +1,12 @@
 #include "bm-xmp-sidecar-writer.hpp"
 
+#include "bm-artifact-sync.hpp"
+#include "bm-file-integrity.hpp"
+#include "bm-frame-rate.hpp"
+
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
-#include <QSaveFile>
-#include <QTextStream>
 #include <QUuid>
 
 #include <algorithm>
@@ -12,16 +15,69 @@
 namespace bm {
 namespace {
 
-QString premiere_frame_rate_value(uint32_t fps_num, uint32_t fps_den)
+// Everything after the last marker. Splices overwrite it with the new <rdf:li> blocks followed by this tail again.
+const char XMP_TRAILER[] = "                </rdf:Seq>\n"
+			   "              </xmpDM:markers>\n"
+			   "            </rdf:Description>\n"
+			   "          </rdf:li>\n"
+			   "        </rdf:Bag>\n"
+			   "      </xmpDM:Tracks>\n"
+			   "    </rdf:Description>\n"
+			   "  </rdf:RDF>\n"
+			   "</x:xmpmeta>\n"
+			   "<?xpacket end=\"w\"?>";
+constexpr qint64 kTrailerSize = sizeof(XMP_TRAILER) - 1;
+
+// A splice is synced under the batch's policy like a full write; without a batch, before append_markers returns.
+bool sync_spliced(QFile &file, ArtifactSyncBatch *sync_batch)
 {
-	if (fps_num == 0 || fps_den == 0)
-		return "f30";
+	return sync_batch ? sync_batch->sync_in_place(file, nullptr) : sync_file_to_disk(file);
+}
+
+// Writes bytes at offset and cuts the sidecar right after them.
+bool apply_splice(const QString &sidecar_path, qint64 offset, const QByteArray &bytes, ArtifactSyncBatch *sync_batch,
+		  QString *error)
+{
+	QFile file(sidecar_path);
+	if (!file.open(QIODevice::ReadWrite) || file.size() < offset || !file.seek(offset) ||
+	    file.write(bytes) != bytes.size() || !file.resize(offset + bytes.size()) ||
+	    !sync_spliced(file, sync_batch)) {
+		if (error)
+			*error = QString("Failed to splice sidecar: %1").arg(sidecar_path);
+		return false;
+	}
+	return true;
+}
+
+// One <rdf:li> of the marker track. A colored marker gets a fresh keyword id each time it is rendered; with a render
+// cache that is once per recording.
+void render_marker_item(XmlEmitter &xml, const MarkerRecord &marker)
+{
+	xml.raw("                  <rdf:li>\n");
+	xml.raw("                    <rdf:Description").attribute("xmpDM:startTime", marker.start_frame);
+	xml.attribute("xmpDM:name", marker.name).attribute("xmpDM:comment", marker.comment);
+	xml.attribute("xmpDM:type", marker.type.isEmpty() ? QString("Comment") : marker.type);
+	xml.attribute("xmpDM:guid", marker.guid).raw(">\n");
+	xml.raw("                      <xmpDM:cuePointParams>\n");
+	xml.raw("                        <rdf:Seq>\n");
+	xml.raw("                          <rdf:li xmpDM:key=\"marker_guid\"");
+	xml.attribute("xmpDM:value", marker.guid).raw("/>\n");
+
+	const std::optional<quint32> argb_color = premiere_color_argb_value(marker.color_id);
+	if (argb_color.has_value()) {
+		const QString color_keyword = "keywordExtDVAv1_" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+		xml.raw("                          <rdf:li").attribute("xmpDM:key", color_keyword);
+		xml.raw(" xmpDM:value=\"{&quot;color&quot;:").number(argb_color.value()).raw("}\"/>\n");
+	}
 
-	const double fps = static_cast<double>(fps_num) / static_cast<double>(fps_den);
-	const int rounded_fps = std::max(1, qRound(fps));
-	return QString("f%1").arg(rounded_fps);
+	xml.raw("                        </rdf:Seq>\n");
+	xml.raw("                      </xmpDM:cuePointParams>\n");
+	xml.raw("                    </rdf:Description>\n");
+	xml.raw("                  </rdf:li>\n");
 }
 
+} // namespace
+
 std::optional<quint32> premiere_color_argb_value(int color_id)
 {
 	switch (color_id) {
@@ -48,7 +104,14 @@ std::optional<quint32> premiere_color_argb_value(int color_id)
 	}
 }
 
-} // namespace
+int premiere_color_id_for_argb(quint32 argb)
+{
+	for (int color_id = 1; color_id <= 8; ++color_id) {
+		if (premiere_color_argb_value(color_id) == argb)
+			return color_id;
+	}
+	return 0;
+}
 
 QString XmpSidecarWriter::sidecar_path_for_media(const QString &media_path)
 {
@@ -56,8 +119,25 @@ QString XmpSidecarWriter::sidecar_path_for_media(const QString &media_path)
 	return info.dir().filePath(info.completeBaseName() + ".xmp");
 }
 
-bool XmpSidecarWriter::write_sidecar(const QString &media_path, const QVector<MarkerRecord> &markers, uint32_t fps_num,
-					     uint32_t fps_den, QString *error) const
+bool XmpSidecarWriter::write_sidecar(const QString &media_path, const MarkerList &markers, uint32_t fps_num,
+				     uint32_t fps_den, QString *error, MarkerRenderCache *render_cache,
+				     ArtifactSyncBatch *sync_batch) const
+{
+	if (fps_num == 0)
+		fps_num = 30;
+	if (fps_den == 0)
+		fps_den = 1;
+
+	XmlArena arena;
+	XmlEmitter xml(arena.buffer());
+	emit_document(xml, markers, fps_num, fps_den, render_cache);
+	return write_artifact(sidecar_path_for_media(media_path), xml.bytes(), sync_batch, error);
+}
+
+bool XmpSidecarWriter::append_markers(const QString &media_path, const MarkerList &markers,
+				      uint32_t fps_num, uint32_t fps_den, QString *error,
+				      const std::shared_ptr<MarkerRenderCache> &render_cache,
+				      ArtifactSyncBatch *sync_batch)
 {
 	if (fps_num == 0)
 		fps_num = 30;
@@ -65,97 +145,114 @@ bool XmpSidecarWriter::write_sidecar(const QString &media_path, const QVector<Ma
 		fps_den = 1;
 
 	const QString sidecar_path = sidecar_path_for_media(media_path);
-	QSaveFile file(sidecar_path);
-	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-		if (error)
-			*error = QString("Failed to open sidecar for write: %1").arg(sidecar_path);
-		return false;
-	}
+	std::lock_guard<std::mutex> lock(m_mutex);
 
-	const QByteArray payload = build_xmp(markers, fps_num, fps_den).toUtf8();
-	if (file.write(payload) == -1) {
-		if (error)
-			*error = QString("Failed to write sidecar: %1").arg(sidecar_path);
-		return false;
+	auto it = m_incremental.find(sidecar_path);
+	if (it != m_incremental.end() && can_splice(sidecar_path, *it, markers, fps_num, fps_den)) {
+		IncrementalState &state = *it;
+		const int first = static_cast<int>(state.markers.size());
+		if (first == markers.size())
+			return true;
+
+		XmlArena arena;
+		XmlEmitter splice(arena.buffer());
+		emit_marker_items(splice, markers, first, render_cache.get());
+		const qint64 items_size = splice.size();
+		splice.raw(XMP_TRAILER, kTrailerSize);
+
+		if (!apply_splice(sidecar_path, state.tail_offset, splice.bytes(), sync_batch, error)) {
+			// The sidecar may hold part of the splice now; the next call rewrites it in full.
+			m_incremental.erase(it);
+			return false;
+		}
+
+		state.markers = markers;
+		state.tail_offset += items_size;
+		state.file_size = state.tail_offset + kTrailerSize;
+		state.render_cache = render_cache;
+		return true;
 	}
 
-	if (!file.commit()) {
-		if (error)
-			*error = QString("Failed to commit sidecar: %1").arg(sidecar_path);
+	XmlArena arena;
+	XmlEmitter xml(arena.buffer());
+	emit_document(xml, markers, fps_num, fps_den, render_cache.get());
+	if (!write_artifact(sidecar_path, xml.bytes(), sync_batch, error)) {
+		m_incremental.remove(sidecar_path);
 		return false;
 	}
 
+	IncrementalState state;
+	state.markers = markers;
+	state.fps_num = fps_num;
+	state.fps_den = fps_den;
+	state.file_size = xml.size();
+	state.tail_offset = state.file_size - kTrailerSize;
+	state.render_cache = render_cache;
+	m_incremental.insert(sidecar_path, state);
 	return true;
 }
 
-QString XmpSidecarWriter::build_xmp(const QVector<MarkerRecord> &markers, uint32_t fps_num, uint32_t fps_den) const
+bool XmpSidecarWriter::finalize_sidecar(const QString &media_path, QString *error)
 {
-	QString xml;
-	QTextStream stream(&xml);
-	stream.setEncoding(QStringConverter::Utf8);
-
-	const QString frame_rate = premiere_frame_rate_value(fps_num, fps_den);
-
-	stream << "<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n";
-	stream << "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\" x:xmptk=\"Better Markers\">\n";
-	stream << "  <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n";
-	stream << "    <rdf:Description rdf:about=\"\" xmlns:xmpDM=\"http://ns.adobe.com/xmp/1.0/DynamicMedia/\">\n";
-	stream << "      <xmpDM:Tracks>\n";
-	stream << "        <rdf:Bag>\n";
-	stream << "          <rdf:li>\n";
-	stream << "            <rdf:Description xmpDM:trackName=\"Markers\" xmpDM:frameRate=\"" << frame_rate << "\">\n";
-	stream << "              <xmpDM:markers>\n";
-	stream << "                <rdf:Seq>\n";
-
-	for (const MarkerRecord &marker : markers) {
-		stream << "                  <rdf:li>\n";
-		stream << "                    <rdf:Description xmpDM:startTime=\"" << marker.start_frame << "\"";
-		stream << " xmpDM:name=\"" << xml_escape(marker.name) << "\"";
-		stream << " xmpDM:comment=\"" << xml_escape(marker.comment) << "\"";
-		stream << " xmpDM:type=\"" << xml_escape(marker.type.isEmpty() ? QString("Comment") : marker.type) << "\"";
-		stream << " xmpDM:guid=\"" << xml_escape(marker.guid) << "\">\n";
-		stream << "                      <xmpDM:cuePointParams>\n";
-		stream << "                        <rdf:Seq>\n";
-		stream << "                          <rdf:li xmpDM:key=\"marker_guid\" xmpDM:value=\""
-		       << xml_escape(marker.guid) << "\"/>\n";
-
-		const std::optional<quint32> argb_color = premiere_color_argb_value(marker.color_id);
-		if (argb_color.has_value()) {
-			const QString color_keyword = "keywordExtDVAv1_" + QUuid::createUuid().toString(QUuid::WithoutBraces);
-			const QString color_payload = QString("{\"color\":%1}").arg(argb_color.value());
-			stream << "                          <rdf:li xmpDM:key=\"" << color_keyword << "\" xmpDM:value=\""
-			       << xml_escape(color_payload) << "\"/>\n";
-		}
-
-		stream << "                        </rdf:Seq>\n";
-		stream << "                      </xmpDM:cuePointParams>\n";
-		stream << "                    </rdf:Description>\n";
-		stream << "                  </rdf:li>\n";
+	const QString sidecar_path = sidecar_path_for_media(media_path);
+	IncrementalState state;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_incremental.find(sidecar_path);
+		if (it == m_incremental.end())
+			return true;
+		state = *it;
+		m_incremental.erase(it);
 	}
+	return write_sidecar(media_path, state.markers, state.fps_num, state.fps_den, error, state.render_cache.get());
+}
+
+bool XmpSidecarWriter::can_splice(const QString &sidecar_path, const IncrementalState &state,
+				  const MarkerList &markers, uint32_t fps_num, uint32_t fps_den) const
+{
+	// Markers are only ever appended; anything else, or a sidecar changed behind our back, takes a full write.
+	const int written = static_cast<int>(state.markers.size());
+	if (state.fps_num != fps_num || state.fps_den != fps_den || written == 0 || markers.size() < written ||
+	    markers.at(written - 1).guid != state.markers.last().guid)
+		return false;
 
-	stream << "                </rdf:Seq>\n";
-	stream << "              </xmpDM:markers>\n";
-	stream << "            </rdf:Description>\n";
-	stream << "          </rdf:li>\n";
-	stream << "        </rdf:Bag>\n";
-	stream << "      </xmpDM:Tracks>\n";
-	stream << "    </rdf:Description>\n";
-	stream << "  </rdf:RDF>\n";
-	stream << "</x:xmpmeta>\n";
-	stream << "<?xpacket end=\"w\"?>";
-
-	return xml;
+	QFile file(sidecar_path);
+	if (!file.open(QIODevice::ReadOnly) || file.size() != state.file_size || !file.seek(state.tail_offset))
+		return false;
+	return file.read(kTrailerSize) == QByteArray(XMP_TRAILER, static_cast<int>(kTrailerSize));
+}
+
+void XmpSidecarWriter::emit_document(XmlEmitter &xml, const MarkerList &markers, uint32_t fps_num,
+				     uint32_t fps_den, MarkerRenderCache *render_cache) const
+{
+	xml.raw("<?xpacket begin=\"\xEF\xBB\xBF\" id=\"W5M0MpCehiHzreSzNTczkc9d\"?>\n");
+	xml.raw("<x:xmpmeta xmlns:x=\"adobe:ns:meta/\" x:xmptk=\"Better Markers\">\n");
+	xml.raw("  <rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n");
+	xml.raw("    <rdf:Description rdf:about=\"\" xmlns:xmpDM=\"http://ns.adobe.com/xmp/1.0/DynamicMedia/\">\n");
+	xml.raw("      <xmpDM:Tracks>\n");
+	xml.raw("        <rdf:Bag>\n");
+	xml.raw("          <rdf:li>\n");
+	xml.raw("            <rdf:Description xmpDM:trackName=\"Markers\" xmpDM:frameRate=\"f");
+	xml.number(FrameRate::from_obs(fps_num, fps_den).timebase()).raw("\">\n");
+	xml.raw("              <xmpDM:markers>\n");
+	xml.raw("                <rdf:Seq>\n");
+	emit_marker_items(xml, markers, 0, render_cache);
+	xml.raw(XMP_TRAILER, kTrailerSize);
 }
 
-QString XmpSidecarWriter::xml_escape(const QString &value)
+void XmpSidecarWriter::emit_marker_items(XmlEmitter &xml, const MarkerList &markers, int first,
+					 MarkerRenderCache *render_cache) const
 {
-	QString escaped = value;
-	escaped.replace('&', "&amp;");
-	escaped.replace('<', "&lt;");
-	escaped.replace('>', "&gt;");
-	escaped.replace('"', "&quot;");
-	escaped.replace('\'', "&apos;");
-	return escaped;
+	for (int i = first; i < markers.size(); ++i) {
+		const MarkerRecord &marker = markers.at(i);
+		if (!render_cache) {
+			render_marker_item(xml, marker);
+			continue;
+		}
+		// Items do not depend on the frame rate; 0/0 keeps them valid across the document's frameRate changes.
+		render_cache->append_fragment(xml, MarkerRenderCache::Fragment::XmpItem, marker, 0, 0,
+					      [&marker](XmlEmitter &item) { render_marker_item(item, marker); });
+	}
 }
 
 } // namespace bm
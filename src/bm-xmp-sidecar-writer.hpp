@@ -1,22 +1,72 @@
 #pragma once
 
 #include "bm-marker-data.hpp"
+#include "bm-marker-log.hpp"
+#include "bm-marker-render-cache.hpp"
+#include "bm-xml-emitter.hpp"
 
+#include <QByteArray>
+#include <QHash>
 #include <QString>
 #include <QVector>
 
+#include <memory>
+#include <mutex>
+#include <optional>
+
 namespace bm {
 
+class ArtifactSyncBatch;
+
+// ARGB value of a marker color id in Premiere's color keyword; none for the default color and unknown ids.
+std::optional<quint32> premiere_color_argb_value(int color_id);
+// The color id premiere_color_argb_value maps to argb, or 0 (default) for any other value.
+int premiere_color_id_for_argb(quint32 argb);
+
 class XmpSidecarWriter {
 public:
 	static QString sidecar_path_for_media(const QString &media_path);
 
-	bool write_sidecar(const QString &media_path, const QVector<MarkerRecord> &markers, uint32_t fps_num,
-			  uint32_t fps_den, QString *error) const;
+	// render_cache (optional) supplies marker items already rendered for this recording; sync_batch (optional)
+	// takes over syncing the rewritten sidecar.
+	bool write_sidecar(const QString &media_path, const MarkerList &markers, uint32_t fps_num,
+			  uint32_t fps_den, QString *error, MarkerRenderCache *render_cache = nullptr,
+			  ArtifactSyncBatch *sync_batch = nullptr) const;
+
+	// Adds the markers past the ones this writer already put into the sidecar: only the new <rdf:li> blocks are
+	// rendered and written over the closing </rdf:Seq> tail in place. Falls back to a full write for the first
+	// marker, a changed frame rate or a sidecar that no longer matches what was written. The render cache is kept
+	// for finalize_sidecar's rewrite. Both a full write and a splice are synced through sync_batch. A crash
+	// mid-splice leaves a torn sidecar, which startup recovery rebuilds from the marker journal.
+	bool append_markers(const QString &media_path, const MarkerList &markers, uint32_t fps_num,
+			    uint32_t fps_den, QString *error,
+			    const std::shared_ptr<MarkerRenderCache> &render_cache = nullptr,
+			    ArtifactSyncBatch *sync_batch = nullptr);
+	// Rewrites the sidecar in full from the appended markers and forgets its incremental state. A no-op for
+	// sidecars this writer has no state for.
+	bool finalize_sidecar(const QString &media_path, QString *error);
+	// Renders the whole UTF-8 sidecar into the emitter's buffer.
+	void emit_document(XmlEmitter &xml, const MarkerList &markers, uint32_t fps_num, uint32_t fps_den,
+			   MarkerRenderCache *render_cache = nullptr) const;
 
 private:
-	QString build_xmp(const QVector<MarkerRecord> &markers, uint32_t fps_num, uint32_t fps_den) const;
-	static QString xml_escape(const QString &value);
+	struct IncrementalState {
+		MarkerList markers;
+		uint32_t fps_num = 30;
+		uint32_t fps_den = 1;
+		// Byte offset of the closing </rdf:Seq> tail and the sidecar size it implies.
+		qint64 tail_offset = 0;
+		qint64 file_size = 0;
+		std::shared_ptr<MarkerRenderCache> render_cache;
+	};
+
+	void emit_marker_items(XmlEmitter &xml, const MarkerList &markers, int first,
+			       MarkerRenderCache *render_cache) const;
+	bool can_splice(const QString &sidecar_path, const IncrementalState &state,
+			const MarkerList &markers, uint32_t fps_num, uint32_t fps_den) const;
+
+	std::mutex m_mutex;
+	QHash<QString, IncrementalState> m_incremental;
 };
 
 } // namespace bm
@@ -266,6 +266,7 @@ public:
 		create_main_dock(main_window);
 		refresh_runtime_bindings();
 		m_tracker.sync_from_frontend_state();
+		m_controller->replay_marker_journals();
 		m_controller->start_recovery_queue_async();
 		check_for_updates_on_startup();
 		const uint64_t after_startup_tasks_ns = os_gettime_ns();
@@ -417,6 +418,7 @@ private:
 
 	void refresh_runtime_bindings()
 	{
+		m_tracker.set_render_clock_enabled(m_store.stamp_markers_with_rendered_frame());
 		const QVector<bm::MarkerTemplate> active_templates = m_store.merged_templates();
 		if (m_controller) {
 			m_controller->set_active_templates(active_templates);
@@ -0,0 +1,184 @@
+#include "bm-chapter-marker-sink.hpp"
+#include "bm-csv-marker-sink.hpp"
+#include "bm-edl-marker-sink.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+void require_text(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Append text sink test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+QByteArray read_file(const QString &path)
+{
+	QFile file(path);
+	require_text(file.open(QIODevice::ReadOnly), "artifact readable");
+	return file.readAll();
+}
+
+bm::MarkerRecord sample_marker(int64_t start_frame, const QString &name)
+{
+	bm::MarkerRecord marker;
+	marker.start_frame = start_frame;
+	marker.name = name;
+	marker.guid = QString("guid-%1").arg(start_frame);
+	return marker;
+}
+
+bm::MarkerExportRecordingContext recording_context(const QTemporaryDir &temp_dir, uint32_t fps_num, uint32_t fps_den)
+{
+	bm::MarkerExportRecordingContext ctx;
+	ctx.media_path = temp_dir.path() + "/Stream.mp4";
+	ctx.fps_num = fps_num;
+	ctx.fps_den = fps_den;
+	return ctx;
+}
+
+// Adds the markers one at a time, as the controller does under the Immediate cadence.
+void add_all(bm::AppendOnlyTextSink &sink, const bm::MarkerExportRecordingContext &ctx,
+	     const QVector<bm::MarkerRecord> &markers)
+{
+	QVector<bm::MarkerRecord> added;
+	QString error;
+	for (const bm::MarkerRecord &marker : markers) {
+		added.push_back(marker);
+		require_text(sink.on_marker_added(ctx, marker, added, &error), "marker exported");
+	}
+}
+
+void test_edl_records()
+{
+	QTemporaryDir temp_dir;
+	require_text(temp_dir.isValid(), "temporary directory created");
+	const bm::MarkerExportRecordingContext ctx = recording_context(temp_dir, 30000, 1001);
+
+	bm::MarkerRecord colored = sample_marker(1800, "Boss\nfight");
+	colored.color_id = 5;
+	bm::EdlMarkerSink sink;
+	add_all(sink, ctx, {sample_marker(30, " Intro "), colored});
+
+	const QByteArray edl = read_file(sink.artifact_path_for_media(ctx.media_path));
+	require_text(edl.startsWith("TITLE: Stream\nFCM: DROP FRAME\n\n"), "EDL header");
+	require_text(edl.contains("001  001      V     C        00:00:01;00 00:00:01;01 00:00:01;00 00:00:01;01  \n"
+				  " |C:ResolveColorGreen |M:Intro |D:1\n\n"),
+		     "first EDL event");
+	require_text(edl.contains("002  001      V     C        00:01:00;02 00:01:00;03 00:01:00;02 00:01:00;03  \n"
+				  " |C:ResolveColorBlue |M:Boss fight |D:1\n\n"),
+		     "second EDL event, drop-frame and single-line name");
+}
+
+void test_csv_rows()
+{
+	QTemporaryDir temp_dir;
+	require_text(temp_dir.isValid(), "temporary directory created");
+	const bm::MarkerExportRecordingContext ctx = recording_context(temp_dir, 60, 1);
+
+	bm::MarkerRecord quoted = sample_marker(90, "Say \"hi\", chat");
+	quoted.comment = "line one\nline two";
+	quoted.color_id = 2;
+	bm::CsvMarkerSink sink;
+	add_all(sink, ctx, {sample_marker(0, "Start"), quoted});
+
+	require_text(read_file(sink.artifact_path_for_media(ctx.media_path)) ==
+			     "index,frame,timecode,seconds,duration_frames,color,name,comment,guid\n"
+			     "1,0,00:00:00:00,0.000,0,green,Start,,guid-0\n"
+			     "2,90,00:00:01:30,1.500,0,orange,\"Say \"\"hi\"\", chat\",\"line one\nline two\","
+			     "guid-90\n",
+		     "CSV rows with RFC 4180 quoting");
+}
+
+void test_chapter_lines()
+{
+	QTemporaryDir temp_dir;
+	require_text(temp_dir.isValid(), "temporary directory created");
+	const bm::MarkerExportRecordingContext ctx = recording_context(temp_dir, 25, 1);
+
+	bm::ChapterMarkerSink sink;
+	add_all(sink, ctx,
+		{sample_marker(0, "Intro"), sample_marker(25 * 754, ""), sample_marker(25 * 3723, "Outro")});
+
+	require_text(read_file(sink.artifact_path_for_media(ctx.media_path)) ==
+			     "0:00 Intro\n12:34 Marker\n1:02:03 Outro\n",
+		     "YouTube chapter lines");
+
+	// YouTube needs the list to start at 0:00.
+	QTemporaryDir late_dir;
+	require_text(late_dir.isValid(), "second temporary directory created");
+	const bm::MarkerExportRecordingContext late_ctx = recording_context(late_dir, 25, 1);
+	bm::ChapterMarkerSink late_sink;
+	add_all(late_sink, late_ctx, {sample_marker(25 * 95, "Topic"), sample_marker(25 * 130, "Next")});
+	require_text(read_file(late_sink.artifact_path_for_media(late_ctx.media_path)) ==
+			     "0:00 Start\n1:35 Topic\n2:10 Next\n",
+		     "opening chapter added before a later first marker");
+}
+
+void test_appends_without_rewrite()
+{
+	QTemporaryDir temp_dir;
+	require_text(temp_dir.isValid(), "temporary directory created");
+	const bm::MarkerExportRecordingContext ctx = recording_context(temp_dir, 30, 1);
+	bm::ChapterMarkerSink sink;
+	const QString path = sink.artifact_path_for_media(ctx.media_path);
+	QString error;
+
+	QVector<bm::MarkerRecord> markers = {sample_marker(0, "One")};
+	require_text(sink.on_marker_added(ctx, markers.last(), markers, &error), "first marker written");
+
+	// A tailer's view: a marker only ever adds bytes after the ones already there.
+	QFile tail(path);
+	require_text(tail.open(QIODevice::ReadOnly), "tail opened");
+	require_text(tail.readAll() == "0:00 One\n", "first line");
+
+	markers.push_back(sample_marker(60, "Two"));
+	markers.push_back(sample_marker(90, "Three"));
+	require_text(sink.on_marker_added(ctx, markers.last(), markers, &error), "batch appended");
+	require_text(tail.readAll() == "0:02 Two\n0:03 Three\n", "tailer sees only the new lines");
+	require_text(sink.on_marker_added(ctx, markers.last(), markers, &error), "no new markers");
+	require_text(tail.readAll().isEmpty(), "nothing written without new markers");
+	tail.close();
+
+	// Someone else wrote to the file: the next marker rewrites it rather than appending after foreign bytes.
+	QFile foreign(path);
+	require_text(foreign.open(QIODevice::WriteOnly | QIODevice::Append) && foreign.write("junk\n") == 5,
+		     "foreign append");
+	foreign.close();
+	markers.push_back(sample_marker(120, "Four"));
+	require_text(sink.on_marker_added(ctx, markers.last(), markers, &error), "marker after foreign change");
+	require_text(read_file(path) == "0:00 One\n0:02 Two\n0:03 Three\n0:04 Four\n", "file rebuilt from the list");
+
+	// After close, a replayed recording starts the file over instead of duplicating its lines.
+	require_text(sink.on_recording_closed(ctx, &error), "recording closed");
+	require_text(sink.on_marker_added(ctx, markers.last(), markers, &error), "replayed markers written");
+	require_text(read_file(path) == "0:00 One\n0:02 Two\n0:03 Three\n0:04 Four\n", "replay does not duplicate");
+}
+
+void test_other_containers_are_skipped()
+{
+	QTemporaryDir temp_dir;
+	require_text(temp_dir.isValid(), "temporary directory created");
+	bm::MarkerExportRecordingContext ctx = recording_context(temp_dir, 30, 1);
+	ctx.media_path = temp_dir.path() + "/Stream.mkv";
+	bm::CsvMarkerSink sink;
+	add_all(sink, ctx, {sample_marker(0, "One")});
+	require_text(!QFile::exists(sink.artifact_path_for_media(ctx.media_path)), "no CSV for MKV recordings");
+}
+
+} // namespace
+
+void run_append_text_sink_tests()
+{
+	test_edl_records();
+	test_csv_rows();
+	test_chapter_lines();
+	test_appends_without_rewrite();
+	test_other_containers_are_skipped();
+}
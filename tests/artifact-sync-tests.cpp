@@ -0,0 +1,293 @@
+#include "bm-artifact-sync.hpp"
+#include "bm-fcpxml-writer.hpp"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+void require_sync(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Artifact sync test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// Windows has no directory sync; the rename is written through instead.
+int directory_syncs(int directories)
+{
+#if defined(_WIN32)
+	Q_UNUSED(directories);
+	return 0;
+#else
+	return directories;
+#endif
+}
+
+QByteArray read_file(const QString &path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	return file.readAll();
+}
+
+void write_file(const QString &path, const QByteArray &contents)
+{
+	QFile file(path);
+	require_sync(file.open(QIODevice::WriteOnly | QIODevice::Truncate), "file writable");
+	require_sync(file.write(contents) == contents.size(), "file written");
+}
+
+bool has_temp_files(const QString &directory)
+{
+	return !QDir(directory).entryList(QStringList{"*.tmp"}, QDir::Files, QDir::Name).isEmpty();
+}
+
+void test_strict_syncs_each_artifact()
+{
+	QTemporaryDir temp_dir;
+	require_sync(temp_dir.isValid(), "temporary directory created");
+	bm::ArtifactSyncer syncer;
+	syncer.set_policy(bm::ArtifactDurability::Strict, 1000);
+	const QString path = temp_dir.path() + "/Stream.fcpxml";
+	write_file(path, "old");
+
+	QString error;
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		require_sync(batch.durability() == bm::ArtifactDurability::Strict, "batch takes the syncer's policy");
+		for (int i = 0; i < 3; ++i) {
+			const QString artifact = temp_dir.path() + QString("/Stream.%1.txt").arg(i);
+			const QByteArray contents = "artifact " + QByteArray::number(i);
+			require_sync(batch.replace_file(artifact, contents, &error), "strict write");
+			require_sync(read_file(artifact) == contents, "strict write is in place before commit");
+		}
+		require_sync(batch.replace_file(path, "new", &error), "strict replace");
+		require_sync(read_file(path) == "new", "strict replace lands right away");
+		require_sync(batch.stats().artifacts == 4 && batch.stats().file_syncs == 4, "one sync per artifact");
+		require_sync(batch.stats().directory_syncs == directory_syncs(4), "one directory sync per artifact");
+		require_sync(batch.commit(&error), "strict commit");
+	}
+	require_sync(!has_temp_files(temp_dir.path()), "no temp files left behind");
+	require_sync(syncer.totals().artifacts == 4 && syncer.totals().file_syncs == 4, "syncer totals");
+
+	// Without a batch, write_artifact is a Strict write of its own.
+	require_sync(bm::write_artifact(path, "standalone", nullptr, &error), "standalone write");
+	require_sync(read_file(path) == "standalone", "standalone write lands");
+	require_sync(!bm::write_artifact(temp_dir.path() + "/missing/Stream.xmp", "x", nullptr, &error),
+		     "write into a missing directory fails");
+	require_sync(error.contains("missing/Stream.xmp"), "error names the artifact");
+}
+
+void test_grouped_syncs_once_per_event()
+{
+	QTemporaryDir temp_dir;
+	require_sync(temp_dir.isValid(), "temporary directory created");
+	require_sync(QDir().mkpath(temp_dir.path() + "/exports"), "second directory created");
+	bm::ArtifactSyncer syncer;
+	syncer.set_policy(bm::ArtifactDurability::Grouped, 1000);
+	const QStringList paths{temp_dir.path() + "/Stream.xmp", temp_dir.path() + "/Stream.fcpxml",
+				temp_dir.path() + "/Stream.csv", temp_dir.path() + "/exports/Stream.edl"};
+	for (const QString &path : paths)
+		write_file(path, "old");
+
+	QString error;
+	bm::ArtifactSyncBatch batch(&syncer);
+	for (const QString &path : paths)
+		require_sync(batch.replace_file(path, "new " + path.toUtf8(), &error), "grouped write");
+	for (const QString &path : paths)
+		require_sync(read_file(path) == "old", "grouped writes appear only at commit");
+	require_sync(batch.stats().file_syncs == 0, "nothing synced before commit");
+
+	require_sync(batch.commit(&error), "grouped commit");
+	for (const QString &path : paths)
+		require_sync(read_file(path) == "new " + path.toUtf8(), "grouped write committed");
+	require_sync(batch.stats().artifacts == 4 && batch.stats().file_syncs == 4, "one sync per artifact");
+	require_sync(batch.stats().directory_syncs == directory_syncs(2), "one sync per directory");
+	require_sync(!has_temp_files(temp_dir.path()) && !has_temp_files(temp_dir.path() + "/exports"),
+		     "no temp files left behind");
+	require_sync(batch.commit(&error), "second commit is a no-op");
+	require_sync(batch.stats().file_syncs == 4, "second commit syncs nothing");
+
+	// A batch going out of scope commits.
+	{
+		bm::ArtifactSyncBatch scoped(&syncer);
+		require_sync(scoped.replace_file(paths.first(), "scoped", &error), "scoped write");
+	}
+	require_sync(read_file(paths.first()) == "scoped", "destroyed batch committed");
+
+	// FCPXML documents go through the batch they are given.
+	bm::FcpxmlDocumentInput input;
+	input.media_path = temp_dir.path() + "/Stream.mov";
+	bm::MarkerRecord marker;
+	marker.start_frame = 30;
+	marker.name = "Grouped";
+	input.markers = QVector<bm::MarkerRecord>{marker};
+	const QString document_path = temp_dir.path() + "/Stream.fcpxml";
+	bm::ArtifactSyncBatch document_batch(&syncer);
+	input.sync_batch = &document_batch;
+	require_sync(bm::FcpxmlWriter().write_document(document_path, input, &error), "batched FCPXML write");
+	require_sync(!read_file(document_path).contains("Grouped"), "batched FCPXML waits for commit");
+	require_sync(document_batch.commit(&error), "FCPXML batch commit");
+	require_sync(read_file(document_path) == bm::FcpxmlWriter().build_document(input), "batched FCPXML committed");
+}
+
+void test_grouped_commit_failure_keeps_old_artifact()
+{
+	QTemporaryDir temp_dir;
+	require_sync(temp_dir.isValid(), "temporary directory created");
+	bm::ArtifactSyncer syncer;
+	syncer.set_policy(bm::ArtifactDurability::Grouped, 1000);
+	const QString kept = temp_dir.path() + "/Stream.csv";
+	const QString replaced = temp_dir.path() + "/Stream.edl";
+	write_file(kept, "old");
+
+	QString error;
+	bm::ArtifactSyncBatch batch(&syncer);
+	require_sync(batch.replace_file(replaced, "new", &error), "grouped write");
+	require_sync(!batch.replace_file(temp_dir.path() + "/missing/Stream.xmp", "x", &error), "unwritable artifact");
+	require_sync(batch.commit(&error), "other artifacts still commit");
+	require_sync(read_file(replaced) == "new" && read_file(kept) == "old", "only staged artifacts change");
+	require_sync(batch.stats().artifacts == 1, "failed artifact not counted");
+}
+
+void test_deferred_syncs_in_the_background()
+{
+	QTemporaryDir temp_dir;
+	require_sync(temp_dir.isValid(), "temporary directory created");
+	bm::ArtifactSyncer syncer;
+	syncer.set_policy(bm::ArtifactDurability::Deferred, bm::kMaxArtifactSyncWindowMs);
+	const QString xmp = temp_dir.path() + "/Stream.xmp";
+	const QString csv = temp_dir.path() + "/Stream.csv";
+
+	QString error;
+	for (int i = 0; i < 3; ++i) {
+		bm::ArtifactSyncBatch batch(&syncer);
+		require_sync(batch.replace_file(xmp, "xmp " + QByteArray::number(i), &error), "deferred XMP write");
+		require_sync(batch.replace_file(csv, "csv " + QByteArray::number(i), &error), "deferred CSV write");
+		require_sync(read_file(xmp) == "xmp " + QByteArray::number(i), "deferred write lands right away");
+		require_sync(batch.commit(&error), "deferred commit");
+		require_sync(batch.stats().artifacts == 2 && batch.stats().file_syncs == 0,
+			     "deferred batch syncs nothing");
+	}
+	require_sync(syncer.deferred_count() == 6, "every write deferred");
+
+	bm::ArtifactSyncStats synced;
+	require_sync(syncer.sync_deferred(&synced, &error), "deferred sync");
+	require_sync(synced.file_syncs == 2, "each artifact synced once, in its latest version");
+	require_sync(synced.directory_syncs == directory_syncs(1), "one directory sync for the window");
+	require_sync(syncer.deferred_count() == 0, "nothing left deferred");
+	require_sync(syncer.totals().artifacts == 6 && syncer.totals().file_syncs == 2, "syncer totals");
+
+	// Artifacts removed before their window closes are skipped.
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		require_sync(batch.replace_file(csv, "gone", &error), "deferred write");
+	}
+	QFile::remove(csv);
+	require_sync(syncer.sync_deferred(&synced, &error) && synced.file_syncs == 0, "removed artifact skipped");
+
+	// The syncer thread syncs once the window after the first deferred artifact passes.
+	std::mutex mutex;
+	std::condition_variable cv;
+	int callbacks = 0;
+	bm::ArtifactSyncStats window_synced;
+	syncer.set_deferred_sync_callback([&](const bm::ArtifactSyncStats &stats, const QString &) {
+		std::lock_guard<std::mutex> lock(mutex);
+		window_synced = stats;
+		++callbacks;
+		cv.notify_all();
+	});
+	syncer.set_policy(bm::ArtifactDurability::Deferred, bm::kMinArtifactSyncWindowMs);
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		require_sync(batch.replace_file(xmp, "windowed", &error), "windowed write");
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		require_sync(cv.wait_for(lock, std::chrono::seconds(10), [&callbacks]() { return callbacks > 0; }),
+			     "window synced in the background");
+		require_sync(window_synced.file_syncs == 1, "window synced the deferred artifact");
+	}
+	require_sync(syncer.deferred_count() == 0, "window drained");
+
+	// Stopping syncs what is still deferred.
+	syncer.set_policy(bm::ArtifactDurability::Deferred, bm::kMaxArtifactSyncWindowMs);
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		require_sync(batch.replace_file(xmp, "stopping", &error), "write before stop");
+	}
+	const int synced_before_stop = syncer.totals().file_syncs;
+	syncer.stop();
+	require_sync(syncer.totals().file_syncs == synced_before_stop + 1, "stop syncs the deferred artifact");
+}
+
+void test_in_place_writes_follow_the_policy()
+{
+	QTemporaryDir temp_dir;
+	require_sync(temp_dir.isValid(), "temporary directory created");
+	bm::ArtifactSyncer syncer;
+	const QString path = temp_dir.path() + "/Stream.xmp";
+	write_file(path, "old");
+	QString error;
+
+	const auto write_in_place = [&](bm::ArtifactSyncBatch &batch, const QByteArray &contents) {
+		QFile file(path);
+		require_sync(file.open(QIODevice::ReadWrite) && file.write(contents) == contents.size(),
+			     "in-place write");
+		require_sync(batch.sync_in_place(file, &error), "in-place sync");
+	};
+
+	syncer.set_policy(bm::ArtifactDurability::Strict, 1000);
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		write_in_place(batch, "strict");
+		require_sync(batch.stats().artifacts == 1 && batch.stats().file_syncs == 1, "strict syncs at once");
+		require_sync(batch.stats().directory_syncs == 0, "nothing renamed, no directory sync");
+	}
+
+	syncer.set_policy(bm::ArtifactDurability::Grouped, 1000);
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		write_in_place(batch, "grouped");
+		write_in_place(batch, "grouped");
+		require_sync(read_file(path) == "grouped", "in-place write visible before commit");
+		require_sync(batch.stats().file_syncs == 0, "grouped waits for commit");
+		require_sync(batch.commit(&error), "grouped commit");
+		require_sync(batch.stats().artifacts == 1 && batch.stats().file_syncs == 1,
+			     "grouped syncs the artifact once at commit");
+		require_sync(batch.stats().directory_syncs == 0, "nothing renamed, no directory sync");
+	}
+
+	syncer.set_policy(bm::ArtifactDurability::Deferred, bm::kMaxArtifactSyncWindowMs);
+	{
+		bm::ArtifactSyncBatch batch(&syncer);
+		write_in_place(batch, "deferred");
+		require_sync(batch.commit(&error), "deferred commit");
+		require_sync(batch.stats().artifacts == 1 && batch.stats().file_syncs == 0,
+			     "deferred batch syncs nothing");
+	}
+	require_sync(syncer.deferred_count() == 1, "in-place write deferred");
+	bm::ArtifactSyncStats synced;
+	require_sync(syncer.sync_deferred(&synced, &error) && synced.file_syncs == 1, "deferred sync");
+}
+
+} // namespace
+
+void run_artifact_sync_tests()
+{
+	test_strict_syncs_each_artifact();
+	test_grouped_syncs_once_per_event();
+	test_grouped_commit_failure_keeps_old_artifact();
+	test_deferred_syncs_in_the_background();
+	test_in_place_writes_follow_the_policy();
+}
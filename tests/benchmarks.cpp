@@ -0,0 +1,402 @@
+// Benchmarks for the plugin's hot paths: XML rendering and escaping, export times, the marker list and marker
+// timing.
+//
+// Bytes allocated per rendered document, before (QTextStream into a QString with escaped QString copies, then
+// toUtf8) and after (XmlEmitter into the thread's XmlArena). Allocation counting interposes malloc and therefore needs
+// glibc without sanitizers; elsewhere only timings are printed.
+//
+// The second table is the escape microbenchmark: the five QString::replace passes against XmlEmitter::text on marker
+// names, and each copy kernel this CPU can run on plain ASCII. The third times FCPXML start times: gcd plus
+// QString::arg against FrameRate at a table rate and at one outside the table.
+//
+// The fourth adds markers one at a time to a recording's list while the previous event still holds the list, as the
+// export queue and the XMP writer do: a QVector detaches and copies every marker on each add, a MarkerLog only
+// appends and hands out a snapshot. Reading the whole list back is timed for both.
+//
+// Marker timing closes the run: the render clock's per-frame tick (which runs on OBS's graphics thread and has to
+// stay well under a microsecond), recording a packet, and a capture's packet-timeline estimate over a full ring.
+//
+//   better-markers-bench [markers-per-document] [documents] [markers-per-recording]
+
+#include "bm-fcpxml-writer.hpp"
+#include "bm-marker-log.hpp"
+#include "bm-packet-timeline.hpp"
+#include "bm-recording-clock.hpp"
+#include "bm-render-frame-clock.hpp"
+#include "bm-xml-escape.hpp"
+#include "bm-xmp-sidecar-writer.hpp"
+
+#include <QTextStream>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define BM_BENCH_COUNTS_ALLOCATIONS 1
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+}
+
+namespace {
+std::atomic<quint64> g_allocations{0};
+std::atomic<quint64> g_allocated_bytes{0};
+
+void count_allocation(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+} // namespace
+
+extern "C" void *malloc(size_t size)
+{
+	count_allocation(size);
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+	count_allocation(count * size);
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+	count_allocation(size);
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+namespace {
+
+QString legacy_escape(const QString &value)
+{
+	QString escaped = value;
+	escaped.replace('&', "&amp;");
+	escaped.replace('<', "&lt;");
+	escaped.replace('>', "&gt;");
+	escaped.replace('"', "&quot;");
+	escaped.replace('\'', "&apos;");
+	return escaped;
+}
+
+QVector<bm::MarkerRecord> sample_markers(int count)
+{
+	QVector<bm::MarkerRecord> markers;
+	markers.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		bm::MarkerRecord marker;
+		marker.start_frame = 1800 * (i + 1);
+		marker.name = QString("Highlight %1 <\"caf\xC3\xA9\" & co>").arg(i);
+		marker.comment = i % 3 ? QString("clip \xE2\x9C\x93") : QString();
+		marker.guid = QString("0c8f2a1e-5b7d-4c3a-9e61-%1").arg(i, 12, 10, QChar('0'));
+		markers.push_back(marker);
+	}
+	return markers;
+}
+
+// The marker part of the pre-emitter XMP writer; the fixed header and trailer are left out, which only flatters it.
+QByteArray legacy_xmp_markers(const QVector<bm::MarkerRecord> &markers)
+{
+	QString xml;
+	QTextStream stream(&xml);
+	stream.setEncoding(QStringConverter::Utf8);
+	for (const bm::MarkerRecord &marker : markers) {
+		stream << "                  <rdf:li>\n";
+		stream << "                    <rdf:Description xmpDM:startTime=\"" << marker.start_frame << "\"";
+		stream << " xmpDM:name=\"" << legacy_escape(marker.name) << "\"";
+		stream << " xmpDM:comment=\"" << legacy_escape(marker.comment) << "\"";
+		stream << " xmpDM:type=\"" << legacy_escape(marker.type) << "\"";
+		stream << " xmpDM:guid=\"" << legacy_escape(marker.guid) << "\">\n";
+		stream << "                      <xmpDM:cuePointParams>\n";
+		stream << "                        <rdf:Seq>\n";
+		stream << "                          <rdf:li xmpDM:key=\"marker_guid\" xmpDM:value=\""
+		       << legacy_escape(marker.guid) << "\"/>\n";
+		stream << "                        </rdf:Seq>\n";
+		stream << "                      </xmpDM:cuePointParams>\n";
+		stream << "                    </rdf:Description>\n";
+		stream << "                  </rdf:li>\n";
+	}
+	stream.flush();
+	return xml.toUtf8();
+}
+
+// The marker lines of the pre-emitter FCPXML writer, again without the fixed envelope.
+QByteArray legacy_fcpxml_markers(const bm::FcpxmlDocumentInput &input)
+{
+	QString xml;
+	QTextStream stream(&xml);
+	stream.setEncoding(QStringConverter::Utf8);
+	const QString marker_duration = bm::FcpxmlWriter::frame_duration_rational(input.fps_num, input.fps_den);
+	for (const bm::MarkerRecord &marker : input.markers) {
+		const QString start =
+			bm::FcpxmlWriter::rational_time_from_frames(marker.start_frame, input.fps_num, input.fps_den);
+		stream << "              <marker start=\"" << start << "\" duration=\"" << marker_duration
+		       << "\" value=\"" << legacy_escape(marker.name.trimmed()) << "\" note=\""
+		       << legacy_escape(marker.comment) << "\"/>\n";
+	}
+	stream.flush();
+	return xml.toUtf8();
+}
+
+struct Sample {
+	double allocations = 0;
+	double bytes = 0;
+	double micros = 0;
+	qsizetype document_size = 0;
+};
+
+Sample measure(int documents, const std::function<qsizetype()> &render)
+{
+	render(); // Warm-up: sizes the arena, as the first marker of a recording does.
+#if defined(BM_BENCH_COUNTS_ALLOCATIONS)
+	const quint64 allocations_before = g_allocations.load();
+	const quint64 bytes_before = g_allocated_bytes.load();
+#endif
+	const auto started = std::chrono::steady_clock::now();
+	Sample sample;
+	for (int i = 0; i < documents; ++i)
+		sample.document_size = render();
+	const auto elapsed = std::chrono::steady_clock::now() - started;
+	sample.micros = std::chrono::duration<double, std::micro>(elapsed).count() / documents;
+#if defined(BM_BENCH_COUNTS_ALLOCATIONS)
+	sample.allocations = static_cast<double>(g_allocations.load() - allocations_before) / documents;
+	sample.bytes = static_cast<double>(g_allocated_bytes.load() - bytes_before) / documents;
+#endif
+	return sample;
+}
+
+void print_row(const char *label, const Sample &sample)
+{
+#if defined(BM_BENCH_COUNTS_ALLOCATIONS)
+	std::printf("%-24s %10lld %14.0f %12.1f %10.2f\n", label, static_cast<long long>(sample.document_size),
+		    sample.bytes, sample.allocations, sample.micros);
+#else
+	std::printf("%-24s %10lld %14s %12s %10.2f\n", label, static_cast<long long>(sample.document_size), "n/a",
+		    "n/a", sample.micros);
+#endif
+}
+
+double mib_per_second(qint64 units, const std::function<void()> &run)
+{
+	run();
+	const int rounds = 20;
+	const auto started = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i)
+		run();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	return static_cast<double>(units) * sizeof(char16_t) * rounds / seconds / (1024.0 * 1024.0);
+}
+
+void run_escape_benchmark(const QVector<bm::MarkerRecord> &markers)
+{
+	QVector<QString> names;
+	qint64 name_units = 0;
+	for (int round = 0; round < 64; ++round) {
+		for (const bm::MarkerRecord &marker : markers) {
+			names.push_back(marker.name);
+			names.push_back(QString("Round %1 start, nothing to escape here").arg(round));
+			name_units += marker.name.size() + names.last().size();
+		}
+	}
+
+	std::printf("\n%-24s %14s\n", "escape", "MiB/s (UTF-16)");
+	qsizetype sink = 0;
+	std::printf("%-24s %14.0f\n", "5x replace + toUtf8", mib_per_second(name_units, [&] {
+			    for (const QString &name : names)
+				    sink += legacy_escape(name).toUtf8().size();
+		    }));
+	std::printf("%-24s %14.0f\n", "XmlEmitter::text", mib_per_second(name_units, [&] {
+			    bm::XmlArena arena;
+			    bm::XmlEmitter xml(arena.buffer());
+			    for (const QString &name : names)
+				    xml.text(name);
+			    sink += xml.size();
+		    }));
+
+	const std::vector<char16_t> plain(1 << 20, u'a');
+	std::vector<char> out(plain.size());
+	for (const bm::xml_escape_detail::Kernel &kernel : bm::xml_escape_detail::available_kernels()) {
+		const QByteArray label = QByteArray("plain copy, ") + kernel.name;
+		std::printf("%-24s %14.0f\n", label.constData(),
+			    mib_per_second(static_cast<qint64>(plain.size()), [&] {
+				    sink += kernel.copy_plain(plain.data(), static_cast<qsizetype>(plain.size()),
+							      out.data());
+			    }));
+	}
+	if (sink == 0)
+		std::printf("(nothing rendered)\n");
+}
+
+double nanos_per_frame(int64_t frames, const std::function<qsizetype(int64_t)> &format)
+{
+	qsizetype sink = 0;
+	const auto started = std::chrono::steady_clock::now();
+	for (int64_t frame = 0; frame < frames; ++frame)
+		sink += format(frame);
+	const auto elapsed = std::chrono::steady_clock::now() - started;
+	if (sink == 0)
+		std::printf("(nothing formatted)\n");
+	return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(frames);
+}
+
+void run_frame_time_benchmark()
+{
+	const int64_t frames = 1 << 20;
+	std::printf("\n%-24s %14s\n", "start time", "ns/marker");
+	std::printf("%-24s %14.1f\n", "gcd + QString::arg", nanos_per_frame(frames, [](int64_t frame) {
+			    const int64_t num = frame * 1001;
+			    const int64_t divisor = std::max<int64_t>(1, std::gcd(num, int64_t(30000)));
+			    return QString("%1/%2s").arg(num / divisor).arg(30000 / divisor).size();
+		    }));
+	for (const auto &[label, fps_num, fps_den] :
+	     {std::tuple<const char *, uint32_t, uint32_t>{"FrameRate 29.97 (table)", 30000, 1001},
+	      std::tuple<const char *, uint32_t, uint32_t>{"FrameRate 14.985 (gcd)", 15000, 1001}}) {
+		const bm::FrameRate rate = bm::FrameRate::from_obs(fps_num, fps_den);
+		char buffer[bm::FrameRate::kMaxRationalTimeSize];
+		std::printf("%-24s %14.1f\n", label, nanos_per_frame(frames, [&](int64_t frame) {
+				    return static_cast<qsizetype>(rate.write_frame_time(buffer, frame) - buffer);
+			    }));
+	}
+}
+
+void run_marker_list_benchmark(const QVector<bm::MarkerRecord> &source)
+{
+	const int events = static_cast<int>(source.size());
+	std::printf("\n%d markers added to one recording\n", events);
+	std::printf("%-24s %10s %14s %12s %10s\n", "marker list", "markers", "alloc B/add", "allocs/add", "us/add");
+
+	// measure()'s warm-up call adds the first marker, so each list ends up holding every marker of the source.
+	QVector<bm::MarkerRecord> vector;
+	QVector<bm::MarkerRecord> vector_held;
+	int next = 0;
+	print_row("QVector copy (before)", measure(events - 1, [&] {
+			  vector.push_back(source.at(next++));
+			  vector_held = vector;
+			  return vector_held.size();
+		  }));
+
+	bm::MarkerLog log;
+	bm::MarkerList log_held;
+	next = 0;
+	print_row("MarkerLog snapshot", measure(events - 1, [&] {
+			  log.append(source.at(next++));
+			  log_held = log.snapshot();
+			  return log_held.size();
+		  }));
+
+	std::printf("\n%-24s %14s\n", "read whole list", "ns/marker");
+	const auto nanos_per_marker = [events](const std::function<int64_t()> &read) {
+		int64_t sink = read();
+		const int rounds = 50;
+		const auto started = std::chrono::steady_clock::now();
+		for (int i = 0; i < rounds; ++i)
+			sink += read();
+		const auto elapsed = std::chrono::steady_clock::now() - started;
+		if (sink == 0)
+			std::printf("(nothing read)\n");
+		return std::chrono::duration<double, std::nano>(elapsed).count() / rounds / events;
+	};
+	std::printf("%-24s %14.2f\n", "QVector", nanos_per_marker([&] {
+			    int64_t sum = 0;
+			    for (const bm::MarkerRecord &marker : vector_held)
+				    sum += marker.start_frame + marker.name.size();
+			    return sum;
+		    }));
+	std::printf("%-24s %14.2f\n", "MarkerList", nanos_per_marker([&] {
+			    int64_t sum = 0;
+			    for (const bm::MarkerRecord &marker : log_held)
+				    sum += marker.start_frame + marker.name.size();
+			    return sum;
+		    }));
+}
+
+void run_marker_timing_benchmark()
+{
+	constexpr uint64_t kFrameNs = 16683334;
+	const int ticks = 1 << 22;
+	auto nanos_per_call = [](int calls, const std::function<void(int)> &call) {
+		const auto started = std::chrono::steady_clock::now();
+		for (int i = 0; i < calls; ++i)
+			call(i);
+		const auto elapsed = std::chrono::steady_clock::now() - started;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(calls);
+	};
+
+	std::printf("\n%-24s %14s\n", "marker timing", "ns/call");
+	bm::RenderFrameClock clock;
+	std::printf("%-24s %14.1f\n", "render clock tick", nanos_per_call(ticks, [&](int i) {
+			    clock.tick(static_cast<uint64_t>(i) * kFrameNs);
+			    clock.record_callback_cost(40);
+		    }));
+
+	bm::PacketTimeline timeline;
+	std::printf("%-24s %14.1f\n", "packet record", nanos_per_call(ticks, [&](int i) {
+			    bm::PacketSample sample;
+			    sample.pts_ns = static_cast<uint64_t>(i) * kFrameNs;
+			    sample.received_ns = sample.pts_ns + 700000000;
+			    sample.composed_ns = sample.pts_ns;
+			    timeline.record(sample);
+		    }));
+
+	int64_t sink = 0;
+	std::printf("%-24s %14.1f\n", "capture estimate", nanos_per_call(1 << 16, [&](int i) {
+			    const bm::RenderTick tick = clock.load();
+			    uint64_t trigger_ns = tick.frame_time_ns + static_cast<uint64_t>(i % 7) * 1000;
+			    bm::rendered_frame_midpoint(tick, trigger_ns, 60000, 1001, &trigger_ns);
+			    sink += timeline.estimate(trigger_ns, 60000, 1001).frame;
+		    }));
+	if (sink == 0)
+		std::printf("(nothing estimated)\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	const int marker_count = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+	const int documents = argc > 2 ? std::max(1, std::atoi(argv[2])) : 2000;
+	const int recording_markers = argc > 3 ? std::max(2, std::atoi(argv[3])) : 10000;
+
+	bm::FcpxmlDocumentInput input;
+	input.media_path = "/recordings/2026-10-16 Stream.mp4";
+	input.fps_num = 30000;
+	input.fps_den = 1001;
+	const QVector<bm::MarkerRecord> markers = sample_markers(marker_count);
+	input.markers = markers;
+
+	const bm::FcpxmlWriter fcpxml_writer;
+	const bm::XmpSidecarWriter xmp_writer;
+
+	std::printf("%d markers per document, %d documents\n", marker_count, documents);
+	std::printf("%-24s %10s %14s %12s %10s\n", "renderer", "doc bytes", "alloc B/doc", "allocs/doc", "us/doc");
+	print_row("xmp markers (before)", measure(documents, [&] { return legacy_xmp_markers(markers).size(); }));
+	print_row("xmp document (after)", measure(documents, [&] {
+			  bm::XmlArena arena;
+			  bm::XmlEmitter xml(arena.buffer());
+			  xmp_writer.emit_document(xml, input.markers, input.fps_num, input.fps_den);
+			  return xml.size();
+		  }));
+	print_row("fcpxml markers (before)", measure(documents, [&] { return legacy_fcpxml_markers(input).size(); }));
+	print_row("fcpxml document (after)", measure(documents, [&] {
+			  bm::XmlArena arena;
+			  bm::XmlEmitter xml(arena.buffer());
+			  fcpxml_writer.emit_document(xml, input);
+			  return xml.size();
+		  }));
+	run_escape_benchmark(markers);
+	run_frame_time_benchmark();
+	run_marker_list_benchmark(sample_markers(recording_markers));
+	run_marker_timing_benchmark();
+	return 0;
+}
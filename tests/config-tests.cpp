@@ -1,6 +1,7 @@
 #include "bm-focus-policy.hpp"
 #include "bm-scope-store.hpp"
 #include "bm-startup-recovery-policy.hpp"
+#include "bm-xmp-sidecar-writer.hpp"
 
 #include <QFile>
 #include <QFileInfo>
@@ -29,6 +30,10 @@ void test_export_profile_defaults()
 	require(profile.enable_premiere_xmp, "default enables Premiere XMP");
 	require(!profile.enable_resolve_fcpxml, "default disables Resolve FCPXML");
 	require(!profile.enable_final_cut_fcpxml, "default disables Final Cut FCPXML");
+	require(!profile.enable_edl_markers && !profile.enable_csv_markers && !profile.enable_youtube_chapters,
+		"default disables the live text exports");
+	require(profile.premiere_embed_writer == bm::PremiereEmbedWriter::Native, "default uses native embed writer");
+	require(!profile.embed_faststart, "default keeps moov where the muxer put it");
 }
 
 void test_export_profile_fallback_values()
@@ -38,12 +43,123 @@ void test_export_profile_fallback_values()
 	json_obj.insert("enableResolveFcpxml", true);
 	json_obj.insert("resolveMode", "unexpected");
 	json_obj.insert("writeCadence", "unexpected");
+	json_obj.insert("premiereEmbedWriter", "unexpected");
 
 	const bm::ExportProfile profile = bm::export_profile_from_json(json_obj);
 	require(!profile.enable_premiere_xmp, "respects explicit Premiere toggle");
 	require(profile.enable_resolve_fcpxml, "respects explicit Resolve toggle");
 	require(profile.resolve_mode == bm::ResolveExportMode::TimelineMarkers, "resolve mode fallback");
 	require(profile.write_cadence == bm::ExportWriteCadence::Immediate, "write cadence fallback");
+	require(profile.premiere_embed_writer == bm::PremiereEmbedWriter::Native, "embed writer fallback");
+}
+
+void test_export_profile_embed_concurrency_is_clamped()
+{
+	QJsonObject json_obj;
+	json_obj.insert("embedMaxConcurrency", 0);
+	json_obj.insert("embedPerDeviceConcurrency", 1000);
+	const bm::ExportProfile profile = bm::export_profile_from_json(json_obj);
+	require(profile.embed_max_concurrency == 1, "embed concurrency lower bound");
+	require(profile.embed_per_device_concurrency == bm::kMaxEmbedConcurrency, "per-device concurrency upper bound");
+}
+
+void test_export_profile_embed_writer_round_trip()
+{
+	bm::ExportProfile profile;
+	profile.premiere_embed_writer = bm::PremiereEmbedWriter::NativeWithExifToolFallback;
+	const QJsonObject json_obj = bm::export_profile_to_json(profile);
+	require(json_obj.value("premiereEmbedWriter").toString() == "native_with_exiftool_fallback",
+		"embed writer serialized");
+	require(bm::export_profile_from_json(json_obj).premiere_embed_writer ==
+			bm::PremiereEmbedWriter::NativeWithExifToolFallback,
+		"embed writer round trip");
+}
+
+void test_export_profile_embed_io_round_trip()
+{
+	bm::ExportProfile profile;
+	profile.embed_io_mode = bm::PremiereEmbedIoMode::Direct;
+	profile.embed_max_throughput_mib_s = 200;
+	profile.embed_faststart = true;
+	const QJsonObject json_obj = bm::export_profile_to_json(profile);
+	require(json_obj.value("embedIoMode").toString() == "direct", "embed io mode serialized");
+	const bm::ExportProfile restored = bm::export_profile_from_json(json_obj);
+	require(restored.embed_io_mode == bm::PremiereEmbedIoMode::Direct, "embed io mode round trip");
+	require(restored.embed_max_throughput_mib_s == 200, "embed throughput cap round trip");
+	require(restored.embed_faststart, "embed faststart round trip");
+
+	QJsonObject invalid;
+	invalid.insert("embedIoMode", "unexpected");
+	invalid.insert("embedMaxThroughputMiBs", -5);
+	const bm::ExportProfile fallback = bm::export_profile_from_json(invalid);
+	require(fallback.embed_io_mode == bm::PremiereEmbedIoMode::PageCache, "embed io mode fallback");
+	require(fallback.embed_max_throughput_mib_s == 0, "negative throughput cap means unlimited");
+}
+
+void test_export_profile_write_cadence_round_trip()
+{
+	bm::ExportProfile profile;
+	profile.write_cadence = bm::ExportWriteCadence::Debounced;
+	profile.write_cadence_ms = 2500;
+	const QJsonObject json_obj = bm::export_profile_to_json(profile);
+	require(json_obj.value("writeCadence").toString() == "debounced", "write cadence serialized");
+	const bm::ExportProfile restored = bm::export_profile_from_json(json_obj);
+	require(restored.write_cadence == bm::ExportWriteCadence::Debounced, "write cadence round trip");
+	require(restored.write_cadence_ms == 2500, "write cadence delay round trip");
+
+	QJsonObject too_short;
+	too_short.insert("writeCadence", "on_recording_close");
+	too_short.insert("writeCadenceMs", 1);
+	const bm::ExportProfile clamped_low = bm::export_profile_from_json(too_short);
+	require(clamped_low.write_cadence == bm::ExportWriteCadence::OnRecordingClose, "on-close cadence parsed");
+	require(clamped_low.write_cadence_ms == bm::kMinWriteCadenceMs, "write cadence delay lower bound");
+
+	QJsonObject too_long;
+	too_long.insert("writeCadence", "interval");
+	too_long.insert("writeCadenceMs", 10000000);
+	const bm::ExportProfile clamped_high = bm::export_profile_from_json(too_long);
+	require(clamped_high.write_cadence == bm::ExportWriteCadence::Interval, "interval cadence parsed");
+	require(clamped_high.write_cadence_ms == bm::kMaxWriteCadenceMs, "write cadence delay upper bound");
+}
+
+void test_export_profile_artifact_durability_round_trip()
+{
+	require(bm::ExportProfile{}.artifact_durability == bm::ArtifactDurability::Grouped,
+		"default groups the syncs of one marker event");
+
+	bm::ExportProfile profile;
+	profile.artifact_durability = bm::ArtifactDurability::Deferred;
+	profile.artifact_sync_window_ms = 5000;
+	const QJsonObject json_obj = bm::export_profile_to_json(profile);
+	require(json_obj.value("artifactDurability").toString() == "deferred", "artifact durability serialized");
+	const bm::ExportProfile restored = bm::export_profile_from_json(json_obj);
+	require(restored.artifact_durability == bm::ArtifactDurability::Deferred, "artifact durability round trip");
+	require(restored.artifact_sync_window_ms == 5000, "artifact sync window round trip");
+
+	QJsonObject out_of_range;
+	out_of_range.insert("artifactDurability", "strict");
+	out_of_range.insert("artifactSyncWindowMs", 0);
+	const bm::ExportProfile clamped_low = bm::export_profile_from_json(out_of_range);
+	require(clamped_low.artifact_durability == bm::ArtifactDurability::Strict, "strict durability parsed");
+	require(clamped_low.artifact_sync_window_ms == bm::kMinArtifactSyncWindowMs, "sync window lower bound");
+	out_of_range.insert("artifactDurability", "unexpected");
+	out_of_range.insert("artifactSyncWindowMs", 10000000);
+	const bm::ExportProfile clamped_high = bm::export_profile_from_json(out_of_range);
+	require(clamped_high.artifact_durability == bm::ArtifactDurability::Grouped, "artifact durability fallback");
+	require(clamped_high.artifact_sync_window_ms == bm::kMaxArtifactSyncWindowMs, "sync window upper bound");
+}
+
+void test_export_profile_live_text_exports_round_trip()
+{
+	bm::ExportProfile profile;
+	profile.enable_edl_markers = true;
+	profile.enable_youtube_chapters = true;
+	const QJsonObject json_obj = bm::export_profile_to_json(profile);
+	require(json_obj.value("enableEdlMarkers").toBool(), "EDL toggle serialized");
+	const bm::ExportProfile restored = bm::export_profile_from_json(json_obj);
+	require(restored.enable_edl_markers, "EDL toggle round trip");
+	require(!restored.enable_csv_markers, "CSV toggle round trip");
+	require(restored.enable_youtube_chapters, "chapters toggle round trip");
 }
 
 void test_scope_store_migration_defaults()
@@ -150,6 +266,25 @@ void test_scope_store_pause_recording_during_dialog_persistence()
 	require(!reloaded.pause_recording_during_marker_dialog(), "persisted pause during dialog value matches");
 }
 
+void test_scope_store_rendered_frame_persistence()
+{
+	QTemporaryDir temp_dir;
+	require(temp_dir.isValid(), "temporary directory created for rendered frame");
+
+	bm::ScopeStore store;
+	store.set_base_dir(temp_dir.path());
+	require(store.load_global(), "load empty global store for rendered frame");
+	require(store.stamp_markers_with_rendered_frame(), "default stamps markers with the rendered frame");
+
+	store.set_stamp_markers_with_rendered_frame(false);
+	require(store.save_global(), "save global store with rendered frame disabled");
+
+	bm::ScopeStore reloaded;
+	reloaded.set_base_dir(temp_dir.path());
+	require(reloaded.load_global(), "reload global store with rendered frame disabled");
+	require(!reloaded.stamp_markers_with_rendered_frame(), "persisted rendered frame value matches");
+}
+
 void test_scope_store_synthetic_keypress_defaults()
 {
 	QTemporaryDir temp_dir;
@@ -284,16 +419,57 @@ void test_startup_recovery_retries_once()
 	require(bm::startup_recovery_retry_attempts() == 1, "startup retry attempts should be exactly one");
 }
 
+void test_startup_recovery_drops_invalid_sidecar()
+{
+	QTemporaryDir temp_dir;
+	require(temp_dir.isValid(), "temporary directory created for startup sidecar validation test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	{
+		QFile media_file(media_path);
+		require(media_file.open(QIODevice::WriteOnly | QIODevice::Truncate), "create mp4 for validation");
+		require(media_file.write("stub") == 4, "write mp4 for validation");
+	}
+
+	bm::MarkerRecord marker;
+	marker.start_frame = 90;
+	marker.guid = "guid-90";
+	const bm::XmpSidecarWriter writer;
+	const QVector<bm::MarkerRecord> markers{marker};
+	QString error;
+	require(writer.write_sidecar(media_path, markers, 30, 1, &error), "write sidecar for validation");
+	bm::StartupRecoveryDecision decision = bm::decide_startup_recovery(media_path);
+	require(bm::validate_startup_sidecar(&decision, &error), "written sidecar should validate");
+	require(decision.action == bm::StartupRecoveryAction::RetryOnce, "valid sidecar should be retried");
+
+	{
+		QFile sidecar_file(decision.sidecar_path);
+		require(sidecar_file.open(QIODevice::WriteOnly | QIODevice::Truncate), "truncate sidecar");
+		require(sidecar_file.write("<x:xmpmeta") == 10, "write torn sidecar");
+	}
+	require(!bm::validate_startup_sidecar(&decision, &error), "torn sidecar should not validate");
+	require(decision.action == bm::StartupRecoveryAction::DropInvalidSidecar, "torn sidecar should be dropped");
+	require(QString(bm::startup_recovery_action_name(decision.action)) == "drop_invalid_sidecar",
+		"invalid sidecar action name");
+}
+
 } // namespace
 
 void run_config_tests()
 {
 	test_export_profile_defaults();
 	test_export_profile_fallback_values();
+	test_export_profile_embed_writer_round_trip();
+	test_export_profile_embed_io_round_trip();
+	test_export_profile_embed_concurrency_is_clamped();
+	test_export_profile_write_cadence_round_trip();
+	test_export_profile_artifact_durability_round_trip();
+	test_export_profile_live_text_exports_round_trip();
 	test_scope_store_migration_defaults();
 	test_scope_store_skipped_update_tag_persistence();
 	test_scope_store_auto_focus_persistence();
 	test_scope_store_pause_recording_during_dialog_persistence();
+	test_scope_store_rendered_frame_persistence();
 	test_scope_store_synthetic_keypress_defaults();
 	test_scope_store_synthetic_keypress_persistence();
 	test_scope_store_synthetic_keypress_empty_values();
@@ -301,4 +477,5 @@ void run_config_tests()
 	test_focus_policy_restore_condition();
 	test_startup_recovery_drops_stale_jobs();
 	test_startup_recovery_retries_once();
+	test_startup_recovery_drops_invalid_sidecar();
 }
@@ -3,9 +3,11 @@
 #include <QFile>
 #include <QTemporaryDir>
 
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 namespace {
@@ -48,6 +50,61 @@ QByteArray valid_single_free_atom_file()
 	return bytes;
 }
 
+QByteArray atom_bytes(const char *type, const QByteArray &payload)
+{
+	QByteArray bytes;
+	const int size = 8 + static_cast<int>(payload.size());
+	bytes.append(static_cast<char>((size >> 24) & 0xFF));
+	bytes.append(static_cast<char>((size >> 16) & 0xFF));
+	bytes.append(static_cast<char>((size >> 8) & 0xFF));
+	bytes.append(static_cast<char>(size & 0xFF));
+	bytes.append(type, 4);
+	bytes.append(payload);
+	return bytes;
+}
+
+quint64 be_value(const QByteArray &bytes, qsizetype offset, int width)
+{
+	quint64 value = 0;
+	for (int i = 0; i < width; ++i)
+		value = (value << 8) | static_cast<unsigned char>(bytes.at(offset + i));
+	return value;
+}
+
+QByteArray be_bytes(quint64 value, int width)
+{
+	QByteArray bytes;
+	for (int shift = (width - 1) * 8; shift >= 0; shift -= 8)
+		bytes.append(static_cast<char>((value >> shift) & 0xFF));
+	return bytes;
+}
+
+// stco (32-bit) or co64 (64-bit) chunk offset table wrapped in trak/mdia/minf/stbl.
+QByteArray chunk_offset_track(const char *type, const QVector<quint64> &offsets)
+{
+	const int width = QByteArray(type) == "co64" ? 8 : 4;
+	QByteArray table = be_bytes(0, 4) + be_bytes(static_cast<quint64>(offsets.size()), 4);
+	for (quint64 offset : offsets)
+		table += be_bytes(offset, width);
+	return atom_bytes("trak", atom_bytes("mdia", atom_bytes("minf", atom_bytes("stbl", atom_bytes(type, table)))));
+}
+
+QVector<quint64> read_chunk_offsets(const QByteArray &file, const char *type)
+{
+	const int width = QByteArray(type) == "co64" ? 8 : 4;
+	const qsizetype table = file.indexOf(type) + 4;
+	QVector<quint64> offsets;
+	const quint64 count = be_value(file, table + 4, 4);
+	for (quint64 i = 0; i < count; ++i)
+		offsets.push_back(be_value(file, table + 8 + static_cast<qsizetype>(i) * width, width));
+	return offsets;
+}
+
+QByteArray xmp_uuid_atom_bytes(const QByteArray &xmp)
+{
+	return atom_bytes("uuid", QByteArray::fromHex("be7acfcb97a942e89c71999491e3afac") + xmp);
+}
+
 QByteArray sample_xmp_payload()
 {
 	return QByteArray(
@@ -167,8 +224,487 @@ void test_fallback_works_when_exiftool_fails()
 	require_embed(qputenv("PATH", test_path), "set PATH for exiftool fallback test");
 
 	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.writer = bm::EmbedWriter::ExifTool;
+	engine.set_options(options);
 	const bm::EmbedResult result = engine.embed_from_sidecar(media_path, sidecar_path);
 	require_embed(result.ok, "embed falls back to internal engine when exiftool exits non-zero");
+	require_embed(result.write_mode != bm::EmbedWriteMode::ExifTool, "fallback reports native write mode");
+}
+
+QByteArray read_file_or_fail(const QString &path, const char *message)
+{
+	QFile file(path);
+	require_embed(file.open(QIODevice::ReadOnly), message);
+	return file.readAll();
+}
+
+void test_in_place_replace_reuses_padding()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for in-place replace test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	const QByteArray old_xmp = sample_xmp_payload() + QByteArray(64, ' ');
+	const QByteArray original = atom_bytes("mdat", QByteArray(32, 'm')) + xmp_uuid_atom_bytes(old_xmp) +
+				    atom_bytes("free", QByteArray(256, '\0'));
+	write_file_or_fail(media_path, original, "write media with existing xmp and padding");
+
+	bm::Mp4MovEmbedEngine engine;
+	const QByteArray new_xmp = sample_xmp_payload() + QByteArray(200, ' ');
+	const bm::EmbedResult result = engine.embed_xmp(media_path, new_xmp);
+	require_embed(result.ok, "in-place replace succeeds");
+	require_embed(result.write_mode == bm::EmbedWriteMode::InPlaceReplace, "replacement used neighbouring padding");
+	require_embed(!QFile::exists(media_path + ".better-markers.tmp"), "in-place replace creates no temp file");
+
+	const QByteArray bytes = read_file_or_fail(media_path, "read in-place replaced media");
+	require_embed(bytes.size() == original.size(), "in-place replace keeps the file size");
+	require_embed(bytes.left(40) == original.left(40), "in-place replace leaves preceding atoms untouched");
+	require_embed(bytes.indexOf(xmp_uuid_atom_bytes(new_xmp)) == 40, "replacement atom written at old offset");
+	require_embed(bytes.mid(40 + xmp_uuid_atom_bytes(new_xmp).size() + 4, 4) == "free", "remainder re-padded");
+}
+
+void test_in_place_append_retires_old_atom()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for in-place append test");
+
+	const QString media_path = temp_dir.path() + "/recording.mov";
+	const QByteArray original = xmp_uuid_atom_bytes(sample_xmp_payload()) + atom_bytes("mdat", QByteArray(32, 'm'));
+	write_file_or_fail(media_path, original, "write media with tight xmp atom");
+
+	bm::Mp4MovEmbedEngine engine;
+	const QByteArray new_xmp = sample_xmp_payload() + QByteArray(512, ' ');
+	const bm::EmbedResult result = engine.embed_xmp(media_path, new_xmp);
+	require_embed(result.ok, "in-place append succeeds");
+	require_embed(result.write_mode == bm::EmbedWriteMode::InPlaceAppend, "oversized replacement appended at EOF");
+
+	const QByteArray bytes = read_file_or_fail(media_path, "read in-place appended media");
+	const QByteArray new_atom = xmp_uuid_atom_bytes(new_xmp);
+	require_embed(bytes.size() == original.size() + new_atom.size(), "append grows file by one atom");
+	require_embed(bytes.mid(4, 4) == "free", "previous xmp atom converted to free");
+	require_embed(bytes.right(new_atom.size()) == new_atom, "new xmp atom written at EOF");
+}
+
+void test_temp_copy_when_in_place_disabled()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for temp copy test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	write_file_or_fail(media_path, valid_single_free_atom_file(), "write valid media file for temp copy test");
+
+	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.allow_in_place = false;
+	engine.set_options(options);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "temp copy embed succeeds");
+	require_embed(result.write_mode == bm::EmbedWriteMode::TempCopy, "temp copy path used when in-place is off");
+	require_embed(result.copy_strategy != bm::CopyStrategy::None, "temp copy reports its copy strategy");
+
+	const QByteArray bytes = read_file_or_fail(media_path, "read temp copied media");
+	require_embed(bytes.left(8) == valid_single_free_atom_file(), "temp copy preserves original atoms");
+	require_embed(bytes.contains("<?xpacket"), "temp copy appends xmp payload");
+}
+
+void test_buffered_copy_when_kernel_copy_disabled()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for buffered copy test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	const QByteArray original = atom_bytes("mdat", QByteArray(3 * 1024 * 1024, 'm'));
+	write_file_or_fail(media_path, original, "write media file for buffered copy test");
+
+	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.allow_in_place = false;
+	options.allow_kernel_copy = false;
+	engine.set_options(options);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "buffered copy embed succeeds");
+	require_embed(result.copy_strategy == bm::CopyStrategy::Buffered, "buffered loop used when kernel copy is off");
+
+	const QByteArray bytes = read_file_or_fail(media_path, "read buffered copied media");
+	require_embed(bytes.left(original.size()) == original, "buffered copy preserves media payload");
+}
+
+void test_atom_walker_finds_nested_xmp()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for atom walker test");
+
+	const QString udta_path = temp_dir.path() + "/udta.mov";
+	const QByteArray udta = atom_bytes("udta", atom_bytes("XMP_", sample_xmp_payload()));
+	const QByteArray moov = atom_bytes("moov", atom_bytes("mvhd", QByteArray(100, '\0')) + udta);
+	write_file_or_fail(udta_path, atom_bytes("mdat", QByteArray(4096, 'm')) + moov, "write moov/udta/XMP_ file");
+	require_embed(bm::Mp4MovEmbedEngine::has_xmp_metadata(udta_path), "walker finds moov/udta/XMP_");
+
+	const QString foreign_uuid_path = temp_dir.path() + "/foreign.mp4";
+	const QByteArray foreign_uuid =
+		atom_bytes("uuid", QByteArray::fromHex("00112233445566778899aabbccddeeff") + sample_xmp_payload());
+	write_file_or_fail(foreign_uuid_path, foreign_uuid + atom_bytes("free", QByteArray()),
+			   "write foreign uuid file");
+	require_embed(!bm::Mp4MovEmbedEngine::has_xmp_metadata(foreign_uuid_path), "walker rejects non-XMP uuid");
+
+	const QString misaligned_path = temp_dir.path() + "/misaligned.mp4";
+	QByteArray broken_moov = moov;
+	broken_moov[8 + 3] = 0x70; // mvhd claims more bytes than moov holds
+	write_file_or_fail(misaligned_path, broken_moov, "write misaligned moov file");
+	require_embed(!bm::Mp4MovEmbedEngine::has_xmp_metadata(misaligned_path), "walker rejects misaligned children");
+}
+
+void test_native_writer_mirrors_udta_xmp()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for udta mirror test");
+
+	const QString media_path = temp_dir.path() + "/recording.mov";
+	const QByteArray mdat = atom_bytes("mdat", QByteArray(32, 'm'));
+	const QByteArray mvhd = atom_bytes("mvhd", QByteArray(100, '\0'));
+	write_file_or_fail(media_path, mdat + atom_bytes("moov", mvhd), "write media with moov at end");
+
+	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.mirror_udta_xmp = true;
+	engine.set_options(options);
+	const QByteArray xmp = sample_xmp_payload();
+	const bm::EmbedResult result = engine.embed_xmp(media_path, xmp);
+	require_embed(result.ok, "native embed with udta mirror succeeds");
+	require_embed(result.udta_mirror_written, "udta mirror reported");
+
+	const QByteArray expected = mdat + atom_bytes("moov", mvhd + atom_bytes("udta", atom_bytes("XMP_", xmp))) +
+				    xmp_uuid_atom_bytes(xmp);
+	require_embed(read_file_or_fail(media_path, "read mirrored media") == expected,
+		      "moov grows by udta/XMP_ and uuid atom follows it");
+}
+
+void test_streaming_and_direct_copy_preserve_media()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for streaming copy test");
+
+	// Odd-sized so the direct path has to finish an unaligned tail through the buffered loop.
+	const QByteArray original = atom_bytes("mdat", QByteArray(5 * 1024 * 1024 + 123, 'm'));
+	const bm::EmbedIoMode modes[] = {bm::EmbedIoMode::Streaming, bm::EmbedIoMode::Direct};
+	for (const bm::EmbedIoMode mode : modes) {
+		const QString media_path = temp_dir.path() + "/" + bm::embed_io_mode_name(mode) + ".mp4";
+		write_file_or_fail(media_path, original, "write media file for streaming copy test");
+
+		bm::Mp4MovEmbedEngine engine;
+		bm::EmbedOptions options;
+		options.allow_in_place = false;
+		options.io_mode = mode;
+		options.max_throughput_mib_s = 1000;
+		engine.set_options(options);
+		const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+		require_embed(result.ok, "streaming/direct embed succeeds");
+		require_embed(result.bytes_written >= static_cast<quint64>(original.size()),
+			      "copied bytes are reported");
+
+		const QByteArray bytes = read_file_or_fail(media_path, "read streamed media");
+		require_embed(bytes.left(original.size()) == original, "streaming/direct copy preserves media payload");
+		require_embed(bytes.mid(original.size()) == xmp_uuid_atom_bytes(sample_xmp_payload()),
+			      "streaming/direct copy appends the xmp atom");
+	}
+}
+
+void test_reflinked_bytes_are_not_paced()
+{
+	using std::chrono::microseconds;
+	constexpr quint64 kCap = 100ULL << 20;
+	constexpr quint64 kTail = 4ULL << 20;
+
+	// A 50 GiB partial clone, then the unaligned tail copied through the kernel or the buffered loop.
+	bm::embed_engine_detail::CopyVolume volume;
+	volume.reflinked_bytes = 50ULL << 30;
+	volume.moved_bytes = kTail;
+	const microseconds tail_budget(kTail * 1000000ULL / kCap);
+	require_embed(volume.written_bytes() == (50ULL << 30) + kTail, "cloned bytes count toward the output");
+	require_embed(bm::embed_engine_detail::copy_pacing_delay(volume, kCap, std::chrono::milliseconds(1)) ==
+			      tail_budget - std::chrono::milliseconds(1),
+		      "only the copied tail is paced after a partial clone");
+	require_embed(bm::embed_engine_detail::copy_pacing_delay(volume, kCap, std::chrono::seconds(1)).count() == 0,
+		      "a copy under the cap does not wait");
+	require_embed(bm::embed_engine_detail::copy_pacing_delay(volume, 0, std::chrono::nanoseconds(0)).count() == 0,
+		      "uncapped copies never wait");
+
+	volume.reflinked_bytes = 0;
+	require_embed(bm::embed_engine_detail::copy_pacing_delay(volume, kCap, std::chrono::nanoseconds(0)) ==
+			      tail_budget,
+		      "moved bytes are paced");
+}
+
+void test_faststart_relocates_moov_and_patches_chunk_offsets()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for faststart test");
+
+	QByteArray samples;
+	for (int i = 0; i < 4096; ++i)
+		samples.append(static_cast<char>(i % 251));
+	const QByteArray ftyp = atom_bytes("ftyp", QByteArray("isom\0\0\0\0isom", 12));
+	const QByteArray head = ftyp + atom_bytes("free", QByteArray());
+	const quint64 samples_at = static_cast<quint64>(head.size()) + 8;
+	const QVector<quint64> stco = {samples_at, samples_at + 100, samples_at + 2000};
+	const QVector<quint64> co64 = {samples_at + 50, samples_at + 4000};
+	const QByteArray tracks = chunk_offset_track("stco", stco) + chunk_offset_track("co64", co64);
+	const QByteArray moov = atom_bytes("moov", atom_bytes("mvhd", QByteArray(100, '\0')) + tracks);
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	write_file_or_fail(media_path, head + atom_bytes("mdat", samples) + moov, "write media with trailing moov");
+
+	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.faststart = true;
+	options.mirror_udta_xmp = true;
+	engine.set_options(options);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "faststart embed succeeds");
+	require_embed(result.write_mode == bm::EmbedWriteMode::Faststart, "faststart write mode reported");
+	require_embed(result.udta_mirror_written, "udta mirror written inside relocated moov");
+
+	const QByteArray bytes = read_file_or_fail(media_path, "read faststart media");
+	const qsizetype moov_at = bytes.indexOf("moov") - 4;
+	const qsizetype xmp_at = bytes.indexOf(QByteArray::fromHex("be7acfcb97a942e89c71999491e3afac")) - 8;
+	const qsizetype mdat_at = bytes.indexOf("mdat") - 4;
+	require_embed(bytes.left(head.size()) == head, "atoms ahead of mdat stay first");
+	require_embed(moov_at == head.size(), "moov follows the file header");
+	require_embed(xmp_at == moov_at + static_cast<qsizetype>(be_value(bytes, moov_at, 4)), "xmp atom follows moov");
+	require_embed(mdat_at > xmp_at && bytes.mid(mdat_at + 8, samples.size()) == samples, "media data moved intact");
+
+	const char *tables[] = {"stco", "co64"};
+	const QVector<quint64> originals[] = {stco, co64};
+	for (int t = 0; t < 2; ++t) {
+		const QVector<quint64> patched = read_chunk_offsets(bytes, tables[t]);
+		require_embed(patched.size() == originals[t].size(), "chunk offset count preserved");
+		for (int i = 0; i < patched.size(); ++i) {
+			const quint64 sample = originals[t].at(i) - samples_at;
+			require_embed(patched.at(i) == static_cast<quint64>(mdat_at) + 8 + sample,
+				      "chunk offset shifted with mdat");
+		}
+	}
+}
+
+void test_faststart_leaves_faststart_files_in_place()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for faststart no-op test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	const QByteArray moov = atom_bytes("moov", chunk_offset_track("stco", {16 + 8}));
+	write_file_or_fail(media_path, moov + atom_bytes("mdat", QByteArray(64, 'm')), "write faststart media");
+
+	bm::Mp4MovEmbedEngine engine;
+	bm::EmbedOptions options;
+	options.faststart = true;
+	engine.set_options(options);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "embed into faststart file succeeds");
+	require_embed(result.write_mode == bm::EmbedWriteMode::InPlaceAppend, "already-faststart file is not copied");
+}
+
+void test_layout_cache_matches_fresh_parse()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for layout cache test");
+
+	const QByteArray larger_xmp = QByteArray("<?xpacket begin=\"\"?><x:xmpmeta xmlns:x=\"adobe:ns:meta/\">") +
+				      QByteArray(300, ' ') + "</x:xmpmeta><?xpacket end=\"w\"?>";
+	const QByteArray payloads[] = {sample_xmp_payload(), larger_xmp, sample_xmp_payload()};
+	const QByteArray moov = atom_bytes("moov", chunk_offset_track("stco", {8 + 8}));
+	const QByteArray original = atom_bytes("free", QByteArray()) + atom_bytes("mdat", QByteArray(256, 'm')) + moov;
+
+	for (int variant = 0; variant < 3; ++variant) {
+		bm::EmbedOptions options;
+		options.allow_in_place = variant != 1;
+		options.faststart = variant == 2;
+
+		const QString cached_path = temp_dir.path() + QString("/cached-%1.mp4").arg(variant);
+		const QString fresh_path = temp_dir.path() + QString("/fresh-%1.mp4").arg(variant);
+		write_file_or_fail(cached_path, original, "write cached layout media");
+		write_file_or_fail(fresh_path, original, "write fresh layout media");
+
+		auto cache = std::make_shared<bm::AtomLayoutCache>();
+		bm::Mp4MovEmbedEngine cached;
+		cached.set_options(options);
+		cached.set_layout_cache(cache);
+		bm::Mp4MovEmbedEngine fresh;
+		fresh.set_options(options);
+		fresh.set_layout_cache(nullptr);
+
+		for (const QByteArray &payload : payloads) {
+			require_embed(cached.embed_xmp(cached_path, payload).ok, "cached-layout embed succeeds");
+			require_embed(fresh.embed_xmp(fresh_path, payload).ok, "fresh-layout embed succeeds");
+			require_embed(read_file_or_fail(cached_path, "read cached layout media") ==
+					      read_file_or_fail(fresh_path, "read fresh layout media"),
+				      "cached layout writes the same bytes as a fresh parse");
+		}
+		require_embed(cache->misses() == 1, "only the first embed parses the file");
+		require_embed(cache->hits() == 2, "later embeds reuse the written layout");
+	}
+}
+
+void test_layout_cache_detects_external_changes()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for cache invalidation test");
+
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+	write_file_or_fail(media_path, valid_single_free_atom_file(), "write media for cache invalidation test");
+
+	auto cache = std::make_shared<bm::AtomLayoutCache>();
+	bm::Mp4MovEmbedEngine engine;
+	engine.set_layout_cache(cache);
+	require_embed(engine.embed_xmp(media_path, sample_xmp_payload()).ok, "first embed succeeds");
+
+	{
+		QFile file(media_path);
+		require_embed(file.open(QIODevice::ReadWrite), "open media for external append");
+		require_embed(file.seek(file.size()), "seek to end for external append");
+		require_embed(file.write(atom_bytes("skip", QByteArray(16, 's'))) == 24, "append external atom");
+	}
+
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "embed after external change succeeds");
+	require_embed(cache->misses() == 2, "changed file is parsed again");
+	const QByteArray bytes = read_file_or_fail(media_path, "read media after external change");
+	require_embed(bytes.contains("skip"), "externally appended atom preserved");
+	require_embed(bm::Mp4MovEmbedEngine::has_xmp_metadata(media_path), "xmp still present after external change");
+}
+
+QByteArray patterned_bytes(int size)
+{
+	QByteArray bytes(size, '\0');
+	for (int i = 0; i < size; ++i)
+		bytes[i] = static_cast<char>(i % 251);
+	return bytes;
+}
+
+// Cancels a buffered temp copy once 3 MiB are out, leaving a temp file and checkpoint behind.
+bm::EmbedResult embed_and_cancel_midway(const QString &media_path, const bm::EmbedOptions &options)
+{
+	std::atomic_bool cancelled{false};
+	bm::EmbedControl control;
+	control.cancelled = &cancelled;
+	control.on_progress = [&cancelled](quint64 bytes_done, quint64) {
+		if (bytes_done >= (3ULL << 20))
+			cancelled = true;
+	};
+
+	bm::Mp4MovEmbedEngine engine;
+	engine.set_options(options);
+	engine.set_control(control);
+	return engine.embed_xmp(media_path, sample_xmp_payload());
+}
+
+void test_cancelled_temp_copy_resumes_from_checkpoint()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for resume test");
+
+	const QByteArray original = atom_bytes("mdat", patterned_bytes(6 * 1024 * 1024 + 321));
+	const QString media_path = temp_dir.path() + "/resume.mp4";
+	const QString temp_path = media_path + ".better-markers.tmp";
+	const QString checkpoint_path = temp_path + ".checkpoint";
+	write_file_or_fail(media_path, original, "write media file for resume test");
+
+	bm::EmbedOptions options;
+	options.allow_in_place = false;
+	options.allow_kernel_copy = false;
+	options.checkpoint_interval_mib = 1;
+
+	std::atomic_bool raised{true};
+	bm::EmbedControl raised_control;
+	raised_control.cancelled = &raised;
+	bm::Mp4MovEmbedEngine raised_engine;
+	raised_engine.set_options(options);
+	raised_engine.set_control(raised_control);
+	const bm::EmbedResult early = raised_engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(!early.ok && early.cancelled && early.retryable, "raised flag cancels before any work");
+	require_embed(!QFile::exists(temp_path), "early cancel leaves no temp file");
+
+	const bm::EmbedResult cancelled = embed_and_cancel_midway(media_path, options);
+	require_embed(!cancelled.ok && cancelled.cancelled && cancelled.retryable, "cancelled copy is retryable");
+	require_embed(QFile::exists(temp_path) && QFile::exists(checkpoint_path),
+		      "cancelled copy keeps temp file and checkpoint");
+	require_embed(read_file_or_fail(media_path, "read media after cancel") == original,
+		      "cancelled copy leaves the recording untouched");
+
+	quint64 last_done = 0;
+	quint64 last_total = 0;
+	bm::EmbedControl control;
+	control.on_progress = [&last_done, &last_total](quint64 bytes_done, quint64 bytes_total) {
+		last_done = bytes_done;
+		last_total = bytes_total;
+	};
+	bm::Mp4MovEmbedEngine engine;
+	engine.set_options(options);
+	engine.set_control(control);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "resumed embed succeeds");
+	require_embed(result.resumed_bytes >= (3ULL << 20), "resumed embed keeps the checkpointed bytes");
+	require_embed(last_total > 0 && last_done == last_total, "progress reaches the total");
+	require_embed(result.bytes_written == last_total - result.resumed_bytes, "only the remainder is written");
+	require_embed(read_file_or_fail(media_path, "read resumed media") ==
+			      original + xmp_uuid_atom_bytes(sample_xmp_payload()),
+		      "resumed output matches a fresh embed");
+	require_embed(!QFile::exists(temp_path) && !QFile::exists(checkpoint_path),
+		      "successful embed removes temp file and checkpoint");
+}
+
+void test_checkpoint_ignored_after_source_changes()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for stale checkpoint test");
+
+	const QByteArray original = atom_bytes("mdat", patterned_bytes(6 * 1024 * 1024 + 321));
+	const QString media_path = temp_dir.path() + "/stale.mp4";
+	write_file_or_fail(media_path, original, "write media file for stale checkpoint test");
+
+	bm::EmbedOptions options;
+	options.allow_in_place = false;
+	options.allow_kernel_copy = false;
+	options.checkpoint_interval_mib = 1;
+	require_embed(embed_and_cancel_midway(media_path, options).cancelled, "first attempt is cancelled");
+
+	const QByteArray changed = original + atom_bytes("free", QByteArray(16, '\0'));
+	write_file_or_fail(media_path, changed, "change media file after cancel");
+
+	bm::Mp4MovEmbedEngine engine;
+	engine.set_options(options);
+	const bm::EmbedResult result = engine.embed_xmp(media_path, sample_xmp_payload());
+	require_embed(result.ok, "embed after source change succeeds");
+	require_embed(result.resumed_bytes == 0, "checkpoint of a changed source is not resumed");
+	require_embed(read_file_or_fail(media_path, "read restarted media") ==
+			      changed + xmp_uuid_atom_bytes(sample_xmp_payload()),
+		      "restarted copy embeds the changed source");
+}
+
+void test_orphaned_temp_copies_are_removed()
+{
+	QTemporaryDir temp_dir;
+	require_embed(temp_dir.isValid(), "temporary directory created for orphan sweep test");
+
+	const QString dir = temp_dir.path();
+	const QStringList files = {"gone.mp4.better-markers.tmp", "gone.mp4.better-markers.tmp.checkpoint",
+				   "pending.mov.better-markers.tmp", "pending.mov.better-markers.tmp.checkpoint",
+				   "replaced.mp4.better-markers.bak", "notes.tmp"};
+	for (const QString &name : files)
+		write_file_or_fail(dir + "/" + name, "x", "write orphan sweep fixture");
+
+	const int removed =
+		bm::Mp4MovEmbedEngine::remove_orphaned_temp_copies(dir, QStringList{dir + "/pending.mov"});
+	require_embed(removed == 2, "only the temp copy and checkpoint without a pending job are removed");
+	require_embed(!QFile::exists(dir + "/gone.mp4.better-markers.tmp") &&
+			      !QFile::exists(dir + "/gone.mp4.better-markers.tmp.checkpoint"),
+		      "orphaned temp copy and checkpoint deleted");
+	require_embed(QFile::exists(dir + "/pending.mov.better-markers.tmp") &&
+			      QFile::exists(dir + "/pending.mov.better-markers.tmp.checkpoint"),
+		      "pending job keeps its resumable copy");
+	require_embed(QFile::exists(dir + "/replaced.mp4.better-markers.bak"), "backups are never swept");
+	require_embed(QFile::exists(dir + "/notes.tmp"), "unrelated files are left alone");
 }
 
 } // namespace
@@ -179,4 +715,19 @@ void run_embed_engine_tests()
 	test_retry_succeeds_after_media_stabilizes();
 	test_empty_sidecar_is_not_retryable();
 	test_fallback_works_when_exiftool_fails();
+	test_in_place_replace_reuses_padding();
+	test_in_place_append_retires_old_atom();
+	test_temp_copy_when_in_place_disabled();
+	test_buffered_copy_when_kernel_copy_disabled();
+	test_atom_walker_finds_nested_xmp();
+	test_native_writer_mirrors_udta_xmp();
+	test_streaming_and_direct_copy_preserve_media();
+	test_reflinked_bytes_are_not_paced();
+	test_faststart_relocates_moov_and_patches_chunk_offsets();
+	test_faststart_leaves_faststart_files_in_place();
+	test_layout_cache_matches_fresh_parse();
+	test_layout_cache_detects_external_changes();
+	test_cancelled_temp_copy_resumes_from_checkpoint();
+	test_checkpoint_ignored_after_source_changes();
+	test_orphaned_temp_copies_are_removed();
 }
@@ -0,0 +1,254 @@
+#include "bm-embed-executor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+void require_executor(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Executor test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// Holds a worker inside a job until released, so tests can queue behind it deterministically.
+class Gate {
+public:
+	void wait_entered()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return m_entered; });
+	}
+
+	void enter_and_wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_entered = true;
+		m_cv.notify_all();
+		m_cv.wait(lock, [this]() { return m_released; });
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_released = true;
+		m_cv.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_entered = false;
+	bool m_released = false;
+};
+
+bm::EmbedConcurrency limits(int max_jobs, int per_device_jobs)
+{
+	bm::EmbedConcurrency concurrency;
+	concurrency.max_jobs = max_jobs;
+	concurrency.per_device_jobs = per_device_jobs;
+	return concurrency;
+}
+
+bm::EmbedResult ok_result()
+{
+	bm::EmbedResult result;
+	result.ok = true;
+	return result;
+}
+
+bm::EmbedExecutorJob blocking_job(const QString &key, Gate *gate, quint64 device = 0)
+{
+	bm::EmbedExecutorJob job;
+	job.key = key;
+	job.device = device;
+	job.task = [gate](const std::atomic_bool &) {
+		gate->enter_and_wait();
+		return ok_result();
+	};
+	return job;
+}
+
+void test_same_file_jobs_are_coalesced()
+{
+	bm::EmbedExecutor executor(limits(1, 1), 8);
+	Gate gate;
+	require_executor(executor.submit(blocking_job("blocker.mp4", &gate)) == bm::EmbedSubmitResult::Queued,
+			 "blocker queued");
+	gate.wait_entered();
+
+	std::atomic_int runs{0};
+	std::atomic_int completions{0};
+	for (int i = 0; i < 3; ++i) {
+		bm::EmbedExecutorJob job;
+		job.key = "recording.mp4";
+		job.task = [&runs](const std::atomic_bool &) {
+			runs.fetch_add(1);
+			return ok_result();
+		};
+		job.on_complete = [&completions](const QString &, const bm::EmbedResult &result) {
+			if (result.ok)
+				completions.fetch_add(1);
+		};
+		const bm::EmbedSubmitResult expected = i == 0 ? bm::EmbedSubmitResult::Queued
+							      : bm::EmbedSubmitResult::Coalesced;
+		require_executor(executor.submit(std::move(job)) == expected, "duplicate submission coalesced");
+	}
+	require_executor(executor.queued_count() == 1, "one queued job per file");
+
+	gate.release();
+	executor.wait_idle();
+	require_executor(runs.load() == 1, "coalesced job runs once");
+	require_executor(completions.load() == 3, "every submitter is notified");
+}
+
+void test_queue_is_bounded()
+{
+	bm::EmbedExecutor executor(limits(1, 1), 1);
+	Gate gate;
+	executor.submit(blocking_job("blocker.mp4", &gate));
+	gate.wait_entered();
+
+	bm::EmbedExecutorJob first;
+	first.key = "a.mp4";
+	first.task = [](const std::atomic_bool &) { return ok_result(); };
+	bm::EmbedExecutorJob second = first;
+	second.key = "b.mp4";
+	require_executor(executor.submit(std::move(first)) == bm::EmbedSubmitResult::Queued, "first job fits");
+	require_executor(executor.submit(std::move(second)) == bm::EmbedSubmitResult::QueueFull,
+			 "queue depth is enforced");
+
+	gate.release();
+	executor.wait_idle();
+}
+
+void test_cancel_group_completes_queued_jobs()
+{
+	bm::EmbedExecutor executor(limits(1, 1), 8);
+	Gate gate;
+	executor.submit(blocking_job("blocker.mp4", &gate));
+	gate.wait_entered();
+
+	std::atomic_bool ran{false};
+	std::atomic_bool cancelled{false};
+	bm::EmbedExecutorJob job;
+	job.key = "recovery.mp4";
+	job.group = "startup-recovery";
+	job.task = [&ran](const std::atomic_bool &) {
+		ran.store(true);
+		return ok_result();
+	};
+	job.on_complete = [&cancelled](const QString &, const bm::EmbedResult &result) {
+		cancelled.store(!result.ok && result.cancelled && result.retryable);
+	};
+	executor.submit(std::move(job));
+
+	require_executor(executor.cancel_group("startup-recovery") == 1, "group cancel matches queued job");
+	require_executor(cancelled.load(), "cancelled job completes with retryable result");
+
+	gate.release();
+	executor.wait_idle();
+	require_executor(!ran.load(), "cancelled job never runs");
+}
+
+void test_running_job_sees_cancellation()
+{
+	bm::EmbedExecutor executor(limits(1, 1), 8);
+	Gate gate;
+	std::atomic_bool saw_flag{false};
+	bm::EmbedExecutorJob job;
+	job.key = "long.mp4";
+	job.task = [&gate, &saw_flag](const std::atomic_bool &is_cancelled) {
+		gate.enter_and_wait();
+		saw_flag.store(is_cancelled.load());
+		return bm::EmbedResult{};
+	};
+	executor.submit(std::move(job));
+	gate.wait_entered();
+
+	require_executor(executor.cancel("long.mp4") == 1, "cancel reaches running job");
+	gate.release();
+	executor.wait_idle();
+	require_executor(saw_flag.load(), "running job observes cancellation flag");
+}
+
+void test_distinct_devices_run_concurrently()
+{
+	// Fake device ids have no sysfs entry, so they get the non-rotational per-device limit.
+	bm::EmbedExecutor executor(limits(4, 1), 8);
+	Gate first_gate;
+	Gate second_gate;
+	executor.submit(blocking_job("disk-a/1.mp4", &first_gate, 101));
+	executor.submit(blocking_job("disk-b/1.mp4", &second_gate, 202));
+	first_gate.wait_entered();
+	second_gate.wait_entered();
+	require_executor(executor.running_count() == 2, "jobs on different devices overlap");
+
+	Gate third_gate;
+	executor.submit(blocking_job("disk-a/2.mp4", &third_gate, 101));
+	require_executor(executor.queued_count() == 1, "second job on a saturated device waits");
+
+	first_gate.release();
+	third_gate.wait_entered();
+	third_gate.release();
+	second_gate.release();
+	executor.wait_idle();
+}
+
+void test_backlog_drains_in_parallel()
+{
+	bm::EmbedExecutor executor(limits(4, 4), 64);
+	std::atomic_int active{0};
+	std::atomic_int peak{0};
+	std::atomic_int done{0};
+	for (int i = 0; i < 30; ++i) {
+		bm::EmbedExecutorJob job;
+		job.key = QString("segment-%1.mp4").arg(i);
+		job.device = 7;
+		job.task = [&active, &peak](const std::atomic_bool &) {
+			const int now = active.fetch_add(1) + 1;
+			int seen = peak.load();
+			while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			active.fetch_sub(1);
+			return ok_result();
+		};
+		job.on_complete = [&done](const QString &, const bm::EmbedResult &) { done.fetch_add(1); };
+		executor.submit(std::move(job));
+	}
+	executor.wait_idle();
+	require_executor(done.load() == 30, "whole backlog completes");
+	require_executor(peak.load() > 1, "backlog uses more than one worker");
+	require_executor(peak.load() <= 4, "backlog respects max_jobs");
+}
+
+void test_shutdown_rejects_new_jobs()
+{
+	bm::EmbedExecutor executor(limits(2, 1), 8);
+	executor.shutdown();
+	bm::EmbedExecutorJob job;
+	job.key = "late.mp4";
+	job.task = [](const std::atomic_bool &) { return ok_result(); };
+	require_executor(executor.submit(std::move(job)) == bm::EmbedSubmitResult::Stopped, "stopped executor rejects");
+}
+
+} // namespace
+
+void run_embed_executor_tests()
+{
+	test_same_file_jobs_are_coalesced();
+	test_queue_is_bounded();
+	test_cancel_group_completes_queued_jobs();
+	test_running_job_sees_cancellation();
+	test_distinct_devices_run_concurrently();
+	test_backlog_drains_in_parallel();
+	test_shutdown_rejects_new_jobs();
+}
@@ -0,0 +1,187 @@
+#include "bm-export-dispatcher.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void require_dispatch(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Export dispatcher test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// The tests carry a per-producer sequence number in the frame rate numerator.
+bm::ExportEvent make_event(bm::ExportEvent::Kind kind, const QString &media_path, int sequence)
+{
+	bm::ExportEvent event;
+	event.kind = kind;
+	event.recording_ctx.media_path = media_path;
+	event.recording_ctx.fps_num = sequence;
+	event.captured_ns = bm::ExportDispatcher::now_ns();
+	return event;
+}
+
+struct Recorder {
+	std::mutex mutex;
+	QVector<bm::ExportEvent> delivered;
+	std::thread::id worker;
+	bool off_worker = false;
+
+	void record(const bm::ExportEvent &event)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (delivered.isEmpty())
+			worker = std::this_thread::get_id();
+		else if (worker != std::this_thread::get_id())
+			off_worker = true;
+		delivered.push_back(event);
+	}
+};
+
+void test_producers_keep_their_order()
+{
+	constexpr int kProducers = 4;
+	constexpr int kEventsPerProducer = 500;
+	Recorder recorder;
+	bm::ExportDispatcher dispatcher([&recorder](const bm::ExportEvent &event) { recorder.record(event); },
+					kProducers * kEventsPerProducer);
+
+	std::vector<std::thread> producers;
+	for (int p = 0; p < kProducers; ++p) {
+		producers.emplace_back([&dispatcher, p]() {
+			const QString path = QString("/tmp/Producer%1.mov").arg(p);
+			for (int i = 0; i < kEventsPerProducer; ++i)
+				require_dispatch(
+					dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, i)),
+					"queue large enough for every event");
+		});
+	}
+	for (std::thread &producer : producers)
+		producer.join();
+	dispatcher.drain();
+
+	require_dispatch(recorder.delivered.size() == kProducers * kEventsPerProducer, "every event delivered");
+	require_dispatch(!recorder.off_worker && recorder.worker != std::this_thread::get_id(),
+			 "events delivered on the worker");
+	uint32_t next[kProducers] = {};
+	for (const bm::ExportEvent &event : recorder.delivered) {
+		const int producer = event.recording_ctx.media_path.mid(QString("/tmp/Producer").size(), 1).toInt();
+		require_dispatch(event.recording_ctx.fps_num == next[producer], "producer order kept");
+		++next[producer];
+	}
+
+	const bm::ExportDispatcher::Metrics metrics = dispatcher.metrics();
+	require_dispatch(metrics.posted == kProducers * kEventsPerProducer, "posted counted");
+	require_dispatch(metrics.delivered == metrics.posted, "delivered counted");
+	require_dispatch(metrics.overflowed == 0 && metrics.coalesced == 0, "nothing overflowed");
+	require_dispatch(metrics.max_depth >= 1 && metrics.max_depth <= kProducers * kEventsPerProducer,
+			 "max depth within capacity");
+	require_dispatch(dispatcher.depth() == 0, "queue empty after drain");
+}
+
+void test_overflow_spills_and_coalesces()
+{
+	constexpr int kCapacity = 4;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool entered = false;
+	bool released = false;
+	QVector<bm::ExportEvent> delivered;
+	bm::ExportDispatcher dispatcher(
+		[&](const bm::ExportEvent &event) {
+			std::unique_lock<std::mutex> lock(mutex);
+			delivered.push_back(event);
+			entered = true;
+			cv.notify_all();
+			cv.wait(lock, [&released]() { return released; });
+		},
+		kCapacity);
+
+	// The first event holds the worker in the callback, so the next ones stay queued.
+	const QString path = "/tmp/Overflow.mov";
+	require_dispatch(dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, 0)), "first event");
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		require_dispatch(cv.wait_for(lock, std::chrono::seconds(10), [&entered]() { return entered; }),
+				 "worker took the first event");
+	}
+	for (int i = 1; i <= kCapacity; ++i)
+		require_dispatch(dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, i)),
+				 "queue has room");
+	require_dispatch(dispatcher.depth() == kCapacity, "queue full");
+
+	// Past capacity: the first spill is kept, later MarkersAdded for the recording merge into it, and the close
+	// (and anything after it) stays behind them in order.
+	require_dispatch(!dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, 10)), "spilled");
+	require_dispatch(!dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, 11)), "coalesced");
+	require_dispatch(!dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, "/tmp/Other.mov", 12)),
+			 "other recording spilled");
+	require_dispatch(!dispatcher.post(make_event(bm::ExportEvent::Kind::RecordingClosed, path, 13)),
+			 "close spilled");
+	require_dispatch(!dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, 14)),
+			 "event after the close spilled");
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released = true;
+	}
+	cv.notify_all();
+	dispatcher.drain();
+
+	const QVector<uint32_t> expected{0, 1, 2, 3, 4, 10, 12, 13, 14};
+	require_dispatch(delivered.size() == expected.size(), "spilled events delivered once");
+	for (qsizetype i = 0; i < expected.size(); ++i)
+		require_dispatch(delivered.at(i).recording_ctx.fps_num == expected.at(i), "spilled events in order");
+	require_dispatch(delivered.at(7).kind == bm::ExportEvent::Kind::RecordingClosed, "close kept its kind");
+
+	const bm::ExportDispatcher::Metrics metrics = dispatcher.metrics();
+	require_dispatch(metrics.posted == 10 && metrics.delivered == 9, "posted and delivered counted");
+	require_dispatch(metrics.overflowed == 5 && metrics.coalesced == 1, "overflow counted");
+	require_dispatch(metrics.max_depth == kCapacity, "max depth is the capacity");
+	require_dispatch(metrics.max_latency_ns > 0, "latency measured");
+
+	// With the overflow delivered, the queue takes events again.
+	require_dispatch(dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, path, 20)), "queue reopened");
+	dispatcher.drain();
+	require_dispatch(delivered.size() == expected.size() + 1, "reopened queue delivers");
+}
+
+void test_stop_delivers_backlog_then_runs_inline()
+{
+	Recorder recorder;
+	bm::ExportDispatcher dispatcher([&recorder](const bm::ExportEvent &event) { recorder.record(event); });
+	for (int i = 0; i < 50; ++i)
+		dispatcher.post(make_event(bm::ExportEvent::Kind::MarkersAdded, "/tmp/Stop.mov", i));
+	dispatcher.stop();
+	require_dispatch(recorder.delivered.size() == 50, "stop delivers what is queued");
+
+	// After stop there is no worker; events are delivered before post returns.
+	require_dispatch(dispatcher.post(make_event(bm::ExportEvent::Kind::RecordingClosed, "/tmp/Stop.mov", 50)),
+			 "post after stop");
+	require_dispatch(recorder.delivered.size() == 51, "post after stop delivers inline");
+	dispatcher.drain();
+	dispatcher.stop();
+	require_dispatch(dispatcher.metrics().delivered == 51, "second stop is a no-op");
+
+	// drain() with nothing posted returns right away.
+	bm::ExportDispatcher idle(nullptr);
+	idle.drain();
+	require_dispatch(idle.metrics().posted == 0, "idle dispatcher");
+}
+
+} // namespace
+
+void run_export_dispatcher_tests()
+{
+	test_producers_keep_their_order();
+	test_overflow_spills_and_coalesces();
+	test_stop_delivers_backlog_then_runs_inline();
+}
@@ -0,0 +1,144 @@
+#include "bm-export-flush-scheduler.hpp"
+
+#include <QVector>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+using Clock = bm::ExportFlushScheduler::Clock;
+using std::chrono::milliseconds;
+
+void require_scheduler(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Flush scheduler test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// Records flushed paths so tests can wait for the scheduler thread.
+class FlushLog {
+public:
+	bm::ExportFlushScheduler::FlushCallback callback()
+	{
+		return [this](const QString &media_path) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_paths.push_back(media_path);
+			m_cv.notify_all();
+		};
+	}
+
+	bool wait_for(int count, milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		return m_cv.wait_for(lock, timeout, [this, count]() { return m_paths.size() >= count; });
+	}
+
+	QVector<QString> paths()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_paths;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	QVector<QString> m_paths;
+};
+
+void test_deadlines()
+{
+	const Clock::time_point first = Clock::time_point(milliseconds(10000));
+	const Clock::time_point last = first + milliseconds(300);
+
+	require_scheduler(bm::ExportFlushScheduler::deadline(bm::ExportWriteCadence::Immediate, 1000, first, last) ==
+				  first,
+			  "immediate is due at once");
+	require_scheduler(bm::ExportFlushScheduler::deadline(bm::ExportWriteCadence::Debounced, 1000, first, last) ==
+				  last + milliseconds(1000),
+			  "debounce waits for a quiet period after the last marker");
+	require_scheduler(bm::ExportFlushScheduler::deadline(bm::ExportWriteCadence::Debounced, 100, first,
+							     first + milliseconds(450)) ==
+				  first + milliseconds(100 * bm::kMaxDebounceFactor),
+			  "debounce is capped after the first marker");
+	require_scheduler(bm::ExportFlushScheduler::deadline(bm::ExportWriteCadence::Interval, 1000, first, last) ==
+				  first + milliseconds(1000),
+			  "interval counts from the first unwritten marker");
+	require_scheduler(bm::ExportFlushScheduler::deadline(bm::ExportWriteCadence::OnRecordingClose, 1000, first,
+							     last) == Clock::time_point::max(),
+			  "on-close is never due by itself");
+}
+
+void test_immediate_cadence_writes_inline()
+{
+	FlushLog log;
+	bm::ExportFlushScheduler scheduler(log.callback());
+	require_scheduler(scheduler.schedule("/rec/a.mp4"), "immediate cadence asks for an inline write");
+	require_scheduler(scheduler.pending_count() == 0, "immediate cadence leaves nothing pending");
+	require_scheduler(!scheduler.flush("/rec/a.mp4"), "nothing to flush after an inline write");
+	require_scheduler(log.paths().isEmpty(), "immediate cadence never calls back");
+}
+
+void test_debounced_cadence_coalesces_per_file()
+{
+	FlushLog log;
+	bm::ExportFlushScheduler scheduler(log.callback());
+	scheduler.set_cadence(bm::ExportWriteCadence::Debounced, bm::kMinWriteCadenceMs);
+	for (int i = 0; i < 5; ++i) {
+		require_scheduler(!scheduler.schedule("/rec/a.mp4"), "debounced cadence defers the write");
+		require_scheduler(!scheduler.schedule("/rec/b.mp4"), "debounced cadence defers the second file");
+	}
+	require_scheduler(scheduler.pending_count() == 2, "one pending entry per file");
+
+	require_scheduler(log.wait_for(2, milliseconds(5000)), "debounced writes happen on the scheduler thread");
+	const QVector<QString> paths = log.paths();
+	require_scheduler(paths.size() == 2, "a burst is written once per file");
+	require_scheduler(paths.contains("/rec/a.mp4") && paths.contains("/rec/b.mp4"), "both files written");
+	require_scheduler(scheduler.pending_count() == 0, "nothing pending after the flush");
+}
+
+void test_on_close_cadence_waits_for_flush()
+{
+	FlushLog log;
+	bm::ExportFlushScheduler scheduler(log.callback());
+	scheduler.set_cadence(bm::ExportWriteCadence::OnRecordingClose, bm::kMinWriteCadenceMs);
+	require_scheduler(!scheduler.schedule("/rec/a.mp4"), "on-close cadence defers the write");
+	require_scheduler(!scheduler.schedule("/rec/b.mp4"), "on-close cadence defers the second file");
+	require_scheduler(!log.wait_for(1, milliseconds(4 * bm::kMinWriteCadenceMs)),
+			  "on-close cadence does not write on a timer");
+
+	require_scheduler(scheduler.flush("/rec/a.mp4"), "closing a file flushes it");
+	require_scheduler(log.paths() == QVector<QString>{"/rec/a.mp4"}, "only the closed file is written");
+	require_scheduler(!scheduler.flush("/rec/a.mp4"), "a flushed file is no longer pending");
+	require_scheduler(scheduler.pending_count() == 1, "the other file stays pending");
+}
+
+void test_stop_flushes_pending_and_writes_inline_afterwards()
+{
+	FlushLog log;
+	{
+		bm::ExportFlushScheduler scheduler(log.callback());
+		scheduler.set_cadence(bm::ExportWriteCadence::Interval, bm::kMaxWriteCadenceMs);
+		require_scheduler(!scheduler.schedule("/rec/a.mp4"), "interval cadence defers the write");
+		scheduler.stop();
+		require_scheduler(log.paths() == QVector<QString>{"/rec/a.mp4"}, "stop flushes pending writes");
+		require_scheduler(scheduler.schedule("/rec/a.mp4"), "a stopped scheduler asks for inline writes");
+	}
+	require_scheduler(log.paths().size() == 1, "destruction after stop writes nothing more");
+}
+
+} // namespace
+
+void run_export_flush_scheduler_tests()
+{
+	test_deadlines();
+	test_immediate_cadence_writes_inline();
+	test_debounced_cadence_coalesces_per_file();
+	test_on_close_cadence_waits_for_flush();
+	test_stop_flushes_pending_and_writes_inline_afterwards();
+}
@@ -43,15 +43,16 @@ void test_final_cut_profile_serialization()
 	marker.start_frame = 45;
 	marker.name = "Intro";
 	marker.comment = "Add lower third";
-	input.markers.push_back(marker);
+	input.markers = QVector<bm::MarkerRecord>{marker};
 
 	const bm::FcpxmlWriter writer;
-	const QString xml = writer.build_document(input);
+	const QByteArray xml = writer.build_document(input);
 
 	require(xml.contains("<fcpxml version=\"1.11\">"), "FCPXML root version");
 	require(xml.contains("<marker start=\"3/2s\" duration=\"1/30s\" value=\"Intro\" note=\"Add lower third\"/>"),
 		"Final Cut clip marker serialization");
 	require(!xml.contains("chapter-marker"), "chapter-marker not emitted in v1");
+	require(xml.contains("tcFormat=\"NDF\""), "30fps sequence uses non-drop timecode");
 }
 
 void test_resolve_profile_serialization()
@@ -66,22 +67,39 @@ void test_resolve_profile_serialization()
 	marker.start_frame = 3;
 	marker.name = "Cutaway";
 	marker.comment = "Switch angle";
-	input.markers.push_back(marker);
+	input.markers = QVector<bm::MarkerRecord>{marker};
 
 	const bm::FcpxmlWriter writer;
-	const QString xml = writer.build_document(input);
+	const QByteArray xml = writer.build_document(input);
 
 	const qsizetype spine_marker_pos = xml.indexOf("<marker start=\"1001/10000s\"");
 	const qsizetype asset_clip_pos = xml.indexOf("<asset-clip ");
 	require(spine_marker_pos >= 0, "Resolve timeline marker present");
 	require(asset_clip_pos >= 0, "Resolve asset clip present");
 	require(spine_marker_pos < asset_clip_pos, "Resolve marker emitted at timeline/spine level");
+	require(xml.contains("tcFormat=\"DF\""), "29.97 sequence uses drop-frame timecode");
 }
 
 } // namespace
 
+void run_append_text_sink_tests();
+void run_artifact_sync_tests();
 void run_config_tests();
 void run_embed_engine_tests();
+void run_embed_executor_tests();
+void run_export_dispatcher_tests();
+void run_export_flush_scheduler_tests();
+void run_frame_rate_tests();
+void run_marker_journal_tests();
+void run_marker_log_tests();
+void run_marker_reader_tests();
+void run_marker_render_cache_tests();
+void run_packet_timeline_tests();
+void run_recording_clock_tests();
+void run_render_frame_clock_tests();
+void run_xmp_sidecar_tests();
+void run_xml_emitter_tests();
+void run_xml_escape_tests();
 
 int main()
 {
@@ -89,7 +107,23 @@ int main()
 	test_artifact_paths();
 	test_final_cut_profile_serialization();
 	test_resolve_profile_serialization();
+	run_append_text_sink_tests();
+	run_artifact_sync_tests();
 	run_config_tests();
 	run_embed_engine_tests();
+	run_embed_executor_tests();
+	run_export_dispatcher_tests();
+	run_export_flush_scheduler_tests();
+	run_frame_rate_tests();
+	run_marker_journal_tests();
+	run_marker_log_tests();
+	run_marker_reader_tests();
+	run_marker_render_cache_tests();
+	run_packet_timeline_tests();
+	run_recording_clock_tests();
+	run_render_frame_clock_tests();
+	run_xmp_sidecar_tests();
+	run_xml_emitter_tests();
+	run_xml_escape_tests();
 	return 0;
 }
@@ -0,0 +1,115 @@
+#include "bm-frame-rate.hpp"
+#include "bm-xml-emitter.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+void require_rate(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Frame rate test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+QString decimal(int64_t value)
+{
+	char buffer[bm::kMaxDecimalSize];
+	const char *const end = bm::write_decimal(buffer, value);
+	return QString::fromLatin1(buffer, static_cast<qsizetype>(end - buffer));
+}
+
+// The gcd reduction the FCPXML writer used before the table.
+QString reference_frame_time(int64_t frame, uint32_t fps_num, uint32_t fps_den)
+{
+	const int64_t num = frame * static_cast<int64_t>(fps_den);
+	const int64_t divisor = std::gcd(num < 0 ? -num : num, static_cast<int64_t>(fps_num));
+	return QString("%1/%2s").arg(num / divisor).arg(static_cast<int64_t>(fps_num) / divisor);
+}
+
+void test_write_decimal()
+{
+	require_rate(decimal(0) == "0", "zero");
+	require_rate(decimal(7) == "7", "one digit");
+	require_rate(decimal(10) == "10", "two digits");
+	require_rate(decimal(-305) == "-305", "negative");
+	require_rate(decimal(1000000007) == "1000000007", "ten digits");
+	require_rate(decimal(std::numeric_limits<int64_t>::max()) == "9223372036854775807", "int64 max");
+	require_rate(decimal(std::numeric_limits<int64_t>::min()) == "-9223372036854775808", "int64 min");
+	for (int64_t value = 1; value < std::numeric_limits<int64_t>::max() / 7; value = value * 7 + 3)
+		require_rate(decimal(value) == QString::number(value), "matches QString::number");
+}
+
+void test_table_matches_gcd_path()
+{
+	for (const bm::CommonFrameRate &common : bm::kCommonFrameRates) {
+		const bm::FrameRate rate = bm::FrameRate::from_obs(common.num, common.den);
+		require_rate(rate.is_common(), "table rate resolved from the table");
+		for (int64_t frame = -3; frame < 5000; ++frame)
+			require_rate(rate.frame_time(frame) == reference_frame_time(frame, common.num, common.den),
+				     "table start time matches the gcd reduction");
+	}
+
+	const bm::FrameRate unreduced = bm::FrameRate::from_obs(60000, 2002);
+	require_rate(unreduced.is_common() && unreduced.num() == 30000 && unreduced.den() == 1001,
+		     "unreduced OBS rate found in the table");
+
+	const bm::FrameRate generic = bm::FrameRate::from_obs(15000, 1001);
+	require_rate(!generic.is_common(), "rate outside the table");
+	require_rate(generic.timebase() == 15 && !generic.drop_frame(), "generic timebase rounded, non-drop");
+	for (int64_t frame = 0; frame < 5000; ++frame)
+		require_rate(generic.frame_time(frame) == reference_frame_time(frame, 15000, 1001),
+			     "generic start time matches the gcd reduction");
+
+	const bm::FrameRate fallback = bm::FrameRate::from_obs(0, 0);
+	require_rate(fallback.num() == 30 && fallback.den() == 1, "zero rate falls back to 30/1");
+}
+
+void test_timebases()
+{
+	require_rate(bm::FrameRate::from_obs(24000, 1001).timebase() == 24, "23.976 timebase");
+	require_rate(bm::FrameRate::from_obs(30000, 1001).timebase() == 30, "29.97 timebase");
+	require_rate(bm::FrameRate::from_obs(60000, 1001).timebase() == 60, "59.94 timebase");
+	require_rate(bm::FrameRate::from_obs(120, 1).timebase() == 120, "120 timebase");
+	require_rate(!bm::FrameRate::from_obs(24000, 1001).drop_frame(), "23.976 is non-drop");
+	require_rate(bm::FrameRate::from_obs(30000, 1001).drop_frame(), "29.97 is drop-frame");
+	require_rate(bm::FrameRate::from_obs(60000, 1001).drop_frame(), "59.94 is drop-frame");
+	require_rate(!bm::FrameRate::from_obs(30, 1).drop_frame(), "30 is non-drop");
+}
+
+void test_timecode()
+{
+	const bm::FrameRate pal = bm::FrameRate::from_obs(25, 1);
+	require_rate(pal.timecode(0) == "00:00:00:00", "zero timecode");
+	require_rate(pal.timecode(-5) == "00:00:00:00", "negative frame clamps");
+	require_rate(pal.timecode(90000 + 25 * 61 + 3) == "01:01:01:03", "non-drop timecode");
+	require_rate(pal.timecode(25 * 3600 * 24) == "00:00:00:00", "hours wrap at 24");
+
+	const bm::FrameRate ntsc = bm::FrameRate::from_obs(30000, 1001);
+	require_rate(ntsc.timecode(1799) == "00:00:59;29", "last frame of the first minute");
+	require_rate(ntsc.timecode(1800) == "00:01:00;02", "frames 0 and 1 skipped at minute one");
+	require_rate(ntsc.timecode(17981) == "00:09:59;29", "last frame before ten minutes");
+	require_rate(ntsc.timecode(17982) == "00:10:00;00", "tenth minute keeps frame 0");
+	require_rate(ntsc.timecode(107892) == "01:00:00;00", "one hour of 29.97 is 107892 frames");
+
+	const bm::FrameRate ntsc60 = bm::FrameRate::from_obs(60000, 1001);
+	require_rate(ntsc60.timecode(3600) == "00:01:00;04", "frames 0-3 skipped at 59.94");
+	require_rate(ntsc60.timecode(215784) == "01:00:00;00", "one hour of 59.94 is 215784 frames");
+
+	const bm::FrameRate fast = bm::FrameRate::from_obs(120, 1);
+	require_rate(fast.timecode(119) == "00:00:00:119", "three-digit frame field");
+}
+
+} // namespace
+
+void run_frame_rate_tests()
+{
+	test_write_decimal();
+	test_table_matches_gcd_path();
+	test_timebases();
+	test_timecode();
+}
@@ -0,0 +1,144 @@
+#include "bm-marker-journal.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+void require_journal(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Marker journal test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+bm::MarkerRecord sample_marker(int i)
+{
+	bm::MarkerRecord marker;
+	marker.start_frame = 30 * (i + 1);
+	marker.duration_frames = i;
+	marker.name = QString("Marker %1 caf\xC3\xA9").arg(i);
+	marker.comment = i % 2 ? QString("note \xE2\x9C\x93") : QString();
+	marker.guid = QString("guid-%1").arg(i);
+	marker.color_id = i % 9;
+	return marker;
+}
+
+bool same_marker(const bm::MarkerRecord &a, const bm::MarkerRecord &b)
+{
+	return a.start_frame == b.start_frame && a.duration_frames == b.duration_frames && a.name == b.name &&
+	       a.comment == b.comment && a.type == b.type && a.guid == b.guid && a.color_id == b.color_id;
+}
+
+void test_round_trip()
+{
+	QTemporaryDir temp_dir;
+	require_journal(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+
+	bm::MarkerJournal journal(temp_dir.path() + "/journal");
+	QString error;
+	for (int i = 0; i < 3; ++i)
+		require_journal(journal.append(media_path, 30000, 1001, sample_marker(i), &error), "marker appended");
+	require_journal(journal.sync(&error), "journal synced");
+
+	bm::MarkerJournal::Recording recording;
+	require_journal(bm::MarkerJournal::read_journal(journal.journal_path_for_media(media_path), &recording, &error),
+			"journal read back");
+	require_journal(recording.media_path == media_path, "media path recorded");
+	require_journal(recording.fps_num == 30000 && recording.fps_den == 1001, "frame rate recorded");
+	require_journal(recording.markers.size() == 3, "every marker recorded");
+	for (int i = 0; i < 3; ++i)
+		require_journal(same_marker(recording.markers.at(i), sample_marker(i)), "marker fields round trip");
+
+	const QVector<bm::MarkerJournal::Recording> all = journal.load_all();
+	require_journal(all.size() == 1 && all.first().media_path == media_path, "load_all finds the journal");
+}
+
+void test_marker_costs_one_small_append()
+{
+	QTemporaryDir temp_dir;
+	require_journal(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+
+	bm::MarkerJournal journal(temp_dir.path() + "/journal");
+	QString error;
+	require_journal(journal.append(media_path, 30, 1, sample_marker(0), &error), "first marker appended");
+	const qint64 size_after_first = QFile(journal.journal_path_for_media(media_path)).size();
+	require_journal(journal.append(media_path, 30, 1, sample_marker(2), &error), "second marker appended");
+	const qint64 record_size = QFile(journal.journal_path_for_media(media_path)).size() - size_after_first;
+	require_journal(record_size > 0 && record_size <= 128, "a marker record is about 100 bytes");
+}
+
+void test_torn_tail_is_dropped()
+{
+	QTemporaryDir temp_dir;
+	require_journal(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/recording.mov";
+	QString journal_path;
+	{
+		bm::MarkerJournal journal(temp_dir.path() + "/journal");
+		QString error;
+		for (int i = 0; i < 4; ++i)
+			require_journal(journal.append(media_path, 60, 1, sample_marker(i), &error), "marker appended");
+		journal_path = journal.journal_path_for_media(media_path);
+	}
+
+	QFile file(journal_path);
+	require_journal(file.open(QIODevice::ReadOnly), "read intact journal");
+	const QByteArray intact = file.readAll();
+	file.close();
+
+	const auto replay_damaged = [&journal_path](const QByteArray &bytes) {
+		QFile damaged(journal_path);
+		require_journal(damaged.open(QIODevice::WriteOnly | QIODevice::Truncate) &&
+					damaged.write(bytes) == bytes.size(),
+				"write damaged journal");
+		damaged.close();
+		bm::MarkerJournal::Recording recording;
+		QString error;
+		require_journal(bm::MarkerJournal::read_journal(journal_path, &recording, &error),
+				"damaged journal still reads");
+		return recording.markers.size();
+	};
+
+	require_journal(replay_damaged(intact.left(intact.size() - 5)) == 3, "replay stops before a torn record");
+	QByteArray flipped = intact;
+	flipped[flipped.size() - 20] = static_cast<char>(flipped.at(flipped.size() - 20) ^ 0x40);
+	require_journal(replay_damaged(flipped) == 3, "replay stops at a checksum mismatch");
+}
+
+void test_remove_and_headerless_journals()
+{
+	QTemporaryDir temp_dir;
+	require_journal(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/recording.mp4";
+
+	bm::MarkerJournal journal(temp_dir.path() + "/journal");
+	QString error;
+	require_journal(journal.append(media_path, 30, 1, sample_marker(0), &error), "marker appended");
+	const QString journal_path = journal.journal_path_for_media(media_path);
+	require_journal(journal.remove(media_path, &error), "journal removed");
+	require_journal(!QFile::exists(journal_path), "journal file deleted");
+
+	QFile stub(journal_path);
+	require_journal(stub.open(QIODevice::WriteOnly | QIODevice::Truncate), "write headerless journal");
+	require_journal(stub.write(QByteArray("BMMJRNL1\x00\x00", 10)) == 10, "headerless journal written");
+	stub.close();
+	require_journal(journal.load_all().isEmpty(), "headerless journal is not a recording");
+	require_journal(!QFile::exists(journal_path), "headerless journal deleted");
+}
+
+} // namespace
+
+void run_marker_journal_tests()
+{
+	test_round_trip();
+	test_marker_costs_one_small_append();
+	test_torn_tail_is_dropped();
+	test_remove_and_headerless_journals();
+}
@@ -0,0 +1,129 @@
+#include "bm-marker-log.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+void require_log(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Marker log test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+bm::MarkerRecord sample_marker(int index)
+{
+	bm::MarkerRecord marker;
+	marker.start_frame = 30 * index;
+	marker.name = QString("Marker %1").arg(index);
+	marker.guid = QString("guid-%1").arg(index);
+	return marker;
+}
+
+bool holds_markers(const bm::MarkerList &list, int count)
+{
+	if (list.size() != count)
+		return false;
+	int index = 0;
+	for (const bm::MarkerRecord &marker : list) {
+		if (marker.start_frame != 30 * index || marker.guid != QString("guid-%1").arg(index))
+			return false;
+		++index;
+	}
+	return index == count;
+}
+
+void test_snapshots_do_not_change()
+{
+	constexpr int kMarkers = 3 * bm::MarkerList::kChunkSize + 5;
+	bm::MarkerLog log;
+	require_log(log.snapshot().isEmpty(), "new log is empty");
+
+	QVector<bm::MarkerList> snapshots;
+	for (int i = 0; i < kMarkers; ++i) {
+		log.append(sample_marker(i));
+		snapshots.push_back(log.snapshot());
+	}
+	require_log(log.size() == kMarkers, "every marker appended");
+
+	// Each snapshot still sees exactly the markers the log held when it was taken, across chunk boundaries.
+	for (int i = 0; i < kMarkers; ++i)
+		require_log(holds_markers(snapshots.at(i), i + 1), "snapshot unchanged by later appends");
+	const bm::MarkerList &full = snapshots.last();
+	require_log(full.first().guid == "guid-0", "first marker");
+	require_log(full.last().guid == QString("guid-%1").arg(kMarkers - 1), "last marker");
+	require_log(full.at(bm::MarkerList::kChunkSize).start_frame == 30 * bm::MarkerList::kChunkSize,
+		    "marker at a chunk boundary");
+	require_log(full.to_vector().size() == kMarkers && full.to_vector().last().guid == full.last().guid,
+		    "copied out to a vector");
+
+	// A snapshot outlives its log.
+	bm::MarkerList kept;
+	{
+		bm::MarkerLog scoped;
+		for (int i = 0; i < 10; ++i)
+			scoped.append(sample_marker(i));
+		kept = scoped.snapshot();
+	}
+	require_log(holds_markers(kept, 10), "snapshot outlives the log");
+}
+
+void test_list_from_vector()
+{
+	QVector<bm::MarkerRecord> markers;
+	for (int i = 0; i < bm::MarkerList::kChunkSize + 1; ++i)
+		markers.push_back(sample_marker(i));
+	const bm::MarkerList list = markers;
+	require_log(holds_markers(list, static_cast<int>(markers.size())), "list built from a vector");
+	markers[0].guid = "changed";
+	require_log(list.first().guid == "guid-0", "list does not share the vector");
+	require_log(bm::MarkerList(QVector<bm::MarkerRecord>()).isEmpty(), "empty vector");
+}
+
+void test_readers_while_appending()
+{
+	constexpr int kMarkers = 20 * bm::MarkerList::kChunkSize;
+	std::mutex mutex;
+	bm::MarkerLog log;
+	std::atomic_bool done{false};
+	std::atomic_bool consistent{true};
+
+	// Readers take snapshots under the owner's lock, then read them without it while the log keeps growing.
+	auto read = [&]() {
+		while (!done.load()) {
+			bm::MarkerList snapshot;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				snapshot = log.snapshot();
+			}
+			if (!holds_markers(snapshot, static_cast<int>(snapshot.size())))
+				consistent.store(false);
+		}
+	};
+	std::thread first_reader(read);
+	std::thread second_reader(read);
+	for (int i = 0; i < kMarkers; ++i) {
+		std::lock_guard<std::mutex> lock(mutex);
+		log.append(sample_marker(i));
+	}
+	done.store(true);
+	first_reader.join();
+	second_reader.join();
+
+	require_log(consistent.load(), "readers only saw complete markers");
+	require_log(holds_markers(log.snapshot(), kMarkers), "every marker appended");
+}
+
+} // namespace
+
+void run_marker_log_tests()
+{
+	test_snapshots_do_not_change();
+	test_list_from_vector();
+	test_readers_while_appending();
+}
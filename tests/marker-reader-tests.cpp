@@ -0,0 +1,235 @@
+#include "bm-fcpxml-reader.hpp"
+#include "bm-xmp-sidecar-reader.hpp"
+#include "bm-xmp-sidecar-writer.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+void require_reader(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Marker reader test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+QByteArray read_file(const QString &path)
+{
+	QFile file(path);
+	require_reader(file.open(QIODevice::ReadOnly), "artifact readable");
+	return file.readAll();
+}
+
+void write_file(const QString &path, const QByteArray &contents)
+{
+	QFile file(path);
+	require_reader(file.open(QIODevice::WriteOnly | QIODevice::Truncate), "artifact writable");
+	require_reader(file.write(contents) == contents.size(), "artifact written");
+}
+
+// Every color id, names and comments that need escaping, and one marker per type the writer distinguishes.
+QVector<bm::MarkerRecord> sample_markers()
+{
+	QVector<bm::MarkerRecord> markers;
+	for (int i = 0; i <= 8; ++i) {
+		bm::MarkerRecord marker;
+		marker.start_frame = 1799 + 1000 * i;
+		marker.name = QString("Marker %1 <\"caf\xC3\xA9\" & 'co'>").arg(i);
+		marker.comment = i % 2 ? QString("line one\nline two \xE2\x9C\x93") : QString();
+		marker.type = i == 3 ? QString("Chapter") : QString("Comment");
+		marker.guid = QString("guid-%1").arg(i);
+		marker.color_id = i;
+		markers.push_back(marker);
+	}
+	return markers;
+}
+
+// XML attribute-value normalization turns the line breaks the writers leave in attributes into spaces.
+QString as_attribute_reads_back(const QString &text)
+{
+	return QString::fromUtf8(text.toUtf8().replace('\n', ' '));
+}
+
+void require_same_xmp_markers(const QVector<bm::MarkerRecord> &read, const QVector<bm::MarkerRecord> &written)
+{
+	require_reader(read.size() == written.size(), "every XMP marker read back");
+	for (int i = 0; i < written.size(); ++i) {
+		require_reader(read.at(i).start_frame == written.at(i).start_frame, "XMP start frame");
+		require_reader(read.at(i).name == written.at(i).name, "XMP name");
+		require_reader(read.at(i).comment == as_attribute_reads_back(written.at(i).comment), "XMP comment");
+		require_reader(read.at(i).type == written.at(i).type, "XMP type");
+		require_reader(read.at(i).guid == written.at(i).guid, "XMP guid");
+		require_reader(read.at(i).color_id == written.at(i).color_id, "XMP color");
+	}
+}
+
+void test_xmp_round_trip()
+{
+	QTemporaryDir temp_dir;
+	require_reader(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/Stream.mp4";
+	const QString sidecar_path = bm::XmpSidecarWriter::sidecar_path_for_media(media_path);
+	const QVector<bm::MarkerRecord> markers = sample_markers();
+	QString error;
+
+	const bm::XmpSidecarWriter writer;
+	require_reader(writer.write_sidecar(media_path, markers, 30000, 1001, &error), "sidecar written");
+	QVector<bm::MarkerRecord> read;
+	bm::XmpSidecarReader::Summary summary;
+	require_reader(bm::XmpSidecarReader::read_markers(sidecar_path, &read, &summary, &error), "sidecar read");
+	require_same_xmp_markers(read, markers);
+	require_reader(summary.timebase == 30 && summary.marker_count == markers.size(), "XMP summary");
+
+	// Spliced sidecars read the same as full writes.
+	bm::XmpSidecarWriter appender;
+	require_reader(appender.append_markers(media_path, markers.mid(0, 4), 60, 1, &error), "first append");
+	require_reader(appender.append_markers(media_path, markers, 60, 1, &error), "splice");
+	require_reader(bm::XmpSidecarReader::read_markers(sidecar_path, &read, &summary, &error), "spliced read");
+	require_same_xmp_markers(read, markers);
+	require_reader(summary.timebase == 60, "spliced XMP timebase");
+
+	int visited = 0;
+	require_reader(bm::XmpSidecarReader::read_file(
+			       sidecar_path, [&visited](const bm::MarkerRecord &) { ++visited; }, nullptr, &error),
+		       "visitor read");
+	require_reader(visited == markers.size(), "visitor sees every marker");
+}
+
+void test_xmp_rejects_broken_sidecars()
+{
+	QTemporaryDir temp_dir;
+	require_reader(temp_dir.isValid(), "temporary directory created");
+	const QString media_path = temp_dir.path() + "/Stream.mov";
+	const QString sidecar_path = bm::XmpSidecarWriter::sidecar_path_for_media(media_path);
+	QString error;
+
+	const bm::XmpSidecarWriter writer;
+	require_reader(writer.write_sidecar(media_path, sample_markers(), 30, 1, &error), "sidecar written");
+	const QByteArray sidecar = read_file(sidecar_path);
+
+	write_file(sidecar_path, sidecar.left(sidecar.size() / 2));
+	require_reader(!bm::XmpSidecarReader::read_file(sidecar_path, nullptr, nullptr, &error), "truncated sidecar");
+	require_reader(error.contains(sidecar_path), "error names the sidecar");
+
+	write_file(sidecar_path, QByteArray(sidecar).replace("xmpDM:startTime=\"1799\"", "xmpDM:startTime=\"soon\""));
+	require_reader(!bm::XmpSidecarReader::read_file(sidecar_path, nullptr, nullptr, &error), "bad start time");
+
+	write_file(sidecar_path, "<xmp/>");
+	require_reader(!bm::XmpSidecarReader::read_file(sidecar_path, nullptr, nullptr, &error), "no marker track");
+
+	require_reader(!bm::XmpSidecarReader::read_file(temp_dir.path() + "/missing.xmp", nullptr, nullptr, &error),
+		       "missing sidecar");
+
+	// An empty marker track is still a valid sidecar.
+	require_reader(writer.write_sidecar(media_path, {}, 30, 1, &error), "empty sidecar written");
+	bm::XmpSidecarReader::Summary summary;
+	require_reader(bm::XmpSidecarReader::read_file(sidecar_path, nullptr, &summary, &error), "empty sidecar read");
+	require_reader(summary.marker_count == 0 && summary.timebase == 30, "empty sidecar summary");
+}
+
+void test_fcpxml_round_trip(bm::FcpxmlProfile profile, uint32_t fps_num, uint32_t fps_den)
+{
+	QTemporaryDir temp_dir;
+	require_reader(temp_dir.isValid(), "temporary directory created");
+
+	bm::FcpxmlDocumentInput input;
+	input.profile = profile;
+	input.media_path = temp_dir.path() + "/My Stream #1.mov";
+	input.fps_num = fps_num;
+	input.fps_den = fps_den;
+	QVector<bm::MarkerRecord> markers = sample_markers();
+	markers[1].name = "  ";
+	markers[2].name = " padded ";
+	input.markers = markers;
+
+	const QString path = bm::FcpxmlWriter::artifact_path_for_media(input.media_path, profile);
+	const bm::FcpxmlWriter writer;
+	QString error;
+	require_reader(writer.write_document(path, input, &error), "FCPXML written");
+
+	QVector<bm::MarkerRecord> read;
+	bm::FcpxmlDocumentInfo info;
+	require_reader(bm::FcpxmlReader::read_markers(path, &read, &info, &error), "FCPXML read");
+	require_reader(info.profile == profile, "FCPXML profile from the marker placement");
+	require_reader(info.media_path == input.media_path, "FCPXML media path from the asset URL");
+	const bm::FrameRate rate = bm::FrameRate::from_obs(fps_num, fps_den);
+	require_reader(info.fps_num == rate.num() && info.fps_den == rate.den(), "FCPXML rate from the format");
+	require_reader(info.drop_frame == rate.drop_frame(), "FCPXML drop-frame flag");
+	require_reader(info.marker_count == input.markers.size() && read.size() == input.markers.size(),
+		       "every FCPXML marker read back");
+	for (int i = 0; i < read.size(); ++i) {
+		require_reader(read.at(i).start_frame == input.markers.at(i).start_frame, "FCPXML start frame");
+		require_reader(read.at(i).comment == as_attribute_reads_back(input.markers.at(i).comment),
+			       "FCPXML comment");
+	}
+	require_reader(read.at(0).name == input.markers.at(0).name, "FCPXML name");
+	require_reader(read.at(1).name == "Marker", "blank name reads back as the placeholder");
+	require_reader(read.at(2).name == "padded", "name reads back trimmed");
+}
+
+void test_fcpxml_rejects_broken_documents()
+{
+	QTemporaryDir temp_dir;
+	require_reader(temp_dir.isValid(), "temporary directory created");
+	bm::FcpxmlDocumentInput input;
+	input.media_path = temp_dir.path() + "/Stream.mp4";
+	input.markers = sample_markers();
+	const QString path = temp_dir.path() + "/broken.fcpxml";
+	const QByteArray document = bm::FcpxmlWriter().build_document(input);
+	QString error;
+
+	write_file(path, document.left(document.size() - 40));
+	require_reader(!bm::FcpxmlReader::read_file(path, nullptr, nullptr, &error), "truncated FCPXML");
+
+	write_file(path, QByteArray(document).replace("frameDuration=\"1/30s\"", "frameDuration=\"fast\""));
+	require_reader(!bm::FcpxmlReader::read_file(path, nullptr, nullptr, &error), "bad frame duration");
+
+	write_file(path, "<fcpxml><spine><marker start=\"1s\"/></spine></fcpxml>");
+	require_reader(!bm::FcpxmlReader::read_file(path, nullptr, nullptr, &error), "marker before the format");
+}
+
+// True when time parses and lands on frame expected.
+bool reads_as_frame(const QString &time, uint32_t fps_num, uint32_t fps_den, int64_t expected)
+{
+	int64_t frame = -1;
+	return bm::FcpxmlReader::frame_from_rational_time(time, fps_num, fps_den, &frame) && frame == expected;
+}
+
+void test_rational_times()
+{
+	require_reader(reads_as_frame("0s", 30, 1, 0), "zero");
+	require_reader(reads_as_frame("0/1s", 30, 1, 0), "zero over one");
+	require_reader(reads_as_frame("3/2s", 30, 1, 45), "one and a half seconds");
+	require_reader(reads_as_frame("1001/10000s", 30000, 1001, 3), "NTSC frame");
+	require_reader(reads_as_frame("1/60s", 30, 1, 1), "half a frame rounds up");
+	require_reader(reads_as_frame("1/61s", 30, 1, 0), "under half a frame rounds down");
+	require_reader(!reads_as_frame("1/0s", 30, 1, 0), "zero denominator");
+	require_reader(!reads_as_frame("1/2", 30, 1, 15), "missing unit");
+	require_reader(!reads_as_frame("x/2s", 30, 1, 0), "not a number");
+	require_reader(!reads_as_frame("9223372036854775807s", 30, 1, 0), "overflow rejected");
+
+	for (const bm::CommonFrameRate &common : bm::kCommonFrameRates) {
+		const bm::FrameRate rate = bm::FrameRate::from_obs(common.num, common.den);
+		for (int64_t frame = 0; frame < 2000; frame += 7)
+			require_reader(reads_as_frame(rate.frame_time(frame), common.num, common.den, frame),
+				       "frame_time round trip");
+	}
+}
+
+} // namespace
+
+void run_marker_reader_tests()
+{
+	test_xmp_round_trip();
+	test_xmp_rejects_broken_sidecars();
+	test_fcpxml_round_trip(bm::FcpxmlProfile::FinalCutClipMarkers, 30, 1);
+	test_fcpxml_round_trip(bm::FcpxmlProfile::ResolveTimelineMarkers, 30000, 1001);
+	test_fcpxml_round_trip(bm::FcpxmlProfile::ResolveTimelineMarkers, 24000, 1001);
+	test_fcpxml_rejects_broken_documents();
+	test_rational_times();
+}
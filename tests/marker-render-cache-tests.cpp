@@ -0,0 +1,135 @@
+#include "bm-fcpxml-writer.hpp"
+#include "bm-marker-render-cache.hpp"
+#include "bm-xmp-sidecar-writer.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+void require_cache(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Marker render cache test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+QVector<bm::MarkerRecord> sample_markers(int count)
+{
+	QVector<bm::MarkerRecord> markers;
+	for (int i = 0; i < count; ++i) {
+		bm::MarkerRecord marker;
+		marker.start_frame = 90 * (i + 1);
+		marker.name = QString("Marker %1 <caf\xC3\xA9>").arg(i);
+		marker.comment = QString("note & %1").arg(i);
+		marker.guid = QString("guid-%1").arg(i);
+		marker.color_id = i % 9;
+		markers.push_back(marker);
+	}
+	return markers;
+}
+
+bm::FcpxmlDocumentInput fcpxml_input(bm::FcpxmlProfile profile, const QVector<bm::MarkerRecord> &markers,
+				     bm::MarkerRenderCache *render_cache)
+{
+	bm::FcpxmlDocumentInput input;
+	input.profile = profile;
+	input.media_path = "/tmp/recording.mp4";
+	input.markers = markers;
+	input.fps_num = 30000;
+	input.fps_den = 1001;
+	input.render_cache = render_cache;
+	return input;
+}
+
+void test_cached_fcpxml_matches_uncached()
+{
+	const QVector<bm::MarkerRecord> markers = sample_markers(4);
+	bm::FcpxmlWriter writer;
+	bm::MarkerRenderCache cache;
+	for (bm::FcpxmlProfile profile :
+	     {bm::FcpxmlProfile::FinalCutClipMarkers, bm::FcpxmlProfile::ResolveTimelineMarkers}) {
+		const QByteArray uncached = writer.build_document(fcpxml_input(profile, markers, nullptr));
+		require_cache(writer.build_document(fcpxml_input(profile, markers, &cache)) == uncached,
+			      "first cached build matches");
+		require_cache(writer.build_document(fcpxml_input(profile, markers, &cache)) == uncached,
+			      "second cached build matches");
+	}
+	// Both profiles share the <marker/> fragment.
+	require_cache(cache.render_count() == 4, "each marker rendered once across builds and profiles");
+	require_cache(cache.size() == 4, "one entry per marker");
+}
+
+void test_only_new_and_edited_markers_render()
+{
+	QVector<bm::MarkerRecord> markers = sample_markers(3);
+	bm::FcpxmlWriter writer;
+	bm::MarkerRenderCache cache;
+	writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	require_cache(cache.render_count() == 3, "initial markers rendered");
+
+	markers.push_back(sample_markers(4).last());
+	writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	require_cache(cache.render_count() == 4, "only the appended marker rendered");
+
+	markers[1].name = "Renamed";
+	const QByteArray edited =
+		writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	require_cache(cache.render_count() == 5, "edited marker rendered again");
+	require_cache(edited.contains("value=\"Renamed\""), "edited marker text written");
+	require_cache(edited == writer.build_document(
+					fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, nullptr)),
+		      "edited document matches uncached");
+
+	bm::FcpxmlDocumentInput input = fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache);
+	input.fps_num = 60;
+	input.fps_den = 1;
+	const QByteArray retimed = writer.build_document(input);
+	require_cache(cache.render_count() == 9, "frame rate change renders every marker again");
+	input.render_cache = nullptr;
+	require_cache(retimed == writer.build_document(input), "retimed document matches uncached");
+}
+
+void test_xmp_and_fcpxml_fragments_coexist()
+{
+	const QVector<bm::MarkerRecord> markers = sample_markers(3);
+	bm::FcpxmlWriter fcpxml_writer;
+	bm::XmpSidecarWriter xmp_writer;
+	bm::MarkerRenderCache cache;
+
+	QByteArray first_xmp;
+	bm::XmlEmitter first(&first_xmp);
+	xmp_writer.emit_document(first, markers, 30, 1, &cache);
+	fcpxml_writer.build_document(fcpxml_input(bm::FcpxmlProfile::ResolveTimelineMarkers, markers, &cache));
+	require_cache(cache.render_count() == 6, "each marker rendered once per fragment");
+
+	QByteArray second_xmp;
+	bm::XmlEmitter second(&second_xmp);
+	xmp_writer.emit_document(second, markers, 30, 1, &cache);
+	fcpxml_writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	require_cache(cache.render_count() == 6, "neither fragment evicts the other");
+	require_cache(second_xmp == first_xmp, "cached XMP items are reused byte for byte");
+	require_cache(first_xmp.contains("Marker 1 &lt;caf\xC3\xA9&gt;"), "cached XMP item carries the marker name");
+}
+
+void test_markers_without_guid_bypass_cache()
+{
+	QVector<bm::MarkerRecord> markers = sample_markers(2);
+	markers[0].guid.clear();
+	bm::FcpxmlWriter writer;
+	bm::MarkerRenderCache cache;
+	writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	writer.build_document(fcpxml_input(bm::FcpxmlProfile::FinalCutClipMarkers, markers, &cache));
+	require_cache(cache.size() == 1 && cache.render_count() == 1, "guid-less marker is never cached");
+}
+
+} // namespace
+
+void run_marker_render_cache_tests()
+{
+	test_cached_fcpxml_matches_uncached();
+	test_only_new_and_edited_markers_render();
+	test_xmp_and_fcpxml_fragments_coexist();
+	test_markers_without_guid_bypass_cache();
+}
@@ -0,0 +1,288 @@
+#include "bm-packet-timeline.hpp"
+#include "bm-recording-clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void require_timeline(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Packet timeline test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+constexpr uint64_t kRecordingStartNs = 5 * kNsPerSecond;
+
+// A synthetic encoder: frames are rendered on a steady clock, grouped behind a P frame with b_frames B frames each,
+// and every packet of a group leaves the encoder latency_ns after the group's last frame was rendered.
+struct StreamShape {
+	uint32_t fps_num = 60000;
+	uint32_t fps_den = 1001;
+	uint64_t b_frames = 0;
+	uint64_t latency_ns = 0;
+	// Every nth packet carries its composition time; 0 for none.
+	uint64_t composed_every = 1;
+	// Frame f is rendered (f % 3) * jitter_ns late.
+	uint64_t jitter_ns = 0;
+};
+
+uint64_t pts_ns(const StreamShape &shape, uint64_t frame)
+{
+	return bm::mul_div_ceil(frame, shape.fps_den * kNsPerSecond, shape.fps_num);
+}
+
+uint64_t render_ns(const StreamShape &shape, uint64_t frame)
+{
+	return kRecordingStartNs + pts_ns(shape, frame) + (frame % 3) * shape.jitter_ns;
+}
+
+// The frame on screen at now_ns.
+int64_t frame_on_screen(const StreamShape &shape, uint64_t now_ns)
+{
+	uint64_t frame = bm::mul_div_floor(now_ns - kRecordingStartNs, shape.fps_num, shape.fps_den * kNsPerSecond) + 1;
+	while (frame > 0 && render_ns(shape, frame) > now_ns)
+		--frame;
+	return static_cast<int64_t>(frame);
+}
+
+std::vector<bm::PacketSample> encode(const StreamShape &shape, uint64_t frames)
+{
+	std::vector<bm::PacketSample> packets;
+	const int64_t frame_usec = static_cast<int64_t>(shape.fps_den * 1000000ull / shape.fps_num);
+	const int64_t reorder_depth = static_cast<int64_t>(shape.b_frames);
+	auto emit_frame = [&](uint64_t frame, uint64_t received_ns) {
+		bm::PacketSample sample;
+		sample.dts_usec = (static_cast<int64_t>(packets.size()) - reorder_depth) * frame_usec;
+		sample.pts_ns = pts_ns(shape, frame);
+		sample.received_ns = received_ns;
+		if (shape.composed_every != 0 && packets.size() % shape.composed_every == 0)
+			sample.composed_ns = render_ns(shape, frame);
+		packets.push_back(sample);
+	};
+
+	emit_frame(0, render_ns(shape, 0) + shape.latency_ns);
+	for (uint64_t anchor = shape.b_frames + 1; anchor < frames; anchor += shape.b_frames + 1) {
+		const uint64_t received_ns = render_ns(shape, anchor) + shape.latency_ns;
+		emit_frame(anchor, received_ns);
+		for (uint64_t frame = anchor - shape.b_frames; frame < anchor; ++frame)
+			emit_frame(frame, received_ns);
+	}
+	return packets;
+}
+
+// What the packet callback would have recorded by now_ns: the newest packets already received.
+bm::PacketFrameEstimate estimate_live(const StreamShape &shape, const std::vector<bm::PacketSample> &packets,
+				      uint64_t now_ns)
+{
+	std::vector<bm::PacketSample> received;
+	for (const bm::PacketSample &packet : packets) {
+		if (packet.received_ns <= now_ns)
+			received.push_back(packet);
+	}
+	const size_t keep = std::min(received.size(), bm::PacketTimeline::kCapacity);
+	return bm::estimate_packet_frame(received.data() + received.size() - keep, keep, now_ns, shape.fps_num,
+					 shape.fps_den);
+}
+
+void test_composition_times_remove_encoder_latency()
+{
+	// Two B frames and 700 ms of lookahead: the newest packet is about 42 frames behind the screen.
+	StreamShape shape;
+	shape.b_frames = 2;
+	shape.latency_ns = 700000000;
+	const std::vector<bm::PacketSample> packets = encode(shape, 1200);
+
+	const uint64_t end_ns = render_ns(shape, 1100);
+	for (uint64_t now_ns = kRecordingStartNs + 4 * kNsPerSecond; now_ns < end_ns; now_ns += 7300011) {
+		const bm::PacketFrameEstimate estimate = estimate_live(shape, packets, now_ns);
+		require_timeline(estimate.valid && estimate.latency_measured, "measured estimate");
+		require_timeline(estimate.frame == frame_on_screen(shape, now_ns), "frame on screen at the trigger");
+		require_timeline(estimate.error_frames == 0.0, "steady clock has no error");
+	}
+}
+
+void test_b_frame_reordering_is_undone()
+{
+	// Without composition times or lookahead, packets arrive in decode order as each P frame is rendered.
+	StreamShape shape;
+	shape.b_frames = 3;
+	shape.composed_every = 0;
+	const std::vector<bm::PacketSample> packets = encode(shape, 600);
+
+	for (uint64_t now_ns = kRecordingStartNs + kNsPerSecond; now_ns < render_ns(shape, 590); now_ns += 3100007) {
+		const bm::PacketFrameEstimate estimate = estimate_live(shape, packets, now_ns);
+		require_timeline(estimate.valid && !estimate.latency_measured, "arrival-only estimate");
+		require_timeline(estimate.frame == frame_on_screen(shape, now_ns), "reordering does not delay");
+	}
+
+	// The latest packet's dts, which the tracker used before, trails the screen by the reorder depth.
+	const uint64_t now_ns = render_ns(shape, 400) + 1;
+	const bm::PacketFrameEstimate estimate = estimate_live(shape, packets, now_ns);
+	int64_t latest_dts_usec = 0;
+	for (const bm::PacketSample &packet : packets) {
+		if (packet.received_ns <= now_ns)
+			latest_dts_usec = packet.dts_usec;
+	}
+	const int64_t dts_frame = latest_dts_usec * shape.fps_num / (shape.fps_den * 1000000ll);
+	require_timeline(estimate.frame == 400 && dts_frame < 400 - 2, "dts frame lags");
+}
+
+void test_unreported_latency_shows_as_lag()
+{
+	StreamShape shape;
+	shape.latency_ns = pts_ns(shape, 30);
+	shape.composed_every = 0;
+	const std::vector<bm::PacketSample> packets = encode(shape, 300);
+	const uint64_t now_ns = render_ns(shape, 200) + 1000;
+	const bm::PacketFrameEstimate estimate = estimate_live(shape, packets, now_ns);
+	require_timeline(estimate.valid && !estimate.latency_measured, "latency not measured");
+	require_timeline(estimate.frame == 170, "frame trails by the latency");
+
+	// One packet in eight reporting its composition time is enough to correct the rest.
+	shape.composed_every = 8;
+	shape.b_frames = 2;
+	const std::vector<bm::PacketSample> sparse = encode(shape, 300);
+	for (uint64_t now = render_ns(shape, 60); now < render_ns(shape, 280); now += 5300003) {
+		const bm::PacketFrameEstimate corrected = estimate_live(shape, sparse, now);
+		require_timeline(corrected.valid && corrected.latency_measured, "latency measured");
+		require_timeline(corrected.frame == frame_on_screen(shape, now), "latency applied to every packet");
+	}
+}
+
+void test_interpolation_and_error_estimate()
+{
+	StreamShape shape;
+	shape.jitter_ns = 2000000;
+	const std::vector<bm::PacketSample> packets = encode(shape, 400);
+
+	// Inside the window the frames bracketing the trigger were composed, so jitter does not move the answer.
+	const bm::PacketSample *window = packets.data() + 272;
+	for (uint64_t frame = 300; frame < 360; ++frame) {
+		const uint64_t shown_ns = render_ns(shape, frame);
+		const uint64_t replaced_ns = render_ns(shape, frame + 1) - 1;
+		const bm::PacketFrameEstimate start = bm::estimate_packet_frame(window, 128, shown_ns, 60000, 1001);
+		const bm::PacketFrameEstimate end = bm::estimate_packet_frame(window, 128, replaced_ns, 60000, 1001);
+		require_timeline(start.frame == static_cast<int64_t>(frame) && end.frame == start.frame,
+				 "interpolated between bracketing frames");
+		require_timeline(start.error_frames > 0.0 && start.error_frames < 0.5, "jitter reported");
+	}
+
+	// Carried forward past the newest frame, the estimate stays within a frame.
+	for (uint64_t now_ns = render_ns(shape, 300); now_ns < render_ns(shape, 390); now_ns += 4100009) {
+		const bm::PacketFrameEstimate estimate = estimate_live(shape, packets, now_ns);
+		const int64_t truth = frame_on_screen(shape, now_ns);
+		require_timeline(estimate.frame >= truth - 1 && estimate.frame <= truth + 1, "carried within a frame");
+	}
+}
+
+void test_estimate_rejects_unmapped_triggers()
+{
+	StreamShape shape;
+	const std::vector<bm::PacketSample> packets = encode(shape, 200);
+	const bm::PacketSample *window = packets.data() + 72;
+
+	require_timeline(!bm::estimate_packet_frame(window, 0, render_ns(shape, 150), 60000, 1001).valid, "no packets");
+	require_timeline(!bm::estimate_packet_frame(window, 128, render_ns(shape, 150), 0, 1001).valid, "zero rate");
+	require_timeline(!bm::estimate_packet_frame(window, 128, render_ns(shape, 71), 60000, 1001).valid,
+			 "trigger older than the window");
+	const uint64_t limit_ns = render_ns(shape, 199) + 5 * kNsPerSecond;
+	require_timeline(bm::estimate_packet_frame(window, 128, limit_ns, 60000, 1001).valid,
+			 "five seconds past the newest frame");
+	require_timeline(!bm::estimate_packet_frame(window, 128, limit_ns + 1, 60000, 1001).valid,
+			 "too far past the newest frame");
+
+	// A lone packet is carried forward with a frame of error.
+	const bm::PacketFrameEstimate lone =
+		bm::estimate_packet_frame(packets.data() + 10, 1, render_ns(shape, 12), 60000, 1001);
+	require_timeline(lone.valid && lone.frame == 12 && lone.error_frames >= 1.0, "single packet");
+}
+
+bm::PacketSample numbered_sample(uint64_t index)
+{
+	bm::PacketSample sample;
+	sample.dts_usec = static_cast<int64_t>(index);
+	sample.pts_ns = index * 1000;
+	sample.received_ns = index * 1000 + 7;
+	sample.composed_ns = index * 1000 + 3;
+	return sample;
+}
+
+void test_ring_keeps_newest_packets()
+{
+	bm::PacketTimeline timeline;
+	bm::PacketSample samples[bm::PacketTimeline::kCapacity];
+	require_timeline(timeline.snapshot(samples) == 0, "empty ring");
+
+	for (uint64_t i = 1; i <= 1000; ++i)
+		timeline.record(numbered_sample(i));
+	require_timeline(timeline.snapshot(samples) == bm::PacketTimeline::kCapacity, "ring is full");
+	const uint64_t oldest = 1000 - bm::PacketTimeline::kCapacity + 1;
+	for (size_t i = 0; i < bm::PacketTimeline::kCapacity; ++i)
+		require_timeline(samples[i].dts_usec == static_cast<int64_t>(oldest + i), "oldest first");
+
+	timeline.reset();
+	require_timeline(timeline.snapshot(samples) == 0, "reset drops every packet");
+	timeline.record(numbered_sample(1001));
+	timeline.record(numbered_sample(1002));
+	require_timeline(timeline.snapshot(samples) == 2 && samples[0].dts_usec == 1001 && samples[1].dts_usec == 1002,
+			 "packets after reset");
+}
+
+void test_ring_reads_are_consistent()
+{
+	bm::PacketTimeline timeline;
+	std::atomic_bool done{false};
+	std::atomic_bool inconsistent{false};
+	auto read = [&]() {
+		bm::PacketSample samples[bm::PacketTimeline::kCapacity];
+		while (!done.load()) {
+			const size_t count = timeline.snapshot(samples);
+			for (size_t i = 0; i < count; ++i) {
+				const uint64_t index = static_cast<uint64_t>(samples[i].dts_usec);
+				const bm::PacketSample expected = numbered_sample(index);
+				const bm::PacketSample &sample = samples[i];
+				if (sample.pts_ns != expected.pts_ns || sample.received_ns != expected.received_ns ||
+				    sample.composed_ns != expected.composed_ns ||
+				    (i > 0 && samples[i - 1].dts_usec + 1 != sample.dts_usec))
+					inconsistent.store(true);
+			}
+		}
+	};
+	std::thread first_reader(read);
+	std::thread second_reader(read);
+	std::thread resetter([&]() {
+		while (!done.load()) {
+			timeline.reset();
+			std::this_thread::yield();
+		}
+	});
+	for (uint64_t i = 1; i <= 200000; ++i)
+		timeline.record(numbered_sample(i));
+	done.store(true);
+	first_reader.join();
+	second_reader.join();
+	resetter.join();
+
+	require_timeline(!inconsistent.load(), "snapshots are contiguous and untorn");
+}
+
+} // namespace
+
+void run_packet_timeline_tests()
+{
+	test_composition_times_remove_encoder_latency();
+	test_b_frame_reordering_is_undone();
+	test_unreported_latency_shows_as_lag();
+	test_interpolation_and_error_estimate();
+	test_estimate_rejects_unmapped_triggers();
+	test_ring_keeps_newest_packets();
+	test_ring_reads_are_consistent();
+}
@@ -0,0 +1,169 @@
+#include "bm-recording-clock.hpp"
+#include "bm-seqlock.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace {
+
+void require_clock(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Recording clock test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+
+bm::RecordingClockState running_at(uint32_t fps_num, uint32_t fps_den)
+{
+	bm::RecordingClockState state;
+	state.active = true;
+	state.start_ns = 1000;
+	state.fps_num = fps_num;
+	state.fps_den = fps_den;
+	return state;
+}
+
+void test_mul_div_is_exact()
+{
+	const uint64_t max = std::numeric_limits<uint64_t>::max();
+	require_clock(bm::mul_div_floor(0, 123, 7) == 0, "zero product");
+	require_clock(bm::mul_div_floor(max, max, max) == max, "full-width product");
+	require_clock(bm::mul_div_floor(max, 2, 3) == max / 3 * 2, "product above 64 bits");
+	require_clock(bm::mul_div_floor(max, 2, 1) == max, "quotient saturates");
+
+	// The portable fallback agrees with the native 128-bit path across magnitudes.
+	uint64_t seed = 0x9e3779b97f4a7c15u;
+	auto next = [&seed]() {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		return seed;
+	};
+	for (int i = 0; i < 20000; ++i) {
+		const uint64_t a = next() >> (next() % 64);
+		const uint64_t b = next() >> (next() % 64);
+		const uint64_t c = (next() >> (next() % 64)) | 1;
+		require_clock(bm::recording_clock_detail::mul_div_floor_portable(a, b, c) == bm::mul_div_floor(a, b, c),
+			      "portable mul_div matches");
+	}
+}
+
+void test_mul_div_ceil()
+{
+	require_clock(bm::mul_div_ceil(6, 5, 3) == 10, "exact division");
+	require_clock(bm::mul_div_ceil(7, 5, 3) == 12, "rounds up");
+	// One frame of 29.97 in nanoseconds, from a 1001/30000 timebase.
+	require_clock(bm::mul_div_ceil(1, 1001 * kNsPerSecond, 30000) == 33366667, "timebase tick");
+	const uint64_t max = std::numeric_limits<uint64_t>::max();
+	require_clock(bm::mul_div_ceil(max, 2, 1) == max, "ceil saturates");
+}
+
+void test_frame_boundaries_stay_exact()
+{
+	// 59.94 for up to thirty days: each frame starts exactly on its boundary.
+	const bm::RecordingClockState state = running_at(60000, 1001);
+	for (uint64_t frame : {1ull, 2ull, 59ull, 60ull, 3600ull * 60, 155366233ull, 155366234ull}) {
+		const uint64_t at = state.start_ns + bm::mul_div_ceil(frame, 1001 * kNsPerSecond, 60000);
+		const int64_t expected = static_cast<int64_t>(frame);
+		require_clock(bm::wall_clock_frame_at(state, at) == expected, "frame starts on time");
+		require_clock(bm::wall_clock_frame_at(state, at - 1) == expected - 1, "previous nanosecond");
+	}
+	require_clock(bm::wall_clock_frame_at(state, state.start_ns) == 0, "start is frame zero");
+	require_clock(bm::wall_clock_frame_at(state, 0) == 0, "before start clamps to zero");
+
+	bm::RecordingClockState invalid = state;
+	invalid.fps_den = 0;
+	require_clock(bm::wall_clock_frame_at(invalid, state.start_ns + kNsPerSecond) == 0, "zero rate");
+	require_clock(!bm::within_packet_drift(invalid, 0, 0), "zero rate has no drift window");
+}
+
+void test_pauses_are_excluded()
+{
+	bm::RecordingClockState state = running_at(30, 1);
+	state.total_paused_ns = 2 * kNsPerSecond;
+	const uint64_t now = state.start_ns + 10 * kNsPerSecond;
+	require_clock(bm::wall_clock_frame_at(state, now) == 8 * 30, "ended pauses subtracted");
+
+	state.paused = true;
+	state.pause_start_ns = state.start_ns + 9 * kNsPerSecond;
+	require_clock(bm::wall_clock_frame_at(state, now) == 7 * 30, "pause in progress subtracted");
+
+	state.total_paused_ns = 20 * kNsPerSecond;
+	require_clock(bm::wall_clock_frame_at(state, now) == 0, "paused longer than elapsed");
+}
+
+void test_packet_drift_window()
+{
+	// Three seconds at 29.97 is 90 frames.
+	const bm::RecordingClockState state = running_at(30000, 1001);
+	require_clock(bm::within_packet_drift(state, 2997, 2907), "90 frames behind");
+	require_clock(bm::within_packet_drift(state, 2997, 3087), "90 frames ahead");
+	require_clock(!bm::within_packet_drift(state, 2997, 2906), "91 frames behind");
+
+	// Low rates still allow 30 frames of drift.
+	const bm::RecordingClockState slow = running_at(5, 1);
+	require_clock(bm::within_packet_drift(slow, 500, 470), "minimum drift window");
+	require_clock(!bm::within_packet_drift(slow, 500, 469), "beyond minimum drift window");
+}
+
+struct Sample {
+	uint64_t first = 0;
+	uint64_t second = 0;
+	uint64_t third = 0;
+	uint32_t fourth = 0;
+};
+
+void test_seqlock_reads_are_consistent()
+{
+	bm::Seqlock<Sample> seqlock;
+	require_clock(seqlock.load().first == 0 && seqlock.load().fourth == 0, "default value");
+
+	std::atomic_bool done{false};
+	std::atomic_bool torn{false};
+	auto read = [&]() {
+		uint64_t last = 0;
+		while (!done.load()) {
+			const Sample sample = seqlock.load();
+			if (sample.first == 0)
+				continue;
+			if (sample.second != sample.first * 3 || sample.third != ~sample.first ||
+			    sample.fourth != static_cast<uint32_t>(sample.first) || sample.first < last)
+				torn.store(true);
+			last = sample.first;
+		}
+	};
+	std::thread first_reader(read);
+	std::thread second_reader(read);
+	for (uint64_t i = 1; i <= 200000; ++i) {
+		Sample sample;
+		sample.first = i;
+		sample.second = i * 3;
+		sample.third = ~i;
+		sample.fourth = static_cast<uint32_t>(i);
+		seqlock.store(sample);
+	}
+	done.store(true);
+	first_reader.join();
+	second_reader.join();
+
+	require_clock(!torn.load(), "no torn or stale reads");
+	require_clock(seqlock.load().first == 200000, "last store visible");
+}
+
+} // namespace
+
+void run_recording_clock_tests()
+{
+	test_mul_div_is_exact();
+	test_mul_div_ceil();
+	test_frame_boundaries_stay_exact();
+	test_pauses_are_excluded();
+	test_packet_drift_window();
+	test_seqlock_reads_are_consistent();
+}
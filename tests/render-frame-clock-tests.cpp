@@ -0,0 +1,173 @@
+#include "bm-packet-timeline.hpp"
+#include "bm-recording-clock.hpp"
+#include "bm-render-frame-clock.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void require_render_clock(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Render frame clock test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+constexpr uint64_t kNsPerSecond = 1000000000;
+constexpr uint32_t kFpsNum = 60000;
+constexpr uint32_t kFpsDen = 1001;
+
+uint64_t frame_interval_ns()
+{
+	return bm::mul_div_floor(kFpsDen, kNsPerSecond, kFpsNum);
+}
+
+void test_midpoint_of_fresh_frame()
+{
+	bm::RenderTick tick;
+	tick.frames = 10;
+	tick.frame_time_ns = 7 * kNsPerSecond;
+
+	uint64_t out = 0;
+	require_render_clock(bm::rendered_frame_midpoint(tick, tick.frame_time_ns + 3000000, kFpsNum, kFpsDen, &out),
+			     "fresh frame");
+	require_render_clock(out == tick.frame_time_ns + 8341666, "middle of a 59.94 fps frame");
+
+	require_render_clock(bm::rendered_frame_midpoint(tick, tick.frame_time_ns - 5, 30, 1, &out),
+			     "trigger read before the frame time");
+	require_render_clock(out == tick.frame_time_ns + 16666666, "middle of a 30 fps frame");
+}
+
+void test_midpoint_rejects_unusable_ticks()
+{
+	bm::RenderTick tick;
+	uint64_t out = 42;
+	require_render_clock(!bm::rendered_frame_midpoint(tick, kNsPerSecond, kFpsNum, kFpsDen, &out),
+			     "never ticked");
+
+	tick.frames = 1;
+	tick.frame_time_ns = kNsPerSecond;
+	require_render_clock(!bm::rendered_frame_midpoint(tick, 2 * kNsPerSecond + 1, kFpsNum, kFpsDen, &out),
+			     "stale frame");
+	require_render_clock(!bm::rendered_frame_midpoint(tick, kNsPerSecond, 0, 1, &out), "zero rate");
+	require_render_clock(!bm::rendered_frame_midpoint(tick, kNsPerSecond, 30, 0, &out), "zero denominator");
+	require_render_clock(out == 42, "rejected ticks leave the output alone");
+	require_render_clock(bm::rendered_frame_midpoint(tick, 2 * kNsPerSecond, kFpsNum, kFpsDen, &out),
+			     "a second old is still usable");
+}
+
+void test_clock_counts_ticks_and_costs()
+{
+	bm::RenderFrameClock clock;
+	require_render_clock(clock.load().frames == 0, "starts empty");
+
+	clock.tick(100);
+	clock.record_callback_cost(300);
+	clock.tick(200);
+	clock.record_callback_cost(900);
+	clock.tick(300);
+	clock.record_callback_cost(120);
+
+	const bm::RenderTick tick = clock.load();
+	require_render_clock(tick.frames == 3 && tick.frame_time_ns == 300, "latest tick");
+	const bm::RenderFrameClockMetrics metrics = clock.metrics();
+	require_render_clock(metrics.ticks == 3, "tick count");
+	require_render_clock(metrics.callback_ns == 1320, "total callback time");
+	require_render_clock(metrics.max_callback_ns == 900, "peak callback time");
+}
+
+void test_clock_reads_are_consistent()
+{
+	bm::RenderFrameClock clock;
+	constexpr uint64_t kBaseNs = 3 * kNsPerSecond;
+	constexpr uint64_t kTicks = 200000;
+	std::atomic<bool> done{false};
+	std::atomic<bool> torn{false};
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 3; ++i) {
+		readers.emplace_back([&]() {
+			uint64_t last_frames = 0;
+			while (!done.load(std::memory_order_acquire)) {
+				const bm::RenderTick tick = clock.load();
+				if (tick.frames == 0)
+					continue;
+				if (tick.frame_time_ns != kBaseNs + tick.frames * frame_interval_ns() ||
+				    tick.frames < last_frames)
+					torn.store(true);
+				last_frames = tick.frames;
+			}
+		});
+	}
+
+	for (uint64_t frame = 1; frame <= kTicks; ++frame)
+		clock.tick(kBaseNs + frame * frame_interval_ns());
+	done.store(true, std::memory_order_release);
+	for (std::thread &reader : readers)
+		reader.join();
+
+	require_render_clock(!torn.load(), "readers never see a torn or older tick");
+	require_render_clock(clock.load().frames == kTicks, "every tick counted");
+}
+
+// A trigger stamped with the frame on screen maps to exactly that frame, even when the encoder's composition times
+// stray from the video clock by up to a third of a frame; the raw trigger time lands on a neighbour.
+void test_midpoint_maps_to_the_frame_on_screen()
+{
+	constexpr uint64_t kStartNs = 20 * kNsPerSecond;
+	constexpr uint64_t kLatencyNs = 45000000;
+	const uint64_t interval = frame_interval_ns();
+	const uint64_t skew = interval / 3;
+	auto video_clock_ns = [&](uint64_t frame) {
+		return kStartNs + bm::mul_div_ceil(frame, kFpsDen * kNsPerSecond, kFpsNum);
+	};
+
+	std::vector<bm::PacketSample> packets;
+	for (uint64_t frame = 0; frame < 120; ++frame) {
+		bm::PacketSample sample;
+		sample.pts_ns = bm::mul_div_ceil(frame, kFpsDen * kNsPerSecond, kFpsNum);
+		// Alternate frames are reported early and late.
+		sample.composed_ns = (frame % 2) != 0 ? video_clock_ns(frame) + skew : video_clock_ns(frame) - skew;
+		sample.received_ns = sample.composed_ns + kLatencyNs;
+		packets.push_back(sample);
+	}
+
+	int raw_misses = 0;
+	for (uint64_t frame = 20; frame < 100; ++frame) {
+		bm::RenderTick tick;
+		tick.frames = frame + 1;
+		tick.frame_time_ns = video_clock_ns(frame);
+		// Late in the frame's display, where the skewed composition times of the next frame already cover it.
+		const uint64_t trigger_ns = tick.frame_time_ns + interval - interval / 10;
+
+		uint64_t stamped_ns = 0;
+		require_render_clock(bm::rendered_frame_midpoint(tick, trigger_ns, kFpsNum, kFpsDen, &stamped_ns),
+				     "midpoint available");
+		const bm::PacketFrameEstimate stamped =
+			bm::estimate_packet_frame(packets.data(), packets.size(), stamped_ns, kFpsNum, kFpsDen);
+		require_render_clock(stamped.valid && stamped.frame == static_cast<int64_t>(frame),
+				     "stamped trigger maps to the frame on screen");
+
+		const bm::PacketFrameEstimate raw =
+			bm::estimate_packet_frame(packets.data(), packets.size(), trigger_ns, kFpsNum, kFpsDen);
+		if (!raw.valid || raw.frame != static_cast<int64_t>(frame))
+			++raw_misses;
+	}
+	require_render_clock(raw_misses > 0, "raw trigger times are affected by the skew");
+}
+
+} // namespace
+
+void run_render_frame_clock_tests()
+{
+	test_midpoint_of_fresh_frame();
+	test_midpoint_rejects_unusable_ticks();
+	test_clock_counts_ticks_and_costs();
+	test_clock_reads_are_consistent();
+	test_midpoint_maps_to_the_frame_on_screen();
+}
@@ -0,0 +1,97 @@
+#include "bm-xml-emitter.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+void require_emitter(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// The QString escape both writers used before the emitter; text() must produce the same bytes.
+QByteArray legacy_escape_utf8(const QString &value)
+{
+	QString escaped = value;
+	escaped.replace('&', "&amp;");
+	escaped.replace('<', "&lt;");
+	escaped.replace('>', "&gt;");
+	escaped.replace('"', "&quot;");
+	escaped.replace('\'', "&apos;");
+	return escaped.toUtf8();
+}
+
+void test_text_escapes_while_transcoding()
+{
+	const QString samples[] = {
+		QString(),
+		QString("plain ascii"),
+		QString("a&b<c>\"d'e"),
+		QString("caf\xC3\xA9 \xE2\x9C\x93 \xF0\x9F\x8E\xAC <cut>"),
+		QString("\xC2\xA0&\xE2\x80\xAF'\xF0\x9F\x98\x80\""),
+	};
+
+	QByteArray buffer;
+	for (const QString &sample : samples) {
+		bm::XmlEmitter xml(&buffer);
+		xml.text(sample);
+		require_emitter(xml.bytes() == legacy_escape_utf8(sample), "text matches escaped QString::toUtf8");
+	}
+
+	const char16_t lone_surrogates[] = {u'a', 0xD800, u'b', 0xDC00};
+	bm::XmlEmitter xml(&buffer);
+	xml.text(QString::fromUtf16(lone_surrogates, 4));
+	require_emitter(xml.bytes() == "a?b?", "lone surrogates become '?'");
+}
+
+void test_numbers_and_attributes()
+{
+	QByteArray buffer;
+	bm::XmlEmitter xml(&buffer);
+	xml.raw("<m").attribute("start", int64_t(0)).attribute("end", int64_t(-42));
+	xml.attribute("min", std::numeric_limits<int64_t>::min()).attribute("name", QString("\"Intro\" & more"));
+	xml.raw("/>");
+	require_emitter(xml.bytes() == "<m start=\"0\" end=\"-42\" min=\"-9223372036854775808\""
+				       " name=\"&quot;Intro&quot; &amp; more\"/>",
+			"attributes render numbers and escaped text");
+}
+
+void test_arena_keeps_capacity_between_documents()
+{
+	qsizetype first_capacity = 0;
+	const char *first_data = nullptr;
+	{
+		bm::XmlArena arena;
+		bm::XmlEmitter xml(arena.buffer());
+		for (int i = 0; i < 1000; ++i)
+			xml.raw("<rdf:li/>\n");
+		first_capacity = arena.buffer()->capacity();
+		first_data = arena.buffer()->constData();
+		require_emitter(xml.size() == 10000, "arena document size");
+
+		bm::XmlArena nested;
+		require_emitter(nested.buffer() != arena.buffer(), "nested arena gets its own buffer");
+	}
+
+	bm::XmlArena arena;
+	require_emitter(arena.buffer()->isEmpty(), "reused arena starts empty");
+	require_emitter(arena.buffer()->capacity() >= first_capacity, "reused arena keeps its capacity");
+	bm::XmlEmitter xml(arena.buffer());
+	xml.raw("<rdf:li/>\n");
+	require_emitter(arena.buffer()->constData() == first_data, "reused arena writes into the same allocation");
+}
+
+} // namespace
+
+void run_xml_emitter_tests()
+{
+	test_text_escapes_while_transcoding();
+	test_numbers_and_attributes();
+	test_arena_keeps_capacity_between_documents();
+}
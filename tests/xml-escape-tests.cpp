@@ -0,0 +1,105 @@
+#include "bm-xml-emitter.hpp"
+#include "bm-xml-escape.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+void require_escape(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+// The five QString::replace passes both writers used before the emitter.
+QByteArray legacy_escape_utf8(const QString &value)
+{
+	QString escaped = value;
+	escaped.replace('&', "&amp;");
+	escaped.replace('<', "&lt;");
+	escaped.replace('>', "&gt;");
+	escaped.replace('"', "&quot;");
+	escaped.replace('\'', "&apos;");
+	return escaped.toUtf8();
+}
+
+// Every stop unit at every offset of runs long enough to cross the 16- and 32-unit SIMD blocks and their tails.
+void test_kernels_stop_at_first_unit_needing_work()
+{
+	const char16_t stops[] = {u'&', u'<', u'>', u'"', u'\'', 0x0080, 0x00E9, 0x4E2D, 0xD83C, 0xFF3C};
+	for (const bm::xml_escape_detail::Kernel &kernel : bm::xml_escape_detail::available_kernels()) {
+		for (int size = 0; size <= 80; ++size) {
+			std::vector<char16_t> units(static_cast<size_t>(size));
+			for (int i = 0; i < size; ++i)
+				units[static_cast<size_t>(i)] = static_cast<char16_t>(u' ' + (i * 7) % 95);
+			for (char16_t &unit : units) {
+				if (unit == u'&' || unit == u'<' || unit == u'>' || unit == u'"' || unit == u'\'')
+					unit = u'x';
+			}
+
+			QByteArray plain_bytes;
+			for (const char16_t unit : units)
+				plain_bytes.append(static_cast<char>(unit));
+
+			std::vector<char> out(static_cast<size_t>(size) + 1, '\0');
+			require_escape(kernel.copy_plain(units.data(), size, out.data()) == size,
+				       "plain run is copied whole");
+			require_escape(QByteArray(out.data(), size) == plain_bytes, "plain run bytes match");
+
+			for (int position = 0; position < size; ++position) {
+				for (const char16_t stop : stops) {
+					std::vector<char16_t> stopped = units;
+					stopped[static_cast<size_t>(position)] = stop;
+					require_escape(kernel.copy_plain(stopped.data(), size, out.data()) == position,
+						       "kernel stops at the first unit needing work");
+					require_escape(QByteArray(out.data(), position) == plain_bytes.left(position),
+						       "bytes before the stop match");
+				}
+			}
+		}
+	}
+}
+
+void test_emitter_matches_legacy_escape()
+{
+	const char *pieces[] = {"Marker ",
+				"&",
+				"<b>",
+				"\"quoted\"",
+				"'",
+				"caf\xC3\xA9",
+				"\xE2\x9C\x93",
+				"\xF0\x9F\x8E\xAC",
+				"  ",
+				"0123456789abcdef0123456789abcdef",
+				"&amp;",
+				"\xE4\xB8\xAD\xE6\x96\x87"};
+	const int piece_count = static_cast<int>(sizeof(pieces) / sizeof(pieces[0]));
+
+	quint32 seed = 12345;
+	QByteArray buffer;
+	for (int sample = 0; sample < 500; ++sample) {
+		QString value;
+		const int count = sample % 24;
+		for (int i = 0; i < count; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			value += QString(pieces[(seed >> 16) % piece_count]);
+		}
+
+		bm::XmlEmitter xml(&buffer);
+		xml.text(value);
+		require_escape(xml.bytes() == legacy_escape_utf8(value), "emitter text matches the legacy escape");
+	}
+}
+
+} // namespace
+
+void run_xml_escape_tests()
+{
+	test_kernels_stop_at_first_unit_needing_work();
+	test_emitter_matches_legacy_escape();
+}
@@ -0,0 +1,113 @@
+#include "bm-xmp-sidecar-writer.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+void require_sidecar(bool condition, const char *message)
+{
+	if (condition)
+		return;
+	std::cerr << "Test failed: " << message << std::endl;
+	std::exit(1);
+}
+
+QByteArray read_file_or_fail(const QString &path, const char *message)
+{
+	QFile file(path);
+	require_sidecar(file.open(QIODevice::ReadOnly), message);
+	return file.readAll();
+}
+
+void write_file_or_fail(const QString &path, const QByteArray &contents, const char *message)
+{
+	QFile file(path);
+	require_sidecar(file.open(QIODevice::WriteOnly | QIODevice::Truncate), message);
+	require_sidecar(file.write(contents) == contents.size(), message);
+}
+
+// Colorless markers render deterministically (color keywords carry a random UUID), so outputs compare byte for byte.
+QVector<bm::MarkerRecord> sample_markers(int count)
+{
+	QVector<bm::MarkerRecord> markers;
+	for (int i = 0; i < count; ++i) {
+		bm::MarkerRecord marker;
+		marker.start_frame = 30 * (i + 1);
+		marker.name = QString("Marker %1 <\"caf\xC3\xA9\" & co>").arg(i);
+		marker.comment = i % 2 ? QString("note \xE2\x9C\x93") : QString();
+		marker.guid = QString("guid-%1").arg(i);
+		markers.push_back(marker);
+	}
+	return markers;
+}
+
+QByteArray full_sidecar(const QTemporaryDir &temp_dir, const QVector<bm::MarkerRecord> &markers)
+{
+	const QString reference_media = temp_dir.path() + "/reference.mp4";
+	const bm::XmpSidecarWriter writer;
+	QString error;
+	require_sidecar(writer.write_sidecar(reference_media, markers, 30, 1, &error), "reference sidecar written");
+	return read_file_or_fail(bm::XmpSidecarWriter::sidecar_path_for_media(reference_media),
+				 "read reference sidecar");
+}
+
+void test_incremental_appends_match_full_rebuild()
+{
+	QTemporaryDir temp_dir;
+	require_sidecar(temp_dir.isValid(), "temporary directory created for incremental sidecar test");
+
+	const QString media_path = temp_dir.path() + "/session.mp4";
+	const QString sidecar_path = bm::XmpSidecarWriter::sidecar_path_for_media(media_path);
+	const QVector<bm::MarkerRecord> all_markers = sample_markers(6);
+
+	bm::XmpSidecarWriter writer;
+	for (int count = 1; count <= all_markers.size(); ++count) {
+		const QVector<bm::MarkerRecord> markers = all_markers.mid(0, count);
+		QString error;
+		require_sidecar(writer.append_markers(media_path, markers, 30, 1, &error),
+				"incremental append succeeds");
+		require_sidecar(read_file_or_fail(sidecar_path, "read incremental sidecar") ==
+					full_sidecar(temp_dir, markers),
+				"incremental sidecar matches a full rebuild");
+	}
+
+	QString error;
+	require_sidecar(writer.finalize_sidecar(media_path, &error), "finalize succeeds");
+	require_sidecar(read_file_or_fail(sidecar_path, "read finalized sidecar") ==
+				full_sidecar(temp_dir, all_markers),
+			"finalized sidecar matches a full rebuild");
+}
+
+void test_changed_sidecar_or_frame_rate_takes_full_write()
+{
+	QTemporaryDir temp_dir;
+	require_sidecar(temp_dir.isValid(), "temporary directory created for sidecar fallback test");
+
+	const QString media_path = temp_dir.path() + "/fallback.mp4";
+	const QString sidecar_path = bm::XmpSidecarWriter::sidecar_path_for_media(media_path);
+	const QVector<bm::MarkerRecord> markers = sample_markers(3);
+
+	bm::XmpSidecarWriter writer;
+	QString error;
+	require_sidecar(writer.append_markers(media_path, markers.mid(0, 2), 30, 1, &error), "initial append");
+	write_file_or_fail(sidecar_path, "clobbered", "clobber sidecar");
+	require_sidecar(writer.append_markers(media_path, markers, 30, 1, &error), "append after external change");
+	require_sidecar(read_file_or_fail(sidecar_path, "read rewritten sidecar") == full_sidecar(temp_dir, markers),
+			"externally changed sidecar is rewritten in full");
+
+	require_sidecar(writer.append_markers(media_path, markers, 60, 1, &error), "append after frame rate change");
+	require_sidecar(read_file_or_fail(sidecar_path, "read 60 fps sidecar").contains("xmpDM:frameRate=\"f60\""),
+			"frame rate change rewrites the header");
+}
+
+} // namespace
+
+void run_xmp_sidecar_tests()
+{
+	test_incremental_appends_match_full_rebuild();
+	test_changed_sidecar_or_frame_rate_takes_full_write();
+}